@@ -17,9 +17,7 @@ let package = Package(
             path: ".",
             sources: [
                 "src",
-                "lib/crypto-algorithms/aes.c",
-                "lib/crypto-algorithms/sha256.c",
-                "lib/curve25519-donna/curve25519-donna.c"
+                "lib/crypto-algorithms/aes.c"
             ],
             cSettings: [
                 .headerSearchPath("lib"),
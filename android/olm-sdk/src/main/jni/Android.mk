@@ -30,27 +30,36 @@ $(LOCAL_PATH)/$(SRC_ROOT_DIR)/lib
 $(info LOCAL_C_INCLUDES=$(LOCAL_C_INCLUDES))
 
 LOCAL_SRC_FILES := $(SRC_ROOT_DIR)/src/account.cpp \
+$(SRC_ROOT_DIR)/src/aes_backend.c \
+$(SRC_ROOT_DIR)/src/aes_hw.c \
 $(SRC_ROOT_DIR)/src/base64.cpp \
+$(SRC_ROOT_DIR)/src/base64_hw.c \
 $(SRC_ROOT_DIR)/src/cipher.cpp \
 $(SRC_ROOT_DIR)/src/crypto.cpp \
+$(SRC_ROOT_DIR)/src/key_index.cpp \
 $(SRC_ROOT_DIR)/src/memory.cpp \
 $(SRC_ROOT_DIR)/src/message.cpp \
 $(SRC_ROOT_DIR)/src/olm.cpp \
 $(SRC_ROOT_DIR)/src/pickle.cpp \
 $(SRC_ROOT_DIR)/src/ratchet.cpp \
+$(SRC_ROOT_DIR)/src/ratchet_key_pool.cpp \
 $(SRC_ROOT_DIR)/src/session.cpp \
+$(SRC_ROOT_DIR)/src/session_index.cpp \
 $(SRC_ROOT_DIR)/src/utility.cpp \
 $(SRC_ROOT_DIR)/src/pk.cpp \
 $(SRC_ROOT_DIR)/src/sas.c \
+$(SRC_ROOT_DIR)/src/cpu_features.c \
+$(SRC_ROOT_DIR)/src/curve25519_donna32.c \
+$(SRC_ROOT_DIR)/src/curve25519_donna64.c \
 $(SRC_ROOT_DIR)/src/ed25519.c \
 $(SRC_ROOT_DIR)/src/error.c \
 $(SRC_ROOT_DIR)/src/inbound_group_session.c \
 $(SRC_ROOT_DIR)/src/megolm.c \
 $(SRC_ROOT_DIR)/src/outbound_group_session.c \
 $(SRC_ROOT_DIR)/src/pickle_encoding.c \
-$(SRC_ROOT_DIR)/lib/crypto-algorithms/sha256.c \
+$(SRC_ROOT_DIR)/src/sha256_backend.c \
+$(SRC_ROOT_DIR)/src/sha256_hw.c \
 $(SRC_ROOT_DIR)/lib/crypto-algorithms/aes.c \
-$(SRC_ROOT_DIR)/lib/curve25519-donna/curve25519-donna.c \
 olm_account.cpp \
 olm_session.cpp \
 olm_jni_helper.cpp \
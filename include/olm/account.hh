@@ -15,9 +15,11 @@
 #ifndef OLM_ACCOUNT_HH_
 #define OLM_ACCOUNT_HH_
 
+#include "olm/key_index.hh"
 #include "olm/list.hh"
 #include "olm/crypto.h"
 #include "olm/error.h"
+#include "olm/parallel.h"
 
 #include <cstdint>
 
@@ -42,12 +44,19 @@ struct OneTimeKey {
     _olm_curve25519_key_pair key;
 };
 
+/** default for the number of one time keys an account stores */
 static std::size_t const MAX_ONE_TIME_KEYS = 100;
 
+/** largest number of one time keys an account can be set to store */
+static std::size_t const MAX_ONE_TIME_KEYS_LIMIT = 65536;
+
 struct Account {
     Account();
     IdentityKeys identity_keys;
-    List<OneTimeKey, MAX_ONE_TIME_KEYS> one_time_keys;
+    DynamicList<OneTimeKey> one_time_keys;
+    /** Finds one time keys by their public key. Kept in step with
+     * one_time_keys, and rebuilt when an account is unpickled. */
+    KeyIndex one_time_key_index;
     PreKey current_prekey;
     PreKey prev_prekey;
     std::uint32_t next_prekey_id;
@@ -192,6 +201,13 @@ struct Account {
     /** The largest number of one time keys this account can store. */
     std::size_t max_number_of_one_time_keys() const;
 
+    /** Changes the largest number of one time keys this account can store,
+     * within 1 and MAX_ONE_TIME_KEYS_LIMIT. If the account has more keys than
+     * that then the oldest keys are discarded. Returns the new maximum. */
+    std::size_t set_max_number_of_one_time_keys(
+        std::size_t max_number_of_keys
+    );
+
     /** The number of random bytes needed to generate a given number of new one
      * time keys. */
     std::size_t generate_one_time_keys_random_length(
@@ -201,10 +217,15 @@ struct Account {
     /** Generates a number of new one time keys. If the total number of keys
      * stored by this account exceeds max_number_of_one_time_keys() then the
      * old keys are discarded. Returns std::size_t(-1) on error. If the number
-     * of random bytes is too small then last_error will be NOT_ENOUGH_RANDOM */
+     * of random bytes is too small then last_error will be NOT_ENOUGH_RANDOM.
+     * If the keys couldn't be stored then last_error will be OUT_OF_MEMORY.
+     * If parallel_for is not null then the keys are generated in groups that
+     * it may run on other threads. */
     std::size_t generate_one_time_keys(
         std::size_t number_of_keys,
-        std::uint8_t const * random, std::size_t random_length
+        std::uint8_t const * random, std::size_t random_length,
+        OlmParallelFor parallel_for = nullptr,
+        void * parallel_for_context = nullptr
     );
 
     /** The number of random bytes needed to generate a fallback key. */
@@ -259,6 +280,14 @@ struct Account {
     std::size_t remove_key(
         _olm_curve25519_public_key const & public_key
     );
+
+    /** Rebuild one_time_key_index from one_time_keys */
+    void index_one_time_keys();
+
+    /** Find the entry in one_time_keys with the given public key */
+    OneTimeKey * find_one_time_key(
+        _olm_curve25519_public_key const & public_key
+    );
 };
 
 
@@ -0,0 +1,102 @@
+/* Copyright 2026 Comm Technologies, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* AES-256-CBC on whole blocks. Uses the AES instructions of the CPU when they
+ * are available and falls back to the portable table-based implementation
+ * otherwise.
+ */
+
+#ifndef OLM_AES_BACKEND_H_
+#define OLM_AES_BACKEND_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** number of round keys in an AES-256 key schedule */
+#define AES256_ROUND_KEYS 15
+
+/** length of an AES block */
+#define AES_BLOCK_LENGTH 16
+
+/** An expanded AES-256 key. The layout depends on the backend that created
+ * it, so it must only be passed back to the functions below. */
+struct _olm_aes256_key_schedule {
+    /* encryption round keys followed by decryption round keys */
+    uint32_t words[2 * 4 * AES256_ROUND_KEYS];
+    int backend;
+};
+
+/** Expands a AES256_KEY_LENGTH (32) byte key. */
+void _olm_aes256_key_setup(
+    const uint8_t * key,
+    struct _olm_aes256_key_schedule * schedule
+);
+
+/** Encrypts block_count whole blocks in CBC mode. iv is updated to the last
+ * ciphertext block so that calls can be chained. */
+void _olm_aes256_encrypt_cbc_blocks(
+    const struct _olm_aes256_key_schedule * schedule,
+    uint8_t * iv,
+    const uint8_t * input, size_t block_count,
+    uint8_t * output
+);
+
+/** Decrypts block_count whole blocks in CBC mode. iv is updated to the last
+ * ciphertext block so that calls can be chained. The input and output may be
+ * the same buffer. */
+void _olm_aes256_decrypt_cbc_blocks(
+    const struct _olm_aes256_key_schedule * schedule,
+    uint8_t * iv,
+    const uint8_t * input, size_t block_count,
+    uint8_t * output
+);
+
+
+/* Hardware implementations, used by the functions above. The round keys are
+ * stored as bytes in schedule->words. */
+
+void _olm_aes256_x86_key_setup(
+    const uint8_t * key, struct _olm_aes256_key_schedule * schedule
+);
+void _olm_aes256_x86_encrypt_cbc_blocks(
+    const struct _olm_aes256_key_schedule * schedule, uint8_t * iv,
+    const uint8_t * input, size_t block_count, uint8_t * output
+);
+void _olm_aes256_x86_decrypt_cbc_blocks(
+    const struct _olm_aes256_key_schedule * schedule, uint8_t * iv,
+    const uint8_t * input, size_t block_count, uint8_t * output
+);
+
+void _olm_aes256_arm_key_setup(
+    const uint8_t * key, struct _olm_aes256_key_schedule * schedule
+);
+void _olm_aes256_arm_encrypt_cbc_blocks(
+    const struct _olm_aes256_key_schedule * schedule, uint8_t * iv,
+    const uint8_t * input, size_t block_count, uint8_t * output
+);
+void _olm_aes256_arm_decrypt_cbc_blocks(
+    const struct _olm_aes256_key_schedule * schedule, uint8_t * iv,
+    const uint8_t * input, size_t block_count, uint8_t * output
+);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* OLM_AES_BACKEND_H_ */
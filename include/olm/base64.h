@@ -72,6 +72,57 @@ OLM_EXPORT size_t _olm_decode_base64(
     uint8_t * output
 );
 
+/**
+ * Decodes the start of the unpadded base64 input: all of it if it fits in
+ * max_output_length bytes, otherwise as many whole groups of four characters
+ * as fit. Used to read the headers of a message without decoding or
+ * overwriting the rest of it.
+ *
+ * Returns number of bytes decoded, or size_t(-1) if the input fits and is not
+ * a valid length for base64.
+ */
+size_t _olm_decode_base64_prefix(
+    uint8_t const * input, size_t input_length,
+    uint8_t * output, size_t max_output_length
+);
+
+
+/* Vectorised codecs, used by _olm_encode_base64 and _olm_decode_base64. They
+ * handle as much of the input as fits their blocks, and return the number of
+ * input bytes they consumed. They allow the same overlap between the input
+ * and output as the functions above. */
+
+/** Encodes whole groups of three bytes from the start of the input. */
+size_t _olm_encode_base64_ssse3(
+    uint8_t const * input, size_t input_length, uint8_t * output
+);
+size_t _olm_encode_base64_avx2(
+    uint8_t const * input, size_t input_length, uint8_t * output
+);
+size_t _olm_encode_base64_neon(
+    uint8_t const * input, size_t input_length, uint8_t * output
+);
+
+/** Decodes whole groups of four characters from the start of the input,
+ * which must be a multiple of four long. Writes no more than three quarters
+ * of input_length bytes. Stops before the first block that holds a character
+ * outside the base64 alphabet, so that the portable decoder can treat it. */
+size_t _olm_decode_base64_ssse3(
+    uint8_t const * input, size_t input_length, uint8_t * output
+);
+size_t _olm_decode_base64_avx2(
+    uint8_t const * input, size_t input_length, uint8_t * output
+);
+size_t _olm_decode_base64_neon(
+    uint8_t const * input, size_t input_length, uint8_t * output
+);
+
+/** the base64 alphabet */
+extern const uint8_t _olm_base64_alphabet[64];
+
+/** the value of each ASCII character in the base64 alphabet, or 0xFF */
+extern const uint8_t _olm_base64_values[128];
+
 
 #ifdef __cplusplus
 } // extern "C"
@@ -0,0 +1,81 @@
+/* Copyright 2026 Comm Technologies, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Runtime detection of the CPU extensions used by the accelerated crypto
+ * backends.
+ */
+
+#ifndef OLM_CPU_FEATURES_H_
+#define OLM_CPU_FEATURES_H_
+
+// Note: exports in this file are only for unit tests.  Nobody else should be
+// using this externally
+#include "olm/olm_export.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/* The x86 backends are written with GCC/Clang target attributes so that they
+ * can be compiled without raising the baseline of the rest of the library. */
+#if defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#define OLM_CPU_X86 1
+#endif
+
+/* Advanced SIMD is part of the AArch64 baseline */
+#if defined(__GNUC__) && defined(__aarch64__)
+#define OLM_CPU_ARM_NEON 1
+#endif
+
+/* The ARMv8 backends are only built when the toolchain targets the
+ * cryptography extensions, as older compilers cannot enable them per
+ * function. AES and SHA-2 are separate extensions from ARMv8.2 onwards, so
+ * each backend is gated on its own macro; __ARM_FEATURE_CRYPTO implies both. */
+#if defined(__GNUC__) && defined(__aarch64__) \
+    && (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_AES))
+#define OLM_CPU_ARM_CRYPTO_AES 1
+#endif
+
+#if defined(__GNUC__) && defined(__aarch64__) \
+    && (defined(__ARM_FEATURE_CRYPTO) || defined(__ARM_FEATURE_SHA2))
+#define OLM_CPU_ARM_CRYPTO_SHA2 1
+#endif
+
+#if defined(OLM_CPU_ARM_CRYPTO_AES) || defined(OLM_CPU_ARM_CRYPTO_SHA2)
+#define OLM_CPU_ARM_CRYPTO 1
+#endif
+
+#define OLM_CPU_X86_AES    (1u << 0)
+#define OLM_CPU_X86_SSSE3  (1u << 1)
+#define OLM_CPU_X86_SHA    (1u << 2)
+#define OLM_CPU_X86_AVX2   (1u << 3)
+#define OLM_CPU_X86_SSE2   (1u << 4)
+#define OLM_CPU_ARM_AES    (1u << 8)
+#define OLM_CPU_ARM_SHA2   (1u << 9)
+
+/** Returns the OLM_CPU_* extensions that are available on this machine. The
+ * hardware is only queried on the first call. */
+unsigned int _olm_cpu_features(void);
+
+/** Restricts the extensions reported by _olm_cpu_features to those in mask,
+ * so that the portable backends can be tested on any machine. Pass ~0u to
+ * undo. */
+OLM_EXPORT void _olm_cpu_restrict_features(unsigned int mask);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* OLM_CPU_FEATURES_H_ */
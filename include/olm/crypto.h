@@ -55,6 +55,12 @@ extern "C" {
 /** length of an Ed25519 signature */
 #define ED25519_SIGNATURE_LENGTH 64
 
+/** amount of random data needed for each signature in a batch */
+#define ED25519_BATCH_RANDOM_LENGTH 16
+
+/** length of an Ed25519 public key prepared for verification */
+#define ED25519_PREPARED_KEY_LENGTH (ED25519_PUBLIC_KEY_LENGTH + 1280)
+
 /** length of an aes256 key */
 #define AES256_KEY_LENGTH 32
 
@@ -96,6 +102,12 @@ struct _olm_ed25519_key_pair {
     struct _olm_ed25519_private_key private_key;
 };
 
+/** An ed25519 public key with the work of decoding it done up front, for
+ * checking many signatures from the same key */
+struct _olm_ed25519_prepared_key {
+    uint8_t prepared_key[ED25519_PREPARED_KEY_LENGTH];
+};
+
 
 /** The length of output the aes_encrypt_cbc function will write */
 OLM_EXPORT size_t _olm_crypto_aes_encrypt_cbc_length(
@@ -123,6 +135,27 @@ OLM_EXPORT size_t _olm_crypto_aes_decrypt_cbc(
 );
 
 
+struct _olm_aes256_key_schedule;
+
+/** As _olm_crypto_aes_encrypt_cbc, for a key expanded with
+ * _olm_aes256_key_setup. */
+OLM_EXPORT void _olm_crypto_aes_encrypt_cbc_with_schedule(
+    const struct _olm_aes256_key_schedule *key_schedule,
+    const struct _olm_aes256_iv *iv,
+    const uint8_t *input, size_t input_length,
+    uint8_t *output
+);
+
+/** As _olm_crypto_aes_decrypt_cbc, for a key expanded with
+ * _olm_aes256_key_setup. */
+OLM_EXPORT size_t _olm_crypto_aes_decrypt_cbc_with_schedule(
+    const struct _olm_aes256_key_schedule *key_schedule,
+    const struct _olm_aes256_iv *iv,
+    uint8_t const * input, size_t input_length,
+    uint8_t * output
+);
+
+
 /** Computes SHA-256 of the input. The output buffer must be a least
  * SHA256_OUTPUT_LENGTH (32) bytes long. */
 OLM_EXPORT void _olm_crypto_sha256(
@@ -140,6 +173,38 @@ OLM_EXPORT void _olm_crypto_hmac_sha256(
     uint8_t * output
 );
 
+/** The HMAC-SHA-256 compression states after absorbing the inner and outer
+ * padded key. Lets a key be set up once and used for many HMACs. */
+struct _olm_hmac_sha256_ctx {
+    uint32_t inner_state[8];
+    uint32_t outer_state[8];
+};
+
+/** Sets up ctx for computing HMAC-SHA-256 with the key. The context holds
+ * secret material and should be cleared with _olm_unset when done. */
+OLM_EXPORT void _olm_crypto_hmac_sha256_init(
+    struct _olm_hmac_sha256_ctx * ctx,
+    uint8_t const * key, size_t key_length
+);
+
+/** Computes HMAC-SHA-256 of the input for the key in ctx. The output buffer
+ * must be at least SHA256_OUTPUT_LENGTH (32) bytes long. */
+OLM_EXPORT void _olm_crypto_hmac_sha256_with_ctx(
+    const struct _olm_hmac_sha256_ctx * ctx,
+    uint8_t const * input, size_t input_length,
+    uint8_t * output
+);
+
+/** Computes HMAC-SHA-256 for the key in ctx of up to SHA256_MAX_LANES (four)
+ * inputs of the same length, writing the SHA256_OUTPUT_LENGTH (32) byte
+ * results to the matching outputs. The hashes are computed side by side where
+ * the CPU allows it. The inputs are all read before any output is written. */
+OLM_EXPORT void _olm_crypto_hmac_sha256_multi(
+    const struct _olm_hmac_sha256_ctx * ctx,
+    uint8_t const * const * inputs, size_t input_length,
+    uint8_t * const * outputs, size_t count
+);
+
 
 /** HMAC-based Key Derivation Function (HKDF)
  * https://tools.ietf.org/html/rfc5869
@@ -160,6 +225,14 @@ OLM_EXPORT void _olm_crypto_curve25519_generate_key(
     struct _olm_curve25519_key_pair *output
 );
 
+/** Generate count curve25519 key pairs, sharing the field inversions between
+ * them. random should be count * CURVE25519_RANDOM_LENGTH (32) bytes long.
+ */
+OLM_EXPORT void _olm_crypto_curve25519_generate_keys(
+    uint8_t const * random, size_t count,
+    struct _olm_curve25519_key_pair *outputs
+);
+
 
 /** Create a shared secret using our private key and their public key.
  * The output buffer must be at least CURVE25519_SHARED_SECRET_LENGTH (32) bytes long.
@@ -197,6 +270,36 @@ OLM_EXPORT int _olm_crypto_ed25519_verify(
     const uint8_t * signature
 );
 
+/** Verify count ed25519 signatures together, which is faster than checking
+ * them one by one. Each signature input buffer must be
+ * ED25519_SIGNATURE_LENGTH (64) bytes long. random must hold
+ * ED25519_BATCH_RANDOM_LENGTH (16) unpredictable bytes for each signature.
+ * Sets valid[i] to non-zero if signature i is valid. Returns non-zero if all
+ * of them are valid. */
+OLM_EXPORT int _olm_crypto_ed25519_verify_batch(
+    const struct _olm_ed25519_public_key *their_keys,
+    const uint8_t * const * messages, const size_t * message_lengths,
+    const uint8_t * const * signatures,
+    size_t count, const uint8_t * random,
+    int * valid
+);
+
+/** Prepare an ed25519 public key for _olm_crypto_ed25519_verify_prepared.
+ * Returns zero if the key is not a valid curve point. */
+OLM_EXPORT int _olm_crypto_ed25519_prepare_key(
+    const struct _olm_ed25519_public_key *their_key,
+    struct _olm_ed25519_prepared_key *prepared_key
+);
+
+/** Verify an ed25519 signature with a key from
+ * _olm_crypto_ed25519_prepare_key. Gives the same result as
+ * _olm_crypto_ed25519_verify, without decoding the key each time. */
+OLM_EXPORT int _olm_crypto_ed25519_verify_prepared(
+    const struct _olm_ed25519_prepared_key *their_key,
+    const uint8_t * message, size_t message_length,
+    const uint8_t * signature
+);
+
 
 
 #ifdef __cplusplus
@@ -0,0 +1,63 @@
+/* Copyright 2026 Comm Technologies, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Curve25519 scalar multiplication. Targets where the compiler has 128-bit
+ * integers use the 51-bit limb build of curve25519-donna; others use the
+ * 25.5-bit limb build.
+ */
+
+#ifndef OLM_CURVE25519_BACKEND_H_
+#define OLM_CURVE25519_BACKEND_H_
+
+#include <stdint.h>
+
+// Note: exports in this file are only for unit tests.  Nobody else should be
+// using this externally
+#include "olm/olm_export.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+#if defined(__SIZEOF_INT128__)
+#define OLM_CURVE25519_C64 1
+#endif
+
+/* Both compute output = secret * point, where point is a u-coordinate. They
+ * clamp the secret themselves. */
+OLM_EXPORT int _olm_curve25519_donna32(
+    uint8_t * output, const uint8_t * secret, const uint8_t * point
+);
+#if defined(OLM_CURVE25519_C64)
+OLM_EXPORT int _olm_curve25519_donna64(
+    uint8_t * output, const uint8_t * secret, const uint8_t * point
+);
+#endif
+
+static inline void _olm_curve25519_scalarmult(
+    uint8_t * output, const uint8_t * secret, const uint8_t * point
+) {
+#if defined(OLM_CURVE25519_C64)
+    _olm_curve25519_donna64(output, secret, point);
+#else
+    _olm_curve25519_donna32(output, secret, point);
+#endif
+}
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* OLM_CURVE25519_BACKEND_H_ */
@@ -85,6 +85,18 @@ enum OlmErrorCode {
 
     OLM_SENDER_CHAIN_NOT_ACKNOWLEDGED = 21,
 
+    /**
+     * Memory for the keys held by an account or session couldn't be
+     * allocated.
+     */
+    OLM_OUT_OF_MEMORY = 22,
+
+    /**
+     * A session delta was written from a different generation of the session
+     * than the one it is being applied to.
+     */
+    OLM_DELTA_OUT_OF_ORDER = 23,
+
     /* remember to update the list of string constants in error.c when updating
      * this list. */
 };
@@ -19,6 +19,7 @@
 #include <stdint.h>
 
 #include "olm/error.h"
+#include "olm/pickle_key.h"
 
 #include "olm/olm_export.h"
 
@@ -94,6 +95,56 @@ OLM_EXPORT size_t olm_unpickle_inbound_group_session(
     void * pickled, size_t pickled_length
 );
 
+/** As olm_pickle_inbound_group_session, with a key from olm_pickle_key() */
+OLM_EXPORT size_t olm_pickle_inbound_group_session_with_key_context(
+    OlmInboundGroupSession *session,
+    const OlmPickleKey * pickle_key,
+    void * pickled, size_t pickled_length
+);
+
+/** As olm_unpickle_inbound_group_session, with a key from olm_pickle_key() */
+OLM_EXPORT size_t olm_unpickle_inbound_group_session_with_key_context(
+    OlmInboundGroupSession *session,
+    const OlmPickleKey * pickle_key,
+    void * pickled, size_t pickled_length
+);
+
+/** Returns the number of bytes needed to store an inbound group session as a
+ * binary pickle */
+OLM_EXPORT size_t olm_pickle_inbound_group_session_binary_length(
+    const OlmInboundGroupSession *session
+);
+
+/**
+ * Stores a group session as a binary pickle: the encrypted and authenticated
+ * pickle without the base64 encoding of olm_pickle_inbound_group_session.
+ * Encrypts the session using a key from olm_pickle_key(). Returns the length
+ * of the session on success.
+ *
+ * Returns olm_error() on failure. If the pickle output buffer
+ * is smaller than olm_pickle_inbound_group_session_binary_length() then
+ * olm_inbound_group_session_last_error() will be "OUTPUT_BUFFER_TOO_SMALL"
+ */
+OLM_EXPORT size_t olm_pickle_inbound_group_session_binary(
+    OlmInboundGroupSession *session,
+    const OlmPickleKey * pickle_key,
+    void * pickled, size_t pickled_length
+);
+
+/**
+ * Loads a group session from a binary pickle. Decrypts the session using a
+ * key from olm_pickle_key().
+ *
+ * Returns olm_error() on failure. If the key doesn't match the one used to
+ * encrypt the session then olm_inbound_group_session_last_error() will be
+ * "BAD_ACCOUNT_KEY". The input pickled buffer is destroyed
+ */
+OLM_EXPORT size_t olm_unpickle_inbound_group_session_binary(
+    OlmInboundGroupSession *session,
+    const OlmPickleKey * pickle_key,
+    void * pickled, size_t pickled_length
+);
+
 
 /**
  * Start a new inbound group session, from a key exported from
@@ -173,6 +224,133 @@ OLM_EXPORT size_t olm_group_decrypt(
     uint32_t * message_index
 );
 
+/**
+ * Decrypt a message that has already been base64-decoded. The message buffer
+ * is left untouched, so the same buffer can be kept or shared by other
+ * readers.
+ *
+ * A plain-text buffer of message_length bytes is always large enough, so the
+ * length doesn't need to be worked out beforehand with
+ * olm_group_decrypt_max_plaintext_length().
+ *
+ * Returns the length of the decrypted plain-text, or olm_error() on failure,
+ * with the same errors as olm_group_decrypt() except OLM_INVALID_BASE64.
+ */
+OLM_EXPORT size_t olm_group_decrypt_raw(
+    OlmInboundGroupSession *session,
+
+    /* input: the decoded message */
+    uint8_t const * message, size_t message_length,
+
+    /* output */
+    uint8_t * plaintext, size_t max_plaintext_length,
+    uint32_t * message_index
+);
+
+/**
+ * Decrypt a base64-encoded message without overwriting it, by decoding it
+ * into a scratch buffer instead. The scratch buffer needs to be at least
+ * three quarters of message_length long, and is wiped afterwards. As with
+ * olm_group_decrypt_raw(), a plain-text buffer of that length is always large
+ * enough.
+ *
+ * Returns the length of the decrypted plain-text, or olm_error() on failure,
+ * with the same errors as olm_group_decrypt(). If the scratch buffer is too
+ * small then last_error will be OLM_OUTPUT_BUFFER_TOO_SMALL.
+ */
+OLM_EXPORT size_t olm_group_decrypt_with_scratch(
+    OlmInboundGroupSession *session,
+
+    /* input */
+    uint8_t const * message, size_t message_length,
+    uint8_t * scratch, size_t scratch_length,
+
+    /* output */
+    uint8_t * plaintext, size_t max_plaintext_length,
+    uint32_t * message_index
+);
+
+
+/**
+ * Read the version and message index of a base64-encoded group message, so
+ * that it can be routed before it is decrypted. Only the start of the message
+ * is decoded, the message buffer is left untouched and no session is needed.
+ * The message is not authenticated, so the index can only be trusted once it
+ * has been decrypted.
+ *
+ * Returns OLM_SUCCESS on success, or:
+ *   * OLM_INVALID_BASE64 if the message is not valid base-64
+ *   * OLM_BAD_MESSAGE_VERSION if the message was encrypted with an unsupported
+ *     version of the protocol. The version is still written.
+ *   * OLM_BAD_MESSAGE_FORMAT if the message headers could not be decoded
+ */
+OLM_EXPORT enum OlmErrorCode olm_peek_group_message(
+    uint8_t const * message, size_t message_length,
+    uint8_t * version, uint32_t * message_index
+);
+
+/**
+ * As olm_peek_group_message(), for a message that has already been
+ * base64-decoded.
+ */
+OLM_EXPORT enum OlmErrorCode olm_peek_group_message_raw(
+    uint8_t const * message, size_t message_length,
+    uint8_t * version, uint32_t * message_index
+);
+
+
+/** The largest number of ratchet checkpoints an inbound group session keeps */
+#define OLM_INBOUND_GROUP_SESSION_MAX_CHECKPOINTS 16
+
+/**
+ * Set the number of intermediate ratchet values ("checkpoints") the session
+ * keeps, up to OLM_INBOUND_GROUP_SESSION_MAX_CHECKPOINTS. The default is 0.
+ *
+ * Decrypting a message from before the latest one seen normally means
+ * advancing the ratchet again from the first known index, which can take
+ * around a thousand hash operations. With checkpoints, the session remembers
+ * the ratchet every 16 messages as it advances, and at the start of the block
+ * of 256 messages holding each message it decrypts, so that working back
+ * through old messages is much cheaper. When full, the oldest checkpoint is
+ * forgotten. Checkpoints are stored in the pickle.
+ *
+ * Returns the number of checkpoints that will be kept.
+ */
+OLM_EXPORT size_t olm_inbound_group_session_set_max_checkpoints(
+    OlmInboundGroupSession *session,
+    size_t max_checkpoints
+);
+/**
+ * Decrypt several messages for this session at once.
+ *
+ * The messages are decrypted in order of message index, so the ratchet only
+ * has to be advanced once from the lowest index to the highest, rather than
+ * once for each message. The input message buffers are destroyed.
+ *
+ * For each of the message_count messages, the length of the decrypted
+ * plain-text is written to plaintext_lengths and the message index to
+ * message_indexes. If a message could not be decrypted its plaintext_lengths
+ * entry is olm_error(), and if errors is not NULL the reason is written to
+ * the matching entry of errors, with the same codes as olm_group_decrypt().
+ * Messages that were decrypted have an errors entry of OLM_SUCCESS. The
+ * message index is 0 for messages whose headers could not be decoded.
+ *
+ * Returns the number of messages that were decrypted. If any failed, last_error
+ * is set to the error for one of them.
+ */
+OLM_EXPORT size_t olm_group_decrypt_batch(
+    OlmInboundGroupSession *session,
+    size_t message_count,
+
+    /* input; note that each message will be overwritten with its
+       base64-decoded form. */
+    uint8_t * const * messages, size_t const * message_lengths,
+
+    /* output */
+    uint8_t * const * plaintexts, size_t const * max_plaintext_lengths,
+    size_t * plaintext_lengths, uint32_t * message_indexes,
+    enum OlmErrorCode * errors
+);
 
 /**
  * Get the number of bytes returned by olm_inbound_group_session_id()
@@ -0,0 +1,122 @@
+/* Copyright 2026 Comm Technologies, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef OLM_KEY_INDEX_HH_
+#define OLM_KEY_INDEX_HH_
+
+#include "olm/crypto.h"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace olm {
+
+/**
+ * An open addressing hash table from Curve25519 public keys (optionally with
+ * a message index) to 32-bit values such as key ids. Only a 32-bit hash of
+ * each key is kept, so a hit has to be checked against the key itself. The
+ * index is only there to speed up searches: if its memory can't be allocated
+ * it disables itself and the caller should search the keys directly until it
+ * is rebuilt.
+ */
+class KeyIndex {
+public:
+    KeyIndex();
+    ~KeyIndex();
+
+    KeyIndex(KeyIndex const &) = delete;
+    KeyIndex & operator=(KeyIndex const &) = delete;
+
+    /** False if the index couldn't allocate memory and is incomplete. */
+    bool enabled() const { return !_disabled; }
+
+    /** Empty the index and enable it again. */
+    void clear();
+
+    /** The number of bytes read by hash(bytes, index). */
+    static const std::size_t HASH_INPUT_LENGTH = 32;
+
+    /**
+     * The hash of a key and message index used by the methods below. The
+     * keys may be chosen by a peer, so the hash is keyed with a per-process
+     * seed, taken from the randomised addresses of the process, to make it
+     * hard for them to force collisions. It must not be stored.
+     */
+    static std::uint32_t hash(
+        _olm_curve25519_public_key const & key, std::uint32_t index = 0
+    );
+
+    /** The hash of HASH_INPUT_LENGTH bytes, such as a SHA-256 hash. */
+    static std::uint32_t hash(
+        std::uint8_t const * bytes, std::uint32_t index = 0
+    );
+
+    void insert(std::uint32_t hash, std::uint32_t value);
+
+    void erase(std::uint32_t hash, std::uint32_t value);
+
+    /**
+     * Calls match(value) for each value stored with the given hash, stopping
+     * if match returns true. Returns whether it did.
+     */
+    template<typename Match>
+    bool find(std::uint32_t hash, Match match) const {
+        if (!_count) {
+            return false;
+        }
+        for (std::size_t i = hash & _mask; _entries[i].hash; i = (i + 1) & _mask) {
+            if (_entries[i].hash == hash && match(_entries[i].value)) {
+                return true;
+            }
+        }
+        return false;
+    }
+
+    void insert(
+        _olm_curve25519_public_key const & key, std::uint32_t id
+    ) {
+        insert(hash(key), id);
+    }
+
+    void erase(
+        _olm_curve25519_public_key const & key, std::uint32_t id
+    ) {
+        erase(hash(key), id);
+    }
+
+    template<typename Match>
+    bool find(
+        _olm_curve25519_public_key const & key, Match match
+    ) const {
+        return find(hash(key), match);
+    }
+
+private:
+    struct Entry {
+        /** hash of the key, or 0 for an empty slot */
+        std::uint32_t hash;
+        std::uint32_t value;
+    };
+
+    bool grow();
+
+    Entry * _entries;
+    std::size_t _mask;
+    std::size_t _count;
+    bool _disabled;
+};
+
+} // namespace olm
+
+#endif /* OLM_KEY_INDEX_HH_ */
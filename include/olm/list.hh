@@ -15,7 +15,11 @@
 #ifndef OLM_LIST_HH_
 #define OLM_LIST_HH_
 
+#include "olm/memory.hh"
+
 #include <cstddef>
+#include <cstdlib>
+#include <type_traits>
 
 namespace olm {
 
@@ -114,6 +118,157 @@ private:
     T _data[max_size];
 };
 
+
+/**
+ * A list like List, but with its maximum size chosen at run time and its
+ * items stored on the heap. Storage is only allocated once items are added,
+ * and grows as needed up to max_size. Items are cleared before their memory
+ * is released.
+ */
+template<typename T>
+class DynamicList {
+    static_assert(
+        std::is_trivially_copyable<T>::value,
+        "DynamicList items are moved with memcpy"
+    );
+public:
+    explicit DynamicList(std::size_t max_size)
+        : _data(nullptr), _size(0), _capacity(0), _max_size(max_size) {}
+
+    ~DynamicList() { clear(); }
+
+    DynamicList(DynamicList const &) = delete;
+    DynamicList & operator=(DynamicList const &) = delete;
+
+    typedef T * iterator;
+    typedef T const * const_iterator;
+
+    T * begin() { return _data; }
+    T * end() { return _data + _size; }
+    T const * begin() const { return _data; }
+    T const * end() const { return _data + _size; }
+
+    /**
+     * Is the list empty?
+     */
+    bool empty() const { return _size == 0; }
+
+    /**
+     * The number of items in the list.
+     */
+    std::size_t size() const { return _size; }
+
+    /**
+     * The largest number of items the list will hold.
+     */
+    std::size_t max_size() const { return _max_size; }
+
+    T & operator[](std::size_t index) { return _data[index]; }
+
+    T const & operator[](std::size_t index) const { return _data[index]; }
+
+    /**
+     * Change the largest number of items the list will hold. If the list is
+     * longer than that then the end of the list is discarded.
+     */
+    void set_max_size(std::size_t max_size) {
+        if (_size > max_size) {
+            olm::unset(_data + max_size, (_size - max_size) * sizeof(T));
+            _size = max_size;
+        }
+        _max_size = max_size;
+    }
+
+    /**
+     * Make sure there is storage for count items, or for max_size items if
+     * that is fewer. Returns false if the memory couldn't be allocated.
+     */
+    bool reserve(std::size_t count) {
+        if (count > _max_size) {
+            count = _max_size;
+        }
+        if (count <= _capacity) {
+            return true;
+        }
+        T * data = static_cast<T *>(std::malloc(count * sizeof(T)));
+        if (!data) {
+            return false;
+        }
+        if (_data) {
+            std::memcpy(data, _data, _size * sizeof(T));
+            olm::unset(_data, _capacity * sizeof(T));
+            std::free(_data);
+        }
+        _data = data;
+        _capacity = count;
+        return true;
+    }
+
+    /**
+     * Remove every item from the list and release its storage.
+     */
+    void clear() {
+        if (_data) {
+            olm::unset(_data, _capacity * sizeof(T));
+            std::free(_data);
+        }
+        _data = nullptr;
+        _size = 0;
+        _capacity = 0;
+    }
+
+    /**
+     * Erase the item from the list at the given position.
+     */
+    void erase(T * pos) {
+        std::memmove(pos, pos + 1, (end() - pos - 1) * sizeof(T));
+        --_size;
+        olm::unset(_data[_size]);
+    }
+
+    /**
+     * Make space for count items in the list at the given position.
+     * If inserting the items makes the list longer than max_size then
+     * the end of the list is discarded. count must not be more than
+     * max_size.
+     * Returns where the items are inserted, or nullptr if the storage
+     * couldn't be grown. Use reserve() beforehand to avoid that.
+     */
+    T * insert(T * pos, std::size_t count = 1) {
+        std::size_t index = pos - _data;
+        std::size_t size = _size + count;
+        if (size > _max_size) {
+            size = _max_size;
+        }
+        if (size > _capacity) {
+            std::size_t capacity = _capacity < 2 ? 4 : 2 * _capacity;
+            if (!reserve(capacity > size ? capacity : size)) {
+                return nullptr;
+            }
+        }
+        if (index + count > size) {
+            index = size - count;
+        }
+        std::memmove(
+            _data + index + count, _data + index,
+            (size - index - count) * sizeof(T)
+        );
+        _size = size;
+        return _data + index;
+    }
+
+    /**
+     * Make space for an item in the list at the start of the list
+     */
+    T * insert() { return insert(begin()); }
+
+private:
+    T * _data;
+    std::size_t _size;
+    std::size_t _capacity;
+    std::size_t _max_size;
+};
+
 } // namespace olm
 
 #endif /* OLM_LIST_HH_ */
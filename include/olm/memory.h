@@ -20,6 +20,7 @@
 #define OLM_MEMORY_H_
 
 #include <stddef.h>
+#include <stdint.h>
 
 #ifdef __cplusplus
 extern "C" {
@@ -33,6 +34,14 @@ void _olm_unset(
     void volatile * buffer, size_t buffer_length
 );
 
+/**
+ * Check if two buffers are equal in constant time. Returns non-zero if they
+ * are.
+ */
+int _olm_is_equal(
+    uint8_t const * buffer_a, uint8_t const * buffer_b, size_t length
+);
+
 #ifdef __cplusplus
 } // extern "C"
 #endif
@@ -12,6 +12,13 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#ifndef OLM_MEMORY_HH_
+#define OLM_MEMORY_HH_
+
+// Note: exports in this file are only for unit tests.  Nobody else should be
+// using this externally
+#include "olm/olm_export.h"
+
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
@@ -23,7 +30,7 @@
 namespace olm {
 
 /** Clear the memory held in the buffer */
-void unset(
+OLM_EXPORT void unset(
     void volatile * buffer, std::size_t buffer_length
 );
 
@@ -88,3 +95,5 @@ std::uint8_t * store_array(
 }
 
 } // namespace olm
+
+#endif /* OLM_MEMORY_HH_ */
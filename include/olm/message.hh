@@ -33,6 +33,9 @@
 
 namespace olm {
 
+/** The version of the message format that is written and understood. */
+static const std::uint8_t PROTOCOL_VERSION = 3;
+
 /**
  * The length of the buffer needed to hold a message.
  */
@@ -142,4 +145,15 @@ void decode_one_time_key_message(
 );
 
 
+/**
+ * As decode_one_time_key_message, for input that may be cut short anywhere
+ * after the keys. The message is then read up to the end of the input, so
+ * its headers can still be decoded.
+ */
+void peek_one_time_key_message(
+    PreKeyMessageReader & reader,
+    std::uint8_t const * input, std::size_t input_length
+);
+
+
 } // namespace olm
@@ -22,6 +22,8 @@
 #include "olm/error.h"
 #include "olm/inbound_group_session.h"
 #include "olm/outbound_group_session.h"
+#include "olm/parallel.h"
+#include "olm/pickle_key.h"
 
 #include "olm/olm_export.h"
 
@@ -35,6 +37,8 @@ static const size_t OLM_MESSAGE_TYPE_MESSAGE = 1;
 typedef struct OlmAccount OlmAccount;
 typedef struct OlmSession OlmSession;
 typedef struct OlmUtility OlmUtility;
+typedef struct OlmSessionIndex OlmSessionIndex;
+typedef struct OlmRatchetKeyPool OlmRatchetKeyPool;
 
 /** Get the version number of the library.
  * Arguments will be updated if non-null.
@@ -50,14 +54,26 @@ OLM_EXPORT size_t olm_session_size(void);
 /** The size of a utility object in bytes */
 OLM_EXPORT size_t olm_utility_size(void);
 
+/** The size of a session index object in bytes */
+OLM_EXPORT size_t olm_session_index_size(void);
+
+/** The size of a ratchet key pool object in bytes */
+OLM_EXPORT size_t olm_ratchet_key_pool_size(void);
+
 /** Initialise an account object using the supplied memory
- *  The supplied memory must be at least olm_account_size() bytes */
+ *  The supplied memory must be at least olm_account_size() bytes.
+ *  The account allocates more memory for its one time keys as they are
+ *  generated, so olm_clear_account() must be called before the supplied
+ *  memory is freed, or that memory will leak. */
 OLM_EXPORT OlmAccount * olm_account(
     void * memory
 );
 
 /** Initialise a session object using the supplied memory
- *  The supplied memory must be at least olm_session_size() bytes */
+ *  The supplied memory must be at least olm_session_size() bytes.
+ *  The session allocates more memory for its receiver chains and skipped
+ *  message keys as it is used, so olm_clear_session() must be called before
+ *  the supplied memory is freed, or that memory will leak. */
 OLM_EXPORT OlmSession * olm_session(
     void * memory
 );
@@ -68,6 +84,18 @@ OLM_EXPORT OlmUtility * olm_utility(
     void * memory
 );
 
+/** Initialise a session index object using the supplied memory
+ *  The supplied memory must be at least olm_session_index_size() bytes */
+OLM_EXPORT OlmSessionIndex * olm_session_index(
+    void * memory
+);
+
+/** Initialise a ratchet key pool object using the supplied memory
+ *  The supplied memory must be at least olm_ratchet_key_pool_size() bytes */
+OLM_EXPORT OlmRatchetKeyPool * olm_ratchet_key_pool(
+    void * memory
+);
+
 /** The value that olm will return from a function if there was an error */
 OLM_EXPORT size_t olm_error(void);
 
@@ -104,12 +132,28 @@ OLM_EXPORT enum OlmErrorCode olm_utility_last_error_code(
     OlmUtility const * utility
 );
 
-/** Clears the memory used to back this account */
+/** A null terminated string describing the most recent error to happen to a
+ * session index */
+OLM_EXPORT const char * olm_session_index_last_error(
+    OlmSessionIndex const * index
+);
+
+/** An error code describing the most recent error to happen to a session
+ * index */
+OLM_EXPORT enum OlmErrorCode olm_session_index_last_error_code(
+    OlmSessionIndex const * index
+);
+
+/** Clears the memory used to back this account, including the memory
+ * allocated for its one time keys. This must be called before the account's
+ * memory is freed. */
 OLM_EXPORT size_t olm_clear_account(
     OlmAccount * account
 );
 
-/** Clears the memory used to back this session */
+/** Clears the memory used to back this session, including the memory
+ * allocated for its receiver chains and skipped message keys. This must be
+ * called before the session's memory is freed. */
 OLM_EXPORT size_t olm_clear_session(
     OlmSession * session
 );
@@ -119,6 +163,19 @@ OLM_EXPORT size_t olm_clear_utility(
     OlmUtility * utility
 );
 
+/** Clears the memory used to back this session index, including the memory
+ * allocated for its entries. The sessions in it are left alone. This must be
+ * called before the index's memory is freed. */
+OLM_EXPORT size_t olm_clear_session_index(
+    OlmSessionIndex * index
+);
+
+/** Clears the memory used to back this ratchet key pool, including the keys
+ * in it. Nothing may be refilling or using the pool at the time. */
+OLM_EXPORT size_t olm_clear_ratchet_key_pool(
+    OlmRatchetKeyPool * pool
+);
+
 /** Returns the number of bytes needed to store an account */
 OLM_EXPORT size_t olm_pickle_account_length(
     OlmAccount const * account
@@ -175,6 +232,124 @@ OLM_EXPORT size_t olm_unpickle_session(
     void * pickled, size_t pickled_length
 );
 
+/** As olm_pickle_account, with a key from olm_pickle_key() */
+OLM_EXPORT size_t olm_pickle_account_with_key_context(
+    OlmAccount * account,
+    OlmPickleKey const * pickle_key,
+    void * pickled, size_t pickled_length
+);
+
+/** As olm_pickle_session, with a key from olm_pickle_key() */
+OLM_EXPORT size_t olm_pickle_session_with_key_context(
+    OlmSession * session,
+    OlmPickleKey const * pickle_key,
+    void * pickled, size_t pickled_length
+);
+
+/** As olm_unpickle_account, with a key from olm_pickle_key() */
+OLM_EXPORT size_t olm_unpickle_account_with_key_context(
+    OlmAccount * account,
+    OlmPickleKey const * pickle_key,
+    void * pickled, size_t pickled_length
+);
+
+/** As olm_unpickle_session, with a key from olm_pickle_key() */
+OLM_EXPORT size_t olm_unpickle_session_with_key_context(
+    OlmSession * session,
+    OlmPickleKey const * pickle_key,
+    void * pickled, size_t pickled_length
+);
+
+/** Returns the number of bytes needed to store an account as a binary
+ * pickle */
+OLM_EXPORT size_t olm_pickle_account_binary_length(
+    OlmAccount const * account
+);
+
+/** Returns the number of bytes needed to store a session as a binary pickle */
+OLM_EXPORT size_t olm_pickle_session_binary_length(
+    OlmSession const * session
+);
+
+/** Stores an account as a binary pickle: the encrypted and authenticated
+ * pickle without the base64 encoding of olm_pickle_account. Encrypts the
+ * account using a key from olm_pickle_key(). Returns the length of the pickled
+ * account on success. Returns olm_error() on failure. If the pickle output
+ * buffer is smaller than olm_pickle_account_binary_length() then
+ * olm_account_last_error() will be "OUTPUT_BUFFER_TOO_SMALL" */
+OLM_EXPORT size_t olm_pickle_account_binary(
+    OlmAccount * account,
+    OlmPickleKey const * pickle_key,
+    void * pickled, size_t pickled_length
+);
+
+/** Stores a session as a binary pickle: the encrypted and authenticated
+ * pickle without the base64 encoding of olm_pickle_session. Encrypts the
+ * session using a key from olm_pickle_key(). Returns the length of the pickled
+ * session on success. Returns olm_error() on failure. If the pickle output
+ * buffer is smaller than olm_pickle_session_binary_length() then
+ * olm_session_last_error() will be "OUTPUT_BUFFER_TOO_SMALL" */
+OLM_EXPORT size_t olm_pickle_session_binary(
+    OlmSession * session,
+    OlmPickleKey const * pickle_key,
+    void * pickled, size_t pickled_length
+);
+
+/** Loads an account from a binary pickle. Decrypts the account using a key
+ * from olm_pickle_key(). Returns olm_error() on failure. If the key doesn't
+ * match the one used to encrypt the account then olm_account_last_error()
+ * will be "BAD_ACCOUNT_KEY". The input pickled buffer is destroyed */
+OLM_EXPORT size_t olm_unpickle_account_binary(
+    OlmAccount * account,
+    OlmPickleKey const * pickle_key,
+    void * pickled, size_t pickled_length
+);
+
+/** Loads a session from a binary pickle. Decrypts the session using a key
+ * from olm_pickle_key(). Returns olm_error() on failure. If the key doesn't
+ * match the one used to encrypt the session then olm_session_last_error()
+ * will be "BAD_ACCOUNT_KEY". The input pickled buffer is destroyed */
+OLM_EXPORT size_t olm_unpickle_session_binary(
+    OlmSession * session,
+    OlmPickleKey const * pickle_key,
+    void * pickled, size_t pickled_length
+);
+
+/** Returns the number of bytes needed to store the changes made to a session
+ * since its last delta, or 0 if it hasn't changed. */
+OLM_EXPORT size_t olm_session_delta_length(
+    OlmSession const * session
+);
+
+/** Stores the changes made to a session since its last delta as an encrypted
+ * and authenticated record, so that a session store can append deltas after
+ * each encrypt or decrypt instead of writing the whole pickle. The deltas must
+ * be applied in the order they were written, starting from a binary pickle
+ * taken before the first of them. Taking a new pickle compacts the deltas
+ * written so far. Encrypts the delta using a key from olm_pickle_key().
+ * Returns the length of the delta, which is 0 if the session hasn't changed.
+ * Returns olm_error() on failure. If the delta output buffer is smaller than
+ * olm_session_delta_length() then olm_session_last_error() will be
+ * "OUTPUT_BUFFER_TOO_SMALL" */
+OLM_EXPORT size_t olm_session_delta(
+    OlmSession * session,
+    OlmPickleKey const * pickle_key,
+    void * delta, size_t delta_length
+);
+
+/** Applies a delta from olm_session_delta() to a session loaded from an
+ * earlier pickle. Returns olm_error() on failure. If the key doesn't match the
+ * one used to encrypt the delta then olm_session_last_error() will be
+ * "BAD_ACCOUNT_KEY". If the delta doesn't follow the pickle or the delta last
+ * applied then olm_session_last_error() will be "DELTA_OUT_OF_ORDER" and the
+ * session is unchanged. The session should be loaded again after any other
+ * failure. The input delta buffer is destroyed */
+OLM_EXPORT size_t olm_session_apply_delta(
+    OlmSession * session,
+    OlmPickleKey const * pickle_key,
+    void * delta, size_t delta_length
+);
+
 /** The number of random bytes needed to create an account.*/
 OLM_EXPORT size_t olm_create_account_random_length(
     OlmAccount const * account
@@ -261,6 +436,16 @@ OLM_EXPORT size_t olm_account_max_number_of_one_time_keys(
     OlmAccount const * account
 );
 
+/** Changes the largest number of one time keys this account can store, which
+ * defaults to 100. The value is kept in the pickle, so this is normally only
+ * called once, after creating the account. Values are limited to between 1
+ * and 65536. If the account holds more keys than the new maximum then the
+ * oldest keys are discarded. Returns the new maximum. */
+OLM_EXPORT size_t olm_account_set_max_number_of_one_time_keys(
+    OlmAccount * account,
+    size_t max_number_of_keys
+);
+
 /** The number of random bytes needed to generate a given number of new one
  * time keys. */
 OLM_EXPORT size_t olm_account_generate_one_time_keys_random_length(
@@ -278,6 +463,18 @@ OLM_EXPORT size_t olm_account_generate_one_time_keys(
     void * random, size_t random_length
 );
 
+/** As olm_account_generate_one_time_keys(), but the keys are split into
+ * groups that are handed to parallel_for, which may generate them on several
+ * threads at once. parallel_for may be NULL to generate them on the calling
+ * thread. The keys are the same as olm_account_generate_one_time_keys() makes
+ * from the same random bytes. */
+OLM_EXPORT size_t olm_account_generate_one_time_keys_parallel(
+    OlmAccount * account,
+    size_t number_of_keys,
+    void * random, size_t random_length,
+    OlmParallelFor parallel_for, void * parallel_for_context
+);
+
 OLM_EXPORT size_t olm_account_generate_prekey_random_length(
     OlmAccount const * account
 );
@@ -458,6 +655,25 @@ OLM_EXPORT int olm_session_is_sender_chain_empty(
  */
 OLM_EXPORT void olm_session_describe(OlmSession * session, char *buf, size_t buflen);
 
+/** Changes the largest number of message keys this session keeps for messages
+ * that have been skipped over, which defaults to 40. The value is kept in the
+ * pickle. Values are limited to between 1 and 65536. If the session holds
+ * more keys than the new maximum then the oldest keys are discarded. Returns
+ * the new maximum. */
+OLM_EXPORT size_t olm_session_set_max_skipped_message_keys(
+    OlmSession * session,
+    size_t max_keys
+);
+
+/** Changes the largest number of receiving chains this session keeps, which
+ * defaults to 5. The value is kept in the pickle. Values are limited to
+ * between 1 and 65536. If the session holds more chains than the new maximum
+ * then the oldest chains are discarded. Returns the new maximum. */
+OLM_EXPORT size_t olm_session_set_max_receiver_chains(
+    OlmSession * session,
+    size_t max_chains
+);
+
 /** Checks if the PRE_KEY message is for this in-bound session. This can happen
  * if multiple messages are sent to this account before this account sends a
  * message in reply. The one_time_key_message buffer is destroyed. Returns 1 if
@@ -487,6 +703,94 @@ OLM_EXPORT size_t olm_matches_inbound_session_from(
     void * one_time_key_message, size_t message_length
 );
 
+/** Adds a session to the index, so that pre-key messages for it can be found
+ * with olm_session_index_find_inbound(). The index refers to the session
+ * rather than copying it, so the session must be removed with
+ * olm_session_index_remove() before it is cleared or freed. Adding a session
+ * that is already in the index has no effect. Returns olm_error() on
+ * failure. If the memory for the index couldn't be allocated then
+ * olm_session_index_last_error() will be "OUT_OF_MEMORY". */
+OLM_EXPORT size_t olm_session_index_add(
+    OlmSessionIndex * index,
+    OlmSession * session
+);
+
+/** Removes a session from the index. Returns 1 if the session was in the
+ * index and 0 if it wasn't. */
+OLM_EXPORT size_t olm_session_index_remove(
+    OlmSessionIndex * index,
+    OlmSession * session
+);
+
+/** The number of sessions in the index */
+OLM_EXPORT size_t olm_session_index_count(
+    OlmSessionIndex const * index
+);
+
+/** Finds the session in the index that a PRE_KEY message is for, checking the
+ * same keys as olm_matches_inbound_session_from(). This takes one decode of
+ * the start of the message whatever the number of sessions, rather than one
+ * decode for each session. their_identity_key may be NULL to take the
+ * identity key from the message. The message buffer is left intact. Sets
+ * *session to the matching session and returns 1 if there is one. Sets
+ * *session to NULL and returns 0 if there isn't. Returns olm_error() on
+ * failure. If the key or the message couldn't be decoded as base64 then
+ * olm_session_index_last_error() will be "INVALID_BASE64". If the message
+ * has an unknown version then olm_session_index_last_error() will be
+ * "BAD_MESSAGE_VERSION". If the keys or the start of the inner message
+ * couldn't be read from the message then olm_session_index_last_error()
+ * will be "BAD_MESSAGE_FORMAT". */
+OLM_EXPORT size_t olm_session_index_find_inbound(
+    OlmSessionIndex * index,
+    void const * their_identity_key, size_t their_identity_key_length,
+    void const * one_time_key_message, size_t message_length,
+    OlmSession ** session
+);
+
+/** The length of the keys in OlmMessageHeaders */
+#define OLM_MESSAGE_HEADER_KEY_LENGTH 32
+
+/** The headers of an Olm message, from olm_peek_message() */
+typedef struct OlmMessageHeaders {
+    /** The protocol version of the message */
+    uint8_t version;
+    /** For PRE_KEY messages, the keys that the session is created from. They
+     * are zero for normal messages. */
+    uint8_t identity_key[OLM_MESSAGE_HEADER_KEY_LENGTH];
+    uint8_t base_key[OLM_MESSAGE_HEADER_KEY_LENGTH];
+    uint8_t one_time_key[OLM_MESSAGE_HEADER_KEY_LENGTH];
+    uint8_t prekey[OLM_MESSAGE_HEADER_KEY_LENGTH];
+    /** The ratchet key and chain index of the message, or of the message
+     * inside a PRE_KEY message */
+    uint8_t ratchet_key[OLM_MESSAGE_HEADER_KEY_LENGTH];
+    uint32_t counter;
+} OlmMessageHeaders;
+
+/** Reads the headers of a base64 encoded message, so that it can be routed to
+ * the right session before it is decrypted. Only the start of the message is
+ * decoded, the message buffer is left untouched and no session is needed. The
+ * keys are written raw, not base64 encoded. The message is not authenticated,
+ * so the headers can only be trusted once it has been decrypted.
+ *
+ * Returns OLM_SUCCESS on success. Returns OLM_INVALID_BASE64 if the base64
+ * couldn't be decoded, and OLM_BAD_MESSAGE_FORMAT if the message type isn't
+ * known or the headers couldn't be decoded. Returns OLM_BAD_MESSAGE_VERSION if
+ * the message was for an unsupported protocol version, in which case only the
+ * version is set. */
+OLM_EXPORT enum OlmErrorCode olm_peek_message(
+    size_t message_type,
+    void const * message, size_t message_length,
+    OlmMessageHeaders * headers
+);
+
+/** As olm_peek_message(), for a message that has already been base64
+ * decoded. */
+OLM_EXPORT enum OlmErrorCode olm_peek_message_raw(
+    size_t message_type,
+    void const * message, size_t message_length,
+    OlmMessageHeaders * headers
+);
+
 /** Removes the one time keys that the session used from the account. Returns
  * olm_error() on failure. If the account doesn't have any matching one time
  * keys then olm_account_last_error() will be "BAD_MESSAGE_KEY_ID".
@@ -529,6 +833,87 @@ OLM_EXPORT size_t olm_encrypt(
     void * message, size_t message_length
 );
 
+/** The number of key pairs in the ratchet key pool */
+OLM_EXPORT size_t olm_ratchet_key_pool_count(
+    OlmRatchetKeyPool const * pool
+);
+
+/** The number of random bytes needed to fill the ratchet key pool */
+OLM_EXPORT size_t olm_ratchet_key_pool_refill_random_length(
+    OlmRatchetKeyPool const * pool
+);
+
+/** Generates new key pairs for the ratchet key pool, one for each 32 random
+ * bytes, until the pool is full. The random buffer is destroyed. Returns the
+ * number of key pairs added.
+ *
+ * Generating a key pair is most of the cost of the first message sent after
+ * each message received, so an application that wants to reply quickly can
+ * refill the pool on another thread or when it is idle. One thread may
+ * refill the pool while another encrypts with olm_encrypt_with_key_pool(),
+ * but the pool must not be refilled from two threads at once. */
+OLM_EXPORT size_t olm_ratchet_key_pool_refill(
+    OlmRatchetKeyPool * pool,
+    void * random, size_t random_length
+);
+
+/** As olm_encrypt(), but if the session needs a new ratchet key then it is
+ * taken from the pool instead of being generated. Random bytes are only
+ * needed if the pool is empty, so random may be NULL if
+ * olm_ratchet_key_pool_count() is not 0. The pool must not be used by
+ * two calls to olm_encrypt_with_key_pool() at once. Returns the length of the
+ * message in bytes on success. Returns olm_error() on failure, with the same
+ * errors as olm_encrypt(). */
+OLM_EXPORT size_t olm_encrypt_with_key_pool(
+    OlmSession * session,
+    OlmRatchetKeyPool * pool,
+    void const * plaintext, size_t plaintext_length,
+    void * random, size_t random_length,
+    void * message, size_t message_length
+);
+
+/** The number of random bytes needed to encrypt the next message for each of
+ * the sessions with olm_encrypt_fan_out(). */
+OLM_EXPORT size_t olm_encrypt_fan_out_random_length(
+    OlmSession * const * sessions, size_t session_count
+);
+
+/** The number of bytes needed to hold the next message for each of the
+ * sessions, one after another, for the given number of plain-text bytes. */
+OLM_EXPORT size_t olm_encrypt_fan_out_length(
+    OlmSession * const * sessions, size_t session_count,
+    size_t plaintext_length
+);
+
+/** Encrypts the same message for each of the sessions, as olm_encrypt() would
+ * for each session in turn, for example to share a room key with every device
+ * in a room. Each session must appear only once. The random bytes are handed
+ * out to the sessions in order, olm_encrypt_random_length() bytes to each.
+ * The messages are written as base64 one after another into the messages
+ * buffer. The message for sessions[i] starts at message_offsets[i] and is
+ * message_lengths[i] bytes long, and its type is the
+ * olm_encrypt_message_type() of the session.
+ *
+ * The sessions are split into groups that are handed to parallel_for, which
+ * may encrypt them on several threads at once. parallel_for may be NULL to
+ * encrypt them on the calling thread.
+ *
+ * Returns the total length of the messages on success. Returns olm_error() on
+ * failure. If there weren't enough random bytes or if the messages buffer is
+ * too small then nothing is encrypted, and the olm_session_last_error() of
+ * every session will be "NOT_ENOUGH_RANDOM" or "OUTPUT_BUFFER_TOO_SMALL". If
+ * encrypting for some of the sessions failed then their message_lengths will
+ * be olm_error(), and olm_session_last_error() will say why. The messages
+ * for the other sessions are still written. */
+OLM_EXPORT size_t olm_encrypt_fan_out(
+    OlmSession * const * sessions, size_t session_count,
+    void const * plaintext, size_t plaintext_length,
+    void * random, size_t random_length,
+    void * messages, size_t messages_length,
+    size_t * message_offsets, size_t * message_lengths,
+    OlmParallelFor parallel_for, void * parallel_for_context
+);
+
 /** The maximum number of bytes of plain-text a given message could decode to.
  * The actual size could be different due to padding. The input message buffer
  * is destroyed. Returns olm_error() on failure. If the message base64
@@ -594,6 +979,38 @@ OLM_EXPORT size_t olm_ed25519_verify(
     void * signature, size_t signature_length
 );
 
+/** The number of random bytes needed by olm_ed25519_verify_batch() to check
+ * count signatures. */
+OLM_EXPORT size_t olm_ed25519_verify_batch_random_length(
+    OlmUtility const * utility,
+    size_t count
+);
+
+/** Verify count ed25519 signatures at once, which is faster than checking
+ * them one at a time with olm_ed25519_verify(). Entry i of each array gives
+ * the key, message and signature for signature i, as for
+ * olm_ed25519_verify(). The signature buffers are destroyed. The random
+ * bytes must be unpredictable to whoever made the signatures.
+ *
+ * Sets results[i] to 1 if signature i is valid and 0 if not. Returns 0 if
+ * all the signatures are valid, otherwise olm_error(). On failure
+ * olm_utility_last_error() will be:
+ *  * "NOT_ENOUGH_RANDOM" if random_length is less than
+ *    olm_ed25519_verify_batch_random_length(); nothing is checked then
+ *  * "OUT_OF_MEMORY" if there wasn't room to decode the keys; nothing is
+ *    checked then
+ *  * "INVALID_BASE64" if any key or signature was not valid base64
+ *  * "BAD_MESSAGE_MAC" if any signature was invalid. */
+OLM_EXPORT size_t olm_ed25519_verify_batch(
+    OlmUtility * utility,
+    size_t count,
+    void const * const * keys, size_t const * key_lengths,
+    void const * const * messages, size_t const * message_lengths,
+    void * const * signatures, size_t const * signature_lengths,
+    void const * random, size_t random_length,
+    int * results
+);
+
 /** The block below contains only Emscripten-specific functions. */
 #ifdef EMSCRIPTEN
 /** Function to get the total memory allocated to the Emscripten heap in bytes.  */
@@ -19,6 +19,7 @@
 #include <stdint.h>
 
 #include "olm/error.h"
+#include "olm/pickle_key.h"
 
 #include "olm/olm_export.h"
 
@@ -94,6 +95,56 @@ OLM_EXPORT size_t olm_unpickle_outbound_group_session(
     void * pickled, size_t pickled_length
 );
 
+/** As olm_pickle_outbound_group_session, with a key from olm_pickle_key() */
+OLM_EXPORT size_t olm_pickle_outbound_group_session_with_key_context(
+    OlmOutboundGroupSession *session,
+    const OlmPickleKey * pickle_key,
+    void * pickled, size_t pickled_length
+);
+
+/** As olm_unpickle_outbound_group_session, with a key from olm_pickle_key() */
+OLM_EXPORT size_t olm_unpickle_outbound_group_session_with_key_context(
+    OlmOutboundGroupSession *session,
+    const OlmPickleKey * pickle_key,
+    void * pickled, size_t pickled_length
+);
+
+/** Returns the number of bytes needed to store an outbound group session as a
+ * binary pickle */
+OLM_EXPORT size_t olm_pickle_outbound_group_session_binary_length(
+    const OlmOutboundGroupSession *session
+);
+
+/**
+ * Stores a group session as a binary pickle: the encrypted and authenticated
+ * pickle without the base64 encoding of olm_pickle_outbound_group_session.
+ * Encrypts the session using a key from olm_pickle_key(). Returns the length
+ * of the session on success.
+ *
+ * Returns olm_error() on failure. If the pickle output buffer
+ * is smaller than olm_pickle_outbound_group_session_binary_length() then
+ * olm_outbound_group_session_last_error() will be "OUTPUT_BUFFER_TOO_SMALL"
+ */
+OLM_EXPORT size_t olm_pickle_outbound_group_session_binary(
+    OlmOutboundGroupSession *session,
+    const OlmPickleKey * pickle_key,
+    void * pickled, size_t pickled_length
+);
+
+/**
+ * Loads a group session from a binary pickle. Decrypts the session using a
+ * key from olm_pickle_key().
+ *
+ * Returns olm_error() on failure. If the key doesn't match the one used to
+ * encrypt the session then olm_outbound_group_session_last_error() will be
+ * "BAD_ACCOUNT_KEY". The input pickled buffer is destroyed
+ */
+OLM_EXPORT size_t olm_unpickle_outbound_group_session_binary(
+    OlmOutboundGroupSession *session,
+    const OlmPickleKey * pickle_key,
+    void * pickled, size_t pickled_length
+);
+
 
 /** The number of random bytes needed to create an outbound group session */
 OLM_EXPORT size_t olm_init_outbound_group_session_random_length(
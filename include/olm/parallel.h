@@ -0,0 +1,38 @@
+/* Copyright 2026 Comm Technologies, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef OLM_PARALLEL_H_
+#define OLM_PARALLEL_H_
+
+#include <stddef.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** A hook that lets the application spread work over its own threads. It
+ * must call task(task_context, index) once for each index from 0 to
+ * task_count - 1, and return once all of the calls have returned. The tasks
+ * are independent of each other so they may run concurrently, for example on
+ * a thread pool. context is passed through unchanged from the olm call. */
+typedef void (*OlmParallelFor)(
+    void * context, size_t task_count,
+    void (*task)(void * task_context, size_t index), void * task_context
+);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* OLM_PARALLEL_H_ */
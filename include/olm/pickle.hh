@@ -146,6 +146,62 @@ std::uint8_t const * unpickle(
 }
 
 
+template<typename T>
+std::size_t pickle_length(
+    olm::DynamicList<T> const & list
+) {
+    std::size_t length = pickle_length(std::uint32_t(list.size()));
+    for (auto const & value : list) {
+        length += pickle_length(value);
+    }
+    return length;
+}
+
+
+template<typename T>
+std::uint8_t * pickle(
+    std::uint8_t * pos,
+    olm::DynamicList<T> const & list
+) {
+    pos = pickle(pos, std::uint32_t(list.size()));
+    for (auto const & value : list) {
+        pos = pickle(pos, value);
+    }
+    return pos;
+}
+
+
+/** Replaces the contents of the list. Fails if the pickle holds more than
+ * max_size items. */
+template<typename T>
+std::uint8_t const * unpickle(
+    std::uint8_t const * pos, std::uint8_t const * end,
+    olm::DynamicList<T> & list
+) {
+    std::uint32_t size;
+
+    pos = unpickle(pos, end, size);
+    if (!pos || size > list.max_size()) {
+        return nullptr;
+    }
+
+    list.clear();
+    if (!list.reserve(size)) {
+        return nullptr;
+    }
+    while (size--) {
+        T * value = list.insert(list.end());
+        pos = unpickle(pos, end, *value);
+
+        if (!pos) {
+            return nullptr;
+        }
+    }
+
+    return pos;
+}
+
+
 std::uint8_t * pickle_bytes(
     std::uint8_t * pos,
     std::uint8_t const * bytes, std::size_t bytes_length
@@ -21,7 +21,10 @@
 #include <stddef.h>
 #include <stdint.h>
 
+#include "olm/aes_backend.h"
+#include "olm/crypto.h"
 #include "olm/error.h"
+#include "olm/pickle_key.h"
 
 // Note: exports in this file are only for unit tests.  Nobody else should be
 // using this externally
@@ -31,6 +34,20 @@
 extern "C" {
 #endif
 
+/** The keys derived from a pickle key */
+struct OlmPickleKey {
+    struct _olm_aes256_key_schedule aes_key;
+    struct _olm_aes256_iv aes_iv;
+    struct _olm_hmac_sha256_ctx mac_key;
+};
+
+/**
+ * Derive the keys for encrypting pickles with the key given.
+ */
+OLM_EXPORT void _olm_pickle_key_setup(
+    struct OlmPickleKey * pickle_key,
+    uint8_t const * key, size_t key_length
+);
 
 /**
  * Get the number of bytes needed to encode a pickle of the length given
@@ -60,6 +77,32 @@ OLM_EXPORT size_t _olm_enc_output(
     uint8_t *pickle, size_t raw_length
 );
 
+/**
+ * As _olm_enc_output, with keys set up by _olm_pickle_key_setup.
+ */
+OLM_EXPORT size_t _olm_enc_output_with_key_context(
+    const struct OlmPickleKey * pickle_key,
+    uint8_t *pickle, size_t raw_length
+);
+
+/**
+ * Get the number of bytes needed to encrypt a pickle of the length given,
+ * without base64 encoding it.
+ */
+OLM_EXPORT size_t _olm_enc_output_binary_length(size_t raw_length);
+
+/**
+ * Encrypt the given pickle in-situ without base64 encoding it. The raw pickle
+ * should have been written to the start of the buffer, which must be at least
+ * _olm_enc_output_binary_length(raw_length) bytes.
+ *
+ * Returns the number of bytes in the encrypted pickle.
+ */
+OLM_EXPORT size_t _olm_enc_output_binary(
+    const struct OlmPickleKey * pickle_key,
+    uint8_t *pickle, size_t raw_length
+);
+
 /**
  * Decode and decrypt the given pickle in-situ.
  *
@@ -72,6 +115,28 @@ OLM_EXPORT size_t _olm_enc_input(
     enum OlmErrorCode * last_error
 );
 
+/**
+ * As _olm_enc_input, with keys set up by _olm_pickle_key_setup.
+ */
+OLM_EXPORT size_t _olm_enc_input_with_key_context(
+    const struct OlmPickleKey * pickle_key,
+    uint8_t * input, size_t b64_length,
+    enum OlmErrorCode * last_error
+);
+
+/**
+ * Decrypt a pickle from _olm_enc_output_binary in-situ.
+ *
+ * Returns the number of bytes in the decrypted pickle, or olm_error() on
+ * error, in which case *last_error will be updated, if last_error is
+ * non-NULL.
+ */
+OLM_EXPORT size_t _olm_enc_input_binary(
+    const struct OlmPickleKey * pickle_key,
+    uint8_t * input, size_t enc_length,
+    enum OlmErrorCode * last_error
+);
+
 
 #ifdef __cplusplus
 } // extern "C"
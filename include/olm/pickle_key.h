@@ -0,0 +1,54 @@
+/* Copyright 2026 Comm Technologies, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#ifndef OLM_PICKLE_KEY_H_
+#define OLM_PICKLE_KEY_H_
+
+#include <stddef.h>
+
+#include "olm/olm_export.h"
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** A pickle key with the keys used to encrypt and authenticate pickles
+ * derived from it up front. Pickling many objects with the same key through
+ * the *_with_key_context functions then skips the key derivation that the
+ * functions taking a raw key do on every call. The pickles are the same
+ * either way. */
+typedef struct OlmPickleKey OlmPickleKey;
+
+/** The size of a pickle key object in bytes */
+OLM_EXPORT size_t olm_pickle_key_size(void);
+
+/** Initialise a pickle key object using the supplied memory and derive the
+ * pickle keys from the key given. The supplied memory must be at least
+ * olm_pickle_key_size() bytes. The object can be shared between threads, as
+ * pickling only reads it. */
+OLM_EXPORT OlmPickleKey * olm_pickle_key(
+    void * memory,
+    void const * key, size_t key_length
+);
+
+/** Clears the memory used to back this pickle key. */
+OLM_EXPORT size_t olm_clear_pickle_key(
+    OlmPickleKey * pickle_key
+);
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* OLM_PICKLE_KEY_H_ */
@@ -20,6 +20,7 @@
 #include <stdint.h>
 
 #include "olm/error.h"
+#include "olm/pickle_key.h"
 
 #include "olm/olm_export.h"
 
@@ -190,6 +191,52 @@ OLM_EXPORT size_t olm_unpickle_pk_decryption(
     void *pubkey, size_t pubkey_length
 );
 
+/** As olm_pickle_pk_decryption, with a key from olm_pickle_key() */
+OLM_EXPORT size_t olm_pickle_pk_decryption_with_key_context(
+    OlmPkDecryption * decryption,
+    OlmPickleKey const * pickle_key,
+    void *pickled, size_t pickled_length
+);
+
+/** As olm_unpickle_pk_decryption, with a key from olm_pickle_key() */
+OLM_EXPORT size_t olm_unpickle_pk_decryption_with_key_context(
+    OlmPkDecryption * decryption,
+    OlmPickleKey const * pickle_key,
+    void *pickled, size_t pickled_length,
+    void *pubkey, size_t pubkey_length
+);
+
+/** Returns the number of bytes needed to store a decryption object as a binary
+ * pickle. */
+OLM_EXPORT size_t olm_pickle_pk_decryption_binary_length(
+    const OlmPkDecryption * decryption
+);
+
+/** Stores decryption object as a binary pickle: the encrypted and
+ * authenticated pickle without the base64 encoding of
+ * olm_pickle_pk_decryption. Encrypts the object using a key from
+ * olm_pickle_key(). Returns the length of the pickled object on success.
+ * Returns olm_error() on failure. If the pickle output buffer
+ * is smaller than olm_pickle_pk_decryption_binary_length() then
+ * olm_pk_decryption_last_error() will be "OUTPUT_BUFFER_TOO_SMALL" */
+OLM_EXPORT size_t olm_pickle_pk_decryption_binary(
+    OlmPkDecryption * decryption,
+    OlmPickleKey const * pickle_key,
+    void *pickled, size_t pickled_length
+);
+
+/** Loads a decryption object from a binary pickle. The associated public key
+ * will be written to the pubkey buffer. Decrypts the object using a key from
+ * olm_pickle_key(). Returns olm_error() on failure. If the key doesn't match
+ * the one used to encrypt the object then olm_pk_decryption_last_error()
+ * will be "BAD_ACCOUNT_KEY". The input pickled buffer is destroyed */
+OLM_EXPORT size_t olm_unpickle_pk_decryption_binary(
+    OlmPkDecryption * decryption,
+    OlmPickleKey const * pickle_key,
+    void *pickled, size_t pickled_length,
+    void *pubkey, size_t pubkey_length
+);
+
 /** Get the length of the plaintext that will correspond to a ciphertext of the
  * given length. */
 OLM_EXPORT size_t olm_pk_max_plaintext_length(
@@ -16,6 +16,7 @@
 #include <cstdint>
 
 #include "olm/crypto.h"
+#include "olm/key_index.hh"
 #include "olm/list.hh"
 #include "olm/error.h"
 
@@ -64,8 +65,129 @@ struct SkippedMessageKey {
 };
 
 
+/**
+ * The message keys skipped over when advancing the receiver chains. They are
+ * kept in the order they were skipped, so that the oldest key is dropped when
+ * there are more than max_size(), and indexed by ratchet key and message
+ * index. The keys are stored in a ring buffer that is allocated on first use.
+ * Keys that are used up leave holes which are squeezed out when the ring
+ * fills, so nothing is shifted when a key is added or removed.
+ */
+class OLM_EXPORT SkippedMessageKeys {
+    struct Slot {
+        SkippedMessageKey key;
+        bool used;
+    };
+
+public:
+    explicit SkippedMessageKeys(std::size_t max_size);
+    ~SkippedMessageKeys();
+
+    SkippedMessageKeys(SkippedMessageKeys const &) = delete;
+    SkippedMessageKeys & operator=(SkippedMessageKeys const &) = delete;
+
+    /** Iterates over the keys, newest first. */
+    class const_iterator {
+    public:
+        const_iterator(SkippedMessageKeys const & keys, std::size_t position)
+            : _keys(keys), _position(position) { skip_holes(); }
+        SkippedMessageKey const & operator*() const {
+            return _keys.slot(_position - 1).key;
+        }
+        const_iterator & operator++() {
+            --_position;
+            skip_holes();
+            return *this;
+        }
+        bool operator!=(const_iterator const & other) const {
+            return _position != other._position;
+        }
+    private:
+        void skip_holes() {
+            while (_position && !_keys.slot(_position - 1).used) {
+                --_position;
+            }
+        }
+        SkippedMessageKeys const & _keys;
+        std::size_t _position;
+    };
+
+    const_iterator begin() const { return const_iterator(*this, _span); }
+    const_iterator end() const { return const_iterator(*this, 0); }
+
+    bool empty() const { return _size == 0; }
+
+    /** The number of keys stored. */
+    std::size_t size() const { return _size; }
+
+    /** The largest number of keys that will be kept. */
+    std::size_t max_size() const { return _max_size; }
+
+    /** Change the largest number of keys that will be kept, dropping the
+     * oldest keys if there are more than that. */
+    void set_max_size(std::size_t max_size);
+
+    /** Make sure there is storage for count keys, or max_size() if that is
+     * fewer. Returns false if the memory couldn't be allocated. */
+    bool reserve(std::size_t count);
+
+    /** Forget all of the keys and release their storage. */
+    void clear();
+
+    /** Add a key as the newest, dropping the oldest key if there are already
+     * max_size(). */
+    void insert(SkippedMessageKey const & key);
+
+    /** Add a key as the oldest, which is how they are unpickled. Returns
+     * false if reserve() hasn't made room for it. */
+    bool insert_oldest(SkippedMessageKey const & key);
+
+    /** Find the key for a message, or return nullptr. */
+    SkippedMessageKey * find(
+        _olm_curve25519_public_key const & ratchet_key, std::uint32_t index
+    );
+
+    /** Remove and clear a key returned by find(). */
+    void erase(SkippedMessageKey * key);
+
+private:
+    Slot const & slot(std::size_t position) const {
+        return _slots[(_head + position) % _capacity];
+    }
+
+    bool resize(std::size_t capacity);
+    void squeeze();
+    void drop_oldest();
+    void trim_holes();
+    void index_slots();
+
+    /** ring buffer of _capacity slots, of which the _span from _head hold the
+     * _size keys and any holes between them */
+    Slot * _slots;
+    std::size_t _capacity;
+    std::size_t _head;
+    std::size_t _span;
+    std::size_t _size;
+    std::size_t _max_size;
+    /** slot numbers, by ratchet key and message index */
+    KeyIndex _index;
+};
+
+/** default for the number of receiver chains a ratchet keeps */
 static std::size_t const MAX_RECEIVER_CHAINS = 5;
+/** default for the number of skipped message keys a ratchet keeps */
 static std::size_t const MAX_SKIPPED_MESSAGE_KEYS = 40;
+/** largest number of receiver chains or skipped message keys a ratchet can
+ * be set to keep */
+static std::size_t const MAX_RATCHET_LIST_LIMIT = 65536;
+
+/** Flags for the parts of a ratchet that have changed since the last delta
+ * was written, see Ratchet::changes. */
+static std::uint8_t const RATCHET_CHANGED_SENDER_CHAIN = 0x01;
+static std::uint8_t const RATCHET_CHANGED_RECEIVER_CHAIN = 0x02;
+static std::uint8_t const RATCHET_CHANGED_RECEIVER_CHAINS = 0x04;
+static std::uint8_t const RATCHET_CHANGED_SKIPPED_MESSAGE_KEYS = 0x08;
+static std::uint8_t const RATCHET_CHANGED_LIMITS = 0x10;
 
 
 struct KdfInfo {
@@ -104,11 +226,29 @@ struct OLM_EXPORT Ratchet {
     /** The receiver chain is used to decrypt received messages. We store the
      * last few chains so we can decrypt any out of order messages we haven't
      * received yet. */
-    List<ReceiverChain, MAX_RECEIVER_CHAINS> receiver_chains;
+    DynamicList<ReceiverChain> receiver_chains;
 
     /** List of message keys we've skipped over when advancing the receiver
      * chain. */
-    List<SkippedMessageKey, MAX_SKIPPED_MESSAGE_KEYS> skipped_message_keys;
+    SkippedMessageKeys skipped_message_keys;
+
+    /** The RATCHET_CHANGED_* flags for the state that has changed since the
+     * last delta was written. The root key changes along with the sender
+     * chain. */
+    std::uint8_t changes;
+
+    /** The position of the receiver chain whose chain key has changed, when
+     * RATCHET_CHANGED_RECEIVER_CHAIN is set. */
+    std::uint32_t changed_receiver_chain;
+
+    /** Record that the chain key of one receiver chain has changed. Changes
+     * to more than one chain are recorded as RATCHET_CHANGED_RECEIVER_CHAINS.
+     */
+    void receiver_chain_changed(std::size_t position);
+
+    /** Record that the list of receiver chains has changed as a whole, which
+     * covers any change to a single chain. */
+    void receiver_chains_changed();
 
     /** Initialise the session using a shared secret and the public part of the
      * remote's first ratchet key */
@@ -139,11 +279,14 @@ struct OLM_EXPORT Ratchet {
      * or std::size_t(-1) on failure. On failure last_error will be set with
      * an error code. The last_error will be NOT_ENOUGH_RANDOM if the number
      * of random bytes is too small. The last_error will be
-     * OUTPUT_BUFFER_TOO_SMALL if the output buffer is too small. */
+     * OUTPUT_BUFFER_TOO_SMALL if the output buffer is too small. If
+     * ratchet_key is given then it is used for a new ephemeral key instead of
+     * generating one from the random bytes, and no random bytes are needed. */
     std::size_t encrypt(
         std::uint8_t const * plaintext, std::size_t plaintext_length,
         std::uint8_t const * random, std::size_t random_length,
-        std::uint8_t * output, std::size_t max_output_length
+        std::uint8_t * output, std::size_t max_output_length,
+        _olm_curve25519_key_pair const * ratchet_key = nullptr
     );
 
     /** An upper bound on the number of bytes of plain-text the decrypt method
@@ -188,4 +331,24 @@ std::uint8_t const * unpickle(
 );
 
 
+/** The length of the state named by value.changes */
+std::size_t pickle_delta_length(
+    Ratchet const & value
+);
+
+
+/** Writes value.changes followed by the state that it names */
+std::uint8_t * pickle_delta(
+    std::uint8_t * pos,
+    Ratchet const & value
+);
+
+
+/** Replaces the state named in a delta from pickle_delta */
+std::uint8_t const * unpickle_delta(
+    std::uint8_t const * pos, std::uint8_t const * end,
+    Ratchet & value
+);
+
+
 } // namespace olm
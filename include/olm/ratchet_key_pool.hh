@@ -0,0 +1,72 @@
+/* Copyright 2026 Comm Technologies, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OLM_RATCHET_KEY_POOL_HH_
+#define OLM_RATCHET_KEY_POOL_HH_
+
+#include "olm/crypto.h"
+
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+
+namespace olm {
+
+/**
+ * A ring buffer of pre-generated Curve25519 key pairs for new sender chains,
+ * so that encrypting doesn't have to generate one. One thread may refill the
+ * pool while another takes keys from it: each end is owned by one thread,
+ * and the keys are handed over through the atomic counters.
+ */
+struct RatchetKeyPool {
+
+    /** The number of key pairs the pool holds. */
+    static const std::size_t CAPACITY = 16;
+
+    RatchetKeyPool();
+    ~RatchetKeyPool();
+
+    RatchetKeyPool(RatchetKeyPool const &) = delete;
+    RatchetKeyPool & operator=(RatchetKeyPool const &) = delete;
+
+    /** The number of key pairs in the pool. */
+    std::size_t count() const;
+
+    /** The number of random bytes refill() needs to fill the pool. */
+    std::size_t refill_random_length() const;
+
+    /** Generate key pairs from the random bytes, one for each
+     * CURVE25519_RANDOM_LENGTH bytes, until the pool is full. Returns the
+     * number of key pairs added. Must only be called from one thread at a
+     * time. */
+    std::size_t refill(
+        std::uint8_t const * random, std::size_t random_length
+    );
+
+    /** Take the oldest key pair from the pool. Returns false if the pool is
+     * empty. Must only be called from one thread at a time. */
+    bool take(_olm_curve25519_key_pair & key);
+
+private:
+    _olm_curve25519_key_pair keys[CAPACITY];
+    /** the number of key pairs ever taken, only written by take() */
+    std::atomic<std::size_t> head;
+    /** the number of key pairs ever added, only written by refill() */
+    std::atomic<std::size_t> tail;
+};
+
+} // namespace olm
+
+#endif /* OLM_RATCHET_KEY_POOL_HH_ */
@@ -24,6 +24,7 @@
 namespace olm {
 
 struct Account;
+struct PreKeyMessageReader;
 
 enum struct MessageType {
     PRE_KEY = 0,
@@ -44,6 +45,11 @@ struct OLM_EXPORT Session {
     _olm_curve25519_public_key bob_one_time_key;
     _olm_curve25519_public_key bob_prekey;
 
+    /** The number of deltas written since the session was created. A delta
+     * can only be applied to the state it was written from, which is
+     * identified by this generation. */
+    std::uint32_t delta_generation;
+
     /** The number of random bytes that are needed to create a new outbound
      * session. This will be 64 bytes since two ephemeral keys are needed. */
     std::size_t new_outbound_session_random_length() const;
@@ -73,6 +79,10 @@ struct OLM_EXPORT Session {
         std::uint8_t const * pre_key_message, std::size_t message_length
     );
 
+    /** The length of the MAC at the end of each normal message, and of the
+     * message inside each pre-key message. */
+    static std::size_t message_mac_length();
+
     /** The number of bytes written by session_id() */
     std::size_t session_id_length() const;
 
@@ -85,6 +95,22 @@ struct OLM_EXPORT Session {
         std::uint8_t * id, std::size_t id_length
     );
 
+    /** Compute the id of a session created from the given keys, as written by
+     * session_id(). id must hold session_id_length() bytes. */
+    static void compute_session_id(
+        _olm_curve25519_public_key const & alice_identity_key,
+        _olm_curve25519_public_key const & alice_base_key,
+        _olm_curve25519_public_key const & bob_one_time_key,
+        std::uint8_t * id
+    );
+
+    /** True if a decoded pre-key message has the fields needed to start or
+     * match an inbound session. The identity key may be left out of the
+     * message if the caller already has it. */
+    static bool check_inbound_message_fields(
+        PreKeyMessageReader const & reader, bool have_their_identity_key
+    );
+
     /** True if this session can be used to decode an inbound pre-key message.
      * This can be used to test whether a pre-key message should be decoded
      * with an existing session or if a new session will need to be created.
@@ -114,11 +140,14 @@ struct OLM_EXPORT Session {
       * or std::size_t(-1) on failure. On failure last_error will be set with
       * an error code. The last_error will be NOT_ENOUGH_RANDOM if the number
       * of random bytes is too small. The last_error will be
-      * OUTPUT_BUFFER_TOO_SMALL if the output buffer is too small. */
+      * OUTPUT_BUFFER_TOO_SMALL if the output buffer is too small. If
+      * ratchet_key is given then no random bytes are needed, see
+      * Ratchet::encrypt. */
     std::size_t encrypt(
         std::uint8_t const * plaintext, std::size_t plaintext_length,
         std::uint8_t const * random, std::size_t random_length,
-        std::uint8_t * message, std::size_t message_length
+        std::uint8_t * message, std::size_t message_length,
+        _olm_curve25519_key_pair const * ratchet_key = nullptr
     );
 
     /** An upper bound on the number of bytes of plain-text the decrypt method
@@ -152,6 +181,16 @@ struct OLM_EXPORT Session {
      * Takes a buffer to write to and the length of that buffer
      */
     void describe(char *buf, size_t buflen);
+
+    /** Changes the largest number of skipped message keys this session keeps,
+     * within 1 and MAX_RATCHET_LIST_LIMIT. If more keys are stored than that
+     * then the oldest ones are discarded. Returns the new maximum. */
+    std::size_t set_max_skipped_message_keys(std::size_t max_keys);
+
+    /** Changes the largest number of receiver chains this session keeps,
+     * within 1 and MAX_RATCHET_LIST_LIMIT. If more chains are stored than
+     * that then the oldest ones are discarded. Returns the new maximum. */
+    std::size_t set_max_receiver_chains(std::size_t max_chains);
 };
 
 
@@ -172,6 +211,29 @@ OLM_EXPORT std::uint8_t const * unpickle(
 );
 
 
+/** The changes to the session since the last delta: received_message and the
+ * parts of the ratchet named by ratchet.changes, tagged with the generation
+ * they apply to. */
+std::size_t pickle_delta_length(
+    Session const & value
+);
+
+
+std::uint8_t * pickle_delta(
+    std::uint8_t * pos,
+    Session const & value
+);
+
+
+/** Applies a delta to a session. The last_error will be
+ * DELTA_OUT_OF_ORDER if the delta was not written from the current
+ * generation of the session. */
+std::uint8_t const * unpickle_delta(
+    std::uint8_t const * pos, std::uint8_t const * end,
+    Session & value
+);
+
+
 } // namespace olm
 
 #endif /* OLM_SESSION_HH_ */
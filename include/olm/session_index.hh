@@ -0,0 +1,95 @@
+/* Copyright 2026 Comm Technologies, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#ifndef OLM_SESSION_INDEX_HH_
+#define OLM_SESSION_INDEX_HH_
+
+#include "olm/crypto.h"
+#include "olm/error.h"
+#include "olm/key_index.hh"
+#include "olm/list.hh"
+
+#include <cstddef>
+#include <cstdint>
+
+namespace olm {
+
+struct Session;
+
+/**
+ * A set of sessions indexed by session id, so that the session a pre-key
+ * message is for can be found without checking every session in turn. The
+ * sessions are not owned by the index and must be removed from it before
+ * they are cleared.
+ */
+struct SessionIndex {
+
+    SessionIndex();
+
+    SessionIndex(SessionIndex const &) = delete;
+    SessionIndex & operator=(SessionIndex const &) = delete;
+
+    OlmErrorCode last_error;
+
+    /** The number of sessions in the index. */
+    std::size_t size() const { return entries.size(); }
+
+    /** Add a session to the index. Adding a session twice has no effect.
+     * Returns std::size_t(-1) on failure. If the memory for the session
+     * couldn't be allocated then last_error will be OUT_OF_MEMORY. */
+    std::size_t add(Session & session);
+
+    /** Remove a session from the index. Returns whether it was there. */
+    bool remove(Session & session);
+
+    /** Find the session with the given id, or nullptr if there isn't one. */
+    Session * find(std::uint8_t const * id) const;
+
+    /** Find the session that an inbound pre-key message is for, matching the
+     * same keys as Session::matches_inbound_session. The message only needs
+     * to be decoded as far as its keys. Sets session to the matching session,
+     * or to nullptr if there isn't one. Returns std::size_t(-1) on failure.
+     * If the message has an unknown version then last_error will be
+     * BAD_MESSAGE_VERSION. If it fails
+     * Session::check_inbound_message_fields then last_error will be
+     * BAD_MESSAGE_FORMAT. */
+    std::size_t find_inbound(
+        _olm_curve25519_public_key const * their_identity_key,
+        std::uint8_t const * pre_key_message, std::size_t message_length,
+        Session * & session
+    );
+
+private:
+    struct Entry {
+        Session * session;
+        std::uint8_t id[SHA256_OUTPUT_LENGTH];
+    };
+
+    /** Rebuild index from entries */
+    void index_sessions();
+
+    /** Find the entry for a session with the given id. If session is null
+     * then any session with that id will do. */
+    Entry const * find_entry(
+        std::uint8_t const * id, Session const * session
+    ) const;
+
+    DynamicList<Entry> entries;
+    KeyIndex index;
+};
+
+} // namespace olm
+
+#endif /* OLM_SESSION_INDEX_HH_ */
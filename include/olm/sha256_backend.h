@@ -0,0 +1,101 @@
+/* Copyright 2026 Comm Technologies, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* SHA-256 with a pluggable compression function. The SHA extensions of the
+ * CPU are used when they are available, with a vectorised message schedule
+ * or portable C as fallbacks.
+ */
+
+#ifndef OLM_SHA256_BACKEND_H_
+#define OLM_SHA256_BACKEND_H_
+
+#include <stddef.h>
+#include <stdint.h>
+
+#ifdef __cplusplus
+extern "C" {
+#endif
+
+/** length of the blocks processed by the SHA-256 compression function */
+#define SHA256_BLOCK_LENGTH 64
+
+/** number of words in the SHA-256 chaining state */
+#define SHA256_STATE_WORDS 8
+
+struct _olm_sha256_ctx {
+    uint32_t state[SHA256_STATE_WORDS];
+    /** number of bytes hashed so far */
+    uint64_t length;
+    /** input that does not yet fill a block */
+    uint8_t buffer[SHA256_BLOCK_LENGTH];
+};
+
+void _olm_sha256_init(struct _olm_sha256_ctx * ctx);
+
+void _olm_sha256_update(
+    struct _olm_sha256_ctx * ctx,
+    const uint8_t * input, size_t input_length
+);
+
+/** Writes the SHA256_OUTPUT_LENGTH (32) byte hash to output. */
+void _olm_sha256_final(struct _olm_sha256_ctx * ctx, uint8_t * output);
+
+/** Runs the compression function over block_count consecutive blocks. */
+void _olm_sha256_compress(
+    uint32_t * state, const uint8_t * blocks, size_t block_count
+);
+
+/** maximum number of states handled by _olm_sha256_compress_lanes */
+#define SHA256_MAX_LANES 4
+
+/** Runs the compression function over one block for each of lane_count (at
+ * most SHA256_MAX_LANES) independent states. The lanes are computed together
+ * in SIMD registers when the CPU has no SHA instructions. */
+void _olm_sha256_compress_lanes(
+    uint32_t (* states)[SHA256_STATE_WORDS],
+    const uint8_t * const * blocks, size_t lane_count
+);
+
+
+/* Implementations, used by _olm_sha256_compress and
+ * _olm_sha256_compress_lanes. */
+
+void _olm_sha256_portable_compress(
+    uint32_t * state, const uint8_t * blocks, size_t block_count
+);
+void _olm_sha256_x86_sha_compress(
+    uint32_t * state, const uint8_t * blocks, size_t block_count
+);
+void _olm_sha256_x86_ssse3_compress(
+    uint32_t * state, const uint8_t * blocks, size_t block_count
+);
+void _olm_sha256_arm_compress(
+    uint32_t * state, const uint8_t * blocks, size_t block_count
+);
+void _olm_sha256_x86_compress_x4(
+    uint32_t (* states)[SHA256_STATE_WORDS], const uint8_t * const * blocks
+);
+void _olm_sha256_neon_compress_x4(
+    uint32_t (* states)[SHA256_STATE_WORDS], const uint8_t * const * blocks
+);
+
+/** the SHA-256 round constants */
+extern const uint32_t _olm_sha256_k[64];
+
+#ifdef __cplusplus
+} // extern "C"
+#endif
+
+#endif /* OLM_SHA256_BACKEND_H_ */
@@ -53,6 +53,21 @@ struct Utility {
         std::uint8_t const * signature, std::size_t signature_length
     );
 
+    /** Verify count ed25519 signatures together. random must hold
+     * ED25519_BATCH_RANDOM_LENGTH bytes for each signature. Sets results[i]
+     * to 1 if signature i is valid, 0 if not. Returns std::size_t(0) if all
+     * of the signatures are valid. Otherwise returns std::size_t(-1) and
+     * last_error will be BAD_MESSAGE_MAC. */
+    std::size_t ed25519_verify_batch(
+        _olm_ed25519_public_key const * keys,
+        std::uint8_t const * const * messages,
+        std::size_t const * message_lengths,
+        std::uint8_t const * const * signatures,
+        std::size_t const * signature_lengths,
+        std::size_t count, std::uint8_t const * random,
+        int * results
+    );
+
 };
 
 
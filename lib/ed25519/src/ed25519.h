@@ -20,6 +20,13 @@
 extern "C" {
 #endif
 
+/* the public key followed by a table of multiples of its point */
+#define ED25519_PREPARED_KEY_SIZE (32 + 8 * 4 * 10 * 4)
+
+/* random bytes needed by ed25519_verify_batch for each signature. Its public
+   keys are packed together, 32 bytes each. */
+#define ED25519_BATCH_RANDOM_SIZE 16
+
 #ifndef ED25519_NO_SEED
 int ED25519_DECLSPEC ed25519_create_seed(unsigned char *seed);
 #endif
@@ -27,8 +34,13 @@ int ED25519_DECLSPEC ed25519_create_seed(unsigned char *seed);
 void ED25519_DECLSPEC ed25519_create_keypair(unsigned char *public_key, unsigned char *private_key, const unsigned char *seed);
 void ED25519_DECLSPEC ed25519_sign(unsigned char *signature, const unsigned char *message, size_t message_len, const unsigned char *public_key, const unsigned char *private_key);
 int ED25519_DECLSPEC ed25519_verify(const unsigned char *signature, const unsigned char *message, size_t message_len, const unsigned char *public_key);
+int ED25519_DECLSPEC ed25519_prepare_public_key(unsigned char *prepared_key, const unsigned char *public_key);
+int ED25519_DECLSPEC ed25519_verify_prepared(const unsigned char *signature, const unsigned char *message, size_t message_len, const unsigned char *prepared_key);
+int ED25519_DECLSPEC ed25519_verify_batch(const unsigned char * const *signatures, const unsigned char * const *messages, const size_t *message_lens, const unsigned char *public_keys, size_t count, const unsigned char *random, int *valid);
 void ED25519_DECLSPEC ed25519_add_scalar(unsigned char *public_key, unsigned char *private_key, const unsigned char *scalar);
 void ED25519_DECLSPEC ed25519_key_exchange(unsigned char *shared_secret, const unsigned char *public_key, const unsigned char *private_key);
+void ED25519_DECLSPEC ed25519_x25519_base(unsigned char *public_key, const unsigned char *private_key);
+void ED25519_DECLSPEC ed25519_x25519_base_batch(unsigned char *public_keys, const unsigned char *private_keys, size_t stride, size_t count);
 
 
 #ifdef __cplusplus
@@ -64,16 +64,10 @@ and b = b[0]+256*b[1]+...+256^31 b[31].
 B is the Ed25519 base point (x,4/5) with x positive.
 */
 
-void ge_double_scalarmult_vartime(ge_p2 *r, const unsigned char *a, const ge_p3 *A, const unsigned char *b) {
-    signed char aslide[256];
-    signed char bslide[256];
-    ge_cached Ai[8]; /* A,3A,5A,7A,9A,11A,13A,15A */
+void ge_p3_to_cached_odd_multiples(ge_cached *Ai, const ge_p3 *A) {
     ge_p1p1 t;
     ge_p3 u;
     ge_p3 A2;
-    int i;
-    slide(aslide, a);
-    slide(bslide, b);
     ge_p3_to_cached(&Ai[0], A);
     ge_p3_dbl(&t, A);
     ge_p1p1_to_p3(&A2, &t);
@@ -98,6 +92,26 @@ void ge_double_scalarmult_vartime(ge_p2 *r, const unsigned char *a, const ge_p3
     ge_add(&t, &A2, &Ai[6]);
     ge_p1p1_to_p3(&u, &t);
     ge_p3_to_cached(&Ai[7], &u);
+}
+
+void ge_double_scalarmult_vartime(ge_p2 *r, const unsigned char *a, const ge_p3 *A, const unsigned char *b) {
+    ge_cached Ai[8]; /* A,3A,5A,7A,9A,11A,13A,15A */
+    ge_p3_to_cached_odd_multiples(Ai, A);
+    ge_double_scalarmult_vartime_cached(r, a, Ai, b);
+}
+
+/*
+as ge_double_scalarmult_vartime, with Ai from ge_p3_to_cached_odd_multiples
+*/
+
+void ge_double_scalarmult_vartime_cached(ge_p2 *r, const unsigned char *a, const ge_cached *Ai, const unsigned char *b) {
+    signed char aslide[256];
+    signed char bslide[256];
+    ge_p1p1 t;
+    ge_p3 u;
+    int i;
+    slide(aslide, a);
+    slide(bslide, b);
     ge_p2_0(r);
 
     for (i = 255; i >= 0; --i) {
@@ -130,6 +144,67 @@ void ge_double_scalarmult_vartime(ge_p2 *r, const unsigned char *a, const ge_p3
 }
 
 
+/*
+r = b * B + a[0] * A[0] + ... + a[count-1] * A[count-1]
+where the a[j] are 32 byte scalars laid out one after another, and the odd
+multiples of A[j] from ge_p3_to_cached_odd_multiples are at Ai[8 * j].
+aslides is scratch space of 256 * count bytes.
+*/
+
+void ge_multi_scalarmult_vartime(ge_p2 *r, const unsigned char *b, const unsigned char *a, const ge_cached *Ai, size_t count, signed char *aslides) {
+    signed char bslide[256];
+    ge_p1p1 t;
+    ge_p3 u;
+    size_t j;
+    int i;
+    slide(bslide, b);
+
+    for (j = 0; j < count; ++j) {
+        slide(aslides + 256 * j, a + 32 * j);
+    }
+
+    ge_p2_0(r);
+
+    for (i = 255; i >= 0; --i) {
+        int nonzero = bslide[i];
+
+        for (j = 0; j < count && !nonzero; ++j) {
+            nonzero = aslides[256 * j + i];
+        }
+
+        if (nonzero) {
+            break;
+        }
+    }
+
+    for (; i >= 0; --i) {
+        ge_p2_dbl(&t, r);
+
+        for (j = 0; j < count; ++j) {
+            signed char digit = aslides[256 * j + i];
+
+            if (digit > 0) {
+                ge_p1p1_to_p3(&u, &t);
+                ge_add(&t, &u, &Ai[8 * j + digit / 2]);
+            } else if (digit < 0) {
+                ge_p1p1_to_p3(&u, &t);
+                ge_sub(&t, &u, &Ai[8 * j + (-digit) / 2]);
+            }
+        }
+
+        if (bslide[i] > 0) {
+            ge_p1p1_to_p3(&u, &t);
+            ge_madd(&t, &u, &Bi[bslide[i] / 2]);
+        } else if (bslide[i] < 0) {
+            ge_p1p1_to_p3(&u, &t);
+            ge_msub(&t, &u, &Bi[(-bslide[i]) / 2]);
+        }
+
+        ge_p1p1_to_p2(r, &t);
+    }
+}
+
+
 static const fe d = {
     -10913610, 13857413, -15372611, 6949391, 114729, -8787816, -6275908, -3247719, -18696448, -12055116
 };
@@ -181,6 +256,176 @@ int ge_frombytes_negate_vartime(ge_p3 *h, const unsigned char *s) {
 }
 
 
+/*
+The checks below work on the Montgomery curve v^2 = u^3 + A u^2 + u with
+u = (1 + y) / (1 - y), where a point other than (0, 0) can be halved exactly
+when u is a square.
+*/
+
+static const fe montgomery_a = {
+    486662, 0, 0, 0, 0, 0, 0, 0, 0, 0
+};
+
+/* sqrt((A^2 - 4) / sqrt(-1)) and sqrt(-(A^2 - 4) / sqrt(-1)) */
+static const fe montgomery_k1 = {
+    62542370, 29662700, 21935382, 10863246, 41376891, 2926223, 49067152, 4052932, 63077071, 8814358
+};
+
+static const fe montgomery_k2 = {
+    21717894, 19069928, 14254103, 16133428, 27204230, 17016392, 34557543, 25042169, 11776238, 31849478
+};
+
+static void fe_carry(fe h, const fe f) {
+    fe one;
+    fe_1(one);
+    fe_mul(h, f, one);
+}
+
+static int fe_equal(const fe f, const fe g) {
+    fe t;
+    fe_sub(t, f, g);
+    return !fe_isnonzero(t);
+}
+
+/*
+r = sqrt(x) if x is a square, otherwise r = x^((q+3)/8) with r^2 = +-sqrt(-1) x
+*/
+static int fe_sqrt_vartime(fe r, const fe x) {
+    fe check;
+    fe_pow22523(r, x);
+    fe_mul(r, r, x);
+    fe_sq(check, r);
+
+    if (fe_equal(check, x)) {
+        return 1;
+    }
+
+    fe_neg(check, check);
+
+    if (fe_equal(check, x)) {
+        fe_mul(r, r, sqrtm1);
+        return 1;
+    }
+
+    return 0;
+}
+
+/*
+h = u^2 + A u w + w^2, which is v^2 / u for the point with u coordinate u / w
+*/
+static void montgomery_halving(fe h, const fe u, const fe w) {
+    fe t;
+    fe_sq(h, u);
+    fe_mul(t, u, w);
+    fe_mul(t, t, montgomery_a);
+    fe_add(h, h, t);
+    fe_carry(h, h);
+    fe_sq(t, w);
+    fe_add(h, h, t);
+    fe_carry(h, h);
+}
+
+/*
+h = A w + 2 (u + s) and t = u + s
+*/
+static void montgomery_slope(fe h, fe t, const fe u, const fe s, const fe w) {
+    fe aw;
+    fe_add(t, u, s);
+    fe_carry(t, t);
+    fe_add(h, t, t);
+    fe_carry(h, h);
+    fe_mul(aw, w, montgomery_a);
+    fe_add(h, h, aw);
+    fe_carry(h, h);
+}
+
+/*
+Returns 1 if p has no small order component, that is if p is in the subgroup
+of order l. The small order points form a cyclic group of order 8, so this
+holds exactly when p can be halved three times.
+
+For u = U / W let s^2 = U^2 + A U W + W^2 and m = (U + s) / W. The point can
+be halved if s exists, and its halves can be halved again if
+(A + 2 m) (m + 1) is not a square. So p is halved once and both conditions
+are checked for the half, whose u is m + sqrt(u (A + 2 m)), or the same with
+m = (U - s) / W if u (A + 2 m) is not a square.
+*/
+int ge_p3_is_torsion_free_vartime(const ge_p3 *p) {
+    fe u;
+    fe w;
+    fe s;
+    fe g;
+    fe x;
+    fe r;
+    fe hu;
+    fe hw;
+    fe t;
+
+    fe_add(u, p->Z, p->Y);
+    fe_sub(w, p->Z, p->Y);
+
+    /* the neutral element */
+    if (!fe_isnonzero(w)) {
+        return 1;
+    }
+
+    /* (0, -1), of order 2 */
+    if (!fe_isnonzero(u)) {
+        return 0;
+    }
+
+    fe_carry(u, u);
+    fe_carry(w, w);
+
+    montgomery_halving(x, u, w);
+
+    if (!fe_sqrt_vartime(s, x)) {
+        return 0;
+    }
+
+    /* the half is hu / hw */
+    montgomery_slope(g, t, u, s, w);
+    fe_mul(x, u, g);            /* x = W^2 u (A + 2 m) */
+
+    if (fe_sqrt_vartime(r, x)) {
+        fe_add(hu, t, r);
+        fe_carry(hu, hu);
+        fe_copy(hw, w);
+    } else {
+        /* with m = (U - s) / W, W^2 u (A + 2 m) = (A^2 - 4) W^2 x / g^2 */
+        fe_sq(t, r);
+        fe_mul(x, x, sqrtm1);
+        fe_mul(r, r, fe_equal(t, x) ? montgomery_k1 : montgomery_k2);
+        fe_sub(t, u, s);
+        fe_mul(hu, t, g);
+        fe_mul(t, w, r);
+        fe_add(hu, hu, t);
+        fe_carry(hu, hu);
+        fe_mul(hw, w, g);
+    }
+
+    montgomery_halving(x, hu, hw);
+
+    if (!fe_sqrt_vartime(s, x)) {
+        return 0;
+    }
+
+    montgomery_slope(g, t, hu, s, hw);
+    fe_add(t, t, hw);
+    fe_mul(x, g, t);            /* x = hw^2 (A + 2 m) (m + 1) */
+
+    /* x^((q-1)/2) = -1 */
+    fe_pow22523(r, x);
+    fe_sq(r, r);
+    fe_sq(r, r);
+    fe_sq(t, x);
+    fe_mul(r, r, t);
+    fe_1(t);
+    fe_add(r, r, t);
+    return !fe_isnonzero(r);
+}
+
+
 /*
 r = p + q
 */
@@ -3,6 +3,8 @@
 #include "ge.h"
 #include "sc.h"
 
+#include <string.h>
+
 static int consttime_equal(const unsigned char *x, const unsigned char *y) {
     unsigned char r = 0;
 
@@ -44,21 +46,22 @@ static int consttime_equal(const unsigned char *x, const unsigned char *y) {
     return !r;
 }
 
-int ed25519_verify(const unsigned char *signature, const unsigned char *message, size_t message_len, const unsigned char *public_key) {
+/* the table of odd multiples is copied in and out, so prepared keys need no
+   particular alignment */
+typedef char prepared_key_size_check[
+    (32 + 8 * sizeof(ge_cached) == ED25519_PREPARED_KEY_SIZE) ? 1 : -1
+];
+
+static int verify_with_table(const unsigned char *signature, const unsigned char *message, size_t message_len, const unsigned char *public_key, const ge_cached *Ai) {
     unsigned char h[64];
     unsigned char checker[32];
     sha512_context hash;
-    ge_p3 A;
     ge_p2 R;
 
     if (signature[63] & 224) {
         return 0;
     }
 
-    if (ge_frombytes_negate_vartime(&A, public_key) != 0) {
-        return 0;
-    }
-
     sha512_init(&hash);
     sha512_update(&hash, signature, 32);
     sha512_update(&hash, public_key, 32);
@@ -66,7 +69,7 @@ int ed25519_verify(const unsigned char *signature, const unsigned char *message,
     sha512_final(&hash, h);
     
     sc_reduce(h);
-    ge_double_scalarmult_vartime(&R, h, &A, signature + 32);
+    ge_double_scalarmult_vartime_cached(&R, h, Ai, signature + 32);
     ge_tobytes(checker, &R);
 
     if (!consttime_equal(checker, signature)) {
@@ -75,3 +78,36 @@ int ed25519_verify(const unsigned char *signature, const unsigned char *message,
 
     return 1;
 }
+
+int ed25519_verify(const unsigned char *signature, const unsigned char *message, size_t message_len, const unsigned char *public_key) {
+    ge_cached Ai[8];
+    ge_p3 A;
+
+    if (ge_frombytes_negate_vartime(&A, public_key) != 0) {
+        return 0;
+    }
+
+    ge_p3_to_cached_odd_multiples(Ai, &A);
+    return verify_with_table(signature, message, message_len, public_key, Ai);
+}
+
+int ed25519_prepare_public_key(unsigned char *prepared_key, const unsigned char *public_key) {
+    ge_cached Ai[8];
+    ge_p3 A;
+
+    if (ge_frombytes_negate_vartime(&A, public_key) != 0) {
+        return 0;
+    }
+
+    ge_p3_to_cached_odd_multiples(Ai, &A);
+    memcpy(prepared_key, public_key, 32);
+    memcpy(prepared_key + 32, Ai, sizeof(Ai));
+    return 1;
+}
+
+int ed25519_verify_prepared(const unsigned char *signature, const unsigned char *message, size_t message_len, const unsigned char *prepared_key) {
+    ge_cached Ai[8];
+
+    memcpy(Ai, prepared_key + 32, sizeof(Ai));
+    return verify_with_table(signature, message, message_len, prepared_key, Ai);
+}
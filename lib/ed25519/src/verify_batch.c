@@ -0,0 +1,182 @@
+#include "ed25519.h"
+#include "sha512.h"
+#include "ge.h"
+#include "sc.h"
+
+#include <string.h>
+
+/*
+Batch verification checks that
+
+    sum of z[i] * (S[i] * B - h[i] * A[i] - R[i]) = 0
+
+for random nonzero 128 bit z[i], which holds for valid signatures and, for
+invalid ones, only by chance. The sum is computed with a single multi-scalar
+multiplication (Straus' method) over a chunk of signatures, sharing the point
+doublings between them.
+
+Like ed25519_verify the check does not multiply by the cofactor. The z[i]
+multiples of small order components could cancel out in the sum though, so
+a signature only enters it once h[i] * A[i] + R[i] is known to have no small
+order component. Otherwise S[i] * B - h[i] * A[i] - R[i] has one, and the
+chunk is left to ed25519_verify, which rejects the signature. So the batch
+accepts exactly the signatures that ed25519_verify accepts. (With a small
+order component in A the sum can also fail for a valid signature, since the
+scalars are reduced mod l, which again leaves the chunk to ed25519_verify.)
+*/
+
+#define BATCH_CHUNK 8
+
+static int is_canonical(const unsigned char *s) {
+    int i;
+
+    /* y must be less than p = 2^255 - 19 */
+    if ((s[31] & 0x7f) == 0x7f && s[0] >= 0xed) {
+        for (i = 1; i < 31 && s[i] == 0xff; ++i);
+
+        if (i == 31) {
+            return 0;
+        }
+    }
+
+    /* x is 0 for y = 1 and y = -1, which must not have the sign bit set */
+    if (s[31] & 0x80) {
+        int one = s[0] == 0x01;
+        int minus_one = s[0] == 0xec && (s[31] & 0x7f) == 0x7f;
+
+        for (i = 1; i < 31; ++i) {
+            one = one && s[i] == 0x00;
+            minus_one = minus_one && s[i] == 0xff;
+        }
+
+        one = one && (s[31] & 0x7f) == 0x00;
+
+        if (one || minus_one) {
+            return 0;
+        }
+    }
+
+    return 1;
+}
+
+/*
+returns 1 if h * A + R has no small order component, given the odd multiples
+of -A and -R; only h mod 8 matters for that
+*/
+static int is_torsion_free(const ge_cached *Ai, const ge_cached *Ri, unsigned char h) {
+    ge_p1p1 t;
+    ge_p3 u;
+    int i;
+    ge_p3_0(&u);
+
+    for (i = 2; i >= 0; --i) {
+        ge_p3_dbl(&t, &u);
+        ge_p1p1_to_p3(&u, &t);
+
+        if ((h >> i) & 1) {
+            ge_add(&t, &u, Ai);
+            ge_p1p1_to_p3(&u, &t);
+        }
+    }
+
+    ge_add(&t, &u, Ri);
+    ge_p1p1_to_p3(&u, &t);
+    return ge_p3_is_torsion_free_vartime(&u);
+}
+
+static int verify_chunk(const unsigned char * const *signatures, const unsigned char * const *messages, const size_t *message_lens, const unsigned char *public_keys, size_t count, const unsigned char *random) {
+    /* two points, -A and -R, per signature */
+    ge_cached Ai[2 * BATCH_CHUNK * 8];
+    unsigned char scalars[2 * BATCH_CHUNK * 32];
+    signed char slides[2 * BATCH_CHUNK * 256];
+    unsigned char b[32] = {0};
+    unsigned char zero[32] = {0};
+    unsigned char z[32] = {0};
+    unsigned char h[64];
+    unsigned char checker[32];
+    sha512_context hash;
+    ge_p3 P;
+    ge_p2 r;
+    size_t i, j;
+
+    for (i = 0; i < count; ++i) {
+        const unsigned char *signature = signatures[i];
+        const unsigned char *public_key = public_keys + 32 * i;
+
+        if (signature[63] & 224) {
+            return 0;
+        }
+
+        /* ed25519_verify compares encodings of R, so a different encoding of
+           the same point must not pass here */
+        if (!is_canonical(signature)) {
+            return 0;
+        }
+
+        if (ge_frombytes_negate_vartime(&P, public_key) != 0) {
+            return 0;
+        }
+
+        ge_p3_to_cached_odd_multiples(&Ai[8 * (2 * i)], &P);
+
+        if (ge_frombytes_negate_vartime(&P, signature) != 0) {
+            return 0;
+        }
+
+        ge_p3_to_cached_odd_multiples(&Ai[8 * (2 * i + 1)], &P);
+
+        sha512_init(&hash);
+        sha512_update(&hash, signature, 32);
+        sha512_update(&hash, public_key, 32);
+        sha512_update(&hash, messages[i], message_lens[i]);
+        sha512_final(&hash, h);
+        sc_reduce(h);
+
+        if (!is_torsion_free(&Ai[8 * (2 * i)], &Ai[8 * (2 * i + 1)], h[0] & 7)) {
+            return 0;
+        }
+
+        /* a zero z would leave the signature out of the sum */
+        memcpy(z, random + ED25519_BATCH_RANDOM_SIZE * i, ED25519_BATCH_RANDOM_SIZE);
+
+        for (j = 0; j < ED25519_BATCH_RANDOM_SIZE && z[j] == 0; ++j);
+
+        if (j == ED25519_BATCH_RANDOM_SIZE) {
+            z[0] = 1;
+        }
+
+        sc_muladd(&scalars[32 * (2 * i)], z, h, zero);
+        memcpy(&scalars[32 * (2 * i + 1)], z, 32);
+        sc_muladd(b, z, signature + 32, b);
+    }
+
+    ge_multi_scalarmult_vartime(&r, b, scalars, Ai, 2 * count, slides);
+    ge_tobytes(checker, &r);
+
+    /* the neutral element, x = 0 and y = 1 */
+    zero[0] = 1;
+    return memcmp(checker, zero, 32) == 0;
+}
+
+int ed25519_verify_batch(const unsigned char * const *signatures, const unsigned char * const *messages, const size_t *message_lens, const unsigned char *public_keys, size_t count, const unsigned char *random, int *valid) {
+    int all_valid = 1;
+    size_t start, i;
+
+    for (start = 0; start < count; start += BATCH_CHUNK) {
+        size_t chunk = count - start < BATCH_CHUNK ? count - start : BATCH_CHUNK;
+
+        if (verify_chunk(signatures + start, messages + start, message_lens + start, public_keys + 32 * start, chunk, random + ED25519_BATCH_RANDOM_SIZE * start)) {
+            for (i = start; i < start + chunk; ++i) {
+                valid[i] = 1;
+            }
+        } else {
+            /* find out which ones failed */
+            for (i = start; i < start + chunk; ++i) {
+                valid[i] = ed25519_verify(signatures[i], messages[i], message_lens[i], public_keys + 32 * i);
+                all_valid = all_valid && valid[i];
+            }
+        }
+    }
+
+    return all_valid;
+}
@@ -0,0 +1,109 @@
+#include "ed25519.h"
+#include "fe.h"
+#include "ge.h"
+
+#include <string.h>
+
+/*
+X25519 public key for a private key, computing secret * B on the Edwards curve
+with the fixed-base tables and mapping the result to the Montgomery curve:
+u = (1 + y) / (1 - y) = (Z + Y) / (Z - Y).
+*/
+
+#define X25519_BATCH_CHUNK 32
+
+static void x25519_base_fraction(fe numerator, fe denominator, const unsigned char *private_key) {
+    unsigned char e[32];
+    ge_p3 A;
+
+    memcpy(e, private_key, 32);
+    e[0] &= 248;
+    e[31] &= 127;
+    e[31] |= 64;
+
+    ge_scalarmult_base(&A, e);
+
+    fe_add(numerator, A.Z, A.Y);
+    fe_sub(denominator, A.Z, A.Y);
+
+    memset(e, 0, sizeof(e));
+    memset(&A, 0, sizeof(A));
+}
+
+void ed25519_x25519_base(unsigned char *public_key, const unsigned char *private_key) {
+    fe numerator;
+    fe denominator;
+    fe u;
+
+    x25519_base_fraction(numerator, denominator, private_key);
+    fe_invert(denominator, denominator);
+    fe_mul(u, numerator, denominator);
+    fe_tobytes(public_key, u);
+}
+
+/*
+Shares one inversion across each chunk of keys (Montgomery's trick): with
+p[i] = d[0] * ... * d[i], 1/d[i] = p[i - 1] / p[i]. A zero denominator, the
+identity point, is swapped for 1 with a zero numerator so that it still maps
+to u = 0 without spoiling the rest of the chunk. Consecutive private and
+public keys are stride bytes apart, so that they can be read from and written
+into an array of key pairs.
+*/
+
+void ed25519_x25519_base_batch(unsigned char *public_keys, const unsigned char *private_keys, size_t stride, size_t count) {
+    fe numerators[X25519_BATCH_CHUNK];
+    fe denominators[X25519_BATCH_CHUNK];
+    fe products[X25519_BATCH_CHUNK];
+    fe zero;
+    fe one;
+    fe inverse;
+    fe u;
+    size_t chunk;
+    size_t i;
+
+    fe_0(zero);
+    fe_1(one);
+
+    while (count) {
+        chunk = count < X25519_BATCH_CHUNK ? count : X25519_BATCH_CHUNK;
+
+        for (i = 0; i < chunk; ++i) {
+            unsigned int identity;
+
+            x25519_base_fraction(numerators[i], denominators[i], private_keys + stride * i);
+            identity = fe_isnonzero(denominators[i]) ^ 1;
+            fe_cmov(denominators[i], one, identity);
+            fe_cmov(numerators[i], zero, identity);
+
+            if (i == 0) {
+                fe_copy(products[0], denominators[0]);
+            } else {
+                fe_mul(products[i], products[i - 1], denominators[i]);
+            }
+        }
+
+        fe_invert(inverse, products[chunk - 1]);
+
+        for (i = chunk; i-- > 0;) {
+            if (i == 0) {
+                fe_copy(u, inverse);
+            } else {
+                /* 1 / d[i], then 1 / p[i - 1] for the next step */
+                fe_mul(u, inverse, products[i - 1]);
+                fe_mul(inverse, inverse, denominators[i]);
+            }
+            fe_mul(u, u, numerators[i]);
+            fe_tobytes(public_keys + stride * i, u);
+        }
+
+        public_keys += stride * chunk;
+        private_keys += stride * chunk;
+        count -= chunk;
+    }
+
+    memset(numerators, 0, sizeof(numerators));
+    memset(denominators, 0, sizeof(denominators));
+    memset(products, 0, sizeof(products));
+    memset(inverse, 0, sizeof(inverse));
+    memset(u, 0, sizeof(u));
+}
@@ -12,6 +12,7 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include <algorithm>
 #include <ctime>
 #include "olm/account.hh"
 #include "olm/base64.hh"
@@ -20,7 +21,8 @@
 #include "olm/memory.hh"
 
 olm::Account::Account(
-) : next_prekey_id(0),
+) : one_time_keys(MAX_ONE_TIME_KEYS),
+    next_prekey_id(0),
     last_prekey_publish_time(0),
     num_prekeys(0),
     num_fallback_keys(0),
@@ -29,13 +31,78 @@ olm::Account::Account(
 }
 
 
-olm::OneTimeKey const * olm::Account::lookup_key(
+std::size_t olm::Account::set_max_number_of_one_time_keys(
+    std::size_t max_number_of_keys
+) {
+    max_number_of_keys = std::max<std::size_t>(max_number_of_keys, 1);
+    max_number_of_keys = std::min(max_number_of_keys, MAX_ONE_TIME_KEYS_LIMIT);
+    if (max_number_of_keys < one_time_keys.size()) {
+        for (std::size_t i = max_number_of_keys; i < one_time_keys.size(); ++i) {
+            one_time_key_index.erase(
+                one_time_keys[i].key.public_key, one_time_keys[i].id
+            );
+        }
+    }
+    one_time_keys.set_max_size(max_number_of_keys);
+    return max_number_of_keys;
+}
+
+
+olm::OneTimeKey * olm::Account::find_one_time_key(
     _olm_curve25519_public_key const & public_key
 ) {
-    for (olm::OneTimeKey const & key : one_time_keys) {
-        if (olm::array_equal(key.key.public_key.public_key, public_key.public_key)) {
-            return &key;
+    if (!one_time_key_index.enabled()) {
+        for (olm::OneTimeKey & key : one_time_keys) {
+            if (olm::array_equal(key.key.public_key.public_key, public_key.public_key)) {
+                return &key;
+            }
         }
+        return nullptr;
+    }
+
+    olm::OneTimeKey * found = nullptr;
+    one_time_key_index.find(public_key, [&](std::uint32_t id) {
+        /* The keys are newest first, so their ids are decreasing unless the
+         * ids have wrapped around. */
+        olm::OneTimeKey * begin = one_time_keys.begin();
+        olm::OneTimeKey * end = one_time_keys.end();
+        olm::OneTimeKey * key = std::lower_bound(
+            begin, end, id,
+            [](olm::OneTimeKey const & key, std::uint32_t id) {
+                return key.id > id;
+            }
+        );
+        if (key == end || key->id != id) {
+            key = std::find_if(begin, end, [=](olm::OneTimeKey const & key) {
+                return key.id == id;
+            });
+        }
+        if (key != end && olm::array_equal(
+                key->key.public_key.public_key, public_key.public_key
+        )) {
+            found = key;
+            return true;
+        }
+        return false;
+    });
+    return found;
+}
+
+
+void olm::Account::index_one_time_keys() {
+    one_time_key_index.clear();
+    for (olm::OneTimeKey const & key : one_time_keys) {
+        one_time_key_index.insert(key.key.public_key, key.id);
+    }
+}
+
+
+olm::OneTimeKey const * olm::Account::lookup_key(
+    _olm_curve25519_public_key const & public_key
+) {
+    olm::OneTimeKey const * key = find_one_time_key(public_key);
+    if (key) {
+        return key;
     }
     if (num_fallback_keys >= 1
             && olm::array_equal(
@@ -57,13 +124,12 @@ olm::OneTimeKey const * olm::Account::lookup_key(
 std::size_t olm::Account::remove_key(
     _olm_curve25519_public_key const & public_key
 ) {
-    OneTimeKey * i;
-    for (i = one_time_keys.begin(); i != one_time_keys.end(); ++i) {
-        if (olm::array_equal(i->key.public_key.public_key, public_key.public_key)) {
-            std::uint32_t id = i->id;
-            one_time_keys.erase(i);
-            return id;
-        }
+    OneTimeKey * key = find_one_time_key(public_key);
+    if (key) {
+        std::uint32_t id = key->id;
+        one_time_key_index.erase(key->key.public_key, id);
+        one_time_keys.erase(key);
+        return id;
     }
     // check if the key is a fallback key, to avoid returning an error, but
     // don't actually remove it
@@ -271,7 +337,7 @@ std::size_t olm::Account::mark_keys_as_published(
 
 std::size_t olm::Account::max_number_of_one_time_keys(
 ) const {
-    return olm::MAX_ONE_TIME_KEYS;
+    return one_time_keys.max_size();
 }
 
 std::size_t olm::Account::generate_one_time_keys_random_length(
@@ -280,21 +346,106 @@ std::size_t olm::Account::generate_one_time_keys_random_length(
     return CURVE25519_RANDOM_LENGTH * number_of_keys;
 }
 
+namespace {
+
+/* Number of one time keys generated by each task handed to an
+ * OlmParallelFor. */
+static const std::size_t ONE_TIME_KEY_GROUP_SIZE = 16;
+
+struct OneTimeKeyGroups {
+    std::uint8_t const * random;
+    /* the new keys, newest first */
+    olm::OneTimeKey * keys;
+    std::size_t number_of_keys;
+    std::uint32_t first_id;
+};
+
+static void generate_one_time_key_group(void * context, std::size_t index) {
+    OneTimeKeyGroups const & groups = *static_cast<OneTimeKeyGroups *>(context);
+    std::size_t begin = index * ONE_TIME_KEY_GROUP_SIZE;
+    std::size_t count = std::min(
+        groups.number_of_keys - begin, ONE_TIME_KEY_GROUP_SIZE
+    );
+    _olm_curve25519_key_pair key_pairs[ONE_TIME_KEY_GROUP_SIZE];
+    _olm_crypto_curve25519_generate_keys(
+        groups.random + begin * CURVE25519_RANDOM_LENGTH, count, key_pairs
+    );
+    for (std::size_t i = 0; i < count; ++i) {
+        olm::OneTimeKey & key
+            = groups.keys[groups.number_of_keys - 1 - (begin + i)];
+        key.id = groups.first_id + begin + i;
+        key.published = false;
+        key.key = key_pairs[i];
+    }
+    olm::unset(key_pairs);
+}
+
+} // namespace
+
 std::size_t olm::Account::generate_one_time_keys(
     std::size_t number_of_keys,
-    std::uint8_t const * random, std::size_t random_length
+    std::uint8_t const * random, std::size_t random_length,
+    OlmParallelFor parallel_for, void * parallel_for_context
 ) {
     if (random_length < generate_one_time_keys_random_length(number_of_keys)) {
         last_error = OlmErrorCode::OLM_NOT_ENOUGH_RANDOM;
         return std::size_t(-1);
     }
-    for (unsigned i = 0; i < number_of_keys; ++i) {
-        OneTimeKey & key = *one_time_keys.insert(one_time_keys.begin());
-        key.id = ++next_one_time_key_id;
-        key.published = false;
-        _olm_crypto_curve25519_generate_key(random, &key.key);
-        random += CURVE25519_RANDOM_LENGTH;
+
+    /* Keys that would be pushed out of the list by later keys in this batch
+     * are never generated, but still use up their id and random bytes. */
+    std::size_t number_to_keep = std::min(
+        number_of_keys, one_time_keys.max_size()
+    );
+    std::size_t number_to_skip = number_of_keys - number_to_keep;
+
+    /* reserve first, so that nothing changes if that fails */
+    if (!one_time_keys.reserve(one_time_keys.size() + number_to_keep)) {
+        last_error = OlmErrorCode::OLM_OUT_OF_MEMORY;
+        return std::size_t(-1);
+    }
+    /* unindex the old keys that the new ones will push out */
+    std::size_t new_size = std::min(
+        one_time_keys.size() + number_to_keep, one_time_keys.max_size()
+    );
+    std::size_t number_to_drop = one_time_keys.size() + number_to_keep - new_size;
+    for (std::size_t i = one_time_keys.size() - number_to_drop;
+            i < one_time_keys.size(); ++i) {
+        one_time_key_index.erase(
+            one_time_keys[i].key.public_key, one_time_keys[i].id
+        );
+    }
+
+    OneTimeKey * keys = one_time_keys.insert(
+        one_time_keys.begin(), number_to_keep
+    );
+    if (number_to_keep && !keys) {
+        last_error = OlmErrorCode::OLM_OUT_OF_MEMORY;
+        return std::size_t(-1);
+    }
+
+    OneTimeKeyGroups groups = {
+        random + number_to_skip * CURVE25519_RANDOM_LENGTH,
+        keys, number_to_keep,
+        std::uint32_t(next_one_time_key_id + number_to_skip + 1)
+    };
+    std::size_t group_count = (
+        number_to_keep + ONE_TIME_KEY_GROUP_SIZE - 1
+    ) / ONE_TIME_KEY_GROUP_SIZE;
+    if (parallel_for && group_count > 1) {
+        parallel_for(
+            parallel_for_context, group_count,
+            generate_one_time_key_group, &groups
+        );
+    } else {
+        for (std::size_t i = 0; i < group_count; ++i) {
+            generate_one_time_key_group(&groups, i);
+        }
+    }
+    for (std::size_t i = 0; i < number_to_keep; ++i) {
+        one_time_key_index.insert(keys[i].key.public_key, keys[i].id);
     }
+    next_one_time_key_id += number_of_keys;
     return number_of_keys;
 }
 
@@ -648,7 +799,8 @@ namespace {
 // pickle version 2 does not have fallback keys.
 // pickle version 3 does not store whether the current fallback key is published.
 // pickle version 4 does not use X3DH.
-static const std::uint32_t ACCOUNT_PICKLE_VERSION = 10005;
+// pickle version 10005 does not store the maximum number of one time keys.
+static const std::uint32_t ACCOUNT_PICKLE_VERSION = 10006;
 }
 
 
@@ -667,6 +819,7 @@ std::size_t olm::pickle_length(
     }
     length += olm::pickle_length(value.next_prekey_id);
     length += olm::pickle_length(value.last_prekey_publish_time);
+    length += olm::pickle_length(std::uint32_t(value.one_time_keys.max_size()));
     length += olm::pickle_length(value.one_time_keys);
     length += olm::pickle_length(value.num_fallback_keys);
     if (value.num_fallback_keys >= 1) {
@@ -695,6 +848,7 @@ std::uint8_t * olm::pickle(
     }
     pos = olm::pickle(pos, value.next_prekey_id);
     pos = olm::pickle(pos, value.last_prekey_publish_time);
+    pos = olm::pickle(pos, std::uint32_t(value.one_time_keys.max_size()));
     pos = olm::pickle(pos, value.one_time_keys);
     pos = olm::pickle(pos, value.num_fallback_keys);
     if (value.num_fallback_keys >= 1) {
@@ -718,6 +872,7 @@ std::uint8_t const * olm::unpickle(
 
     switch (pickle_version) {
         case ACCOUNT_PICKLE_VERSION:
+        case 10005:
         case 4:
         case 3:
         case 2:
@@ -747,7 +902,17 @@ std::uint8_t const * olm::unpickle(
         pos = olm::unpickle(pos, end, value.next_prekey_id); UNPICKLE_OK(pos);
         pos = olm::unpickle(pos, end, value.last_prekey_publish_time); UNPICKLE_OK(pos);
     }
+    if (pickle_version >= 10006) {
+        std::uint32_t max_one_time_keys;
+        pos = olm::unpickle(pos, end, max_one_time_keys); UNPICKLE_OK(pos);
+        if (max_one_time_keys < 1 || max_one_time_keys > MAX_ONE_TIME_KEYS_LIMIT) {
+            value.last_error = OlmErrorCode::OLM_CORRUPTED_PICKLE;
+            return nullptr;
+        }
+        value.one_time_keys.set_max_size(max_one_time_keys);
+    }
     pos = olm::unpickle(pos, end, value.one_time_keys); UNPICKLE_OK(pos);
+    value.index_one_time_keys();
 
     if (pickle_version <= 2) {
         // version 2 did not have fallback keys
@@ -0,0 +1,128 @@
+/* Copyright 2026 Comm Technologies, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "olm/aes_backend.h"
+#include "olm/cpu_features.h"
+#include "olm/crypto.h"
+
+#include "crypto-algorithms/aes.h"
+
+#include <string.h>
+
+#define AES_KEY_BITS (8 * AES256_KEY_LENGTH)
+
+enum {
+    AES_BACKEND_PORTABLE = 0,
+    AES_BACKEND_X86 = 1,
+    AES_BACKEND_ARM = 2,
+};
+
+static void xor_block(uint8_t * block, const uint8_t * input) {
+    size_t i;
+    for (i = 0; i < AES_BLOCK_LENGTH; ++i) {
+        block[i] ^= input[i];
+    }
+}
+
+void _olm_aes256_key_setup(
+    const uint8_t * key,
+    struct _olm_aes256_key_schedule * schedule
+) {
+    unsigned int features = _olm_cpu_features();
+    (void)features;
+#if defined(OLM_CPU_X86)
+    if (features & OLM_CPU_X86_AES) {
+        _olm_aes256_x86_key_setup(key, schedule);
+        schedule->backend = AES_BACKEND_X86;
+        return;
+    }
+#elif defined(OLM_CPU_ARM_CRYPTO_AES)
+    if (features & OLM_CPU_ARM_AES) {
+        _olm_aes256_arm_key_setup(key, schedule);
+        schedule->backend = AES_BACKEND_ARM;
+        return;
+    }
+#endif
+    aes_key_setup(key, schedule->words, AES_KEY_BITS);
+    schedule->backend = AES_BACKEND_PORTABLE;
+}
+
+void _olm_aes256_encrypt_cbc_blocks(
+    const struct _olm_aes256_key_schedule * schedule,
+    uint8_t * iv,
+    const uint8_t * input, size_t block_count,
+    uint8_t * output
+) {
+    uint8_t block[AES_BLOCK_LENGTH];
+
+#if defined(OLM_CPU_X86)
+    if (schedule->backend == AES_BACKEND_X86) {
+        _olm_aes256_x86_encrypt_cbc_blocks(
+            schedule, iv, input, block_count, output
+        );
+        return;
+    }
+#elif defined(OLM_CPU_ARM_CRYPTO_AES)
+    if (schedule->backend == AES_BACKEND_ARM) {
+        _olm_aes256_arm_encrypt_cbc_blocks(
+            schedule, iv, input, block_count, output
+        );
+        return;
+    }
+#endif
+    while (block_count--) {
+        memcpy(block, iv, AES_BLOCK_LENGTH);
+        xor_block(block, input);
+        aes_encrypt(block, output, schedule->words, AES_KEY_BITS);
+        memcpy(iv, output, AES_BLOCK_LENGTH);
+        input += AES_BLOCK_LENGTH;
+        output += AES_BLOCK_LENGTH;
+    }
+    memset(block, 0, sizeof(block));
+}
+
+void _olm_aes256_decrypt_cbc_blocks(
+    const struct _olm_aes256_key_schedule * schedule,
+    uint8_t * iv,
+    const uint8_t * input, size_t block_count,
+    uint8_t * output
+) {
+    uint8_t ciphertext[AES_BLOCK_LENGTH];
+
+#if defined(OLM_CPU_X86)
+    if (schedule->backend == AES_BACKEND_X86) {
+        _olm_aes256_x86_decrypt_cbc_blocks(
+            schedule, iv, input, block_count, output
+        );
+        return;
+    }
+#elif defined(OLM_CPU_ARM_CRYPTO_AES)
+    if (schedule->backend == AES_BACKEND_ARM) {
+        _olm_aes256_arm_decrypt_cbc_blocks(
+            schedule, iv, input, block_count, output
+        );
+        return;
+    }
+#endif
+    while (block_count--) {
+        /* keep a copy of the ciphertext in case we are decrypting in place */
+        memcpy(ciphertext, input, AES_BLOCK_LENGTH);
+        aes_decrypt(input, output, schedule->words, AES_KEY_BITS);
+        xor_block(output, iv);
+        memcpy(iv, ciphertext, AES_BLOCK_LENGTH);
+        input += AES_BLOCK_LENGTH;
+        output += AES_BLOCK_LENGTH;
+    }
+}
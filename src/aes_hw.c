@@ -0,0 +1,407 @@
+/* Copyright 2026 Comm Technologies, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* AES-256 using the AES-NI instructions on x86 and the cryptography
+ * extensions on ARMv8. Only called after the CPU has been checked for
+ * support, see aes_backend.c.
+ */
+
+#include "olm/aes_backend.h"
+#include "olm/cpu_features.h"
+
+#if defined(OLM_CPU_X86)
+
+#include <wmmintrin.h>
+#include <emmintrin.h>
+
+#define OLM_TARGET_AES __attribute__((target("aes,sse2")))
+
+#define ROUND_KEYS(schedule) ((__m128i *)(schedule)->words)
+#define DECRYPT_ROUND_KEYS(schedule) \
+    ((__m128i *)(schedule)->words + AES256_ROUND_KEYS)
+
+OLM_TARGET_AES
+static __m128i expand_even(__m128i key, __m128i assist) {
+    assist = _mm_shuffle_epi32(assist, 0xff);
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    return _mm_xor_si128(key, assist);
+}
+
+OLM_TARGET_AES
+static __m128i expand_odd(__m128i even_key, __m128i key) {
+    __m128i assist = _mm_shuffle_epi32(
+        _mm_aeskeygenassist_si128(even_key, 0), 0xaa
+    );
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    key = _mm_xor_si128(key, _mm_slli_si128(key, 4));
+    return _mm_xor_si128(key, assist);
+}
+
+/* the round constant has to be an immediate, hence the macro */
+#define EXPAND_ROUND(rk, i, rcon) do { \
+    rk[i] = expand_even(rk[i - 2], _mm_aeskeygenassist_si128(rk[i - 1], rcon)); \
+    if (i + 1 < AES256_ROUND_KEYS) { \
+        rk[i + 1] = expand_odd(rk[i], rk[i - 1]); \
+    } \
+} while (0)
+
+OLM_TARGET_AES
+void _olm_aes256_x86_key_setup(
+    const uint8_t * key, struct _olm_aes256_key_schedule * schedule
+) {
+    __m128i rk[AES256_ROUND_KEYS];
+    __m128i * encrypt_keys = ROUND_KEYS(schedule);
+    __m128i * decrypt_keys = DECRYPT_ROUND_KEYS(schedule);
+    int i;
+
+    rk[0] = _mm_loadu_si128((const __m128i *)key);
+    rk[1] = _mm_loadu_si128((const __m128i *)(key + 16));
+    EXPAND_ROUND(rk, 2, 0x01);
+    EXPAND_ROUND(rk, 4, 0x02);
+    EXPAND_ROUND(rk, 6, 0x04);
+    EXPAND_ROUND(rk, 8, 0x08);
+    EXPAND_ROUND(rk, 10, 0x10);
+    EXPAND_ROUND(rk, 12, 0x20);
+    EXPAND_ROUND(rk, 14, 0x40);
+
+    /* the equivalent inverse cipher uses the round keys in reverse order,
+     * with InvMixColumns applied to all but the first and last */
+    for (i = 0; i < AES256_ROUND_KEYS; ++i) {
+        _mm_storeu_si128(&encrypt_keys[i], rk[i]);
+    }
+    _mm_storeu_si128(&decrypt_keys[0], rk[AES256_ROUND_KEYS - 1]);
+    for (i = 1; i < AES256_ROUND_KEYS - 1; ++i) {
+        _mm_storeu_si128(
+            &decrypt_keys[i], _mm_aesimc_si128(rk[AES256_ROUND_KEYS - 1 - i])
+        );
+    }
+    _mm_storeu_si128(&decrypt_keys[AES256_ROUND_KEYS - 1], rk[0]);
+
+    for (i = 0; i < AES256_ROUND_KEYS; ++i) {
+        rk[i] = _mm_setzero_si128();
+    }
+}
+
+OLM_TARGET_AES
+void _olm_aes256_x86_encrypt_cbc_blocks(
+    const struct _olm_aes256_key_schedule * schedule, uint8_t * iv,
+    const uint8_t * input, size_t block_count, uint8_t * output
+) {
+    const __m128i * rk = ROUND_KEYS(schedule);
+    __m128i state = _mm_loadu_si128((const __m128i *)iv);
+    int round;
+
+    while (block_count--) {
+        state = _mm_xor_si128(
+            state, _mm_loadu_si128((const __m128i *)input)
+        );
+        state = _mm_xor_si128(state, _mm_loadu_si128(&rk[0]));
+        for (round = 1; round < AES256_ROUND_KEYS - 1; ++round) {
+            state = _mm_aesenc_si128(state, _mm_loadu_si128(&rk[round]));
+        }
+        state = _mm_aesenclast_si128(
+            state, _mm_loadu_si128(&rk[AES256_ROUND_KEYS - 1])
+        );
+        _mm_storeu_si128((__m128i *)output, state);
+        input += AES_BLOCK_LENGTH;
+        output += AES_BLOCK_LENGTH;
+    }
+    _mm_storeu_si128((__m128i *)iv, state);
+}
+
+/* CBC decryption has no dependency between blocks, so eight blocks are
+ * decrypted together to keep the AES unit busy while each AESDEC completes. */
+#define X86_PARALLEL_BLOCKS 8
+
+OLM_TARGET_AES
+void _olm_aes256_x86_decrypt_cbc_blocks(
+    const struct _olm_aes256_key_schedule * schedule, uint8_t * iv,
+    const uint8_t * input, size_t block_count, uint8_t * output
+) {
+    const __m128i * rk = DECRYPT_ROUND_KEYS(schedule);
+    __m128i previous = _mm_loadu_si128((const __m128i *)iv);
+    int round, i;
+
+    while (block_count >= X86_PARALLEL_BLOCKS) {
+        __m128i ciphertext[X86_PARALLEL_BLOCKS];
+        __m128i state[X86_PARALLEL_BLOCKS];
+        __m128i key = _mm_loadu_si128(&rk[0]);
+
+        /* read all the ciphertext before writing anything, as the output
+         * may overlap the input */
+        for (i = 0; i < X86_PARALLEL_BLOCKS; ++i) {
+            ciphertext[i] = _mm_loadu_si128((const __m128i *)input + i);
+            state[i] = _mm_xor_si128(ciphertext[i], key);
+        }
+        for (round = 1; round < AES256_ROUND_KEYS - 1; ++round) {
+            key = _mm_loadu_si128(&rk[round]);
+            for (i = 0; i < X86_PARALLEL_BLOCKS; ++i) {
+                state[i] = _mm_aesdec_si128(state[i], key);
+            }
+        }
+        key = _mm_loadu_si128(&rk[AES256_ROUND_KEYS - 1]);
+        for (i = 0; i < X86_PARALLEL_BLOCKS; ++i) {
+            state[i] = _mm_aesdeclast_si128(state[i], key);
+        }
+
+        _mm_storeu_si128(
+            (__m128i *)output, _mm_xor_si128(state[0], previous)
+        );
+        for (i = 1; i < X86_PARALLEL_BLOCKS; ++i) {
+            _mm_storeu_si128(
+                (__m128i *)output + i,
+                _mm_xor_si128(state[i], ciphertext[i - 1])
+            );
+        }
+        previous = ciphertext[X86_PARALLEL_BLOCKS - 1];
+        input += X86_PARALLEL_BLOCKS * AES_BLOCK_LENGTH;
+        output += X86_PARALLEL_BLOCKS * AES_BLOCK_LENGTH;
+        block_count -= X86_PARALLEL_BLOCKS;
+    }
+
+    while (block_count--) {
+        __m128i ciphertext = _mm_loadu_si128((const __m128i *)input);
+        __m128i state = _mm_xor_si128(ciphertext, _mm_loadu_si128(&rk[0]));
+        for (round = 1; round < AES256_ROUND_KEYS - 1; ++round) {
+            state = _mm_aesdec_si128(state, _mm_loadu_si128(&rk[round]));
+        }
+        state = _mm_aesdeclast_si128(
+            state, _mm_loadu_si128(&rk[AES256_ROUND_KEYS - 1])
+        );
+        _mm_storeu_si128(
+            (__m128i *)output, _mm_xor_si128(state, previous)
+        );
+        previous = ciphertext;
+        input += AES_BLOCK_LENGTH;
+        output += AES_BLOCK_LENGTH;
+    }
+    _mm_storeu_si128((__m128i *)iv, previous);
+}
+
+#elif defined(OLM_CPU_ARM_CRYPTO_AES)
+
+#include <arm_neon.h>
+#include <string.h>
+
+#define ROUND_KEYS(schedule) ((uint8_t *)(schedule)->words)
+#define DECRYPT_ROUND_KEYS(schedule) \
+    ((uint8_t *)(schedule)->words + AES256_ROUND_KEYS * AES_BLOCK_LENGTH)
+
+static const uint8_t SBOX[256] = {
+    0x63, 0x7c, 0x77, 0x7b, 0xf2, 0x6b, 0x6f, 0xc5,
+    0x30, 0x01, 0x67, 0x2b, 0xfe, 0xd7, 0xab, 0x76,
+    0xca, 0x82, 0xc9, 0x7d, 0xfa, 0x59, 0x47, 0xf0,
+    0xad, 0xd4, 0xa2, 0xaf, 0x9c, 0xa4, 0x72, 0xc0,
+    0xb7, 0xfd, 0x93, 0x26, 0x36, 0x3f, 0xf7, 0xcc,
+    0x34, 0xa5, 0xe5, 0xf1, 0x71, 0xd8, 0x31, 0x15,
+    0x04, 0xc7, 0x23, 0xc3, 0x18, 0x96, 0x05, 0x9a,
+    0x07, 0x12, 0x80, 0xe2, 0xeb, 0x27, 0xb2, 0x75,
+    0x09, 0x83, 0x2c, 0x1a, 0x1b, 0x6e, 0x5a, 0xa0,
+    0x52, 0x3b, 0xd6, 0xb3, 0x29, 0xe3, 0x2f, 0x84,
+    0x53, 0xd1, 0x00, 0xed, 0x20, 0xfc, 0xb1, 0x5b,
+    0x6a, 0xcb, 0xbe, 0x39, 0x4a, 0x4c, 0x58, 0xcf,
+    0xd0, 0xef, 0xaa, 0xfb, 0x43, 0x4d, 0x33, 0x85,
+    0x45, 0xf9, 0x02, 0x7f, 0x50, 0x3c, 0x9f, 0xa8,
+    0x51, 0xa3, 0x40, 0x8f, 0x92, 0x9d, 0x38, 0xf5,
+    0xbc, 0xb6, 0xda, 0x21, 0x10, 0xff, 0xf3, 0xd2,
+    0xcd, 0x0c, 0x13, 0xec, 0x5f, 0x97, 0x44, 0x17,
+    0xc4, 0xa7, 0x7e, 0x3d, 0x64, 0x5d, 0x19, 0x73,
+    0x60, 0x81, 0x4f, 0xdc, 0x22, 0x2a, 0x90, 0x88,
+    0x46, 0xee, 0xb8, 0x14, 0xde, 0x5e, 0x0b, 0xdb,
+    0xe0, 0x32, 0x3a, 0x0a, 0x49, 0x06, 0x24, 0x5c,
+    0xc2, 0xd3, 0xac, 0x62, 0x91, 0x95, 0xe4, 0x79,
+    0xe7, 0xc8, 0x37, 0x6d, 0x8d, 0xd5, 0x4e, 0xa9,
+    0x6c, 0x56, 0xf4, 0xea, 0x65, 0x7a, 0xae, 0x08,
+    0xba, 0x78, 0x25, 0x2e, 0x1c, 0xa6, 0xb4, 0xc6,
+    0xe8, 0xdd, 0x74, 0x1f, 0x4b, 0xbd, 0x8b, 0x8a,
+    0x70, 0x3e, 0xb5, 0x66, 0x48, 0x03, 0xf6, 0x0e,
+    0x61, 0x35, 0x57, 0xb9, 0x86, 0xc1, 0x1d, 0x9e,
+    0xe1, 0xf8, 0x98, 0x11, 0x69, 0xd9, 0x8e, 0x94,
+    0x9b, 0x1e, 0x87, 0xe9, 0xce, 0x55, 0x28, 0xdf,
+    0x8c, 0xa1, 0x89, 0x0d, 0xbf, 0xe6, 0x42, 0x68,
+    0x41, 0x99, 0x2d, 0x0f, 0xb0, 0x54, 0xbb, 0x16,
+};
+
+static const uint8_t RCON[7] = {0x01, 0x02, 0x04, 0x08, 0x10, 0x20, 0x40};
+
+static uint32_t load_be32(const uint8_t * bytes) {
+    return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16)
+        | ((uint32_t)bytes[2] << 8) | (uint32_t)bytes[3];
+}
+
+static void store_be32(uint8_t * bytes, uint32_t value) {
+    bytes[0] = value >> 24;
+    bytes[1] = value >> 16;
+    bytes[2] = value >> 8;
+    bytes[3] = value;
+}
+
+static uint32_t sub_word(uint32_t word) {
+    return ((uint32_t)SBOX[word >> 24] << 24)
+        | ((uint32_t)SBOX[(word >> 16) & 0xff] << 16)
+        | ((uint32_t)SBOX[(word >> 8) & 0xff] << 8)
+        | (uint32_t)SBOX[word & 0xff];
+}
+
+/* The key expansion is done in scalar code: it runs once per key and the
+ * ARMv8 instructions have no equivalent of AESKEYGENASSIST. */
+void _olm_aes256_arm_key_setup(
+    const uint8_t * key, struct _olm_aes256_key_schedule * schedule
+) {
+    uint32_t w[4 * AES256_ROUND_KEYS];
+    uint8_t * encrypt_keys = ROUND_KEYS(schedule);
+    uint8_t * decrypt_keys = DECRYPT_ROUND_KEYS(schedule);
+    int i;
+
+    for (i = 0; i < 8; ++i) {
+        w[i] = load_be32(key + 4 * i);
+    }
+    for (i = 8; i < 4 * AES256_ROUND_KEYS; ++i) {
+        uint32_t temp = w[i - 1];
+        if (i % 8 == 0) {
+            temp = sub_word((temp << 8) | (temp >> 24))
+                ^ ((uint32_t)RCON[i / 8 - 1] << 24);
+        } else if (i % 8 == 4) {
+            temp = sub_word(temp);
+        }
+        w[i] = w[i - 8] ^ temp;
+    }
+    for (i = 0; i < 4 * AES256_ROUND_KEYS; ++i) {
+        store_be32(encrypt_keys + 4 * i, w[i]);
+    }
+
+    memcpy(
+        decrypt_keys,
+        encrypt_keys + (AES256_ROUND_KEYS - 1) * AES_BLOCK_LENGTH,
+        AES_BLOCK_LENGTH
+    );
+    for (i = 1; i < AES256_ROUND_KEYS - 1; ++i) {
+        vst1q_u8(
+            decrypt_keys + i * AES_BLOCK_LENGTH,
+            vaesimcq_u8(vld1q_u8(
+                encrypt_keys + (AES256_ROUND_KEYS - 1 - i) * AES_BLOCK_LENGTH
+            ))
+        );
+    }
+    memcpy(
+        decrypt_keys + (AES256_ROUND_KEYS - 1) * AES_BLOCK_LENGTH,
+        encrypt_keys, AES_BLOCK_LENGTH
+    );
+    memset(w, 0, sizeof(w));
+}
+
+void _olm_aes256_arm_encrypt_cbc_blocks(
+    const struct _olm_aes256_key_schedule * schedule, uint8_t * iv,
+    const uint8_t * input, size_t block_count, uint8_t * output
+) {
+    const uint8_t * rk = ROUND_KEYS(schedule);
+    uint8x16_t state = vld1q_u8(iv);
+    int round;
+
+    while (block_count--) {
+        state = veorq_u8(state, vld1q_u8(input));
+        /* AESE does AddRoundKey first, so the last key is added by hand */
+        for (round = 0; round < AES256_ROUND_KEYS - 2; ++round) {
+            state = vaesmcq_u8(
+                vaeseq_u8(state, vld1q_u8(rk + round * AES_BLOCK_LENGTH))
+            );
+        }
+        state = vaeseq_u8(
+            state, vld1q_u8(rk + (AES256_ROUND_KEYS - 2) * AES_BLOCK_LENGTH)
+        );
+        state = veorq_u8(
+            state, vld1q_u8(rk + (AES256_ROUND_KEYS - 1) * AES_BLOCK_LENGTH)
+        );
+        vst1q_u8(output, state);
+        input += AES_BLOCK_LENGTH;
+        output += AES_BLOCK_LENGTH;
+    }
+    vst1q_u8(iv, state);
+}
+
+/* As on x86, independent blocks are interleaved. Four is enough to cover
+ * the AESD/AESIMC latency on current cores. */
+#define ARM_PARALLEL_BLOCKS 4
+
+void _olm_aes256_arm_decrypt_cbc_blocks(
+    const struct _olm_aes256_key_schedule * schedule, uint8_t * iv,
+    const uint8_t * input, size_t block_count, uint8_t * output
+) {
+    const uint8_t * rk = DECRYPT_ROUND_KEYS(schedule);
+    uint8x16_t previous = vld1q_u8(iv);
+    int round, i;
+
+    while (block_count >= ARM_PARALLEL_BLOCKS) {
+        uint8x16_t ciphertext[ARM_PARALLEL_BLOCKS];
+        uint8x16_t state[ARM_PARALLEL_BLOCKS];
+        uint8x16_t key;
+
+        /* read all the ciphertext before writing anything, as the output
+         * may overlap the input */
+        for (i = 0; i < ARM_PARALLEL_BLOCKS; ++i) {
+            ciphertext[i] = vld1q_u8(input + i * AES_BLOCK_LENGTH);
+            state[i] = ciphertext[i];
+        }
+        for (round = 0; round < AES256_ROUND_KEYS - 2; ++round) {
+            key = vld1q_u8(rk + round * AES_BLOCK_LENGTH);
+            for (i = 0; i < ARM_PARALLEL_BLOCKS; ++i) {
+                state[i] = vaesimcq_u8(vaesdq_u8(state[i], key));
+            }
+        }
+        key = vld1q_u8(rk + (AES256_ROUND_KEYS - 2) * AES_BLOCK_LENGTH);
+        for (i = 0; i < ARM_PARALLEL_BLOCKS; ++i) {
+            state[i] = vaesdq_u8(state[i], key);
+        }
+        key = vld1q_u8(rk + (AES256_ROUND_KEYS - 1) * AES_BLOCK_LENGTH);
+
+        vst1q_u8(output, veorq_u8(veorq_u8(state[0], key), previous));
+        for (i = 1; i < ARM_PARALLEL_BLOCKS; ++i) {
+            vst1q_u8(
+                output + i * AES_BLOCK_LENGTH,
+                veorq_u8(veorq_u8(state[i], key), ciphertext[i - 1])
+            );
+        }
+        previous = ciphertext[ARM_PARALLEL_BLOCKS - 1];
+        input += ARM_PARALLEL_BLOCKS * AES_BLOCK_LENGTH;
+        output += ARM_PARALLEL_BLOCKS * AES_BLOCK_LENGTH;
+        block_count -= ARM_PARALLEL_BLOCKS;
+    }
+
+    while (block_count--) {
+        uint8x16_t ciphertext = vld1q_u8(input);
+        uint8x16_t state = ciphertext;
+        for (round = 0; round < AES256_ROUND_KEYS - 2; ++round) {
+            state = vaesimcq_u8(
+                vaesdq_u8(state, vld1q_u8(rk + round * AES_BLOCK_LENGTH))
+            );
+        }
+        state = vaesdq_u8(
+            state, vld1q_u8(rk + (AES256_ROUND_KEYS - 2) * AES_BLOCK_LENGTH)
+        );
+        state = veorq_u8(
+            state, vld1q_u8(rk + (AES256_ROUND_KEYS - 1) * AES_BLOCK_LENGTH)
+        );
+        vst1q_u8(output, veorq_u8(state, previous));
+        previous = ciphertext;
+        input += AES_BLOCK_LENGTH;
+        output += AES_BLOCK_LENGTH;
+    }
+    vst1q_u8(iv, previous);
+}
+
+#endif
@@ -16,10 +16,15 @@
 
 #include "olm/base64.h"
 #include "olm/base64.hh"
+#include "olm/cpu_features.h"
 
 namespace {
 
-static const std::uint8_t ENCODE_BASE64[64] = {
+static const std::uint8_t E = -1;
+
+} // namespace
+
+const std::uint8_t _olm_base64_alphabet[64] = {
     0x41, 0x42, 0x43, 0x44, 0x45, 0x46, 0x47, 0x48,
     0x49, 0x4A, 0x4B, 0x4C, 0x4D, 0x4E, 0x4F, 0x50,
     0x51, 0x52, 0x53, 0x54, 0x55, 0x56, 0x57, 0x58,
@@ -30,9 +35,7 @@ static const std::uint8_t ENCODE_BASE64[64] = {
     0x34, 0x35, 0x36, 0x37, 0x38, 0x39, 0x2B, 0x2F,
 };
 
-static const std::uint8_t E = -1;
-
-static const std::uint8_t DECODE_BASE64[128] = {
+const std::uint8_t _olm_base64_values[128] = {
 /*  0x0 0x1 0x2 0x3 0x4 0x5 0x6 0x7 0x8 0x9 0xA 0xB 0xC 0xD 0xE 0xF */
      E,  E,  E,  E,  E,  E,  E,  E,  E,  E,  E,  E,  E,  E,  E,  E,
      E,  E,  E,  E,  E,  E,  E,  E,  E,  E,  E,  E,  E,  E,  E,  E,
@@ -44,6 +47,51 @@ static const std::uint8_t DECODE_BASE64[128] = {
     41, 42, 43, 44, 45, 46, 47, 48, 49, 50, 51,  E,  E,  E,  E,  E,
 };
 
+namespace {
+
+static const std::uint8_t * const ENCODE_BASE64 = _olm_base64_alphabet;
+static const std::uint8_t * const DECODE_BASE64 = _olm_base64_values;
+
+/* The vectorised codecs return the number of bytes they consumed, and leave
+ * the rest of the input to the loops below. */
+static std::size_t encode_blocks(
+    std::uint8_t const * input, std::size_t input_length,
+    std::uint8_t * output
+) {
+    unsigned int features = _olm_cpu_features();
+    (void)features;
+#if defined(OLM_CPU_X86)
+    if (features & OLM_CPU_X86_AVX2) {
+        return _olm_encode_base64_avx2(input, input_length, output);
+    }
+    if (features & OLM_CPU_X86_SSSE3) {
+        return _olm_encode_base64_ssse3(input, input_length, output);
+    }
+#elif defined(OLM_CPU_ARM_NEON)
+    return _olm_encode_base64_neon(input, input_length, output);
+#endif
+    return 0;
+}
+
+static std::size_t decode_blocks(
+    std::uint8_t const * input, std::size_t input_length,
+    std::uint8_t * output
+) {
+    unsigned int features = _olm_cpu_features();
+    (void)features;
+#if defined(OLM_CPU_X86)
+    if (features & OLM_CPU_X86_AVX2) {
+        return _olm_decode_base64_avx2(input, input_length, output);
+    }
+    if (features & OLM_CPU_X86_SSSE3) {
+        return _olm_decode_base64_ssse3(input, input_length, output);
+    }
+#elif defined(OLM_CPU_ARM_NEON)
+    return _olm_decode_base64_neon(input, input_length, output);
+#endif
+    return 0;
+}
+
 } // namespace
 
 
@@ -59,6 +107,9 @@ std::uint8_t * olm::encode_base64(
 ) {
     std::uint8_t const * end = input + (input_length / 3) * 3;
     std::uint8_t const * pos = input;
+    std::size_t encoded = encode_blocks(input, input_length, output);
+    pos += encoded;
+    output += encoded / 3 * 4;
     while (pos != end) {
         unsigned value = pos[0];
         value <<= 8; value |= pos[1];
@@ -115,6 +166,9 @@ std::size_t olm::decode_base64(
 
     std::uint8_t const * end = input + (input_length / 4) * 4;
     std::uint8_t const * pos = input;
+    std::size_t decoded = decode_blocks(input, end - input, output);
+    pos += decoded;
+    output += decoded / 4 * 3;
 
     while (pos != end) {
         unsigned value = DECODE_BASE64[pos[0] & 0x7F];
@@ -185,3 +239,14 @@ size_t _olm_decode_base64(
 ) {
     return olm::decode_base64(input, input_length, output);
 }
+
+size_t _olm_decode_base64_prefix(
+    uint8_t const * input, size_t input_length,
+    uint8_t * output, size_t max_output_length
+) {
+    size_t max_input_length = max_output_length / 3 * 4;
+    if (input_length > max_input_length) {
+        input_length = max_input_length;
+    }
+    return olm::decode_base64(input, input_length, output);
+}
@@ -0,0 +1,317 @@
+/* Copyright 2026 Comm Technologies, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* Base64 codecs for SSSE3, AVX2 and NEON, after the ones described by Muła
+ * and Lemire in "Faster Base64 Encoding and Decoding using AVX2
+ * Instructions". Only called after the CPU has been checked for support, see
+ * base64.cpp.
+ *
+ * When the input and output overlap, each block is loaded before anything is
+ * stored, and the stores never reach the input that is still to be loaded.
+ */
+
+#include "olm/base64.h"
+#include "olm/cpu_features.h"
+
+#include <string.h>
+
+#if defined(OLM_CPU_X86)
+
+#include <immintrin.h>
+
+#define OLM_TARGET_SSSE3 __attribute__((target("ssse3")))
+#define OLM_TARGET_AVX2 __attribute__((target("avx2")))
+
+/* Spreads each group of three bytes over four bytes holding six bits each */
+OLM_TARGET_SSSE3
+static __m128i encode_split_ssse3(__m128i in) {
+    __m128i t0, t1, t2, t3;
+    in = _mm_shuffle_epi8(in, _mm_set_epi8(
+        10, 11, 9, 10, 7, 8, 6, 7, 4, 5, 3, 4, 1, 2, 0, 1
+    ));
+    t0 = _mm_and_si128(in, _mm_set1_epi32(0x0FC0FC00));
+    t1 = _mm_mulhi_epu16(t0, _mm_set1_epi32(0x04000040));
+    t2 = _mm_and_si128(in, _mm_set1_epi32(0x003F03F0));
+    t3 = _mm_mullo_epi16(t2, _mm_set1_epi32(0x01000010));
+    return _mm_or_si128(t1, t3);
+}
+
+/* Maps each six bit value to its character by adding the offset of the range
+ * that it falls in: 'A', 'a', '0' to '9', '+' or '/'. Values from 52 up get
+ * their own row of the table, the letters share the first two. */
+OLM_TARGET_SSSE3
+static __m128i encode_translate_ssse3(__m128i indices) {
+    const __m128i offsets = _mm_setr_epi8(
+        65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0
+    );
+    __m128i range = _mm_subs_epu8(indices, _mm_set1_epi8(51));
+    __m128i lower = _mm_cmpgt_epi8(indices, _mm_set1_epi8(25));
+    range = _mm_sub_epi8(range, lower);
+    return _mm_add_epi8(_mm_shuffle_epi8(offsets, range), indices);
+}
+
+OLM_TARGET_SSSE3
+size_t _olm_encode_base64_ssse3(
+    uint8_t const * input, size_t input_length, uint8_t * output
+) {
+    uint8_t const * pos = input;
+
+    /* each block loads 16 bytes and uses 12 of them */
+    while (input + input_length - pos >= 16) {
+        __m128i in = _mm_loadu_si128((const __m128i *)pos);
+        __m128i out = encode_translate_ssse3(encode_split_ssse3(in));
+        _mm_storeu_si128((__m128i *)output, out);
+        pos += 12;
+        output += 16;
+    }
+    return pos - input;
+}
+
+OLM_TARGET_AVX2
+size_t _olm_encode_base64_avx2(
+    uint8_t const * input, size_t input_length, uint8_t * output
+) {
+    const __m256i offsets = _mm256_setr_epi8(
+        65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0,
+        65, 71, -4, -4, -4, -4, -4, -4, -4, -4, -4, -4, -19, -16, 0, 0
+    );
+    const __m256i split = _mm256_setr_epi8(
+        1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10,
+        1, 0, 2, 1, 4, 3, 5, 4, 7, 6, 8, 7, 10, 9, 11, 10
+    );
+    uint8_t const * pos = input;
+
+    /* each lane loads 16 bytes and uses 12 of them */
+    while (input + input_length - pos >= 28) {
+        __m256i in, t0, t1, t2, t3, indices, range, lower;
+        in = _mm256_inserti128_si256(
+            _mm256_castsi128_si256(_mm_loadu_si128((const __m128i *)pos)),
+            _mm_loadu_si128((const __m128i *)(pos + 12)), 1
+        );
+        in = _mm256_shuffle_epi8(in, split);
+        t0 = _mm256_and_si256(in, _mm256_set1_epi32(0x0FC0FC00));
+        t1 = _mm256_mulhi_epu16(t0, _mm256_set1_epi32(0x04000040));
+        t2 = _mm256_and_si256(in, _mm256_set1_epi32(0x003F03F0));
+        t3 = _mm256_mullo_epi16(t2, _mm256_set1_epi32(0x01000010));
+        indices = _mm256_or_si256(t1, t3);
+
+        range = _mm256_subs_epu8(indices, _mm256_set1_epi8(51));
+        lower = _mm256_cmpgt_epi8(indices, _mm256_set1_epi8(25));
+        range = _mm256_sub_epi8(range, lower);
+        _mm256_storeu_si256(
+            (__m256i *)output,
+            _mm256_add_epi8(_mm256_shuffle_epi8(offsets, range), indices)
+        );
+        pos += 24;
+        output += 32;
+    }
+    return (pos - input) + _olm_encode_base64_ssse3(
+        pos, input + input_length - pos, output
+    );
+}
+
+/* Classifies each character by its two nibbles. A character is outside the
+ * alphabet if the bits looked up for its nibbles have any in common. */
+#define DECODE_CHECK_LO \
+    0x15, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, 0x11, \
+    0x11, 0x11, 0x13, 0x1A, 0x1B, 0x1B, 0x1B, 0x1A
+#define DECODE_CHECK_HI \
+    0x10, 0x10, 0x01, 0x02, 0x04, 0x08, 0x04, 0x08, \
+    0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10, 0x10
+/* The offset from each character to its value, by high nibble. '/' shares a
+ * high nibble with '+' and is moved down a row. */
+#define DECODE_OFFSETS \
+    0, 16, 19, 4, -65, -65, -71, -71, 0, 0, 0, 0, 0, 0, 0, 0
+#define DECODE_PACK \
+    2, 1, 0, 6, 5, 4, 10, 9, 8, 14, 13, 12, -1, -1, -1, -1
+
+OLM_TARGET_SSSE3
+size_t _olm_decode_base64_ssse3(
+    uint8_t const * input, size_t input_length, uint8_t * output
+) {
+    const __m128i check_lo = _mm_setr_epi8(DECODE_CHECK_LO);
+    const __m128i check_hi = _mm_setr_epi8(DECODE_CHECK_HI);
+    const __m128i offsets = _mm_setr_epi8(DECODE_OFFSETS);
+    const __m128i pack = _mm_setr_epi8(DECODE_PACK);
+    const __m128i mask_2f = _mm_set1_epi8(0x2F);
+    uint8_t const * pos = input;
+
+    while (input + input_length - pos >= 16) {
+        __m128i in, hi_nibbles, lo_nibbles, invalid, values;
+        uint32_t last;
+        in = _mm_loadu_si128((const __m128i *)pos);
+        hi_nibbles = _mm_and_si128(_mm_srli_epi32(in, 4), mask_2f);
+        lo_nibbles = _mm_and_si128(in, mask_2f);
+        invalid = _mm_and_si128(
+            _mm_shuffle_epi8(check_lo, lo_nibbles),
+            _mm_shuffle_epi8(check_hi, hi_nibbles)
+        );
+        if (_mm_movemask_epi8(
+            _mm_cmpgt_epi8(invalid, _mm_setzero_si128())
+        )) {
+            break;
+        }
+        values = _mm_add_epi8(in, _mm_shuffle_epi8(
+            offsets, _mm_add_epi8(_mm_cmpeq_epi8(in, mask_2f), hi_nibbles)
+        ));
+
+        /* join the pairs of six bits, then the pairs of twelve bits, and
+         * reverse the bytes of each group */
+        values = _mm_maddubs_epi16(values, _mm_set1_epi32(0x01400140));
+        values = _mm_madd_epi16(values, _mm_set1_epi32(0x00011000));
+        values = _mm_shuffle_epi8(values, pack);
+        _mm_storel_epi64((__m128i *)output, values);
+        last = _mm_cvtsi128_si32(_mm_srli_si128(values, 8));
+        memcpy(output + 8, &last, 4);
+        pos += 16;
+        output += 12;
+    }
+    return pos - input;
+}
+
+OLM_TARGET_AVX2
+size_t _olm_decode_base64_avx2(
+    uint8_t const * input, size_t input_length, uint8_t * output
+) {
+    const __m256i check_lo = _mm256_setr_epi8(DECODE_CHECK_LO, DECODE_CHECK_LO);
+    const __m256i check_hi = _mm256_setr_epi8(DECODE_CHECK_HI, DECODE_CHECK_HI);
+    const __m256i offsets = _mm256_setr_epi8(DECODE_OFFSETS, DECODE_OFFSETS);
+    const __m256i pack = _mm256_setr_epi8(DECODE_PACK, DECODE_PACK);
+    const __m256i mask_2f = _mm256_set1_epi8(0x2F);
+    uint8_t const * pos = input;
+
+    while (input + input_length - pos >= 32) {
+        __m256i in, hi_nibbles, lo_nibbles, invalid, values;
+        in = _mm256_loadu_si256((const __m256i *)pos);
+        hi_nibbles = _mm256_and_si256(_mm256_srli_epi32(in, 4), mask_2f);
+        lo_nibbles = _mm256_and_si256(in, mask_2f);
+        invalid = _mm256_and_si256(
+            _mm256_shuffle_epi8(check_lo, lo_nibbles),
+            _mm256_shuffle_epi8(check_hi, hi_nibbles)
+        );
+        if (_mm256_movemask_epi8(
+            _mm256_cmpgt_epi8(invalid, _mm256_setzero_si256())
+        )) {
+            break;
+        }
+        values = _mm256_add_epi8(in, _mm256_shuffle_epi8(
+            offsets,
+            _mm256_add_epi8(_mm256_cmpeq_epi8(in, mask_2f), hi_nibbles)
+        ));
+
+        values = _mm256_maddubs_epi16(values, _mm256_set1_epi32(0x01400140));
+        values = _mm256_madd_epi16(values, _mm256_set1_epi32(0x00011000));
+        values = _mm256_shuffle_epi8(values, pack);
+        /* each lane holds twelve bytes, move them next to each other */
+        values = _mm256_permutevar8x32_epi32(
+            values, _mm256_setr_epi32(0, 1, 2, 4, 5, 6, 7, 7)
+        );
+        _mm_storeu_si128((__m128i *)output, _mm256_castsi256_si128(values));
+        _mm_storel_epi64(
+            (__m128i *)(output + 16), _mm256_extracti128_si256(values, 1)
+        );
+        pos += 32;
+        output += 24;
+    }
+    return (pos - input) + _olm_decode_base64_ssse3(
+        pos, input + input_length - pos, output
+    );
+}
+
+#elif defined(OLM_CPU_ARM_NEON)
+
+#include <arm_neon.h>
+
+static uint8x16x4_t load_table(const uint8_t * table) {
+    uint8x16x4_t result;
+    result.val[0] = vld1q_u8(table);
+    result.val[1] = vld1q_u8(table + 16);
+    result.val[2] = vld1q_u8(table + 32);
+    result.val[3] = vld1q_u8(table + 48);
+    return result;
+}
+
+size_t _olm_encode_base64_neon(
+    uint8_t const * input, size_t input_length, uint8_t * output
+) {
+    const uint8x16x4_t alphabet = load_table(_olm_base64_alphabet);
+    const uint8x16_t mask = vdupq_n_u8(0x3F);
+    uint8_t const * pos = input;
+
+    /* the loads deinterleave the bytes of each group of three, and the stores
+     * interleave the characters of each group of four */
+    while (input + input_length - pos >= 48) {
+        uint8x16x3_t in = vld3q_u8(pos);
+        uint8x16x4_t out;
+        out.val[0] = vshrq_n_u8(in.val[0], 2);
+        out.val[1] = vandq_u8(
+            vorrq_u8(vshlq_n_u8(in.val[0], 4), vshrq_n_u8(in.val[1], 4)), mask
+        );
+        out.val[2] = vandq_u8(
+            vorrq_u8(vshlq_n_u8(in.val[1], 2), vshrq_n_u8(in.val[2], 6)), mask
+        );
+        out.val[3] = vandq_u8(in.val[2], mask);
+        out.val[0] = vqtbl4q_u8(alphabet, out.val[0]);
+        out.val[1] = vqtbl4q_u8(alphabet, out.val[1]);
+        out.val[2] = vqtbl4q_u8(alphabet, out.val[2]);
+        out.val[3] = vqtbl4q_u8(alphabet, out.val[3]);
+        vst4q_u8(output, out);
+        pos += 48;
+        output += 64;
+    }
+    return pos - input;
+}
+
+size_t _olm_decode_base64_neon(
+    uint8_t const * input, size_t input_length, uint8_t * output
+) {
+    const uint8x16x4_t values_lo = load_table(_olm_base64_values);
+    const uint8x16x4_t values_hi = load_table(_olm_base64_values + 64);
+    const uint8x16_t offset = vdupq_n_u8(64);
+    uint8_t const * pos = input;
+
+    while (input + input_length - pos >= 64) {
+        uint8x16x4_t in = vld4q_u8(pos);
+        uint8x16x3_t out;
+        uint8x16_t invalid = vdupq_n_u8(0);
+        int i;
+
+        /* characters from 0x80 up and values of 0xFF have the top bit set */
+        for (i = 0; i < 4; ++i) {
+            invalid = vorrq_u8(invalid, in.val[i]);
+            in.val[i] = vqtbx4q_u8(
+                vqtbl4q_u8(values_lo, in.val[i]),
+                values_hi, vsubq_u8(in.val[i], offset)
+            );
+            invalid = vorrq_u8(invalid, in.val[i]);
+        }
+        if (vmaxvq_u8(invalid) & 0x80) {
+            break;
+        }
+        out.val[0] = vorrq_u8(
+            vshlq_n_u8(in.val[0], 2), vshrq_n_u8(in.val[1], 4)
+        );
+        out.val[1] = vorrq_u8(
+            vshlq_n_u8(in.val[1], 4), vshrq_n_u8(in.val[2], 2)
+        );
+        out.val[2] = vorrq_u8(vshlq_n_u8(in.val[2], 6), in.val[3]);
+        vst3q_u8(output, out);
+        pos += 64;
+        output += 48;
+    }
+    return pos - input;
+}
+
+#endif
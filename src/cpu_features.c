@@ -0,0 +1,108 @@
+/* Copyright 2026 Comm Technologies, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "olm/cpu_features.h"
+
+#if defined(OLM_CPU_X86)
+#include <cpuid.h>
+#elif defined(OLM_CPU_ARM_CRYPTO) && defined(__linux__)
+#include <sys/auxv.h>
+#ifndef HWCAP_AES
+#define HWCAP_AES (1 << 3)
+#endif
+#ifndef HWCAP_SHA2
+#define HWCAP_SHA2 (1 << 6)
+#endif
+#endif
+
+/* The detected features are cached. Every thread computes the same value, so
+ * racing on the first call is harmless. */
+static volatile unsigned int detected_features;
+static volatile int features_detected;
+static volatile unsigned int feature_mask = ~0u;
+
+#if defined(OLM_CPU_X86)
+static unsigned int detect_features(void) {
+    unsigned int eax, ebx, ecx, edx;
+    unsigned int features = 0;
+    int os_saves_ymm = 0;
+
+    if (!__get_cpuid(1, &eax, &ebx, &ecx, &edx)) {
+        return 0;
+    }
+    /* everything below needs SSE2 */
+    if (!(edx & (1u << 26))) {
+        return 0;
+    }
+    features |= OLM_CPU_X86_SSE2;
+    if (ecx & (1u << 25)) {
+        features |= OLM_CPU_X86_AES;
+    }
+    if ((ecx & (1u << 9)) && (ecx & (1u << 19))) {
+        /* SSSE3 and SSE4.1 */
+        features |= OLM_CPU_X86_SSSE3;
+    }
+    if ((ecx & (1u << 27)) && (ecx & (1u << 28))) {
+        /* OSXSAVE and AVX: check that the OS saves the YMM registers */
+        unsigned int xcr0_lo, xcr0_hi;
+        __asm__ __volatile__ ("xgetbv" : "=a"(xcr0_lo), "=d"(xcr0_hi) : "c"(0));
+        os_saves_ymm = (xcr0_lo & 6) == 6;
+    }
+
+    if (__get_cpuid_max(0, 0) >= 7) {
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        if ((ebx & (1u << 29)) && (features & OLM_CPU_X86_SSSE3)) {
+            features |= OLM_CPU_X86_SHA;
+        }
+        if ((ebx & (1u << 5)) && os_saves_ymm) {
+            features |= OLM_CPU_X86_AVX2;
+        }
+    }
+    return features;
+}
+#elif defined(OLM_CPU_ARM_CRYPTO)
+static unsigned int detect_features(void) {
+#if defined(__linux__)
+    unsigned long hwcap = getauxval(AT_HWCAP);
+    unsigned int features = 0;
+    if (hwcap & HWCAP_AES) {
+        features |= OLM_CPU_ARM_AES;
+    }
+    if (hwcap & HWCAP_SHA2) {
+        features |= OLM_CPU_ARM_SHA2;
+    }
+    return features;
+#else
+    /* the toolchain was told the extensions are present (eg. Apple arm64) */
+    return OLM_CPU_ARM_AES | OLM_CPU_ARM_SHA2;
+#endif
+}
+#else
+static unsigned int detect_features(void) {
+    return 0;
+}
+#endif
+
+unsigned int _olm_cpu_features(void) {
+    if (!features_detected) {
+        detected_features = detect_features();
+        features_detected = 1;
+    }
+    return detected_features & feature_mask;
+}
+
+void _olm_cpu_restrict_features(unsigned int mask) {
+    feature_mask = mask;
+}
@@ -13,89 +13,96 @@
  * limitations under the License.
  */
 #include "olm/crypto.h"
+#include "olm/aes_backend.h"
+#include "olm/curve25519_backend.h"
 #include "olm/memory.hh"
+#include "olm/sha256_backend.h"
 
+#include <cassert>
+#include <cstddef>
 #include <cstring>
 
-extern "C" {
-
-#include "crypto-algorithms/aes.h"
-#include "crypto-algorithms/sha256.h"
-
-}
-
 #include "ed25519/src/ed25519.h"
-#include "curve25519-donna.h"
 
 namespace {
 
-static const std::uint8_t CURVE25519_BASEPOINT[32] = {9};
-static const std::size_t AES_KEY_SCHEDULE_LENGTH = 60;
-static const std::size_t AES_KEY_BITS = 8 * AES256_KEY_LENGTH;
-static const std::size_t AES_BLOCK_LENGTH = 16;
-static const std::size_t SHA256_BLOCK_LENGTH = 64;
 static const std::uint8_t HKDF_DEFAULT_SALT[32] = {};
 
 
-template<std::size_t block_size>
-inline static void xor_block(
-    std::uint8_t * block,
-    std::uint8_t const * input
-) {
-    for (std::size_t i = 0; i < block_size; ++i) {
-        block[i] ^= input[i];
-    }
-}
-
-
 inline static void hmac_sha256_key(
     std::uint8_t const * input_key, std::size_t input_key_length,
     std::uint8_t * hmac_key
 ) {
     std::memset(hmac_key, 0, SHA256_BLOCK_LENGTH);
     if (input_key_length > SHA256_BLOCK_LENGTH) {
-        ::SHA256_CTX context;
-        ::sha256_init(&context);
-        ::sha256_update(&context, input_key, input_key_length);
-        ::sha256_final(&context, hmac_key);
+        _olm_sha256_ctx context;
+        _olm_sha256_init(&context);
+        _olm_sha256_update(&context, input_key, input_key_length);
+        _olm_sha256_final(&context, hmac_key);
     } else {
         std::memcpy(hmac_key, input_key, input_key_length);
     }
 }
 
 
-inline static void hmac_sha256_init(
-    ::SHA256_CTX * context,
-    std::uint8_t const * hmac_key
+inline static void hmac_sha256_pad_state(
+    std::uint8_t const * hmac_key, std::uint8_t pad,
+    std::uint32_t * state
 ) {
-    std::uint8_t i_pad[SHA256_BLOCK_LENGTH];
-    std::memcpy(i_pad, hmac_key, SHA256_BLOCK_LENGTH);
+    _olm_sha256_ctx context;
+    std::uint8_t padded_key[SHA256_BLOCK_LENGTH];
     for (std::size_t i = 0; i < SHA256_BLOCK_LENGTH; ++i) {
-        i_pad[i] ^= 0x36;
+        padded_key[i] = hmac_key[i] ^ pad;
     }
-    ::sha256_init(context);
-    ::sha256_update(context, i_pad, SHA256_BLOCK_LENGTH);
-    olm::unset(i_pad);
+    _olm_sha256_init(&context);
+    _olm_sha256_compress(context.state, padded_key, 1);
+    std::memcpy(state, context.state, sizeof(context.state));
+    olm::unset(padded_key);
+    olm::unset(context);
+}
+
+
+/** start hashing from the inner midstate */
+inline static void hmac_sha256_start(
+    _olm_hmac_sha256_ctx const * hmac,
+    _olm_sha256_ctx * context
+) {
+    std::memcpy(context->state, hmac->inner_state, sizeof(context->state));
+    context->length = SHA256_BLOCK_LENGTH;
 }
 
 
-inline static void hmac_sha256_final(
-    ::SHA256_CTX * context,
-    std::uint8_t const * hmac_key,
+inline static void hmac_sha256_finish(
+    _olm_hmac_sha256_ctx const * hmac,
+    _olm_sha256_ctx * context,
     std::uint8_t * output
 ) {
-    std::uint8_t o_pad[SHA256_BLOCK_LENGTH + SHA256_OUTPUT_LENGTH];
-    std::memcpy(o_pad, hmac_key, SHA256_BLOCK_LENGTH);
-    for (std::size_t i = 0; i < SHA256_BLOCK_LENGTH; ++i) {
-        o_pad[i] ^= 0x5C;
+    std::uint8_t inner_hash[SHA256_OUTPUT_LENGTH];
+    _olm_sha256_final(context, inner_hash);
+    std::memcpy(context->state, hmac->outer_state, sizeof(context->state));
+    context->length = SHA256_BLOCK_LENGTH;
+    _olm_sha256_update(context, inner_hash, sizeof(inner_hash));
+    _olm_sha256_final(context, output);
+    olm::unset(inner_hash);
+}
+
+
+inline static void store_be64(std::uint8_t * bytes, std::uint64_t value) {
+    for (unsigned i = 0; i < 8; ++i) {
+        bytes[i] = value >> (56 - 8 * i);
+    }
+}
+
+
+inline static void store_state(
+    std::uint32_t const * state, std::uint8_t * output
+) {
+    for (unsigned i = 0; i < SHA256_STATE_WORDS; ++i) {
+        output[4 * i] = state[i] >> 24;
+        output[4 * i + 1] = state[i] >> 16;
+        output[4 * i + 2] = state[i] >> 8;
+        output[4 * i + 3] = state[i];
     }
-    ::sha256_final(context, o_pad + SHA256_BLOCK_LENGTH);
-    ::SHA256_CTX final_context;
-    ::sha256_init(&final_context);
-    ::sha256_update(&final_context, o_pad, sizeof(o_pad));
-    ::sha256_final(&final_context, output);
-    olm::unset(final_context);
-    olm::unset(o_pad);
 }
 
 } // namespace
@@ -108,10 +115,30 @@ void _olm_crypto_curve25519_generate_key(
         key_pair->private_key.private_key, random_32_bytes,
         CURVE25519_KEY_LENGTH
     );
-    ::curve25519_donna(
+    /* the Edwards curve fixed-base tables are much faster than a ladder */
+    ::ed25519_x25519_base(
         key_pair->public_key.public_key,
-        key_pair->private_key.private_key,
-        CURVE25519_BASEPOINT
+        key_pair->private_key.private_key
+    );
+}
+
+
+void _olm_crypto_curve25519_generate_keys(
+    uint8_t const * random, size_t count,
+    struct _olm_curve25519_key_pair *key_pairs
+) {
+    for (std::size_t i = 0; i < count; ++i) {
+        std::memcpy(
+            key_pairs[i].private_key.private_key,
+            random + i * CURVE25519_RANDOM_LENGTH, CURVE25519_KEY_LENGTH
+        );
+    }
+    /* the public keys are written straight into the key pairs */
+    std::uint8_t * pairs = reinterpret_cast<std::uint8_t *>(key_pairs);
+    ::ed25519_x25519_base_batch(
+        pairs + offsetof(_olm_curve25519_key_pair, public_key),
+        pairs + offsetof(_olm_curve25519_key_pair, private_key),
+        sizeof(_olm_curve25519_key_pair), count
     );
 }
 
@@ -121,7 +148,9 @@ void _olm_crypto_curve25519_shared_secret(
     const struct _olm_curve25519_public_key * their_key,
     std::uint8_t * output
 ) {
-    ::curve25519_donna(output, our_key->private_key.private_key, their_key->public_key);
+    _olm_curve25519_scalarmult(
+        output, our_key->private_key.private_key, their_key->public_key
+    );
 }
 
 
@@ -163,6 +192,61 @@ int _olm_crypto_ed25519_verify(
 }
 
 
+static_assert(
+    ED25519_BATCH_RANDOM_LENGTH == ED25519_BATCH_RANDOM_SIZE,
+    "batch verification takes the randomness the library expects"
+);
+
+static_assert(
+    sizeof(_olm_ed25519_public_key) == ED25519_PUBLIC_KEY_LENGTH,
+    "an array of keys is packed as the library expects"
+);
+
+
+int _olm_crypto_ed25519_verify_batch(
+    const struct _olm_ed25519_public_key *their_keys,
+    std::uint8_t const * const * messages, std::size_t const * message_lengths,
+    std::uint8_t const * const * signatures,
+    std::size_t count, std::uint8_t const * random,
+    int * valid
+) {
+    return ::ed25519_verify_batch(
+        signatures, messages, message_lengths,
+        reinterpret_cast<std::uint8_t const *>(their_keys), count, random,
+        valid
+    );
+}
+
+
+static_assert(
+    ED25519_PREPARED_KEY_LENGTH == ED25519_PREPARED_KEY_SIZE,
+    "prepared ed25519 keys are the size the library expects"
+);
+
+
+int _olm_crypto_ed25519_prepare_key(
+    const struct _olm_ed25519_public_key *their_key,
+    struct _olm_ed25519_prepared_key *prepared_key
+) {
+    return 0 != ::ed25519_prepare_public_key(
+        prepared_key->prepared_key, their_key->public_key
+    );
+}
+
+
+int _olm_crypto_ed25519_verify_prepared(
+    const struct _olm_ed25519_prepared_key *their_key,
+    std::uint8_t const * message, std::size_t message_length,
+    std::uint8_t const * signature
+) {
+    return 0 != ::ed25519_verify_prepared(
+        signature,
+        message, message_length,
+        their_key->prepared_key
+    );
+}
+
+
 std::size_t _olm_crypto_aes_encrypt_cbc_length(
     std::size_t input_length
 ) {
@@ -176,28 +260,43 @@ void _olm_crypto_aes_encrypt_cbc(
     std::uint8_t const * input, std::size_t input_length,
     std::uint8_t * output
 ) {
-    std::uint32_t key_schedule[AES_KEY_SCHEDULE_LENGTH];
-    ::aes_key_setup(key->key, key_schedule, AES_KEY_BITS);
-    std::uint8_t input_block[AES_BLOCK_LENGTH];
-    std::memcpy(input_block, iv->iv, AES_BLOCK_LENGTH);
-    while (input_length >= AES_BLOCK_LENGTH) {
-        xor_block<AES_BLOCK_LENGTH>(input_block, input);
-        ::aes_encrypt(input_block, output, key_schedule, AES_KEY_BITS);
-        std::memcpy(input_block, output, AES_BLOCK_LENGTH);
-        input += AES_BLOCK_LENGTH;
-        output += AES_BLOCK_LENGTH;
-        input_length -= AES_BLOCK_LENGTH;
-    }
+    _olm_aes256_key_schedule key_schedule;
+    _olm_aes256_key_setup(key->key, &key_schedule);
+    _olm_crypto_aes_encrypt_cbc_with_schedule(
+        &key_schedule, iv, input, input_length, output
+    );
+    olm::unset(key_schedule);
+}
+
+
+void _olm_crypto_aes_encrypt_cbc_with_schedule(
+    _olm_aes256_key_schedule const *key_schedule,
+    _olm_aes256_iv const *iv,
+    std::uint8_t const * input, std::size_t input_length,
+    std::uint8_t * output
+) {
+    std::uint8_t chain[AES_BLOCK_LENGTH];
+    std::memcpy(chain, iv->iv, AES_BLOCK_LENGTH);
+    std::size_t full_blocks = input_length / AES_BLOCK_LENGTH;
+    _olm_aes256_encrypt_cbc_blocks(
+        key_schedule, chain, input, full_blocks, output
+    );
+    input += full_blocks * AES_BLOCK_LENGTH;
+    output += full_blocks * AES_BLOCK_LENGTH;
+    input_length -= full_blocks * AES_BLOCK_LENGTH;
+    std::uint8_t final_block[AES_BLOCK_LENGTH];
     std::size_t i = 0;
     for (; i < input_length; ++i) {
-        input_block[i] ^= input[i];
+        final_block[i] = input[i];
     }
     for (; i < AES_BLOCK_LENGTH; ++i) {
-        input_block[i] ^= AES_BLOCK_LENGTH - input_length;
+        final_block[i] = AES_BLOCK_LENGTH - input_length;
     }
-    ::aes_encrypt(input_block, output, key_schedule, AES_KEY_BITS);
-    olm::unset(key_schedule);
-    olm::unset(input_block);
+    _olm_aes256_encrypt_cbc_blocks(
+        key_schedule, chain, final_block, 1, output
+    );
+    olm::unset(chain);
+    olm::unset(final_block);
 }
 
 
@@ -207,20 +306,28 @@ std::size_t _olm_crypto_aes_decrypt_cbc(
     std::uint8_t const * input, std::size_t input_length,
     std::uint8_t * output
 ) {
-    std::uint32_t key_schedule[AES_KEY_SCHEDULE_LENGTH];
-    ::aes_key_setup(key->key, key_schedule, AES_KEY_BITS);
-    std::uint8_t block1[AES_BLOCK_LENGTH];
-    std::uint8_t block2[AES_BLOCK_LENGTH];
-    std::memcpy(block1, iv->iv, AES_BLOCK_LENGTH);
-    for (std::size_t i = 0; i < input_length; i += AES_BLOCK_LENGTH) {
-        std::memcpy(block2, &input[i], AES_BLOCK_LENGTH);
-        ::aes_decrypt(&input[i], &output[i], key_schedule, AES_KEY_BITS);
-        xor_block<AES_BLOCK_LENGTH>(&output[i], block1);
-        std::memcpy(block1, block2, AES_BLOCK_LENGTH);
-    }
+    _olm_aes256_key_schedule key_schedule;
+    _olm_aes256_key_setup(key->key, &key_schedule);
+    std::size_t result = _olm_crypto_aes_decrypt_cbc_with_schedule(
+        &key_schedule, iv, input, input_length, output
+    );
     olm::unset(key_schedule);
-    olm::unset(block1);
-    olm::unset(block2);
+    return result;
+}
+
+
+std::size_t _olm_crypto_aes_decrypt_cbc_with_schedule(
+    _olm_aes256_key_schedule const *key_schedule,
+    _olm_aes256_iv const *iv,
+    std::uint8_t const * input, std::size_t input_length,
+    std::uint8_t * output
+) {
+    std::uint8_t chain[AES_BLOCK_LENGTH];
+    std::memcpy(chain, iv->iv, AES_BLOCK_LENGTH);
+    _olm_aes256_decrypt_cbc_blocks(
+        key_schedule, chain, input, input_length / AES_BLOCK_LENGTH, output
+    );
+    olm::unset(chain);
     std::size_t padding = output[input_length - 1];
     return (padding > input_length) ? std::size_t(-1) : (input_length - padding);
 }
@@ -230,38 +337,124 @@ void _olm_crypto_sha256(
     std::uint8_t const * input, std::size_t input_length,
     std::uint8_t * output
 ) {
-    ::SHA256_CTX context;
-    ::sha256_init(&context);
-    ::sha256_update(&context, input, input_length);
-    ::sha256_final(&context, output);
+    _olm_sha256_ctx context;
+    _olm_sha256_init(&context);
+    _olm_sha256_update(&context, input, input_length);
+    _olm_sha256_final(&context, output);
     olm::unset(context);
 }
 
 
-void _olm_crypto_hmac_sha256(
-    std::uint8_t const * key, std::size_t key_length,
-    std::uint8_t const * input, std::size_t input_length,
-    std::uint8_t * output
+void _olm_crypto_hmac_sha256_init(
+    _olm_hmac_sha256_ctx * ctx,
+    std::uint8_t const * key, std::size_t key_length
 ) {
     std::uint8_t hmac_key[SHA256_BLOCK_LENGTH];
-    ::SHA256_CTX context;
     hmac_sha256_key(key, key_length, hmac_key);
-    hmac_sha256_init(&context, hmac_key);
-    ::sha256_update(&context, input, input_length);
-    hmac_sha256_final(&context, hmac_key, output);
+    hmac_sha256_pad_state(hmac_key, 0x36, ctx->inner_state);
+    hmac_sha256_pad_state(hmac_key, 0x5C, ctx->outer_state);
     olm::unset(hmac_key);
+}
+
+
+void _olm_crypto_hmac_sha256_with_ctx(
+    _olm_hmac_sha256_ctx const * ctx,
+    std::uint8_t const * input, std::size_t input_length,
+    std::uint8_t * output
+) {
+    _olm_sha256_ctx context;
+    hmac_sha256_start(ctx, &context);
+    _olm_sha256_update(&context, input, input_length);
+    hmac_sha256_finish(ctx, &context, output);
     olm::unset(context);
 }
 
 
+void _olm_crypto_hmac_sha256_multi(
+    _olm_hmac_sha256_ctx const * ctx,
+    std::uint8_t const * const * inputs, std::size_t input_length,
+    std::uint8_t * const * outputs, std::size_t count
+) {
+    assert(count <= SHA256_MAX_LANES);
+    std::uint32_t states[SHA256_MAX_LANES][SHA256_STATE_WORDS];
+    std::uint8_t tails[SHA256_MAX_LANES][2 * SHA256_BLOCK_LENGTH];
+    std::uint8_t const * blocks[SHA256_MAX_LANES];
+    std::size_t full_blocks = input_length / SHA256_BLOCK_LENGTH;
+    std::size_t remainder = input_length % SHA256_BLOCK_LENGTH;
+    /* the padding needs a 0x80 byte and the 8 byte length after the input */
+    std::size_t tail_blocks = remainder + 9 > SHA256_BLOCK_LENGTH ? 2 : 1;
+
+    for (std::size_t i = 0; i < count; ++i) {
+        std::memcpy(states[i], ctx->inner_state, sizeof(states[i]));
+        std::uint8_t * tail = tails[i];
+        std::memset(tail, 0, sizeof(tails[i]));
+        std::memcpy(
+            tail, inputs[i] + full_blocks * SHA256_BLOCK_LENGTH, remainder
+        );
+        tail[remainder] = 0x80;
+        store_be64(
+            tail + tail_blocks * SHA256_BLOCK_LENGTH - 8,
+            (SHA256_BLOCK_LENGTH + std::uint64_t(input_length)) * 8
+        );
+    }
+
+    /* inner hash, continuing from the padded key */
+    for (std::size_t b = 0; b < full_blocks; ++b) {
+        for (std::size_t i = 0; i < count; ++i) {
+            blocks[i] = inputs[i] + b * SHA256_BLOCK_LENGTH;
+        }
+        _olm_sha256_compress_lanes(states, blocks, count);
+    }
+    for (std::size_t b = 0; b < tail_blocks; ++b) {
+        for (std::size_t i = 0; i < count; ++i) {
+            blocks[i] = tails[i] + b * SHA256_BLOCK_LENGTH;
+        }
+        _olm_sha256_compress_lanes(states, blocks, count);
+    }
+
+    /* outer hash: the inner hash always fits in a single padded block */
+    for (std::size_t i = 0; i < count; ++i) {
+        std::uint8_t * tail = tails[i];
+        std::memset(tail, 0, SHA256_BLOCK_LENGTH);
+        store_state(states[i], tail);
+        tail[SHA256_OUTPUT_LENGTH] = 0x80;
+        store_be64(
+            tail + SHA256_BLOCK_LENGTH - 8,
+            (SHA256_BLOCK_LENGTH + SHA256_OUTPUT_LENGTH) * 8
+        );
+        std::memcpy(states[i], ctx->outer_state, sizeof(states[i]));
+        blocks[i] = tail;
+    }
+    _olm_sha256_compress_lanes(states, blocks, count);
+
+    for (std::size_t i = 0; i < count; ++i) {
+        store_state(states[i], outputs[i]);
+    }
+    olm::unset(states);
+    olm::unset(tails);
+}
+
+
+void _olm_crypto_hmac_sha256(
+    std::uint8_t const * key, std::size_t key_length,
+    std::uint8_t const * input, std::size_t input_length,
+    std::uint8_t * output
+) {
+    _olm_hmac_sha256_ctx hmac;
+    _olm_crypto_hmac_sha256_init(&hmac, key, key_length);
+    _olm_crypto_hmac_sha256_with_ctx(&hmac, input, input_length, output);
+    olm::unset(hmac);
+}
+
+
 void _olm_crypto_hkdf_sha256(
     std::uint8_t const * input, std::size_t input_length,
     std::uint8_t const * salt, std::size_t salt_length,
     std::uint8_t const * info, std::size_t info_length,
     std::uint8_t * output, std::size_t output_length
 ) {
-    ::SHA256_CTX context;
-    std::uint8_t hmac_key[SHA256_BLOCK_LENGTH];
+    _olm_sha256_ctx context;
+    _olm_hmac_sha256_ctx hmac;
     std::uint8_t step_result[SHA256_OUTPUT_LENGTH];
     std::size_t bytes_remaining = output_length;
     std::uint8_t iteration = 1;
@@ -270,30 +463,29 @@ void _olm_crypto_hkdf_sha256(
         salt_length = sizeof(HKDF_DEFAULT_SALT);
     }
     /* Extract */
-    hmac_sha256_key(salt, salt_length, hmac_key);
-    hmac_sha256_init(&context, hmac_key);
-    ::sha256_update(&context, input, input_length);
-    hmac_sha256_final(&context, hmac_key, step_result);
-    hmac_sha256_key(step_result, SHA256_OUTPUT_LENGTH, hmac_key);
-
-    /* Expand */
-    hmac_sha256_init(&context, hmac_key);
-    ::sha256_update(&context, info, info_length);
-    ::sha256_update(&context, &iteration, 1);
-    hmac_sha256_final(&context, hmac_key, step_result);
+    _olm_crypto_hmac_sha256_init(&hmac, salt, salt_length);
+    _olm_crypto_hmac_sha256_with_ctx(&hmac, input, input_length, step_result);
+
+    /* Expand: every step is keyed with the same pseudorandom key, so its
+     * midstates are only computed once */
+    _olm_crypto_hmac_sha256_init(&hmac, step_result, SHA256_OUTPUT_LENGTH);
+    hmac_sha256_start(&hmac, &context);
+    _olm_sha256_update(&context, info, info_length);
+    _olm_sha256_update(&context, &iteration, 1);
+    hmac_sha256_finish(&hmac, &context, step_result);
     while (bytes_remaining > SHA256_OUTPUT_LENGTH) {
         std::memcpy(output, step_result, SHA256_OUTPUT_LENGTH);
         output += SHA256_OUTPUT_LENGTH;
         bytes_remaining -= SHA256_OUTPUT_LENGTH;
         iteration ++;
-        hmac_sha256_init(&context, hmac_key);
-        ::sha256_update(&context, step_result, SHA256_OUTPUT_LENGTH);
-        ::sha256_update(&context, info, info_length);
-        ::sha256_update(&context, &iteration, 1);
-        hmac_sha256_final(&context, hmac_key, step_result);
+        hmac_sha256_start(&hmac, &context);
+        _olm_sha256_update(&context, step_result, SHA256_OUTPUT_LENGTH);
+        _olm_sha256_update(&context, info, info_length);
+        _olm_sha256_update(&context, &iteration, 1);
+        hmac_sha256_finish(&hmac, &context, step_result);
     }
     std::memcpy(output, step_result, bytes_remaining);
     olm::unset(context);
-    olm::unset(hmac_key);
+    olm::unset(hmac);
     olm::unset(step_result);
 }
@@ -19,4 +19,6 @@
 #include "ed25519/src/keypair.c"
 #include "ed25519/src/sha512.c"
 #include "ed25519/src/verify.c"
+#include "ed25519/src/verify_batch.c"
 #include "ed25519/src/sign.c"
+#include "ed25519/src/x25519_base.c"
@@ -37,7 +37,9 @@ static const char * ERRORS[] = {
     "OLM_MESSAGE_OUT_OF_ORDER",
     "OLM_ALREADY_DECRYPTED_OR_KEYS_SKIPPED",
     "OLM_MAX_MESSAGE_GAP_EXCEEDED",
-    "OLM_SENDER_CHAIN_NOT_ACKNOWLEDGED"
+    "OLM_SENDER_CHAIN_NOT_ACKNOWLEDGED",
+    "OLM_OUT_OF_MEMORY",
+    "OLM_DELTA_OUT_OF_ORDER"
 };
 
 const char * _olm_error_to_string(enum OlmErrorCode error)
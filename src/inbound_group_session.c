@@ -30,10 +30,17 @@
 
 #define OLM_PROTOCOL_VERSION     3
 #define GROUP_SESSION_ID_LENGTH  ED25519_PUBLIC_KEY_LENGTH
-#define PICKLE_VERSION           2
+#define PICKLE_VERSION           3
+/* written while checkpoints are off, so that older versions can load it */
+#define PICKLE_VERSION_NO_CHECKPOINTS 2
 #define SESSION_KEY_VERSION      2
 #define SESSION_EXPORT_VERSION   1
 
+/* checkpoints are kept at the start of each 256 message block (where R(2)
+ * changes), and every CHECKPOINT_INTERVAL messages within a block */
+#define CHECKPOINT_BLOCK_MASK    (~(uint32_t)0xff)
+#define CHECKPOINT_INTERVAL      16
+
 struct OlmInboundGroupSession {
     /** our earliest known ratchet value */
     Megolm initial_ratchet;
@@ -44,6 +51,13 @@ struct OlmInboundGroupSession {
     /** The ed25519 signing key */
     struct _olm_ed25519_public_key signing_key;
 
+    /**
+     * signing_key prepared for checking signatures, if
+     * signing_key_prepared is set. Not pickled.
+     */
+    struct _olm_ed25519_prepared_key prepared_signing_key;
+    int signing_key_prepared;
+
     /**
      * Have we ever seen any evidence that this is a valid session?
      * (either because the original session share was signed, or because we
@@ -55,6 +69,19 @@ struct OlmInboundGroupSession {
      */
     int signing_key_verified;
 
+    /** the number of checkpoints to keep; 0 disables them */
+    uint32_t max_checkpoints;
+
+    /** the number of valid entries in checkpoints */
+    uint32_t checkpoint_count;
+
+    /**
+     * Ratchet values between initial_ratchet and latest_ratchet, oldest
+     * first, so that earlier messages can be decrypted without advancing
+     * all the way from initial_ratchet.
+     */
+    Megolm checkpoints[OLM_INBOUND_GROUP_SESSION_MAX_CHECKPOINTS];
+
     enum OlmErrorCode last_error;
 };
 
@@ -119,11 +146,14 @@ static size_t _init_group_session_keys(
 
     megolm_init(&session->initial_ratchet, ptr, counter);
     megolm_init(&session->latest_ratchet, ptr, counter);
+    _olm_unset(session->checkpoints, sizeof(session->checkpoints));
+    session->checkpoint_count = 0;
 
     ptr += MEGOLM_RATCHET_LENGTH;
     memcpy(
         session->signing_key.public_key, ptr, ED25519_PUBLIC_KEY_LENGTH
     );
+    session->signing_key_prepared = 0;
     ptr += ED25519_PUBLIC_KEY_LENGTH;
 
     if (!export_format) {
@@ -196,57 +226,49 @@ static size_t raw_pickle_length(
     length += megolm_pickle_length(&session->latest_ratchet);
     length += _olm_pickle_ed25519_public_key_length(&session->signing_key);
     length += _olm_pickle_bool_length(session->signing_key_verified);
+    if (!session->max_checkpoints) {
+        return length;
+    }
+    length += _olm_pickle_uint32_length(session->max_checkpoints);
+    length += _olm_pickle_uint32_length(session->checkpoint_count);
+    for (uint32_t i = 0; i < session->checkpoint_count; i++) {
+        length += megolm_pickle_length(&session->checkpoints[i]);
+    }
     return length;
 }
 
-size_t olm_pickle_inbound_group_session_length(
-    const OlmInboundGroupSession *session
+static void raw_pickle(
+    const OlmInboundGroupSession *session, uint8_t *pos
 ) {
-    return _olm_enc_output_length(raw_pickle_length(session));
-}
-
-size_t olm_pickle_inbound_group_session(
-    OlmInboundGroupSession *session,
-    void const * key, size_t key_length,
-    void * pickled, size_t pickled_length
-) {
-    size_t raw_length = raw_pickle_length(session);
-    uint8_t *pos;
-
-    if (pickled_length < _olm_enc_output_length(raw_length)) {
-        session->last_error = OLM_OUTPUT_BUFFER_TOO_SMALL;
-        return (size_t)-1;
-    }
-
-    pos = _olm_enc_output_pos(pickled, raw_length);
-    pos = _olm_pickle_uint32(pos, PICKLE_VERSION);
+    pos = _olm_pickle_uint32(
+        pos, session->max_checkpoints
+            ? PICKLE_VERSION : PICKLE_VERSION_NO_CHECKPOINTS
+    );
     pos = megolm_pickle(&session->initial_ratchet, pos);
     pos = megolm_pickle(&session->latest_ratchet, pos);
     pos = _olm_pickle_ed25519_public_key(pos, &session->signing_key);
     pos = _olm_pickle_bool(pos, session->signing_key_verified);
-
-    return _olm_enc_output(key, key_length, pickled, raw_length);
+    if (!session->max_checkpoints) {
+        return;
+    }
+    pos = _olm_pickle_uint32(pos, session->max_checkpoints);
+    pos = _olm_pickle_uint32(pos, session->checkpoint_count);
+    for (uint32_t i = 0; i < session->checkpoint_count; i++) {
+        pos = megolm_pickle(&session->checkpoints[i], pos);
+    }
 }
 
-size_t olm_unpickle_inbound_group_session(
+/* Loads the session from a pickle that has been decrypted in place. Returns
+ * pickled_length on success. */
+static size_t raw_unpickle(
     OlmInboundGroupSession *session,
-    void const * key, size_t key_length,
-    void * pickled, size_t pickled_length
+    const uint8_t *input, size_t raw_length,
+    size_t pickled_length
 ) {
-    const uint8_t *pos;
-    const uint8_t *end;
+    const uint8_t *pos = input;
+    const uint8_t *end = pos + raw_length;
     uint32_t pickle_version;
 
-    size_t raw_length = _olm_enc_input(
-        key, key_length, pickled, pickled_length, &(session->last_error)
-    );
-    if (raw_length == (size_t)-1) {
-        return raw_length;
-    }
-
-    pos = pickled;
-    end = pos + raw_length;
-
     pos = _olm_unpickle_uint32(pos, end, &pickle_version);
     FAIL_ON_CORRUPTED_PICKLE(pos, session);
 
@@ -263,6 +285,7 @@ size_t olm_unpickle_inbound_group_session(
 
     pos = _olm_unpickle_ed25519_public_key(pos, end, &session->signing_key);
     FAIL_ON_CORRUPTED_PICKLE(pos, session);
+    session->signing_key_prepared = 0;
 
     if (pickle_version == 1) {
         /* pickle v1 had no signing_key_verified field (all keyshares were
@@ -273,6 +296,27 @@ size_t olm_unpickle_inbound_group_session(
     }
     FAIL_ON_CORRUPTED_PICKLE(pos, session);
 
+    if (pickle_version < 3) {
+        /* pickle v2 had no checkpoints */
+        session->max_checkpoints = 0;
+        session->checkpoint_count = 0;
+    } else {
+        pos = _olm_unpickle_uint32(pos, end, &session->max_checkpoints);
+        FAIL_ON_CORRUPTED_PICKLE(pos, session);
+        pos = _olm_unpickle_uint32(pos, end, &session->checkpoint_count);
+        FAIL_ON_CORRUPTED_PICKLE(pos, session);
+
+        if (session->max_checkpoints > OLM_INBOUND_GROUP_SESSION_MAX_CHECKPOINTS
+                || session->checkpoint_count > session->max_checkpoints) {
+            session->last_error = OLM_CORRUPTED_PICKLE;
+            return (size_t)-1;
+        }
+        for (uint32_t i = 0; i < session->checkpoint_count; i++) {
+            pos = megolm_unpickle(&session->checkpoints[i], pos, end);
+            FAIL_ON_CORRUPTED_PICKLE(pos, session);
+        }
+    }
+
     if (pos != end) {
         /* Input was longer than expected. */
         session->last_error = OLM_PICKLE_EXTRA_DATA;
@@ -282,6 +326,113 @@ size_t olm_unpickle_inbound_group_session(
     return pickled_length;
 }
 
+size_t olm_pickle_inbound_group_session_length(
+    const OlmInboundGroupSession *session
+) {
+    return _olm_enc_output_length(raw_pickle_length(session));
+}
+
+size_t olm_pickle_inbound_group_session(
+    OlmInboundGroupSession *session,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length
+) {
+    struct OlmPickleKey pickle_key;
+    size_t result;
+    _olm_pickle_key_setup(&pickle_key, key, key_length);
+    result = olm_pickle_inbound_group_session_with_key_context(
+        session, &pickle_key, pickled, pickled_length
+    );
+    _olm_unset(&pickle_key, sizeof(pickle_key));
+    return result;
+}
+
+size_t olm_pickle_inbound_group_session_with_key_context(
+    OlmInboundGroupSession *session,
+    const OlmPickleKey * pickle_key,
+    void * pickled, size_t pickled_length
+) {
+    size_t raw_length = raw_pickle_length(session);
+    uint8_t *pos;
+
+    if (pickled_length < _olm_enc_output_length(raw_length)) {
+        session->last_error = OLM_OUTPUT_BUFFER_TOO_SMALL;
+        return (size_t)-1;
+    }
+
+    pos = _olm_enc_output_pos(pickled, raw_length);
+    raw_pickle(session, pos);
+
+    return _olm_enc_output_with_key_context(pickle_key, pickled, raw_length);
+}
+
+size_t olm_unpickle_inbound_group_session(
+    OlmInboundGroupSession *session,
+    void const * key, size_t key_length,
+    void * pickled, size_t pickled_length
+) {
+    struct OlmPickleKey pickle_key;
+    size_t result;
+    _olm_pickle_key_setup(&pickle_key, key, key_length);
+    result = olm_unpickle_inbound_group_session_with_key_context(
+        session, &pickle_key, pickled, pickled_length
+    );
+    _olm_unset(&pickle_key, sizeof(pickle_key));
+    return result;
+}
+
+size_t olm_unpickle_inbound_group_session_with_key_context(
+    OlmInboundGroupSession *session,
+    const OlmPickleKey * pickle_key,
+    void * pickled, size_t pickled_length
+) {
+    size_t raw_length = _olm_enc_input_with_key_context(
+        pickle_key, pickled, pickled_length, &(session->last_error)
+    );
+    if (raw_length == (size_t)-1) {
+        return raw_length;
+    }
+
+    return raw_unpickle(session, pickled, raw_length, pickled_length);
+}
+
+size_t olm_pickle_inbound_group_session_binary_length(
+    const OlmInboundGroupSession *session
+) {
+    return _olm_enc_output_binary_length(raw_pickle_length(session));
+}
+
+size_t olm_pickle_inbound_group_session_binary(
+    OlmInboundGroupSession *session,
+    const OlmPickleKey * pickle_key,
+    void * pickled, size_t pickled_length
+) {
+    size_t raw_length = raw_pickle_length(session);
+
+    if (pickled_length < _olm_enc_output_binary_length(raw_length)) {
+        session->last_error = OLM_OUTPUT_BUFFER_TOO_SMALL;
+        return (size_t)-1;
+    }
+
+    raw_pickle(session, pickled);
+    return _olm_enc_output_binary(pickle_key, pickled, raw_length);
+}
+
+size_t olm_unpickle_inbound_group_session_binary(
+    OlmInboundGroupSession *session,
+    const OlmPickleKey * pickle_key,
+    void * pickled, size_t pickled_length
+) {
+    size_t raw_length = _olm_enc_input_binary(
+        pickle_key, pickled, pickled_length, &(session->last_error)
+    );
+    if (raw_length == (size_t)-1) {
+        return raw_length;
+    }
+
+    return raw_unpickle(session, pickled, raw_length, pickled_length);
+}
+
 /**
  * get the max plaintext length in an un-base64-ed message
  */
@@ -328,6 +479,83 @@ size_t olm_group_decrypt_max_plaintext_length(
     );
 }
 
+size_t olm_inbound_group_session_set_max_checkpoints(
+    OlmInboundGroupSession *session,
+    size_t max_checkpoints
+) {
+    if (max_checkpoints > OLM_INBOUND_GROUP_SESSION_MAX_CHECKPOINTS) {
+        max_checkpoints = OLM_INBOUND_GROUP_SESSION_MAX_CHECKPOINTS;
+    }
+    if (session->checkpoint_count > max_checkpoints) {
+        /* drop the oldest */
+        uint32_t dropped = session->checkpoint_count - max_checkpoints;
+        memmove(
+            session->checkpoints, session->checkpoints + dropped,
+            max_checkpoints * sizeof(Megolm)
+        );
+        _olm_unset(
+            session->checkpoints + max_checkpoints, dropped * sizeof(Megolm)
+        );
+        session->checkpoint_count = max_checkpoints;
+    }
+    session->max_checkpoints = max_checkpoints;
+    return max_checkpoints;
+}
+
+static void _add_checkpoint(
+    OlmInboundGroupSession *session, const Megolm *megolm
+) {
+    uint32_t i;
+
+    for (i = 0; i < session->checkpoint_count; i++) {
+        if (session->checkpoints[i].counter == megolm->counter) {
+            return;
+        }
+    }
+    if (session->checkpoint_count == session->max_checkpoints) {
+        /* full: forget the oldest */
+        memmove(
+            session->checkpoints, session->checkpoints + 1,
+            (session->checkpoint_count - 1) * sizeof(Megolm)
+        );
+        session->checkpoint_count--;
+    }
+    session->checkpoints[session->checkpoint_count++] = *megolm;
+}
+
+/**
+ * advance a megolm ratchet to the given index, saving the ratchet values at
+ * the checkpoint positions it passes on the way.
+ */
+static void _advance_with_checkpoints(
+    OlmInboundGroupSession *session, Megolm *megolm, uint32_t message_index
+) {
+    uint32_t block = message_index & CHECKPOINT_BLOCK_MASK;
+
+    if (!session->max_checkpoints) {
+        megolm_advance_to(megolm, message_index);
+        return;
+    }
+
+    for (;;) {
+        uint32_t remaining = message_index - megolm->counter;
+        uint32_t next;
+
+        if ((uint32_t)(block - megolm->counter) - 1 < remaining) {
+            /* jump straight to the start of the block holding the index */
+            next = block;
+        } else {
+            next = (megolm->counter | (CHECKPOINT_INTERVAL - 1)) + 1;
+        }
+        if ((uint32_t)(next - megolm->counter) > remaining) {
+            break;
+        }
+        megolm_advance_to(megolm, next);
+        _add_checkpoint(session, megolm);
+    }
+    megolm_advance_to(megolm, message_index);
+}
+
 /**
  * get a copy of the megolm ratchet, advanced
  * to the relevant index. Returns 0 on success, -1 on error
@@ -338,7 +566,9 @@ static size_t _get_megolm(
     /* pick a megolm instance to use. If we're at or beyond the latest ratchet
      * value, use that */
     if ((message_index - session->latest_ratchet.counter) < (1U << 31)) {
-        megolm_advance_to(&session->latest_ratchet, message_index);
+        _advance_with_checkpoints(
+            session, &session->latest_ratchet, message_index
+        );
         *result = session->latest_ratchet;
         return 0;
     } else if ((message_index - session->initial_ratchet.counter) >= (1U << 31)) {
@@ -346,45 +576,59 @@ static size_t _get_megolm(
         session->last_error = OLM_UNKNOWN_MESSAGE_INDEX;
         return (size_t)-1;
     } else {
-        /* otherwise, start from the initial megolm. Take a copy so that we
-         * don't overwrite the initial megolm */
-        *result = session->initial_ratchet;
-        megolm_advance_to(result, message_index);
+        /* otherwise, start from the closest checkpoint before the index, or
+         * the initial megolm. Take a copy so that we don't overwrite it. */
+        const Megolm *start = &session->initial_ratchet;
+        uint32_t target = message_index - session->initial_ratchet.counter;
+        uint32_t best = 0;
+        uint32_t i;
+
+        for (i = 0; i < session->checkpoint_count; i++) {
+            uint32_t offset = session->checkpoints[i].counter
+                - session->initial_ratchet.counter;
+            if (offset <= target && offset > best) {
+                best = offset;
+                start = &session->checkpoints[i];
+            }
+        }
+        *result = *start;
+        _advance_with_checkpoints(session, result, message_index);
         return 0;
     }
 }
 
 /**
- * decrypt an un-base64-ed message
+ * check the headers and signature of an un-base64-ed message, and that its
+ * plain-text will fit in the output buffer. Returns the length of the message
+ * without the signature on success, -1 on error
  */
-static size_t _decrypt(
+static size_t _verify_message(
     OlmInboundGroupSession *session,
-    uint8_t * message, size_t message_length,
-    uint8_t * plaintext, size_t max_plaintext_length,
+    const uint8_t * message, size_t message_length,
+    size_t max_plaintext_length,
+    struct _OlmDecodeGroupMessageResults *decoded_results,
     uint32_t * message_index
 ) {
-    struct _OlmDecodeGroupMessageResults decoded_results;
     size_t max_length, r;
-    Megolm megolm;
 
     _olm_decode_group_message(
         message, message_length,
         megolm_cipher->ops->mac_length(megolm_cipher),
         ED25519_SIGNATURE_LENGTH,
-        &decoded_results);
+        decoded_results);
 
-    if (decoded_results.version != OLM_PROTOCOL_VERSION) {
+    if (decoded_results->version != OLM_PROTOCOL_VERSION) {
         session->last_error = OLM_BAD_MESSAGE_VERSION;
         return (size_t)-1;
     }
 
-    if (!decoded_results.has_message_index || !decoded_results.ciphertext) {
+    if (!decoded_results->has_message_index || !decoded_results->ciphertext) {
         session->last_error = OLM_BAD_MESSAGE_FORMAT;
         return (size_t)-1;
     }
 
     if (message_index != NULL) {
-        *message_index = decoded_results.message_index;
+        *message_index = decoded_results->message_index;
     }
 
     /* verify the signature. We could do this before decoding the message, but
@@ -393,8 +637,15 @@ static size_t _decrypt(
      * than "BAD_SIGNATURE" in this case.
      */
     message_length -= ED25519_SIGNATURE_LENGTH;
-    r = _olm_crypto_ed25519_verify(
-        &session->signing_key,
+    if (!session->signing_key_prepared) {
+        /* decoding the key is a good part of the cost of checking a
+         * signature, so it is only done once */
+        session->signing_key_prepared = _olm_crypto_ed25519_prepare_key(
+            &session->signing_key, &session->prepared_signing_key
+        );
+    }
+    r = session->signing_key_prepared && _olm_crypto_ed25519_verify_prepared(
+        &session->prepared_signing_key,
         message, message_length,
         message + message_length
     );
@@ -405,28 +656,34 @@ static size_t _decrypt(
 
     max_length = megolm_cipher->ops->decrypt_max_plaintext_length(
         megolm_cipher,
-        decoded_results.ciphertext_length
+        decoded_results->ciphertext_length
     );
     if (max_plaintext_length < max_length) {
         session->last_error = OLM_OUTPUT_BUFFER_TOO_SMALL;
         return (size_t)-1;
     }
 
-    r = _get_megolm(session, decoded_results.message_index, &megolm);
-    if (r == (size_t)-1) {
-        return r;
-    }
+    return message_length;
+}
 
-    /* now try checking the mac, and decrypting */
-    r = megolm_cipher->ops->decrypt(
+/**
+ * check the mac of a verified message and decrypt it, using the megolm
+ * ratchet for its index
+ */
+static size_t _decrypt_verified(
+    OlmInboundGroupSession *session, const Megolm *megolm,
+    const uint8_t * message, size_t message_length,
+    const struct _OlmDecodeGroupMessageResults *decoded_results,
+    uint8_t * plaintext, size_t max_plaintext_length
+) {
+    size_t r = megolm_cipher->ops->decrypt(
         megolm_cipher,
-        megolm_get_data(&megolm), MEGOLM_RATCHET_LENGTH,
+        megolm_get_data(megolm), MEGOLM_RATCHET_LENGTH,
         message, message_length,
-        decoded_results.ciphertext, decoded_results.ciphertext_length,
+        decoded_results->ciphertext, decoded_results->ciphertext_length,
         plaintext, max_plaintext_length
     );
 
-    _olm_unset(&megolm, sizeof(megolm));
     if (r == (size_t)-1) {
         session->last_error = OLM_BAD_MESSAGE_MAC;
         return r;
@@ -439,6 +696,42 @@ static size_t _decrypt(
     return r;
 }
 
+/**
+ * decrypt an un-base64-ed message
+ */
+static size_t _decrypt(
+    OlmInboundGroupSession *session,
+    const uint8_t * message, size_t message_length,
+    uint8_t * plaintext, size_t max_plaintext_length,
+    uint32_t * message_index
+) {
+    struct _OlmDecodeGroupMessageResults decoded_results;
+    size_t r;
+    Megolm megolm;
+
+    message_length = _verify_message(
+        session, message, message_length, max_plaintext_length,
+        &decoded_results, message_index
+    );
+    if (message_length == (size_t)-1) {
+        return message_length;
+    }
+
+    r = _get_megolm(session, decoded_results.message_index, &megolm);
+    if (r == (size_t)-1) {
+        return r;
+    }
+
+    /* now try checking the mac, and decrypting */
+    r = _decrypt_verified(
+        session, &megolm, message, message_length, &decoded_results,
+        plaintext, max_plaintext_length
+    );
+
+    _olm_unset(&megolm, sizeof(megolm));
+    return r;
+}
+
 size_t olm_group_decrypt(
     OlmInboundGroupSession *session,
     uint8_t * message, size_t message_length,
@@ -460,6 +753,222 @@ size_t olm_group_decrypt(
     );
 }
 
+size_t olm_group_decrypt_raw(
+    OlmInboundGroupSession *session,
+    const uint8_t * message, size_t message_length,
+    uint8_t * plaintext, size_t max_plaintext_length,
+    uint32_t * message_index
+) {
+    return _decrypt(
+        session, message, message_length,
+        plaintext, max_plaintext_length,
+        message_index
+    );
+}
+
+size_t olm_group_decrypt_with_scratch(
+    OlmInboundGroupSession *session,
+    const uint8_t * message, size_t message_length,
+    uint8_t * scratch, size_t scratch_length,
+    uint8_t * plaintext, size_t max_plaintext_length,
+    uint32_t * message_index
+) {
+    size_t raw_message_length, r;
+
+    raw_message_length = _olm_decode_base64_length(message_length);
+    if (raw_message_length == (size_t)-1) {
+        session->last_error = OLM_INVALID_BASE64;
+        return (size_t)-1;
+    }
+    if (scratch_length < raw_message_length) {
+        session->last_error = OLM_OUTPUT_BUFFER_TOO_SMALL;
+        return (size_t)-1;
+    }
+    _olm_decode_base64(message, message_length, scratch);
+
+    r = _decrypt(
+        session, scratch, raw_message_length,
+        plaintext, max_plaintext_length,
+        message_index
+    );
+    _olm_unset(scratch, raw_message_length);
+    return r;
+}
+
+/* enough of a group message for its version and index */
+#define GROUP_MESSAGE_PEEK_LENGTH 12
+
+/**
+ * read the headers of an un-base64-ed message. If the message is incomplete
+ * then it has been cut short after the headers, and has no MAC or signature
+ * to leave out.
+ */
+static enum OlmErrorCode _peek_group_message(
+    const uint8_t * message, size_t message_length, int complete,
+    uint8_t * version, uint32_t * message_index
+) {
+    struct _OlmDecodeGroupMessageResults decoded_results;
+
+    _olm_decode_group_message(
+        message, message_length,
+        complete ? megolm_cipher->ops->mac_length(megolm_cipher) : 0,
+        complete ? ED25519_SIGNATURE_LENGTH : 0,
+        &decoded_results);
+    *version = decoded_results.version;
+    if (decoded_results.version != OLM_PROTOCOL_VERSION) {
+        return OLM_BAD_MESSAGE_VERSION;
+    }
+    if (!decoded_results.has_message_index) {
+        return OLM_BAD_MESSAGE_FORMAT;
+    }
+    *message_index = decoded_results.message_index;
+    return OLM_SUCCESS;
+}
+
+enum OlmErrorCode olm_peek_group_message_raw(
+    const uint8_t * message, size_t message_length,
+    uint8_t * version, uint32_t * message_index
+) {
+    return _peek_group_message(
+        message, message_length, 1, version, message_index
+    );
+}
+
+enum OlmErrorCode olm_peek_group_message(
+    const uint8_t * message, size_t message_length,
+    uint8_t * version, uint32_t * message_index
+) {
+    uint8_t headers[GROUP_MESSAGE_PEEK_LENGTH];
+    size_t raw_length = _olm_decode_base64_prefix(
+        message, message_length, headers, sizeof(headers)
+    );
+    if (raw_length == (size_t)-1) {
+        return OLM_INVALID_BASE64;
+    }
+    return _peek_group_message(
+        headers, raw_length,
+        raw_length == _olm_decode_base64_length(message_length),
+        version, message_index
+    );
+}
+
+size_t olm_group_decrypt_batch(
+    OlmInboundGroupSession *session,
+    size_t message_count,
+    uint8_t * const * messages, size_t const * message_lengths,
+    uint8_t * const * plaintexts, size_t const * max_plaintext_lengths,
+    size_t * plaintext_lengths, uint32_t * message_indexes,
+    enum OlmErrorCode * errors
+) {
+    struct _OlmDecodeGroupMessageResults decoded_results;
+    Megolm megolm;
+    int have_megolm = 0;
+    int started = 0;
+    size_t decrypted = 0;
+    size_t i, previous = 0;
+    uint32_t previous_offset = 0;
+
+    /* first decode and verify everything. Messages that fail are marked with
+     * a plaintext length of olm_error() */
+    for (i = 0; i < message_count; i++) {
+        size_t raw_length = _olm_decode_base64(
+            messages[i], message_lengths[i], messages[i]
+        );
+        message_indexes[i] = 0;
+        plaintext_lengths[i] = 0;
+        if (raw_length == (size_t)-1) {
+            session->last_error = OLM_INVALID_BASE64;
+        } else {
+            raw_length = _verify_message(
+                session, messages[i], raw_length, max_plaintext_lengths[i],
+                &decoded_results, &message_indexes[i]
+            );
+        }
+        if (raw_length == (size_t)-1) {
+            plaintext_lengths[i] = (size_t)-1;
+        }
+        if (errors != NULL) {
+            errors[i] = raw_length == (size_t)-1
+                ? session->last_error : OLM_SUCCESS;
+        }
+    }
+
+    /* then decrypt in order of message index, counting from the initial
+     * ratchet so that messages from before it sort last. The next message is
+     * found by a scan rather than by sorting, so that no memory is needed
+     * beyond the caller's arrays. Messages with the same index are taken in
+     * input order. */
+    for (;;) {
+        uint32_t message_index, next_offset = 0;
+        size_t next = 0, message_length, r;
+        int found = 0;
+
+        for (i = 0; i < message_count; i++) {
+            uint32_t offset;
+            if (plaintext_lengths[i] == (size_t)-1) {
+                continue;
+            }
+            offset = message_indexes[i] - session->initial_ratchet.counter;
+            if (started && (offset < previous_offset
+                    || (offset == previous_offset && i <= previous))) {
+                continue;
+            }
+            if (!found || offset < next_offset) {
+                found = 1;
+                next = i;
+                next_offset = offset;
+            }
+        }
+        if (!found) {
+            break;
+        }
+        started = 1;
+        previous = next;
+        previous_offset = next_offset;
+        message_index = message_indexes[next];
+
+        /* walk the working copy forward for messages from before the latest
+         * ratchet; from the latest ratchet onwards _get_megolm advances it in
+         * place. Either way the ratchet only ever moves forward. */
+        if (have_megolm
+                && (message_index - session->latest_ratchet.counter) >= (1U << 31)
+                && (message_index - megolm.counter) < (1U << 31)) {
+            _advance_with_checkpoints(session, &megolm, message_index);
+            r = 0;
+        } else {
+            r = _get_megolm(session, message_index, &megolm);
+            have_megolm = r != (size_t)-1;
+        }
+
+        if (r != (size_t)-1) {
+            message_length = _olm_decode_base64_length(message_lengths[next]);
+            _olm_decode_group_message(
+                messages[next], message_length,
+                megolm_cipher->ops->mac_length(megolm_cipher),
+                ED25519_SIGNATURE_LENGTH,
+                &decoded_results);
+            r = _decrypt_verified(
+                session, &megolm,
+                messages[next], message_length - ED25519_SIGNATURE_LENGTH,
+                &decoded_results,
+                plaintexts[next], max_plaintext_lengths[next]
+            );
+        }
+
+        plaintext_lengths[next] = r;
+        if (r == (size_t)-1) {
+            if (errors != NULL) {
+                errors[next] = session->last_error;
+            }
+        } else {
+            decrypted++;
+        }
+    }
+
+    _olm_unset(&megolm, sizeof(megolm));
+    return decrypted;
+}
+
 size_t olm_inbound_group_session_id_length(
     const OlmInboundGroupSession *session
 ) {
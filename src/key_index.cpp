@@ -0,0 +1,196 @@
+/* Copyright 2026 Comm Technologies, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "olm/key_index.hh"
+
+#include <cstdlib>
+
+namespace {
+
+/* smallest number of slots allocated */
+static const std::size_t MIN_CAPACITY = 16;
+
+struct HashSeed {
+    std::uint64_t words[2];
+};
+
+/* the finalizer of MurmurHash3 */
+static std::uint64_t mix(std::uint64_t value) {
+    value ^= value >> 33;
+    value *= 0xff51afd7ed558ccdULL;
+    value ^= value >> 33;
+    value *= 0xc4ceb9fe1a85ec53ULL;
+    value ^= value >> 33;
+    return value;
+}
+
+static HashSeed make_seed() {
+    HashSeed seed;
+    /* The library takes no randomness of its own, but the addresses of a
+     * stack and a static variable vary between runs where the address space
+     * is randomised. */
+    static const char anchor = 0;
+    seed.words[0] = mix(
+        reinterpret_cast<std::uintptr_t>(&seed)
+            ^ reinterpret_cast<std::uintptr_t>(&anchor) << 16
+    );
+    seed.words[1] = mix(seed.words[0] + 0x9e3779b97f4a7c15ULL);
+    return seed;
+}
+
+/* The keys that are hashed are chosen by the peer, so the hash is keyed with
+ * a secret that is fixed for the life of the process. */
+static HashSeed const & hash_seed() {
+    static const HashSeed seed = make_seed();
+    return seed;
+}
+
+} // namespace
+
+static_assert(
+    CURVE25519_KEY_LENGTH == olm::KeyIndex::HASH_INPUT_LENGTH
+        && SHA256_OUTPUT_LENGTH == olm::KeyIndex::HASH_INPUT_LENGTH,
+    "keys and session ids are hashed whole"
+);
+
+olm::KeyIndex::KeyIndex(
+) : _entries(nullptr),
+    _mask(0),
+    _count(0),
+    _disabled(false) {
+}
+
+
+olm::KeyIndex::~KeyIndex() {
+    std::free(_entries);
+}
+
+
+void olm::KeyIndex::clear() {
+    std::free(_entries);
+    _entries = nullptr;
+    _mask = 0;
+    _count = 0;
+    _disabled = false;
+}
+
+
+std::uint32_t olm::KeyIndex::hash(
+    _olm_curve25519_public_key const & key, std::uint32_t index
+) {
+    return hash(key.public_key, index);
+}
+
+
+std::uint32_t olm::KeyIndex::hash(
+    std::uint8_t const * bytes, std::uint32_t index
+) {
+    HashSeed const & seed = hash_seed();
+    std::uint64_t value = seed.words[0] ^ index;
+    for (unsigned word = 0; word < HASH_INPUT_LENGTH / 8; ++word) {
+        std::uint64_t input = 0;
+        for (unsigned i = 0; i < 8; ++i) {
+            input |= std::uint64_t(bytes[8 * word + i]) << (8 * i);
+        }
+        value = mix(value ^ input ^ seed.words[1]);
+    }
+    std::uint32_t hash = value >> 32;
+    return hash ? hash : 1;
+}
+
+
+bool olm::KeyIndex::grow() {
+    std::size_t capacity = _entries ? 2 * (_mask + 1) : MIN_CAPACITY;
+    Entry * entries = static_cast<Entry *>(
+        std::calloc(capacity, sizeof(Entry))
+    );
+    if (!entries) {
+        return false;
+    }
+    std::size_t mask = capacity - 1;
+    if (_entries) {
+        for (std::size_t i = 0; i <= _mask; ++i) {
+            if (_entries[i].hash) {
+                std::size_t j = _entries[i].hash & mask;
+                while (entries[j].hash) {
+                    j = (j + 1) & mask;
+                }
+                entries[j] = _entries[i];
+            }
+        }
+        std::free(_entries);
+    }
+    _entries = entries;
+    _mask = mask;
+    return true;
+}
+
+
+void olm::KeyIndex::insert(
+    std::uint32_t hash, std::uint32_t value
+) {
+    if (_disabled) {
+        return;
+    }
+    /* keep the table at most half full so that probes stay short */
+    if (!_entries || 2 * (_count + 1) > _mask + 1) {
+        if (!grow()) {
+            clear();
+            _disabled = true;
+            return;
+        }
+    }
+    std::size_t i = hash & _mask;
+    while (_entries[i].hash) {
+        i = (i + 1) & _mask;
+    }
+    _entries[i].hash = hash;
+    _entries[i].value = value;
+    ++_count;
+}
+
+
+void olm::KeyIndex::erase(
+    std::uint32_t hash, std::uint32_t value
+) {
+    if (!_count) {
+        return;
+    }
+    std::size_t i = hash & _mask;
+    while (_entries[i].hash
+            && (_entries[i].hash != hash || _entries[i].value != value)) {
+        i = (i + 1) & _mask;
+    }
+    if (!_entries[i].hash) {
+        return;
+    }
+    --_count;
+
+    /* Shift later entries of the probe sequence back into the gap, so that
+     * lookups never stop early at an empty slot. */
+    std::size_t j = i;
+    for (;;) {
+        j = (j + 1) & _mask;
+        if (!_entries[j].hash) {
+            break;
+        }
+        std::size_t home = _entries[j].hash & _mask;
+        /* the entry can move to i unless its home slot is in (i, j] */
+        if (((j - home) & _mask) >= ((j - i) & _mask)) {
+            _entries[i] = _entries[j];
+            i = j;
+        }
+    }
+    _entries[i].hash = 0;
+}
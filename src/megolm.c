@@ -20,6 +20,7 @@
 
 #include "olm/cipher.h"
 #include "olm/crypto.h"
+#include "olm/memory.h"
 #include "olm/pickle.h"
 
 static const struct _olm_cipher_aes_sha_256 MEGOLM_CIPHER =
@@ -48,6 +49,33 @@ static void rehash_part(
     );
 }
 
+/* update R(from)...R(3) based on R(from). All of them are keyed with
+ * R(from), so the HMAC key is only set up once. */
+static void rehash_parts(
+    uint8_t data[MEGOLM_RATCHET_PARTS][MEGOLM_RATCHET_PART_LENGTH],
+    int rehash_from_part
+) {
+    struct _olm_hmac_sha256_ctx hmac;
+    uint8_t const * inputs[MEGOLM_RATCHET_PARTS];
+    uint8_t * outputs[MEGOLM_RATCHET_PARTS];
+    int i;
+
+    _olm_crypto_hmac_sha256_init(
+        &hmac, data[rehash_from_part], MEGOLM_RATCHET_PART_LENGTH
+    );
+    /* the key has been absorbed into the context, so R(from) can be
+     * overwritten along with the rest */
+    for (i = rehash_from_part; i < (int)MEGOLM_RATCHET_PARTS; i++) {
+        inputs[i - rehash_from_part] = HASH_KEY_SEEDS[i];
+        outputs[i - rehash_from_part] = data[i];
+    }
+    _olm_crypto_hmac_sha256_multi(
+        &hmac, inputs, HASH_KEY_SEED_LENGTH, outputs,
+        MEGOLM_RATCHET_PARTS - rehash_from_part
+    );
+    _olm_unset(&hmac, sizeof(hmac));
+}
+
 
 
 void megolm_init(Megolm *megolm, uint8_t const *random_data, uint32_t counter) {
@@ -85,7 +113,6 @@ const uint8_t * megolm_unpickle(Megolm *megolm, const uint8_t *pos,
 void megolm_advance(Megolm *megolm) {
     uint32_t mask = 0x00FFFFFF;
     int h = 0;
-    int i;
 
     megolm->counter++;
 
@@ -98,9 +125,7 @@ void megolm_advance(Megolm *megolm) {
     }
 
     /* now update R(h)...R(3) based on R(h) */
-    for (i = MEGOLM_RATCHET_PARTS-1; i >= h; i--) {
-        rehash_part(megolm->data, h, i);
-    }
+    rehash_parts(megolm->data, h);
 }
 
 void megolm_advance_to(Megolm *megolm, uint32_t advance_to) {
@@ -110,7 +135,6 @@ void megolm_advance_to(Megolm *megolm, uint32_t advance_to) {
     for (j = 0; j < (int)MEGOLM_RATCHET_PARTS; j++) {
         int shift = (MEGOLM_RATCHET_PARTS-j-1) * 8;
         uint32_t mask = (~(uint32_t)0) << shift;
-        int k;
 
         /* how many times do we need to rehash this part?
          *
@@ -146,9 +170,7 @@ void megolm_advance_to(Megolm *megolm, uint32_t advance_to) {
          * R(j+1) again, but the code to figure that out is a bit baroque and
          * doesn't save us much).
          */
-        for (k = 3; k >= j; k--) {
-            rehash_part(megolm->data, j, k);
-        }
+        rehash_parts(megolm->data, j);
         megolm->counter = advance_to & mask;
     }
 }
@@ -21,6 +21,12 @@ void _olm_unset(
     olm::unset(buffer, buffer_length);
 }
 
+int _olm_is_equal(
+    uint8_t const * buffer_a, uint8_t const * buffer_b, size_t length
+) {
+    return olm::is_equal(buffer_a, buffer_b, length);
+}
+
 void olm::unset(
     void volatile * buffer, std::size_t buffer_length
 ) {
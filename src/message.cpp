@@ -123,17 +123,23 @@ static std::uint8_t const * decode(
 }
 
 
+/* If partial is set, a value cut short by the end of the input is read up
+ * to the end rather than ignored. */
 static std::uint8_t const * decode(
     std::uint8_t const * pos, std::uint8_t const * end,
     std::uint8_t tag,
-    std::uint8_t const * & value, std::size_t & value_length
+    std::uint8_t const * & value, std::size_t & value_length,
+    bool partial = false
 ) {
     if (pos != end && *pos == tag) {
         ++pos;
         std::uint8_t const * len_start = pos;
         pos = varint_skip(pos, end);
         std::size_t len = varint_decode<std::size_t>(len_start, pos);
-        if (len > std::size_t(end - pos)) return end;
+        if (len > std::size_t(end - pos)) {
+            if (!partial) return end;
+            len = end - pos;
+        }
         value = pos;
         value_length = len;
         pos += len;
@@ -290,9 +296,10 @@ void olm::encode_one_time_key_message(
 }
 
 
-void olm::decode_one_time_key_message(
-    PreKeyMessageReader & reader,
-    std::uint8_t const * input, std::size_t input_length
+static void decode_pre_key_message(
+    olm::PreKeyMessageReader & reader,
+    std::uint8_t const * input, std::size_t input_length,
+    bool partial
 ) {
     std::uint8_t const * pos = input;
     std::uint8_t const * end = input + input_length;
@@ -334,7 +341,7 @@ void olm::decode_one_time_key_message(
         );
         pos = decode(
             pos, end, MESSAGE_TAG,
-            reader.message, reader.message_length
+            reader.message, reader.message_length, partial
         );
         if (unknown == pos) {
             pos = skip_unknown(pos, end);
@@ -343,6 +350,22 @@ void olm::decode_one_time_key_message(
 }
 
 
+void olm::decode_one_time_key_message(
+    PreKeyMessageReader & reader,
+    std::uint8_t const * input, std::size_t input_length
+) {
+    decode_pre_key_message(reader, input, input_length, false);
+}
+
+
+void olm::peek_one_time_key_message(
+    PreKeyMessageReader & reader,
+    std::uint8_t const * input, std::size_t input_length
+) {
+    decode_pre_key_message(reader, input, input_length, true);
+}
+
+
 
 static const std::uint8_t GROUP_MESSAGE_INDEX_TAG = 010;
 static const std::uint8_t GROUP_CIPHERTEXT_TAG = 022;
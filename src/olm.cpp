@@ -14,19 +14,25 @@
  */
 #include "olm/olm.h"
 #include "olm/session.hh"
+#include "olm/session_index.hh"
+#include "olm/ratchet_key_pool.hh"
 #include "olm/account.hh"
 #include "olm/cipher.h"
 #include "olm/pickle_encoding.h"
 #include "olm/utility.hh"
+#include "olm/base64.h"
 #include "olm/base64.hh"
 #include "olm/memory.hh"
+#include "olm/message.hh"
 
 #ifdef EMSCRIPTEN
 #include <emscripten/emscripten.h>
 #include <unistd.h>
 #endif
 
+#include <algorithm>
 #include <new>
+#include <cstdlib>
 #include <cstring>
 
 namespace {
@@ -43,6 +49,14 @@ static OlmUtility * to_c(olm::Utility * utility) {
     return reinterpret_cast<OlmUtility *>(utility);
 }
 
+static OlmSessionIndex * to_c(olm::SessionIndex * index) {
+    return reinterpret_cast<OlmSessionIndex *>(index);
+}
+
+static OlmRatchetKeyPool * to_c(olm::RatchetKeyPool * pool) {
+    return reinterpret_cast<OlmRatchetKeyPool *>(pool);
+}
+
 static olm::Account * from_c(OlmAccount * account) {
     return reinterpret_cast<olm::Account *>(account);
 }
@@ -67,6 +81,22 @@ static const olm::Utility * from_c(OlmUtility const * utility) {
     return reinterpret_cast<const olm::Utility *>(utility);
 }
 
+static olm::SessionIndex * from_c(OlmSessionIndex * index) {
+    return reinterpret_cast<olm::SessionIndex *>(index);
+}
+
+static const olm::SessionIndex * from_c(OlmSessionIndex const * index) {
+    return reinterpret_cast<const olm::SessionIndex *>(index);
+}
+
+static olm::RatchetKeyPool * from_c(OlmRatchetKeyPool * pool) {
+    return reinterpret_cast<olm::RatchetKeyPool *>(pool);
+}
+
+static const olm::RatchetKeyPool * from_c(OlmRatchetKeyPool const * pool) {
+    return reinterpret_cast<const olm::RatchetKeyPool *>(pool);
+}
+
 static std::uint8_t * from_c(void * bytes) {
     return reinterpret_cast<std::uint8_t *>(bytes);
 }
@@ -110,6 +140,179 @@ std::size_t b64_input(
     return raw_length;
 }
 
+/* Loads an object from a pickle that has been decrypted in place. */
+template<typename T>
+std::size_t unpickle_decrypted(
+    T & object,
+    std::uint8_t const * input, std::size_t raw_length,
+    std::size_t pickled_length
+) {
+    std::uint8_t const * pos = input;
+    std::uint8_t const * end = pos + raw_length;
+
+    pos = unpickle(pos, end, object);
+
+    if (!pos) {
+        /* Input was corrupted. */
+        if (object.last_error == OlmErrorCode::OLM_SUCCESS) {
+            object.last_error = OlmErrorCode::OLM_CORRUPTED_PICKLE;
+        }
+        return std::size_t(-1);
+    } else if (pos != end) {
+        /* Input was longer than expected. */
+        object.last_error = OlmErrorCode::OLM_PICKLE_EXTRA_DATA;
+        return std::size_t(-1);
+    }
+
+    return pickled_length;
+}
+
+/* enough of a message for its headers: the keys of a pre-key message, and the
+ * ratchet key and counter of the message inside it */
+static const std::size_t MESSAGE_PEEK_LENGTH = 192;
+
+/* Reads the headers of a decoded message. If the message is incomplete then
+ * it has been cut short after the headers, and has no MAC to leave out. */
+OlmErrorCode peek_message(
+    std::size_t message_type,
+    std::uint8_t const * input, std::size_t input_length, bool complete,
+    OlmMessageHeaders & headers
+) {
+    std::memset(&headers, 0, sizeof(headers));
+    if (message_type == OLM_MESSAGE_TYPE_PRE_KEY) {
+        olm::PreKeyMessageReader reader;
+        olm::peek_one_time_key_message(reader, input, input_length);
+        headers.version = reader.version;
+        if (reader.version != olm::PROTOCOL_VERSION) {
+            return OlmErrorCode::OLM_BAD_MESSAGE_VERSION;
+        }
+        if (reader.identity_key_length != CURVE25519_KEY_LENGTH
+                || reader.base_key_length != CURVE25519_KEY_LENGTH
+                || reader.one_time_key_length != CURVE25519_KEY_LENGTH
+                || reader.prekey_length != CURVE25519_KEY_LENGTH
+                || !reader.message) {
+            return OlmErrorCode::OLM_BAD_MESSAGE_FORMAT;
+        }
+        olm::load_array(headers.identity_key, reader.identity_key);
+        olm::load_array(headers.base_key, reader.base_key);
+        olm::load_array(headers.one_time_key, reader.one_time_key);
+        olm::load_array(headers.prekey, reader.prekey);
+        input = reader.message;
+        input_length = reader.message_length;
+    } else if (message_type != OLM_MESSAGE_TYPE_MESSAGE) {
+        return OlmErrorCode::OLM_BAD_MESSAGE_FORMAT;
+    }
+
+    olm::MessageReader reader;
+    olm::decode_message(
+        reader, input, input_length,
+        complete ? olm::Session::message_mac_length() : 0
+    );
+    headers.version = reader.version;
+    if (reader.version != olm::PROTOCOL_VERSION) {
+        return OlmErrorCode::OLM_BAD_MESSAGE_VERSION;
+    }
+    if (!reader.has_counter
+            || reader.ratchet_key_length != CURVE25519_KEY_LENGTH) {
+        return OlmErrorCode::OLM_BAD_MESSAGE_FORMAT;
+    }
+    olm::load_array(headers.ratchet_key, reader.ratchet_key);
+    headers.counter = reader.counter;
+    return OlmErrorCode::OLM_SUCCESS;
+}
+
+/* Number of sessions encrypted by each task handed to an OlmParallelFor. */
+static const std::size_t FAN_OUT_GROUP_SIZE = 16;
+
+struct FanOutEncryption {
+    OlmSession * const * sessions;
+    std::size_t session_count;
+    std::uint8_t const * plaintext;
+    std::size_t plaintext_length;
+    std::uint8_t const * random;
+    std::uint8_t * messages;
+    /* where the laid out messages end */
+    std::size_t messages_length;
+    std::size_t const * message_offsets;
+    /* holds the offset of each session's random bytes until it is encrypted */
+    std::size_t * message_lengths;
+};
+
+static void encrypt_fan_out_group(void * context, std::size_t index) {
+    FanOutEncryption const & fan_out
+        = *static_cast<FanOutEncryption *>(context);
+    std::size_t begin = index * FAN_OUT_GROUP_SIZE;
+    std::size_t end = std::min(
+        begin + FAN_OUT_GROUP_SIZE, fan_out.session_count
+    );
+    for (std::size_t i = begin; i < end; ++i) {
+        olm::Session & session = *from_c(fan_out.sessions[i]);
+        std::size_t slot_end = i + 1 < fan_out.session_count
+            ? fan_out.message_offsets[i + 1] : fan_out.messages_length;
+        /* the message must fit the slot that was laid out for it */
+        std::size_t slot_length = olm::decode_base64_length(
+            slot_end - fan_out.message_offsets[i]
+        );
+        std::size_t raw_length = session.encrypt_message_length(
+            fan_out.plaintext_length
+        );
+        std::uint8_t * message = fan_out.messages + fan_out.message_offsets[i];
+        std::uint8_t * raw_message = b64_output_pos(message, slot_length);
+        std::size_t result = session.encrypt(
+            fan_out.plaintext, fan_out.plaintext_length,
+            fan_out.random + fan_out.message_lengths[i],
+            session.encrypt_random_length(),
+            raw_message, slot_length
+        );
+        if (result == std::size_t(-1)) {
+            fan_out.message_lengths[i] = result;
+        } else {
+            std::memmove(
+                b64_output_pos(message, raw_length), raw_message, raw_length
+            );
+            fan_out.message_lengths[i] = b64_output(message, raw_length);
+        }
+    }
+}
+
+/* The decoded keys and signatures for olm_ed25519_verify_batch, in one
+ * allocation that is freed when it goes out of scope. */
+struct BatchScratch {
+    void * memory = nullptr;
+    std::uint8_t const * * messages;
+    std::uint8_t const * * signatures;
+    std::size_t * signature_lengths;
+    _olm_ed25519_public_key * keys;
+
+    BatchScratch() = default;
+    BatchScratch(BatchScratch const &) = delete;
+    BatchScratch & operator=(BatchScratch const &) = delete;
+
+    ~BatchScratch() {
+        std::free(memory);
+    }
+
+    bool allocate(std::size_t count) {
+        std::size_t entry_size = 2 * sizeof(std::uint8_t const *)
+            + sizeof(std::size_t) + sizeof(_olm_ed25519_public_key);
+        if (count > std::size_t(-1) / entry_size) {
+            return false;
+        }
+        /* the pointers and lengths first, as the keys need no alignment */
+        memory = std::malloc(count ? count * entry_size : 1);
+        if (!memory) {
+            return false;
+        }
+        messages = static_cast<std::uint8_t const * *>(memory);
+        signatures = messages + count;
+        signature_lengths = reinterpret_cast<std::size_t *>(signatures + count);
+        keys = reinterpret_cast<_olm_ed25519_public_key *>(
+            signature_lengths + count
+        );
+        return true;
+    }
+};
+
 } // namespace
 
 
@@ -165,6 +368,19 @@ enum OlmErrorCode olm_utility_last_error_code(
     return from_c(utility)->last_error;
 }
 
+const char * olm_session_index_last_error(
+    OlmSessionIndex const * index
+) {
+    auto error = from_c(index)->last_error;
+    return _olm_error_to_string(error);
+}
+
+enum OlmErrorCode olm_session_index_last_error_code(
+    OlmSessionIndex const * index
+) {
+    return from_c(index)->last_error;
+}
+
 size_t olm_account_size(void) {
     return sizeof(olm::Account);
 }
@@ -178,6 +394,14 @@ size_t olm_utility_size(void) {
     return sizeof(olm::Utility);
 }
 
+size_t olm_session_index_size(void) {
+    return sizeof(olm::SessionIndex);
+}
+
+size_t olm_ratchet_key_pool_size(void) {
+    return sizeof(olm::RatchetKeyPool);
+}
+
 OlmAccount * olm_account(
     void * memory
 ) {
@@ -202,10 +426,27 @@ OlmUtility * olm_utility(
 }
 
 
+OlmSessionIndex * olm_session_index(
+    void * memory
+) {
+    olm::unset(memory, sizeof(olm::SessionIndex));
+    return to_c(new(memory) olm::SessionIndex());
+}
+
+
+OlmRatchetKeyPool * olm_ratchet_key_pool(
+    void * memory
+) {
+    olm::unset(memory, sizeof(olm::RatchetKeyPool));
+    return to_c(new(memory) olm::RatchetKeyPool());
+}
+
+
 size_t olm_clear_account(
     OlmAccount * account
 ) {
-    /* Clear the memory backing the account  */
+    /* Release and clear the key storage, then the account itself */
+    from_c(account)->~Account();
     olm::unset(account, sizeof(olm::Account));
     /* Initialise a fresh account object in case someone tries to use it */
     new(account) olm::Account();
@@ -216,7 +457,8 @@ size_t olm_clear_account(
 size_t olm_clear_session(
     OlmSession * session
 ) {
-    /* Clear the memory backing the session */
+    /* Release and clear the key storage, then the session itself */
+    from_c(session)->~Session();
     olm::unset(session, sizeof(olm::Session));
     /* Initialise a fresh session object in case someone tries to use it */
     new(session) olm::Session();
@@ -235,6 +477,30 @@ size_t olm_clear_utility(
 }
 
 
+size_t olm_clear_session_index(
+    OlmSessionIndex * index
+) {
+    /* Release and clear the entries, then the index itself */
+    from_c(index)->~SessionIndex();
+    olm::unset(index, sizeof(olm::SessionIndex));
+    /* Initialise a fresh index object in case someone tries to use it */
+    new(index) olm::SessionIndex();
+    return sizeof(olm::SessionIndex);
+}
+
+
+size_t olm_clear_ratchet_key_pool(
+    OlmRatchetKeyPool * pool
+) {
+    /* Clear the keys, then the pool itself */
+    from_c(pool)->~RatchetKeyPool();
+    olm::unset(pool, sizeof(olm::RatchetKeyPool));
+    /* Initialise a fresh pool object in case someone tries to use it */
+    new(pool) olm::RatchetKeyPool();
+    return sizeof(olm::RatchetKeyPool);
+}
+
+
 size_t olm_pickle_account_length(
     OlmAccount const * account
 ) {
@@ -253,6 +519,21 @@ size_t olm_pickle_account(
     OlmAccount * account,
     void const * key, size_t key_length,
     void * pickled, size_t pickled_length
+) {
+    OlmPickleKey pickle_key;
+    _olm_pickle_key_setup(&pickle_key, from_c(key), key_length);
+    std::size_t result = olm_pickle_account_with_key_context(
+        account, &pickle_key, pickled, pickled_length
+    );
+    olm::unset(pickle_key);
+    return result;
+}
+
+
+size_t olm_pickle_account_with_key_context(
+    OlmAccount * account,
+    OlmPickleKey const * pickle_key,
+    void * pickled, size_t pickled_length
 ) {
     olm::Account & object = *from_c(account);
     std::size_t raw_length = pickle_length(object);
@@ -261,7 +542,9 @@ size_t olm_pickle_account(
         return size_t(-1);
     }
     pickle(_olm_enc_output_pos(from_c(pickled), raw_length), object);
-    return _olm_enc_output(from_c(key), key_length, from_c(pickled), raw_length);
+    return _olm_enc_output_with_key_context(
+        pickle_key, from_c(pickled), raw_length
+    );
 }
 
 
@@ -269,6 +552,21 @@ size_t olm_pickle_session(
     OlmSession * session,
     void const * key, size_t key_length,
     void * pickled, size_t pickled_length
+) {
+    OlmPickleKey pickle_key;
+    _olm_pickle_key_setup(&pickle_key, from_c(key), key_length);
+    std::size_t result = olm_pickle_session_with_key_context(
+        session, &pickle_key, pickled, pickled_length
+    );
+    olm::unset(pickle_key);
+    return result;
+}
+
+
+size_t olm_pickle_session_with_key_context(
+    OlmSession * session,
+    OlmPickleKey const * pickle_key,
+    void * pickled, size_t pickled_length
 ) {
     olm::Session & object = *from_c(session);
     std::size_t raw_length = pickle_length(object);
@@ -277,7 +575,9 @@ size_t olm_pickle_session(
         return size_t(-1);
     }
     pickle(_olm_enc_output_pos(from_c(pickled), raw_length), object);
-    return _olm_enc_output(from_c(key), key_length, from_c(pickled), raw_length);
+    return _olm_enc_output_with_key_context(
+        pickle_key, from_c(pickled), raw_length
+    );
 }
 
 
@@ -285,34 +585,73 @@ size_t olm_unpickle_account(
     OlmAccount * account,
     void const * key, size_t key_length,
     void * pickled, size_t pickled_length
+) {
+    OlmPickleKey pickle_key;
+    _olm_pickle_key_setup(&pickle_key, from_c(key), key_length);
+    std::size_t result = olm_unpickle_account_with_key_context(
+        account, &pickle_key, pickled, pickled_length
+    );
+    olm::unset(pickle_key);
+    return result;
+}
+
+
+size_t olm_unpickle_account_with_key_context(
+    OlmAccount * account,
+    OlmPickleKey const * pickle_key,
+    void * pickled, size_t pickled_length
 ) {
     olm::Account & object = *from_c(account);
     std::uint8_t * input = from_c(pickled);
-    std::size_t raw_length = _olm_enc_input(
-        from_c(key), key_length, input, pickled_length, &object.last_error
+    std::size_t raw_length = _olm_enc_input_with_key_context(
+        pickle_key, input, pickled_length, &object.last_error
     );
     if (raw_length == std::size_t(-1)) {
         return std::size_t(-1);
     }
 
-    std::uint8_t const * pos = input;
-    std::uint8_t const * end = pos + raw_length;
+    return unpickle_decrypted(object, input, raw_length, pickled_length);
+}
 
-    pos = unpickle(pos, end, object);
 
-    if (!pos) {
-        /* Input was corrupted. */
-        if (object.last_error == OlmErrorCode::OLM_SUCCESS) {
-            object.last_error = OlmErrorCode::OLM_CORRUPTED_PICKLE;
-        }
-        return std::size_t(-1);
-    } else if (pos != end) {
-        /* Input was longer than expected. */
-        object.last_error = OlmErrorCode::OLM_PICKLE_EXTRA_DATA;
+size_t olm_pickle_account_binary_length(
+    OlmAccount const * account
+) {
+    return _olm_enc_output_binary_length(pickle_length(*from_c(account)));
+}
+
+
+size_t olm_pickle_account_binary(
+    OlmAccount * account,
+    OlmPickleKey const * pickle_key,
+    void * pickled, size_t pickled_length
+) {
+    olm::Account & object = *from_c(account);
+    std::size_t raw_length = pickle_length(object);
+    if (pickled_length < _olm_enc_output_binary_length(raw_length)) {
+        object.last_error = OlmErrorCode::OLM_OUTPUT_BUFFER_TOO_SMALL;
+        return size_t(-1);
+    }
+    pickle(from_c(pickled), object);
+    return _olm_enc_output_binary(pickle_key, from_c(pickled), raw_length);
+}
+
+
+size_t olm_unpickle_account_binary(
+    OlmAccount * account,
+    OlmPickleKey const * pickle_key,
+    void * pickled, size_t pickled_length
+) {
+    olm::Account & object = *from_c(account);
+    std::uint8_t * input = from_c(pickled);
+    std::size_t raw_length = _olm_enc_input_binary(
+        pickle_key, input, pickled_length, &object.last_error
+    );
+    if (raw_length == std::size_t(-1)) {
         return std::size_t(-1);
     }
 
-    return pickled_length;
+    return unpickle_decrypted(object, input, raw_length, pickled_length);
 }
 
 
@@ -320,21 +659,127 @@ size_t olm_unpickle_session(
     OlmSession * session,
     void const * key, size_t key_length,
     void * pickled, size_t pickled_length
+) {
+    OlmPickleKey pickle_key;
+    _olm_pickle_key_setup(&pickle_key, from_c(key), key_length);
+    std::size_t result = olm_unpickle_session_with_key_context(
+        session, &pickle_key, pickled, pickled_length
+    );
+    olm::unset(pickle_key);
+    return result;
+}
+
+
+size_t olm_unpickle_session_with_key_context(
+    OlmSession * session,
+    OlmPickleKey const * pickle_key,
+    void * pickled, size_t pickled_length
 ) {
     olm::Session & object = *from_c(session);
     std::uint8_t * input = from_c(pickled);
-    std::size_t raw_length = _olm_enc_input(
-        from_c(key), key_length, input, pickled_length, &object.last_error
+    std::size_t raw_length = _olm_enc_input_with_key_context(
+        pickle_key, input, pickled_length, &object.last_error
     );
     if (raw_length == std::size_t(-1)) {
         return std::size_t(-1);
     }
 
-    std::uint8_t const * pos = input;
-    std::uint8_t const * end = pos + raw_length;
+    return unpickle_decrypted(object, input, raw_length, pickled_length);
+}
 
-    pos = unpickle(pos, end, object);
 
+size_t olm_pickle_session_binary_length(
+    OlmSession const * session
+) {
+    return _olm_enc_output_binary_length(pickle_length(*from_c(session)));
+}
+
+
+size_t olm_pickle_session_binary(
+    OlmSession * session,
+    OlmPickleKey const * pickle_key,
+    void * pickled, size_t pickled_length
+) {
+    olm::Session & object = *from_c(session);
+    std::size_t raw_length = pickle_length(object);
+    if (pickled_length < _olm_enc_output_binary_length(raw_length)) {
+        object.last_error = OlmErrorCode::OLM_OUTPUT_BUFFER_TOO_SMALL;
+        return size_t(-1);
+    }
+    pickle(from_c(pickled), object);
+    return _olm_enc_output_binary(pickle_key, from_c(pickled), raw_length);
+}
+
+
+size_t olm_unpickle_session_binary(
+    OlmSession * session,
+    OlmPickleKey const * pickle_key,
+    void * pickled, size_t pickled_length
+) {
+    olm::Session & object = *from_c(session);
+    std::uint8_t * input = from_c(pickled);
+    std::size_t raw_length = _olm_enc_input_binary(
+        pickle_key, input, pickled_length, &object.last_error
+    );
+    if (raw_length == std::size_t(-1)) {
+        return std::size_t(-1);
+    }
+
+    return unpickle_decrypted(object, input, raw_length, pickled_length);
+}
+
+
+size_t olm_session_delta_length(
+    OlmSession const * session
+) {
+    olm::Session const & object = *from_c(session);
+    if (!object.ratchet.changes) {
+        return 0;
+    }
+    return _olm_enc_output_binary_length(pickle_delta_length(object));
+}
+
+
+size_t olm_session_delta(
+    OlmSession * session,
+    OlmPickleKey const * pickle_key,
+    void * delta, size_t delta_length
+) {
+    olm::Session & object = *from_c(session);
+    if (!object.ratchet.changes) {
+        return 0;
+    }
+    std::size_t raw_length = pickle_delta_length(object);
+    if (delta_length < _olm_enc_output_binary_length(raw_length)) {
+        object.last_error = OlmErrorCode::OLM_OUTPUT_BUFFER_TOO_SMALL;
+        return size_t(-1);
+    }
+    pickle_delta(from_c(delta), object);
+    std::size_t result = _olm_enc_output_binary(
+        pickle_key, from_c(delta), raw_length
+    );
+    object.ratchet.changes = 0;
+    object.delta_generation++;
+    return result;
+}
+
+
+size_t olm_session_apply_delta(
+    OlmSession * session,
+    OlmPickleKey const * pickle_key,
+    void * delta, size_t delta_length
+) {
+    olm::Session & object = *from_c(session);
+    std::uint8_t * input = from_c(delta);
+    std::size_t raw_length = _olm_enc_input_binary(
+        pickle_key, input, delta_length, &object.last_error
+    );
+    if (raw_length == std::size_t(-1)) {
+        return std::size_t(-1);
+    }
+
+    std::uint8_t const * end = input + raw_length;
+    std::uint8_t const * pos = unpickle_delta(input, end, object);
     if (!pos) {
         /* Input was corrupted. */
         if (object.last_error == OlmErrorCode::OLM_SUCCESS) {
@@ -346,8 +791,7 @@ size_t olm_unpickle_session(
         object.last_error = OlmErrorCode::OLM_PICKLE_EXTRA_DATA;
         return std::size_t(-1);
     }
-
-    return pickled_length;
+    return delta_length;
 }
 
 
@@ -442,6 +886,16 @@ size_t olm_account_max_number_of_one_time_keys(
 }
 
 
+size_t olm_account_set_max_number_of_one_time_keys(
+    OlmAccount * account,
+    size_t max_number_of_keys
+) {
+    return from_c(account)->set_max_number_of_one_time_keys(
+        max_number_of_keys
+    );
+}
+
+
 size_t olm_account_generate_one_time_keys_random_length(
     OlmAccount const * account,
     size_t number_of_keys
@@ -463,6 +917,22 @@ size_t olm_account_generate_one_time_keys(
     return result;
 }
 
+
+size_t olm_account_generate_one_time_keys_parallel(
+    OlmAccount * account,
+    size_t number_of_keys,
+    void * random, size_t random_length,
+    OlmParallelFor parallel_for, void * parallel_for_context
+) {
+    size_t result = from_c(account)->generate_one_time_keys(
+        number_of_keys,
+        from_c(random), random_length,
+        parallel_for, parallel_for_context
+    );
+    olm::unset(random, random_length);
+    return result;
+}
+
 size_t olm_account_generate_prekey_random_length(
     OlmAccount const * account
 ) {
@@ -783,6 +1253,20 @@ void olm_session_describe(
     from_c(session)->describe(buf, buflen);
 }
 
+size_t olm_session_set_max_skipped_message_keys(
+    OlmSession * session,
+    size_t max_keys
+) {
+    return from_c(session)->set_max_skipped_message_keys(max_keys);
+}
+
+size_t olm_session_set_max_receiver_chains(
+    OlmSession * session,
+    size_t max_chains
+) {
+    return from_c(session)->set_max_receiver_chains(max_chains);
+}
+
 size_t olm_matches_inbound_session(
     OlmSession * session,
     void * one_time_key_message, size_t message_length
@@ -828,6 +1312,99 @@ size_t olm_matches_inbound_session_from(
 }
 
 
+size_t olm_session_index_add(
+    OlmSessionIndex * index,
+    OlmSession * session
+) {
+    return from_c(index)->add(*from_c(session));
+}
+
+
+size_t olm_session_index_remove(
+    OlmSessionIndex * index,
+    OlmSession * session
+) {
+    return from_c(index)->remove(*from_c(session)) ? 1 : 0;
+}
+
+
+size_t olm_session_index_count(
+    OlmSessionIndex const * index
+) {
+    return from_c(index)->size();
+}
+
+
+size_t olm_session_index_find_inbound(
+    OlmSessionIndex * index,
+    void const * their_identity_key, size_t their_identity_key_length,
+    void const * one_time_key_message, size_t message_length,
+    OlmSession ** session
+) {
+    *session = nullptr;
+    _olm_curve25519_public_key identity_key;
+    if (their_identity_key) {
+        std::uint8_t const * id_key = from_c(their_identity_key);
+        std::size_t id_key_length = their_identity_key_length;
+        if (olm::decode_base64_length(id_key_length) != CURVE25519_KEY_LENGTH) {
+            from_c(index)->last_error = OlmErrorCode::OLM_INVALID_BASE64;
+            return std::size_t(-1);
+        }
+        olm::decode_base64(id_key, id_key_length, identity_key.public_key);
+    }
+
+    /* only the keys at the start of the message are needed */
+    std::uint8_t raw[MESSAGE_PEEK_LENGTH];
+    std::size_t raw_length = _olm_decode_base64_prefix(
+        from_c(one_time_key_message), message_length, raw, sizeof(raw)
+    );
+    if (raw_length == std::size_t(-1)) {
+        from_c(index)->last_error = OlmErrorCode::OLM_INVALID_BASE64;
+        return std::size_t(-1);
+    }
+
+    olm::Session * found;
+    std::size_t result = from_c(index)->find_inbound(
+        their_identity_key ? &identity_key : nullptr, raw, raw_length, found
+    );
+    if (result == std::size_t(-1)) {
+        return result;
+    }
+    *session = to_c(found);
+    return found ? 1 : 0;
+}
+
+
+OlmErrorCode olm_peek_message(
+    size_t message_type,
+    void const * message, size_t message_length,
+    OlmMessageHeaders * headers
+) {
+    std::uint8_t raw[MESSAGE_PEEK_LENGTH];
+    std::size_t raw_length = _olm_decode_base64_prefix(
+        from_c(message), message_length, raw, sizeof(raw)
+    );
+    if (raw_length == std::size_t(-1)) {
+        return OlmErrorCode::OLM_INVALID_BASE64;
+    }
+    return peek_message(
+        message_type, raw, raw_length,
+        raw_length == olm::decode_base64_length(message_length), *headers
+    );
+}
+
+
+OlmErrorCode olm_peek_message_raw(
+    size_t message_type,
+    void const * message, size_t message_length,
+    OlmMessageHeaders * headers
+) {
+    return peek_message(
+        message_type, from_c(message), message_length, true, *headers
+    );
+}
+
+
 size_t olm_remove_one_time_keys(
     OlmAccount * account,
     OlmSession * session
@@ -902,6 +1479,154 @@ size_t olm_encrypt(
 }
 
 
+size_t olm_ratchet_key_pool_count(
+    OlmRatchetKeyPool const * pool
+) {
+    return from_c(pool)->count();
+}
+
+
+size_t olm_ratchet_key_pool_refill_random_length(
+    OlmRatchetKeyPool const * pool
+) {
+    return from_c(pool)->refill_random_length();
+}
+
+
+size_t olm_ratchet_key_pool_refill(
+    OlmRatchetKeyPool * pool,
+    void * random, size_t random_length
+) {
+    std::size_t result = from_c(pool)->refill(from_c(random), random_length);
+    olm::unset(random, random_length);
+    return result;
+}
+
+
+size_t olm_encrypt_with_key_pool(
+    OlmSession * session,
+    OlmRatchetKeyPool * pool,
+    void const * plaintext, size_t plaintext_length,
+    void * random, size_t random_length,
+    void * message, size_t message_length
+) {
+    std::size_t raw_length = from_c(session)->encrypt_message_length(
+        plaintext_length
+    );
+    if (message_length < b64_output_length(raw_length)) {
+        from_c(session)->last_error =
+            OlmErrorCode::OLM_OUTPUT_BUFFER_TOO_SMALL;
+        return std::size_t(-1);
+    }
+    _olm_curve25519_key_pair ratchet_key;
+    bool have_key = from_c(session)->encrypt_random_length()
+        && from_c(pool)->take(ratchet_key);
+    std::size_t result = from_c(session)->encrypt(
+        from_c(plaintext), plaintext_length,
+        from_c(random), random_length,
+        b64_output_pos(from_c(message), raw_length), raw_length,
+        have_key ? &ratchet_key : nullptr
+    );
+    olm::unset(ratchet_key);
+    olm::unset(random, random_length);
+    if (result == std::size_t(-1)) {
+        return result;
+    }
+    return b64_output(from_c(message), raw_length);
+}
+
+
+size_t olm_encrypt_fan_out_random_length(
+    OlmSession * const * sessions, size_t session_count
+) {
+    std::size_t random_length = 0;
+    for (std::size_t i = 0; i < session_count; ++i) {
+        random_length += from_c(sessions[i])->encrypt_random_length();
+    }
+    return random_length;
+}
+
+
+size_t olm_encrypt_fan_out_length(
+    OlmSession * const * sessions, size_t session_count,
+    size_t plaintext_length
+) {
+    std::size_t messages_length = 0;
+    for (std::size_t i = 0; i < session_count; ++i) {
+        messages_length += b64_output_length(
+            from_c(sessions[i])->encrypt_message_length(plaintext_length)
+        );
+    }
+    return messages_length;
+}
+
+
+size_t olm_encrypt_fan_out(
+    OlmSession * const * sessions, size_t session_count,
+    void const * plaintext, size_t plaintext_length,
+    void * random, size_t random_length,
+    void * messages, size_t messages_length,
+    size_t * message_offsets, size_t * message_lengths,
+    OlmParallelFor parallel_for, void * parallel_for_context
+) {
+    /* lay out the messages and the random bytes before encrypting anything */
+    std::size_t message_offset = 0;
+    std::size_t random_offset = 0;
+    for (std::size_t i = 0; i < session_count; ++i) {
+        olm::Session const & session = *from_c(sessions[i]);
+        message_offsets[i] = message_offset;
+        message_lengths[i] = random_offset;
+        message_offset += b64_output_length(
+            session.encrypt_message_length(plaintext_length)
+        );
+        random_offset += session.encrypt_random_length();
+    }
+
+    OlmErrorCode error = OlmErrorCode::OLM_SUCCESS;
+    if (random_length < random_offset) {
+        error = OlmErrorCode::OLM_NOT_ENOUGH_RANDOM;
+    } else if (messages_length < message_offset) {
+        error = OlmErrorCode::OLM_OUTPUT_BUFFER_TOO_SMALL;
+    }
+    if (error != OlmErrorCode::OLM_SUCCESS) {
+        for (std::size_t i = 0; i < session_count; ++i) {
+            from_c(sessions[i])->last_error = error;
+            message_lengths[i] = std::size_t(-1);
+        }
+        olm::unset(random, random_length);
+        return std::size_t(-1);
+    }
+
+    FanOutEncryption fan_out = {
+        sessions, session_count,
+        from_c(plaintext), plaintext_length,
+        from_c(random), from_c(messages), message_offset,
+        message_offsets, message_lengths
+    };
+    std::size_t group_count = (
+        session_count + FAN_OUT_GROUP_SIZE - 1
+    ) / FAN_OUT_GROUP_SIZE;
+    if (parallel_for && group_count > 1) {
+        parallel_for(
+            parallel_for_context, group_count,
+            encrypt_fan_out_group, &fan_out
+        );
+    } else {
+        for (std::size_t i = 0; i < group_count; ++i) {
+            encrypt_fan_out_group(&fan_out, i);
+        }
+    }
+    olm::unset(random, random_length);
+
+    for (std::size_t i = 0; i < session_count; ++i) {
+        if (message_lengths[i] == std::size_t(-1)) {
+            return std::size_t(-1);
+        }
+    }
+    return message_offset;
+}
+
+
 size_t olm_decrypt_max_plaintext_length(
     OlmSession * session,
     size_t message_type,
@@ -1010,6 +1735,72 @@ size_t olm_ed25519_verify(
     );
 }
 
+size_t olm_ed25519_verify_batch_random_length(
+    OlmUtility const * utility,
+    size_t count
+) {
+    (void)utility;
+    return count * ED25519_BATCH_RANDOM_LENGTH;
+}
+
+size_t olm_ed25519_verify_batch(
+    OlmUtility * utility,
+    size_t count,
+    void const * const * keys, size_t const * key_lengths,
+    void const * const * messages, size_t const * message_lengths,
+    void * const * signatures, size_t const * signature_lengths,
+    void const * random, size_t random_length,
+    int * results
+) {
+    olm::Utility * self = from_c(utility);
+    if (random_length < olm_ed25519_verify_batch_random_length(utility, count)) {
+        self->last_error = OlmErrorCode::OLM_NOT_ENOUGH_RANDOM;
+        return std::size_t(-1);
+    }
+
+    /* the keys and signatures are decoded up front, so that the whole batch
+     * can be handed down in one call */
+    BatchScratch scratch;
+    if (!scratch.allocate(count)) {
+        self->last_error = OlmErrorCode::OLM_OUT_OF_MEMORY;
+        return std::size_t(-1);
+    }
+    bool bad_base64 = false;
+    for (std::size_t i = 0; i < count; ++i) {
+        std::size_t raw_signature_length = olm::decode_base64_length(
+            signature_lengths[i]
+        );
+        scratch.messages[i] = from_c(messages[i]);
+        scratch.signatures[i] = from_c(signatures[i]);
+        /* an undecodable key or signature is given a length of zero, so that
+         * it fails verification */
+        scratch.signature_lengths[i] = 0;
+        if (olm::decode_base64_length(key_lengths[i]) != CURVE25519_KEY_LENGTH
+                || raw_signature_length == std::size_t(-1)) {
+            bad_base64 = true;
+            continue;
+        }
+        olm::decode_base64(
+            from_c(keys[i]), key_lengths[i], scratch.keys[i].public_key
+        );
+        olm::decode_base64(
+            from_c(signatures[i]), signature_lengths[i], from_c(signatures[i])
+        );
+        scratch.signature_lengths[i] = raw_signature_length;
+    }
+    std::size_t result = self->ed25519_verify_batch(
+        scratch.keys, scratch.messages, message_lengths,
+        scratch.signatures, scratch.signature_lengths, count,
+        from_c(random), results
+    );
+
+    if (bad_base64) {
+        self->last_error = OlmErrorCode::OLM_INVALID_BASE64;
+        return std::size_t(-1);
+    }
+    return result;
+}
+
 #ifdef EMSCRIPTEN
 extern "C" {
     struct s_mallinfo {
@@ -84,6 +84,48 @@ static size_t raw_pickle_length(
     return length;
 }
 
+static void raw_pickle(
+    const OlmOutboundGroupSession *session, uint8_t *pos
+) {
+    pos = _olm_pickle_uint32(pos, PICKLE_VERSION);
+    pos = megolm_pickle(&(session->ratchet), pos);
+    pos = _olm_pickle_ed25519_key_pair(pos, &(session->signing_key));
+}
+
+/* Loads the session from a pickle that has been decrypted in place. Returns
+ * pickled_length on success. */
+static size_t raw_unpickle(
+    OlmOutboundGroupSession *session,
+    const uint8_t *input, size_t raw_length,
+    size_t pickled_length
+) {
+    const uint8_t *pos = input;
+    const uint8_t *end = pos + raw_length;
+    uint32_t pickle_version;
+
+    pos = _olm_unpickle_uint32(pos, end, &pickle_version);
+    FAIL_ON_CORRUPTED_PICKLE(pos, session);
+
+    if (pickle_version != PICKLE_VERSION) {
+        session->last_error = OLM_UNKNOWN_PICKLE_VERSION;
+        return (size_t)-1;
+    }
+
+    pos = megolm_unpickle(&(session->ratchet), pos, end);
+    FAIL_ON_CORRUPTED_PICKLE(pos, session);
+
+    pos = _olm_unpickle_ed25519_key_pair(pos, end, &(session->signing_key));
+    FAIL_ON_CORRUPTED_PICKLE(pos, session);
+
+    if (pos != end) {
+        /* Input was longer than expected. */
+        session->last_error = OLM_PICKLE_EXTRA_DATA;
+        return (size_t)-1;
+    }
+
+    return pickled_length;
+}
+
 size_t olm_pickle_outbound_group_session_length(
     const OlmOutboundGroupSession *session
 ) {
@@ -94,6 +136,21 @@ size_t olm_pickle_outbound_group_session(
     OlmOutboundGroupSession *session,
     void const * key, size_t key_length,
     void * pickled, size_t pickled_length
+) {
+    struct OlmPickleKey pickle_key;
+    size_t result;
+    _olm_pickle_key_setup(&pickle_key, key, key_length);
+    result = olm_pickle_outbound_group_session_with_key_context(
+        session, &pickle_key, pickled, pickled_length
+    );
+    _olm_unset(&pickle_key, sizeof(pickle_key));
+    return result;
+}
+
+size_t olm_pickle_outbound_group_session_with_key_context(
+    OlmOutboundGroupSession *session,
+    const OlmPickleKey * pickle_key,
+    void * pickled, size_t pickled_length
 ) {
     size_t raw_length = raw_pickle_length(session);
     uint8_t *pos;
@@ -109,12 +166,10 @@ size_t olm_pickle_outbound_group_session(
     pos = pickled;
 #endif
 
-    pos = _olm_pickle_uint32(pos, PICKLE_VERSION);
-    pos = megolm_pickle(&(session->ratchet), pos);
-    pos = _olm_pickle_ed25519_key_pair(pos, &(session->signing_key));
+    raw_pickle(session, pos);
 
 #ifndef OLM_FUZZING
-    return _olm_enc_output(key, key_length, pickled, raw_length);
+    return _olm_enc_output_with_key_context(pickle_key, pickled, raw_length);
 #else
     return raw_length;
 #endif
@@ -125,13 +180,24 @@ size_t olm_unpickle_outbound_group_session(
     void const * key, size_t key_length,
     void * pickled, size_t pickled_length
 ) {
-    const uint8_t *pos;
-    const uint8_t *end;
-    uint32_t pickle_version;
+    struct OlmPickleKey pickle_key;
+    size_t result;
+    _olm_pickle_key_setup(&pickle_key, key, key_length);
+    result = olm_unpickle_outbound_group_session_with_key_context(
+        session, &pickle_key, pickled, pickled_length
+    );
+    _olm_unset(&pickle_key, sizeof(pickle_key));
+    return result;
+}
 
+size_t olm_unpickle_outbound_group_session_with_key_context(
+    OlmOutboundGroupSession *session,
+    const OlmPickleKey * pickle_key,
+    void * pickled, size_t pickled_length
+) {
 #ifndef OLM_FUZZING
-    size_t raw_length = _olm_enc_input(
-        key, key_length, pickled, pickled_length, &(session->last_error)
+    size_t raw_length = _olm_enc_input_with_key_context(
+        pickle_key, pickled, pickled_length, &(session->last_error)
     );
 #else
     size_t raw_length = pickled_length;
@@ -141,30 +207,44 @@ size_t olm_unpickle_outbound_group_session(
         return raw_length;
     }
 
-    pos = pickled;
-    end = pos + raw_length;
+    return raw_unpickle(session, pickled, raw_length, pickled_length);
+}
 
-    pos = _olm_unpickle_uint32(pos, end, &pickle_version);
-    FAIL_ON_CORRUPTED_PICKLE(pos, session);
+size_t olm_pickle_outbound_group_session_binary_length(
+    const OlmOutboundGroupSession *session
+) {
+    return _olm_enc_output_binary_length(raw_pickle_length(session));
+}
 
-    if (pickle_version != PICKLE_VERSION) {
-        session->last_error = OLM_UNKNOWN_PICKLE_VERSION;
+size_t olm_pickle_outbound_group_session_binary(
+    OlmOutboundGroupSession *session,
+    const OlmPickleKey * pickle_key,
+    void * pickled, size_t pickled_length
+) {
+    size_t raw_length = raw_pickle_length(session);
+
+    if (pickled_length < _olm_enc_output_binary_length(raw_length)) {
+        session->last_error = OLM_OUTPUT_BUFFER_TOO_SMALL;
         return (size_t)-1;
     }
 
-    pos = megolm_unpickle(&(session->ratchet), pos, end);
-    FAIL_ON_CORRUPTED_PICKLE(pos, session);
-
-    pos = _olm_unpickle_ed25519_key_pair(pos, end, &(session->signing_key));
-    FAIL_ON_CORRUPTED_PICKLE(pos, session);
+    raw_pickle(session, pickled);
+    return _olm_enc_output_binary(pickle_key, pickled, raw_length);
+}
 
-    if (pos != end) {
-        /* Input was longer than expected. */
-        session->last_error = OLM_PICKLE_EXTRA_DATA;
-        return (size_t)-1;
+size_t olm_unpickle_outbound_group_session_binary(
+    OlmOutboundGroupSession *session,
+    const OlmPickleKey * pickle_key,
+    void * pickled, size_t pickled_length
+) {
+    size_t raw_length = _olm_enc_input_binary(
+        pickle_key, pickled, pickled_length, &(session->last_error)
+    );
+    if (raw_length == (size_t)-1) {
+        return raw_length;
     }
 
-    return pickled_length;
+    return raw_unpickle(session, pickled, raw_length, pickled_length);
 }
 
 
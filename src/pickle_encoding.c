@@ -17,11 +17,18 @@
 
 #include "olm/base64.h"
 #include "olm/cipher.h"
+#include "olm/memory.h"
 #include "olm/olm.h"
 
+#include <string.h>
+
 static const struct _olm_cipher_aes_sha_256 PICKLE_CIPHER =
     OLM_CIPHER_INIT_AES_SHA_256("Pickle");
 
+/* the lengths used by the PICKLE_CIPHER */
+#define PICKLE_MAC_KEY_LENGTH 32
+#define PICKLE_MAC_LENGTH 8
+
 size_t _olm_enc_output_length(
     size_t raw_length
 ) {
@@ -41,32 +48,104 @@ uint8_t * _olm_enc_output_pos(
     return output + _olm_encode_base64_length(length) - length;
 }
 
+void _olm_pickle_key_setup(
+    struct OlmPickleKey * pickle_key,
+    uint8_t const * key, size_t key_length
+) {
+    /* the same keys as the PICKLE_CIPHER derives for each call */
+    uint8_t derived_secrets[
+        AES256_KEY_LENGTH + PICKLE_MAC_KEY_LENGTH + AES256_IV_LENGTH
+    ];
+    _olm_crypto_hkdf_sha256(
+        key, key_length,
+        NULL, 0,
+        PICKLE_CIPHER.kdf_info, PICKLE_CIPHER.kdf_info_length,
+        derived_secrets, sizeof(derived_secrets)
+    );
+    _olm_aes256_key_setup(derived_secrets, &pickle_key->aes_key);
+    _olm_crypto_hmac_sha256_init(
+        &pickle_key->mac_key,
+        derived_secrets + AES256_KEY_LENGTH, PICKLE_MAC_KEY_LENGTH
+    );
+    memcpy(
+        pickle_key->aes_iv.iv,
+        derived_secrets + AES256_KEY_LENGTH + PICKLE_MAC_KEY_LENGTH,
+        AES256_IV_LENGTH
+    );
+    _olm_unset(derived_secrets, sizeof(derived_secrets));
+}
+
 size_t _olm_enc_output(
     uint8_t const * key, size_t key_length,
     uint8_t * output, size_t raw_length
 ) {
-    const struct _olm_cipher *cipher = OLM_CIPHER_BASE(&PICKLE_CIPHER);
-    size_t ciphertext_length = cipher->ops->encrypt_ciphertext_length(
-        cipher, raw_length
-    );
-    size_t length = ciphertext_length + cipher->ops->mac_length(cipher);
+    struct OlmPickleKey pickle_key;
+    size_t result;
+    _olm_pickle_key_setup(&pickle_key, key, key_length);
+    result = _olm_enc_output_with_key_context(&pickle_key, output, raw_length);
+    _olm_unset(&pickle_key, sizeof(pickle_key));
+    return result;
+}
+
+size_t _olm_enc_output_with_key_context(
+    const struct OlmPickleKey * pickle_key,
+    uint8_t * output, size_t raw_length
+) {
+    size_t length = _olm_enc_output_binary_length(raw_length);
     size_t base64_length = _olm_encode_base64_length(length);
     uint8_t * raw_output = output + base64_length - length;
-    cipher->ops->encrypt(
-        cipher,
-        key, key_length,
-        raw_output, raw_length,
-        raw_output, ciphertext_length,
-        raw_output, length
-    );
+    _olm_enc_output_binary(pickle_key, raw_output, raw_length);
     _olm_encode_base64(raw_output, length, output);
     return base64_length;
 }
 
+size_t _olm_enc_output_binary_length(
+    size_t raw_length
+) {
+    const struct _olm_cipher *cipher = OLM_CIPHER_BASE(&PICKLE_CIPHER);
+    return cipher->ops->encrypt_ciphertext_length(cipher, raw_length)
+        + PICKLE_MAC_LENGTH;
+}
+
+size_t _olm_enc_output_binary(
+    const struct OlmPickleKey * pickle_key,
+    uint8_t * pickle, size_t raw_length
+) {
+    const struct _olm_cipher *cipher = OLM_CIPHER_BASE(&PICKLE_CIPHER);
+    size_t ciphertext_length = cipher->ops->encrypt_ciphertext_length(
+        cipher, raw_length
+    );
+    uint8_t mac[SHA256_OUTPUT_LENGTH];
+
+    _olm_crypto_aes_encrypt_cbc_with_schedule(
+        &pickle_key->aes_key, &pickle_key->aes_iv,
+        pickle, raw_length, pickle
+    );
+    _olm_crypto_hmac_sha256_with_ctx(
+        &pickle_key->mac_key, pickle, ciphertext_length, mac
+    );
+    memcpy(pickle + ciphertext_length, mac, PICKLE_MAC_LENGTH);
+    return ciphertext_length + PICKLE_MAC_LENGTH;
+}
 
 size_t _olm_enc_input(uint8_t const * key, size_t key_length,
                       uint8_t * input, size_t b64_length,
                       enum OlmErrorCode * last_error
+) {
+    struct OlmPickleKey pickle_key;
+    size_t result;
+    _olm_pickle_key_setup(&pickle_key, key, key_length);
+    result = _olm_enc_input_with_key_context(
+        &pickle_key, input, b64_length, last_error
+    );
+    _olm_unset(&pickle_key, sizeof(pickle_key));
+    return result;
+}
+
+size_t _olm_enc_input_with_key_context(
+    const struct OlmPickleKey * pickle_key,
+    uint8_t * input, size_t b64_length,
+    enum OlmErrorCode * last_error
 ) {
     size_t enc_length = _olm_decode_base64_length(b64_length);
     if (enc_length == (size_t)-1) {
@@ -76,17 +155,52 @@ size_t _olm_enc_input(uint8_t const * key, size_t key_length,
         return (size_t)-1;
     }
     _olm_decode_base64(input, b64_length, input);
-    const struct _olm_cipher *cipher = OLM_CIPHER_BASE(&PICKLE_CIPHER);
-    size_t raw_length = enc_length - cipher->ops->mac_length(cipher);
-    size_t result = cipher->ops->decrypt(
-        cipher,
-        key, key_length,
-        input, enc_length,
-        input, raw_length,
-        input, raw_length
-    );
+    return _olm_enc_input_binary(pickle_key, input, enc_length, last_error);
+}
+
+size_t _olm_enc_input_binary(
+    const struct OlmPickleKey * pickle_key,
+    uint8_t * input, size_t enc_length,
+    enum OlmErrorCode * last_error
+) {
+    size_t raw_length;
+    size_t result = (size_t)-1;
+    uint8_t mac[SHA256_OUTPUT_LENGTH];
+
+    if (enc_length >= PICKLE_MAC_LENGTH) {
+        raw_length = enc_length - PICKLE_MAC_LENGTH;
+        _olm_crypto_hmac_sha256_with_ctx(
+            &pickle_key->mac_key, input, raw_length, mac
+        );
+        if (_olm_is_equal(input + raw_length, mac, PICKLE_MAC_LENGTH)) {
+            result = _olm_crypto_aes_decrypt_cbc_with_schedule(
+                &pickle_key->aes_key, &pickle_key->aes_iv,
+                input, raw_length, input
+            );
+        }
+    }
     if (result == (size_t)-1 && last_error) {
         *last_error = OLM_BAD_ACCOUNT_KEY;
     }
     return result;
 }
+
+size_t olm_pickle_key_size(void) {
+    return sizeof(struct OlmPickleKey);
+}
+
+OlmPickleKey * olm_pickle_key(
+    void * memory,
+    void const * key, size_t key_length
+) {
+    struct OlmPickleKey * pickle_key = (struct OlmPickleKey *)memory;
+    _olm_pickle_key_setup(pickle_key, (uint8_t const *)key, key_length);
+    return pickle_key;
+}
+
+size_t olm_clear_pickle_key(
+    OlmPickleKey * pickle_key
+) {
+    _olm_unset(pickle_key, sizeof(struct OlmPickleKey));
+    return sizeof(struct OlmPickleKey);
+}
@@ -289,6 +289,42 @@ namespace {
 
         return pos;
     }
+
+
+    /* Loads the object from a pickle that has been decrypted in place. */
+    static std::size_t unpickle_decrypted(
+        OlmPkDecryption & object,
+        std::uint8_t const * input, std::size_t raw_length,
+        std::size_t pickled_length,
+        void *pubkey
+    ) {
+        std::uint8_t const * pos = input;
+        std::uint8_t const * end = pos + raw_length;
+
+        pos = unpickle(pos, end, object);
+
+        if (!pos) {
+            /* Input was corrupted. */
+            if (object.last_error == OlmErrorCode::OLM_SUCCESS) {
+                object.last_error = OlmErrorCode::OLM_CORRUPTED_PICKLE;
+            }
+            return std::size_t(-1);
+        } else if (pos != end) {
+            /* Input was longer than expected. */
+            object.last_error = OlmErrorCode::OLM_PICKLE_EXTRA_DATA;
+            return std::size_t(-1);
+        }
+
+        if (pubkey != NULL) {
+            olm::encode_base64(
+                (const uint8_t *)object.key_pair.public_key.public_key,
+                CURVE25519_KEY_LENGTH,
+                (uint8_t *)pubkey
+            );
+        }
+
+        return pickled_length;
+    }
 }
 
 size_t olm_pickle_pk_decryption_length(
@@ -301,6 +337,22 @@ size_t olm_pickle_pk_decryption(
     OlmPkDecryption * decryption,
     void const * key, size_t key_length,
     void *pickled, size_t pickled_length
+) {
+    OlmPickleKey pickle_key;
+    _olm_pickle_key_setup(
+        &pickle_key, reinterpret_cast<std::uint8_t const *>(key), key_length
+    );
+    std::size_t result = olm_pickle_pk_decryption_with_key_context(
+        decryption, &pickle_key, pickled, pickled_length
+    );
+    olm::unset(pickle_key);
+    return result;
+}
+
+size_t olm_pickle_pk_decryption_with_key_context(
+    OlmPkDecryption * decryption,
+    OlmPickleKey const * pickle_key,
+    void *pickled, size_t pickled_length
 ) {
     OlmPkDecryption & object = *decryption;
     std::size_t raw_length = pickle_length(object);
@@ -309,9 +361,8 @@ size_t olm_pickle_pk_decryption(
         return std::size_t(-1);
     }
     pickle(_olm_enc_output_pos(reinterpret_cast<std::uint8_t *>(pickled), raw_length), object);
-    return _olm_enc_output(
-        reinterpret_cast<std::uint8_t const *>(key), key_length,
-        reinterpret_cast<std::uint8_t *>(pickled), raw_length
+    return _olm_enc_output_with_key_context(
+        pickle_key, reinterpret_cast<std::uint8_t *>(pickled), raw_length
     );
 }
 
@@ -320,6 +371,24 @@ size_t olm_unpickle_pk_decryption(
     void const * key, size_t key_length,
     void *pickled, size_t pickled_length,
     void *pubkey, size_t pubkey_length
+) {
+    OlmPickleKey pickle_key;
+    _olm_pickle_key_setup(
+        &pickle_key, reinterpret_cast<std::uint8_t const *>(key), key_length
+    );
+    std::size_t result = olm_unpickle_pk_decryption_with_key_context(
+        decryption, &pickle_key, pickled, pickled_length,
+        pubkey, pubkey_length
+    );
+    olm::unset(pickle_key);
+    return result;
+}
+
+size_t olm_unpickle_pk_decryption_with_key_context(
+    OlmPkDecryption * decryption,
+    OlmPickleKey const * pickle_key,
+    void *pickled, size_t pickled_length,
+    void *pubkey, size_t pubkey_length
 ) {
     OlmPkDecryption & object = *decryption;
     if (pubkey != NULL && pubkey_length < olm_pk_key_length()) {
@@ -327,40 +396,63 @@ size_t olm_unpickle_pk_decryption(
         return std::size_t(-1);
     }
     std::uint8_t * const input = reinterpret_cast<std::uint8_t *>(pickled);
-    std::size_t raw_length = _olm_enc_input(
-        reinterpret_cast<std::uint8_t const *>(key), key_length,
-        input, pickled_length, &object.last_error
+    std::size_t raw_length = _olm_enc_input_with_key_context(
+        pickle_key, input, pickled_length, &object.last_error
     );
     if (raw_length == std::size_t(-1)) {
         return std::size_t(-1);
     }
 
-    std::uint8_t const * pos = input;
-    std::uint8_t const * end = pos + raw_length;
+    return unpickle_decrypted(
+        object, input, raw_length, pickled_length, pubkey
+    );
+}
 
-    pos = unpickle(pos, end, object);
+size_t olm_pickle_pk_decryption_binary_length(
+    const OlmPkDecryption * decryption
+) {
+    return _olm_enc_output_binary_length(pickle_length(*decryption));
+}
 
-    if (!pos) {
-        /* Input was corrupted. */
-        if (object.last_error == OlmErrorCode::OLM_SUCCESS) {
-            object.last_error = OlmErrorCode::OLM_CORRUPTED_PICKLE;
-        }
-        return std::size_t(-1);
-    } else if (pos != end) {
-        /* Input was longer than expected. */
-        object.last_error = OlmErrorCode::OLM_PICKLE_EXTRA_DATA;
+size_t olm_pickle_pk_decryption_binary(
+    OlmPkDecryption * decryption,
+    OlmPickleKey const * pickle_key,
+    void *pickled, size_t pickled_length
+) {
+    OlmPkDecryption & object = *decryption;
+    std::size_t raw_length = pickle_length(object);
+    if (pickled_length < _olm_enc_output_binary_length(raw_length)) {
+        object.last_error = OlmErrorCode::OLM_OUTPUT_BUFFER_TOO_SMALL;
         return std::size_t(-1);
     }
+    pickle(reinterpret_cast<std::uint8_t *>(pickled), object);
+    return _olm_enc_output_binary(
+        pickle_key, reinterpret_cast<std::uint8_t *>(pickled), raw_length
+    );
+}
 
-    if (pubkey != NULL) {
-        olm::encode_base64(
-            (const uint8_t *)object.key_pair.public_key.public_key,
-            CURVE25519_KEY_LENGTH,
-            (uint8_t *)pubkey
-        );
+size_t olm_unpickle_pk_decryption_binary(
+    OlmPkDecryption * decryption,
+    OlmPickleKey const * pickle_key,
+    void *pickled, size_t pickled_length,
+    void *pubkey, size_t pubkey_length
+) {
+    OlmPkDecryption & object = *decryption;
+    if (pubkey != NULL && pubkey_length < olm_pk_key_length()) {
+        object.last_error = OlmErrorCode::OLM_OUTPUT_BUFFER_TOO_SMALL;
+        return std::size_t(-1);
+    }
+    std::uint8_t * const input = reinterpret_cast<std::uint8_t *>(pickled);
+    std::size_t raw_length = _olm_enc_input_binary(
+        pickle_key, input, pickled_length, &object.last_error
+    );
+    if (raw_length == std::size_t(-1)) {
+        return std::size_t(-1);
     }
 
-    return pickled_length;
+    return unpickle_decrypted(
+        object, input, raw_length, pickled_length, pubkey
+    );
 }
 
 size_t olm_pk_max_plaintext_length(
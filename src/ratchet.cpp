@@ -18,11 +18,12 @@
 #include "olm/cipher.h"
 #include "olm/pickle.hh"
 
+#include <algorithm>
+#include <cstdlib>
 #include <cstring>
 
 namespace {
 
-static const std::uint8_t PROTOCOL_VERSION = 3;
 static const std::uint8_t MESSAGE_KEY_SEED[1] = {0x01};
 static const std::uint8_t CHAIN_KEY_SEED[1] = {0x02};
 static const std::size_t MAX_MESSAGE_GAP = 2000;
@@ -65,12 +66,27 @@ static void create_chain_key(
 }
 
 
+/**
+ * Set up the HMAC keyed with the chain key, shared by advance_chain_key and
+ * create_message_keys for the same chain key.
+ */
+static void chain_key_hmac(
+    olm::ChainKey const & chain_key,
+    _olm_hmac_sha256_ctx & hmac
+) {
+    _olm_crypto_hmac_sha256_init(
+        &hmac, chain_key.key, sizeof(chain_key.key)
+    );
+}
+
+
 static void advance_chain_key(
+    _olm_hmac_sha256_ctx const & chain_hmac,
     olm::ChainKey const & chain_key,
     olm::ChainKey & new_chain_key
 ) {
-    _olm_crypto_hmac_sha256(
-        chain_key.key, sizeof(chain_key.key),
+    _olm_crypto_hmac_sha256_with_ctx(
+        &chain_hmac,
         CHAIN_KEY_SEED, sizeof(CHAIN_KEY_SEED),
         new_chain_key.key
     );
@@ -78,12 +94,24 @@ static void advance_chain_key(
 }
 
 
+static void advance_chain_key(
+    olm::ChainKey const & chain_key,
+    olm::ChainKey & new_chain_key
+) {
+    _olm_hmac_sha256_ctx chain_hmac;
+    chain_key_hmac(chain_key, chain_hmac);
+    advance_chain_key(chain_hmac, chain_key, new_chain_key);
+    olm::unset(chain_hmac);
+}
+
+
 static void create_message_keys(
+    _olm_hmac_sha256_ctx const & chain_hmac,
     olm::ChainKey const & chain_key,
     olm::KdfInfo const & info,
     olm::MessageKey & message_key) {
-    _olm_crypto_hmac_sha256(
-        chain_key.key, sizeof(chain_key.key),
+    _olm_crypto_hmac_sha256_with_ctx(
+        &chain_hmac,
         MESSAGE_KEY_SEED, sizeof(MESSAGE_KEY_SEED),
         message_key.key
     );
@@ -91,6 +119,22 @@ static void create_message_keys(
 }
 
 
+/**
+ * Create the message key for a chain key, then advance the chain key.
+ */
+static void create_message_keys_and_advance(
+    olm::ChainKey & chain_key,
+    olm::KdfInfo const & info,
+    olm::MessageKey & message_key
+) {
+    _olm_hmac_sha256_ctx chain_hmac;
+    chain_key_hmac(chain_key, chain_hmac);
+    create_message_keys(chain_hmac, chain_key, info, message_key);
+    advance_chain_key(chain_hmac, chain_key, chain_key);
+    olm::unset(chain_hmac);
+}
+
+
 static std::size_t verify_mac_and_decrypt(
     _olm_cipher const *cipher,
     olm::MessageKey const & message_key,
@@ -107,52 +151,105 @@ static std::size_t verify_mac_and_decrypt(
 }
 
 
+/**
+ * The state derived while checking a message. It is only copied into the
+ * ratchet once the MAC has been verified, so nothing is derived twice and a
+ * message that fails to decrypt leaves the ratchet unchanged.
+ */
+struct DecryptTransaction {
+    DecryptTransaction()
+        : new_chain(false), skipped_keys(nullptr), skipped_count(0) {}
+
+    ~DecryptTransaction() {
+        if (skipped_keys) {
+            olm::unset(skipped_keys, skipped_count * sizeof(olm::MessageKey));
+            std::free(skipped_keys);
+        }
+        olm::unset(new_root_key);
+        olm::unset(chain);
+    }
+
+    DecryptTransaction(DecryptTransaction const &) = delete;
+    DecryptTransaction & operator=(DecryptTransaction const &) = delete;
+
+    /** whether the message starts a new receiver chain */
+    bool new_chain;
+    /** the root key after the new chain was created */
+    olm::SharedKey new_root_key;
+    /** the receiver chain, advanced past the message */
+    olm::ReceiverChain chain;
+    /** the keys for the messages skipped over that will be kept, oldest
+     * first */
+    olm::MessageKey * skipped_keys;
+    std::size_t skipped_count;
+};
+
+
 static std::size_t verify_mac_and_decrypt_for_existing_chain(
     olm::Ratchet const & session,
-    olm::ChainKey const & chain,
+    DecryptTransaction & transaction,
     olm::MessageReader const & reader,
     std::uint8_t * plaintext, std::size_t max_plaintext_length,
     OlmErrorCode & last_error
 ) {
-    if (reader.counter < chain.index) {
+    olm::ChainKey & chain_key = transaction.chain.chain_key;
+
+    if (reader.counter < chain_key.index) {
         last_error = OlmErrorCode::OLM_ALREADY_DECRYPTED_OR_KEYS_SKIPPED;
         return std::size_t(-1);
     }
 
     /* Limit the number of hashes we're prepared to compute */
-    if (reader.counter - chain.index > MAX_MESSAGE_GAP) {
+    std::size_t gap = reader.counter - chain_key.index;
+    if (gap > MAX_MESSAGE_GAP) {
         last_error = OlmErrorCode::OLM_MAX_MESSAGE_GAP_EXCEEDED;
         return std::size_t(-1);
     }
 
-    olm::ChainKey new_chain = chain;
+    /* Only the newest of the skipped keys would survive being stored, so
+     * there is no need to create the others. */
+    std::size_t keep = std::min(gap, session.skipped_message_keys.max_size());
+    if (keep) {
+        transaction.skipped_keys = static_cast<olm::MessageKey *>(
+            std::malloc(keep * sizeof(olm::MessageKey))
+        );
+        if (!transaction.skipped_keys) {
+            last_error = OlmErrorCode::OLM_OUT_OF_MEMORY;
+            return std::size_t(-1);
+        }
+    }
 
-    while (new_chain.index < reader.counter) {
-        advance_chain_key(new_chain, new_chain);
+    while (chain_key.index < reader.counter) {
+        if (reader.counter - chain_key.index <= keep) {
+            create_message_keys_and_advance(
+                chain_key, session.kdf_info,
+                transaction.skipped_keys[transaction.skipped_count++]
+            );
+        } else {
+            advance_chain_key(chain_key, chain_key);
+        }
     }
 
     olm::MessageKey message_key;
-    create_message_keys(new_chain, session.kdf_info, message_key);
+    create_message_keys_and_advance(chain_key, session.kdf_info, message_key);
 
     std::size_t result = verify_mac_and_decrypt(
         session.ratchet_cipher, message_key, reader,
         plaintext, max_plaintext_length
     );
 
-    olm::unset(new_chain);
+    olm::unset(message_key);
     return result;
 }
 
 
 static std::size_t verify_mac_and_decrypt_for_new_chain(
     olm::Ratchet const & session,
+    DecryptTransaction & transaction,
     olm::MessageReader const & reader,
     std::uint8_t * plaintext, std::size_t max_plaintext_length,
     OlmErrorCode & last_error
 ) {
-    olm::SharedKey new_root_key;
-    olm::ReceiverChain new_chain;
-
     /* They shouldn't move to a new chain until we've sent them a message
      * acknowledging the last one */
     if (session.sender_chain.empty()) {
@@ -165,31 +262,351 @@ static std::size_t verify_mac_and_decrypt_for_new_chain(
         last_error = OlmErrorCode::OLM_MAX_MESSAGE_GAP_EXCEEDED;
         return std::size_t(-1);
     }
-    olm::load_array(new_chain.ratchet_key.public_key, reader.ratchet_key);
+
+    transaction.new_chain = true;
+    olm::load_array(transaction.chain.ratchet_key.public_key, reader.ratchet_key);
 
     create_chain_key(
         session.root_key, session.sender_chain[0].ratchet_key,
-        new_chain.ratchet_key, session.kdf_info,
-        new_root_key, new_chain.chain_key
+        transaction.chain.ratchet_key, session.kdf_info,
+        transaction.new_root_key, transaction.chain.chain_key
     );
-    std::size_t result = verify_mac_and_decrypt_for_existing_chain(
-        session, new_chain.chain_key, reader,
+    return verify_mac_and_decrypt_for_existing_chain(
+        session, transaction, reader,
         plaintext, max_plaintext_length, last_error
     );
-    olm::unset(new_root_key);
-    olm::unset(new_chain);
-    return result;
+}
+
+
+/**
+ * Copy the state derived for a verified message into the ratchet. Returns
+ * false, leaving the ratchet unchanged, if memory couldn't be allocated for
+ * it.
+ */
+static bool commit_decrypt(
+    olm::Ratchet & session,
+    olm::ReceiverChain * chain,
+    DecryptTransaction const & transaction
+) {
+    if (!session.skipped_message_keys.reserve(
+            session.skipped_message_keys.size() + transaction.skipped_count
+    )) {
+        return false;
+    }
+
+    if (transaction.new_chain) {
+        /* They have started using a new ephemeral ratchet key.
+         * We can discard our previous ephemeral ratchet key.
+         * We will generate a new key when we send the next message. */
+        chain = session.receiver_chains.insert();
+        if (!chain) {
+            return false;
+        }
+        olm::load_array(session.root_key, transaction.new_root_key);
+        olm::unset(session.sender_chain[0]);
+        session.sender_chain.erase(session.sender_chain.begin());
+        session.changes |= olm::RATCHET_CHANGED_SENDER_CHAIN;
+        session.receiver_chains_changed();
+    } else {
+        session.receiver_chain_changed(
+            chain - session.receiver_chains.begin()
+        );
+    }
+
+    *chain = transaction.chain;
+    if (transaction.skipped_count) {
+        session.changes |= olm::RATCHET_CHANGED_SKIPPED_MESSAGE_KEYS;
+    }
+
+    olm::SkippedMessageKey key;
+    key.ratchet_key = transaction.chain.ratchet_key;
+    for (std::size_t i = 0; i < transaction.skipped_count; ++i) {
+        key.message_key = transaction.skipped_keys[i];
+        session.skipped_message_keys.insert(key);
+    }
+    olm::unset(key);
+    return true;
 }
 
 } // namespace
 
 
+olm::SkippedMessageKeys::SkippedMessageKeys(
+    std::size_t max_size
+) : _slots(nullptr),
+    _capacity(0),
+    _head(0),
+    _span(0),
+    _size(0),
+    _max_size(max_size) {
+}
+
+
+olm::SkippedMessageKeys::~SkippedMessageKeys() {
+    clear();
+}
+
+
+void olm::SkippedMessageKeys::clear() {
+    if (_slots) {
+        olm::unset(_slots, _capacity * sizeof(Slot));
+        std::free(_slots);
+    }
+    _slots = nullptr;
+    _capacity = 0;
+    _head = 0;
+    _span = 0;
+    _size = 0;
+    _index.clear();
+}
+
+
+void olm::SkippedMessageKeys::index_slots() {
+    _index.clear();
+    for (std::size_t i = 0; i < _span; ++i) {
+        std::size_t position = (_head + i) % _capacity;
+        Slot const & slot = _slots[position];
+        if (slot.used) {
+            _index.insert(
+                KeyIndex::hash(slot.key.ratchet_key, slot.key.message_key.index),
+                position
+            );
+        }
+    }
+}
+
+
+bool olm::SkippedMessageKeys::resize(
+    std::size_t capacity
+) {
+    Slot * slots = static_cast<Slot *>(std::malloc(capacity * sizeof(Slot)));
+    if (!slots) {
+        return false;
+    }
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < _span; ++i) {
+        Slot const & slot = _slots[(_head + i) % _capacity];
+        if (slot.used) {
+            slots[count++] = slot;
+        }
+    }
+    std::memset(slots + count, 0, (capacity - count) * sizeof(Slot));
+    if (_slots) {
+        olm::unset(_slots, _capacity * sizeof(Slot));
+        std::free(_slots);
+    }
+    _slots = slots;
+    _capacity = capacity;
+    _head = 0;
+    _span = count;
+    index_slots();
+    return true;
+}
+
+
+void olm::SkippedMessageKeys::squeeze() {
+    /* move the keys to the start of the buffer, in order and without holes */
+    std::rotate(_slots, _slots + _head, _slots + _capacity);
+    std::size_t count = 0;
+    for (std::size_t i = 0; i < _span; ++i) {
+        if (_slots[i].used) {
+            if (i != count) {
+                _slots[count] = _slots[i];
+            }
+            ++count;
+        }
+    }
+    olm::unset(_slots + count, (_capacity - count) * sizeof(Slot));
+    _head = 0;
+    _span = _size;
+    index_slots();
+}
+
+
+void olm::SkippedMessageKeys::trim_holes() {
+    while (_span && !_slots[_head].used) {
+        _head = (_head + 1) % _capacity;
+        --_span;
+    }
+    while (_span && !_slots[(_head + _span - 1) % _capacity].used) {
+        --_span;
+    }
+}
+
+
+void olm::SkippedMessageKeys::drop_oldest() {
+    /* the oldest slot is never a hole */
+    Slot & slot = _slots[_head];
+    _index.erase(
+        KeyIndex::hash(slot.key.ratchet_key, slot.key.message_key.index), _head
+    );
+    olm::unset(slot);
+    --_size;
+    _head = (_head + 1) % _capacity;
+    --_span;
+    trim_holes();
+}
+
+
+void olm::SkippedMessageKeys::set_max_size(
+    std::size_t max_size
+) {
+    while (_size > max_size) {
+        drop_oldest();
+    }
+    _max_size = max_size;
+}
+
+
+bool olm::SkippedMessageKeys::reserve(
+    std::size_t count
+) {
+    count = std::min(count, _max_size);
+    return count <= _capacity || resize(count);
+}
+
+
+void olm::SkippedMessageKeys::insert(
+    SkippedMessageKey const & key
+) {
+    if (_max_size == 0) {
+        return;
+    }
+    if (_size == _max_size) {
+        drop_oldest();
+    }
+    if (_span == _capacity) {
+        /* Grow while the ring is at least half full of keys, up to room for
+         * twice the maximum. Otherwise squeezing out the holes frees at least
+         * half of it. */
+        std::size_t limit = 2 * _max_size;
+        if (2 * _size >= _capacity && _capacity < limit) {
+            resize(std::min(_capacity ? 2 * _capacity : 4, limit));
+        }
+        if (_span == _capacity) {
+            if (_size < _capacity) {
+                squeeze();
+            } else if (_size) {
+                /* couldn't grow the ring */
+                drop_oldest();
+            } else {
+                return;
+            }
+        }
+    }
+    std::size_t position = (_head + _span) % _capacity;
+    _slots[position].key = key;
+    _slots[position].used = true;
+    ++_span;
+    ++_size;
+    _index.insert(
+        KeyIndex::hash(key.ratchet_key, key.message_key.index), position
+    );
+}
+
+
+bool olm::SkippedMessageKeys::insert_oldest(
+    SkippedMessageKey const & key
+) {
+    if (_span == _capacity || _size == _max_size) {
+        return false;
+    }
+    _head = (_head + _capacity - 1) % _capacity;
+    _slots[_head].key = key;
+    _slots[_head].used = true;
+    ++_span;
+    ++_size;
+    _index.insert(
+        KeyIndex::hash(key.ratchet_key, key.message_key.index), _head
+    );
+    return true;
+}
+
+
+olm::SkippedMessageKey * olm::SkippedMessageKeys::find(
+    _olm_curve25519_public_key const & ratchet_key, std::uint32_t index
+) {
+    auto matches = [&](Slot const & slot) {
+        return slot.used
+            && slot.key.message_key.index == index
+            && 0 == std::memcmp(
+                slot.key.ratchet_key.public_key, ratchet_key.public_key,
+                CURVE25519_KEY_LENGTH
+            );
+    };
+
+    if (!_index.enabled()) {
+        for (std::size_t i = 0; i < _span; ++i) {
+            Slot & slot = _slots[(_head + i) % _capacity];
+            if (matches(slot)) {
+                return &slot.key;
+            }
+        }
+        return nullptr;
+    }
+
+    SkippedMessageKey * found = nullptr;
+    _index.find(
+        KeyIndex::hash(ratchet_key, index),
+        [&](std::uint32_t position) {
+            if (matches(_slots[position])) {
+                found = &_slots[position].key;
+                return true;
+            }
+            return false;
+        }
+    );
+    return found;
+}
+
+
+void olm::SkippedMessageKeys::erase(
+    SkippedMessageKey * key
+) {
+    std::size_t position = reinterpret_cast<Slot *>(key) - _slots;
+    Slot & slot = _slots[position];
+    _index.erase(
+        KeyIndex::hash(slot.key.ratchet_key, slot.key.message_key.index),
+        position
+    );
+    olm::unset(slot);
+    --_size;
+    trim_holes();
+}
+
+
 olm::Ratchet::Ratchet(
     olm::KdfInfo const & kdf_info,
     _olm_cipher const * ratchet_cipher
 ) : kdf_info(kdf_info),
     ratchet_cipher(ratchet_cipher),
-    last_error(OlmErrorCode::OLM_SUCCESS) {
+    last_error(OlmErrorCode::OLM_SUCCESS),
+    receiver_chains(MAX_RECEIVER_CHAINS),
+    skipped_message_keys(MAX_SKIPPED_MESSAGE_KEYS),
+    changes(0),
+    changed_receiver_chain(0) {
+}
+
+
+void olm::Ratchet::receiver_chain_changed(
+    std::size_t position
+) {
+    if (changes & RATCHET_CHANGED_RECEIVER_CHAINS) {
+        return;
+    }
+    if ((changes & RATCHET_CHANGED_RECEIVER_CHAIN)
+            && changed_receiver_chain != position) {
+        receiver_chains_changed();
+        return;
+    }
+    changes |= RATCHET_CHANGED_RECEIVER_CHAIN;
+    changed_receiver_chain = position;
+}
+
+
+void olm::Ratchet::receiver_chains_changed() {
+    changes &= ~RATCHET_CHANGED_RECEIVER_CHAIN;
+    changes |= RATCHET_CHANGED_RECEIVER_CHAINS;
 }
 
 
@@ -358,6 +775,57 @@ static std::uint8_t const * unpickle(
 }
 
 
+static std::size_t pickle_length(
+    const olm::SkippedMessageKeys & value
+) {
+    std::size_t length = olm::pickle_length(std::uint32_t(value.size()));
+    for (auto const & key : value) {
+        length += pickle_length(key);
+    }
+    return length;
+}
+
+
+static std::uint8_t * pickle(
+    std::uint8_t * pos,
+    const olm::SkippedMessageKeys & value
+) {
+    pos = olm::pickle(pos, std::uint32_t(value.size()));
+    for (auto const & key : value) {
+        pos = pickle(pos, key);
+    }
+    return pos;
+}
+
+
+static std::uint8_t const * unpickle(
+    std::uint8_t const * pos, std::uint8_t const * end,
+    olm::SkippedMessageKeys & value
+) {
+    std::uint32_t size;
+    pos = olm::unpickle(pos, end, size); UNPICKLE_OK(pos);
+    if (size > value.max_size()) {
+        return nullptr;
+    }
+
+    value.clear();
+    if (!value.reserve(size)) {
+        return nullptr;
+    }
+    /* the keys are pickled newest first */
+    olm::SkippedMessageKey key;
+    while (size--) {
+        pos = unpickle(pos, end, key);
+        if (!pos || !value.insert_oldest(key)) {
+            olm::unset(key);
+            return nullptr;
+        }
+    }
+    olm::unset(key);
+    return pos;
+}
+
+
 } // namespace olm
 
 
@@ -399,6 +867,131 @@ std::uint8_t const * olm::unpickle(
         std::uint32_t dummy;
         pos = unpickle(pos, end, dummy); UNPICKLE_OK(pos);
     }
+    value.changes = 0;
+    return pos;
+}
+
+
+namespace {
+
+/* The changes written to a delta. A single receiver chain is left out when the
+ * whole list of them is written, since its position may no longer be in the
+ * list. */
+static std::uint8_t delta_changes(
+    olm::Ratchet const & value
+) {
+    std::uint8_t changes = value.changes;
+    if (changes & olm::RATCHET_CHANGED_RECEIVER_CHAINS) {
+        changes &= ~olm::RATCHET_CHANGED_RECEIVER_CHAIN;
+    }
+    return changes;
+}
+
+} // namespace
+
+
+std::size_t olm::pickle_delta_length(
+    olm::Ratchet const & value
+) {
+    std::uint8_t changes = delta_changes(value);
+    std::size_t length = olm::pickle_length(changes);
+    if (changes & RATCHET_CHANGED_LIMITS) {
+        length += 2 * olm::pickle_length(std::uint32_t(0));
+    }
+    if (changes & RATCHET_CHANGED_SENDER_CHAIN) {
+        length += olm::OLM_SHARED_KEY_LENGTH;
+        length += olm::pickle_length(value.sender_chain);
+    }
+    if (changes & RATCHET_CHANGED_RECEIVER_CHAIN) {
+        length += olm::pickle_length(value.changed_receiver_chain);
+        length += pickle_length(
+            value.receiver_chains[value.changed_receiver_chain]
+        );
+    }
+    if (changes & RATCHET_CHANGED_RECEIVER_CHAINS) {
+        length += olm::pickle_length(value.receiver_chains);
+    }
+    if (changes & RATCHET_CHANGED_SKIPPED_MESSAGE_KEYS) {
+        length += pickle_length(value.skipped_message_keys);
+    }
+    return length;
+}
+
+
+std::uint8_t * olm::pickle_delta(
+    std::uint8_t * pos,
+    olm::Ratchet const & value
+) {
+    std::uint8_t changes = delta_changes(value);
+    pos = olm::pickle(pos, changes);
+    if (changes & RATCHET_CHANGED_LIMITS) {
+        pos = olm::pickle(
+            pos, std::uint32_t(value.receiver_chains.max_size())
+        );
+        pos = olm::pickle(
+            pos, std::uint32_t(value.skipped_message_keys.max_size())
+        );
+    }
+    if (changes & RATCHET_CHANGED_SENDER_CHAIN) {
+        pos = pickle(pos, value.root_key);
+        pos = pickle(pos, value.sender_chain);
+    }
+    if (changes & RATCHET_CHANGED_RECEIVER_CHAIN) {
+        pos = olm::pickle(pos, value.changed_receiver_chain);
+        pos = pickle(pos, value.receiver_chains[value.changed_receiver_chain]);
+    }
+    if (changes & RATCHET_CHANGED_RECEIVER_CHAINS) {
+        pos = pickle(pos, value.receiver_chains);
+    }
+    if (changes & RATCHET_CHANGED_SKIPPED_MESSAGE_KEYS) {
+        pos = pickle(pos, value.skipped_message_keys);
+    }
+    return pos;
+}
+
+
+std::uint8_t const * olm::unpickle_delta(
+    std::uint8_t const * pos, std::uint8_t const * end,
+    olm::Ratchet & value
+) {
+    std::uint8_t changes;
+    pos = olm::unpickle(pos, end, changes); UNPICKLE_OK(pos);
+    if (changes & RATCHET_CHANGED_LIMITS) {
+        std::uint32_t max_receiver_chains, max_skipped_message_keys;
+        pos = olm::unpickle(pos, end, max_receiver_chains); UNPICKLE_OK(pos);
+        pos = olm::unpickle(pos, end, max_skipped_message_keys); UNPICKLE_OK(pos);
+        if (max_receiver_chains < 1
+                || max_receiver_chains > MAX_RATCHET_LIST_LIMIT
+                || max_skipped_message_keys < 1
+                || max_skipped_message_keys > MAX_RATCHET_LIST_LIMIT) {
+            return nullptr;
+        }
+        value.receiver_chains.set_max_size(max_receiver_chains);
+        value.skipped_message_keys.set_max_size(max_skipped_message_keys);
+    }
+    if (changes & RATCHET_CHANGED_SENDER_CHAIN) {
+        pos = unpickle(pos, end, value.root_key); UNPICKLE_OK(pos);
+        if (!value.sender_chain.empty()) {
+            value.sender_chain.erase(value.sender_chain.begin());
+        }
+        pos = unpickle(pos, end, value.sender_chain); UNPICKLE_OK(pos);
+    }
+    if (changes & RATCHET_CHANGED_RECEIVER_CHAIN) {
+        std::uint32_t position;
+        pos = olm::unpickle(pos, end, position); UNPICKLE_OK(pos);
+        if (position >= value.receiver_chains.size()) {
+            return nullptr;
+        }
+        pos = unpickle(pos, end, value.receiver_chains[position]);
+        UNPICKLE_OK(pos);
+    }
+    if (changes & RATCHET_CHANGED_RECEIVER_CHAINS) {
+        pos = unpickle(pos, end, value.receiver_chains); UNPICKLE_OK(pos);
+    }
+    if (changes & RATCHET_CHANGED_SKIPPED_MESSAGE_KEYS) {
+        value.skipped_message_keys.clear();
+        pos = unpickle(pos, end, value.skipped_message_keys); UNPICKLE_OK(pos);
+    }
     return pos;
 }
 
@@ -428,11 +1021,12 @@ std::size_t olm::Ratchet::encrypt_random_length() const {
 std::size_t olm::Ratchet::encrypt(
     std::uint8_t const * plaintext, std::size_t plaintext_length,
     std::uint8_t const * random, std::size_t random_length,
-    std::uint8_t * output, std::size_t max_output_length
+    std::uint8_t * output, std::size_t max_output_length,
+    _olm_curve25519_key_pair const * ratchet_key
 ) {
     std::size_t output_length = encrypt_output_length(plaintext_length);
 
-    if (random_length < encrypt_random_length()) {
+    if (!ratchet_key && random_length < encrypt_random_length()) {
         last_error = OlmErrorCode::OLM_NOT_ENOUGH_RANDOM;
         return std::size_t(-1);
     }
@@ -443,7 +1037,13 @@ std::size_t olm::Ratchet::encrypt(
 
     if (sender_chain.empty()) {
         sender_chain.insert();
-        _olm_crypto_curve25519_generate_key(random, &sender_chain[0].ratchet_key);
+        if (ratchet_key) {
+            sender_chain[0].ratchet_key = *ratchet_key;
+        } else {
+            _olm_crypto_curve25519_generate_key(
+                random, &sender_chain[0].ratchet_key
+            );
+        }
         create_chain_key(
             root_key,
             sender_chain[0].ratchet_key,
@@ -454,15 +1054,15 @@ std::size_t olm::Ratchet::encrypt(
     }
 
     MessageKey keys;
-    create_message_keys(sender_chain[0].chain_key, kdf_info, keys);
-    advance_chain_key(sender_chain[0].chain_key, sender_chain[0].chain_key);
+    create_message_keys_and_advance(sender_chain[0].chain_key, kdf_info, keys);
+    changes |= RATCHET_CHANGED_SENDER_CHAIN;
 
     std::size_t ciphertext_length = ratchet_cipher->ops->encrypt_ciphertext_length(
         ratchet_cipher,
         plaintext_length
     );
     std::uint32_t counter = keys.index;
-    _olm_curve25519_public_key const & ratchet_key =
+    _olm_curve25519_public_key const & sender_key =
         sender_chain[0].ratchet_key.public_key;
 
     olm::MessageWriter writer;
@@ -473,7 +1073,7 @@ std::size_t olm::Ratchet::encrypt(
         output
     );
 
-    olm::store_array(writer.ratchet_key, ratchet_key.public_key);
+    olm::store_array(writer.ratchet_key, sender_key.public_key);
 
     ratchet_cipher->ops->encrypt(
         ratchet_cipher,
@@ -556,10 +1156,12 @@ std::size_t olm::Ratchet::decrypt(
     }
 
     std::size_t result = std::size_t(-1);
+    DecryptTransaction transaction;
 
     if (!chain) {
         result = verify_mac_and_decrypt_for_new_chain(
-            *this, reader, plaintext, max_plaintext_length, last_error
+            *this, transaction, reader,
+            plaintext, max_plaintext_length, last_error
         );
     } else if (is_sequential && reader.counter > chain->chain_key.index) {
         last_error = OlmErrorCode::OLM_MESSAGE_OUT_OF_ORDER;
@@ -567,36 +1169,32 @@ std::size_t olm::Ratchet::decrypt(
     } else if (chain->chain_key.index > reader.counter) {
         /* Chain already advanced beyond the key for this message
          * Check if the message keys are in the skipped key list. */
-        for (olm::SkippedMessageKey & skipped : skipped_message_keys) {
-            if (reader.counter == skipped.message_key.index
-                    && 0 == std::memcmp(
-                        skipped.ratchet_key.public_key, reader.ratchet_key,
-                        CURVE25519_KEY_LENGTH
-                    )
-            ) {
-                /* Found the key for this message. Check the MAC. */
-
-                result = verify_mac_and_decrypt(
-                    ratchet_cipher, skipped.message_key, reader,
-                    plaintext, max_plaintext_length
-                );
-
-                if (result != std::size_t(-1)) {
-                    /* Remove the key from the skipped keys now that we've
-                     * decoded the message it corresponds to. */
-                    olm::unset(skipped);
-                    skipped_message_keys.erase(&skipped);
-                    return result;
-                }
+        olm::SkippedMessageKey * skipped = skipped_message_keys.find(
+            chain->ratchet_key, reader.counter
+        );
+        if (skipped) {
+            /* Found the key for this message. Check the MAC. */
+
+            result = verify_mac_and_decrypt(
+                ratchet_cipher, skipped->message_key, reader,
+                plaintext, max_plaintext_length
+            );
+
+            if (result != std::size_t(-1)) {
+                /* Remove the key from the skipped keys now that we've
+                 * decoded the message it corresponds to. */
+                skipped_message_keys.erase(skipped);
+                changes |= RATCHET_CHANGED_SKIPPED_MESSAGE_KEYS;
+                return result;
             }
         }
         /* No key found for this message. */
         last_error = OlmErrorCode::OLM_ALREADY_DECRYPTED_OR_KEYS_SKIPPED;
     } else {
+        transaction.chain = *chain;
         result = verify_mac_and_decrypt_for_existing_chain(
-            *this, chain->chain_key,
-            reader, plaintext, max_plaintext_length,
-            last_error
+            *this, transaction, reader,
+            plaintext, max_plaintext_length, last_error
         );
     }
 
@@ -608,34 +1206,10 @@ std::size_t olm::Ratchet::decrypt(
         return std::size_t(-1);
     }
 
-    if (!chain) {
-        /* They have started using a new ephemeral ratchet key.
-         * We need to derive a new set of chain keys.
-         * We can discard our previous ephemeral ratchet key.
-         * We will generate a new key when we send the next message. */
-
-        chain = receiver_chains.insert();
-        olm::load_array(chain->ratchet_key.public_key, reader.ratchet_key);
-
-        // TODO: we've already done this once, in
-        // verify_mac_and_decrypt_for_new_chain(). we could reuse the result.
-        create_chain_key(
-            root_key, sender_chain[0].ratchet_key, chain->ratchet_key,
-            kdf_info, root_key, chain->chain_key
-        );
-
-        olm::unset(sender_chain[0]);
-        sender_chain.erase(sender_chain.begin());
-    }
-
-    while (chain->chain_key.index < reader.counter) {
-        olm::SkippedMessageKey & key = *skipped_message_keys.insert();
-        create_message_keys(chain->chain_key, kdf_info, key.message_key);
-        key.ratchet_key = chain->ratchet_key;
-        advance_chain_key(chain->chain_key, chain->chain_key);
+    if (!commit_decrypt(*this, chain, transaction)) {
+        last_error = OlmErrorCode::OLM_OUT_OF_MEMORY;
+        return std::size_t(-1);
     }
 
-    advance_chain_key(chain->chain_key, chain->chain_key);
-
     return result;
 }
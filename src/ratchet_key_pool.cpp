@@ -0,0 +1,78 @@
+/* Copyright 2026 Comm Technologies, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "olm/ratchet_key_pool.hh"
+#include "olm/memory.hh"
+
+#include <algorithm>
+
+olm::RatchetKeyPool::RatchetKeyPool(
+) : head(0), tail(0) {
+}
+
+
+olm::RatchetKeyPool::~RatchetKeyPool() {
+    olm::unset(keys);
+}
+
+
+std::size_t olm::RatchetKeyPool::count() const {
+    std::size_t taken = head.load(std::memory_order_acquire);
+    return tail.load(std::memory_order_acquire) - taken;
+}
+
+
+std::size_t olm::RatchetKeyPool::refill_random_length() const {
+    return (CAPACITY - count()) * CURVE25519_RANDOM_LENGTH;
+}
+
+
+std::size_t olm::RatchetKeyPool::refill(
+    std::uint8_t const * random, std::size_t random_length
+) {
+    /* Acquiring head makes sure take() has finished with the slots that are
+     * free before they are written again. */
+    std::size_t taken = head.load(std::memory_order_acquire);
+    std::size_t added = tail.load(std::memory_order_relaxed);
+    std::size_t number_of_keys = std::min(
+        CAPACITY - (added - taken), random_length / CURVE25519_RANDOM_LENGTH
+    );
+
+    /* the free slots wrap around the end of the buffer at most once */
+    std::size_t position = added % CAPACITY;
+    std::size_t first = std::min(number_of_keys, CAPACITY - position);
+    _olm_crypto_curve25519_generate_keys(random, first, keys + position);
+    _olm_crypto_curve25519_generate_keys(
+        random + first * CURVE25519_RANDOM_LENGTH,
+        number_of_keys - first, keys
+    );
+
+    tail.store(added + number_of_keys, std::memory_order_release);
+    return number_of_keys;
+}
+
+
+bool olm::RatchetKeyPool::take(
+    _olm_curve25519_key_pair & key
+) {
+    std::size_t taken = head.load(std::memory_order_relaxed);
+    if (taken == tail.load(std::memory_order_acquire)) {
+        return false;
+    }
+    _olm_curve25519_key_pair & slot = keys[taken % CAPACITY];
+    key = slot;
+    olm::unset(slot);
+    head.store(taken + 1, std::memory_order_release);
+    return true;
+}
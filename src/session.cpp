@@ -20,13 +20,12 @@
 #include "olm/message.hh"
 #include "olm/pickle.hh"
 
+#include <algorithm>
 #include <cstring>
 #include <stdio.h>
 
 namespace {
 
-static const std::uint8_t PROTOCOL_VERSION = 0x3;
-
 static const std::uint8_t ROOT_KDF_INFO[] = "OLM_ROOT";
 static const std::uint8_t RATCHET_KDF_INFO[] = "OLM_RATCHET";
 static const std::uint8_t CIPHER_KDF_INFO[] = "OLM_KEYS";
@@ -44,8 +43,15 @@ static const struct _olm_cipher_aes_sha_256 OLM_CIPHER =
 olm::Session::Session(
 ) : ratchet(OLM_KDF_INFO, OLM_CIPHER_BASE(&OLM_CIPHER)),
     last_error(OlmErrorCode::OLM_SUCCESS),
-    received_message(false) {
+    received_message(false),
+    delta_generation(0) {
+
+}
+
 
+std::size_t olm::Session::message_mac_length() {
+    _olm_cipher const * cipher = OLM_CIPHER_BASE(&OLM_CIPHER);
+    return cipher->ops->mac_length(cipher);
 }
 
 
@@ -121,10 +127,8 @@ std::size_t olm::Session::new_outbound_session(
     return std::size_t(0);
 }
 
-namespace {
-
-static bool check_message_fields(
-    olm::PreKeyMessageReader & reader, bool have_their_identity_key
+bool olm::Session::check_inbound_message_fields(
+    olm::PreKeyMessageReader const & reader, bool have_their_identity_key
 ) {
     bool ok = true;
     ok = ok && (have_their_identity_key || reader.identity_key);
@@ -139,8 +143,6 @@ static bool check_message_fields(
     return ok;
 }
 
-} // namespace
-
 
 std::size_t olm::Session::new_inbound_session(
     olm::Account & local_account,
@@ -150,7 +152,7 @@ std::size_t olm::Session::new_inbound_session(
     olm::PreKeyMessageReader reader;
     decode_one_time_key_message(reader, one_time_key_message, message_length);
 
-    if (!check_message_fields(reader, their_identity_key)) {
+    if (!check_inbound_message_fields(reader, their_identity_key)) {
         last_error = OlmErrorCode::OLM_BAD_MESSAGE_FORMAT;
         return std::size_t(-1);
     }
@@ -215,6 +217,11 @@ std::size_t olm::Session::new_inbound_session(
         using_prekey_as_otk ? our_prekey->key : our_one_time_key->key;
     _olm_curve25519_key_pair const & bob_prekey = our_prekey->key;
 
+    if (!ratchet.receiver_chains.reserve(ratchet.receiver_chains.size() + 1)) {
+        last_error = OlmErrorCode::OLM_OUT_OF_MEMORY;
+        return std::size_t(-1);
+    }
+
     // Calculate the shared secret S via triple DH
     std::uint8_t secret[CURVE25519_SHARED_SECRET_LENGTH * 4];
     std::uint8_t * pos = secret;
@@ -250,14 +257,27 @@ std::size_t olm::Session::session_id(
         last_error = OlmErrorCode::OLM_OUTPUT_BUFFER_TOO_SMALL;
         return std::size_t(-1);
     }
+    compute_session_id(
+        alice_identity_key, alice_base_key, bob_one_time_key, id
+    );
+    return session_id_length();
+}
+
+
+void olm::Session::compute_session_id(
+    _olm_curve25519_public_key const & alice_identity_key,
+    _olm_curve25519_public_key const & alice_base_key,
+    _olm_curve25519_public_key const & bob_one_time_key,
+    std::uint8_t * id
+) {
     std::uint8_t tmp[CURVE25519_KEY_LENGTH * 3];
     std::uint8_t * pos = tmp;
     pos = olm::store_array(pos, alice_identity_key.public_key);
     pos = olm::store_array(pos, alice_base_key.public_key);
     pos = olm::store_array(pos, bob_one_time_key.public_key);
-    pos = olm::store_array(pos, bob_prekey.public_key);
+    /* The prekey is deliberately not part of the ID: adding it would change
+     * the ID of every existing session. */
     _olm_crypto_sha256(tmp, sizeof(tmp), id);
-    return session_id_length();
 }
 
 
@@ -268,7 +288,7 @@ bool olm::Session::matches_inbound_session(
     olm::PreKeyMessageReader reader;
     decode_one_time_key_message(reader, one_time_key_message, message_length);
 
-    if (!check_message_fields(reader, their_identity_key)) {
+    if (!check_inbound_message_fields(reader, their_identity_key)) {
         return false;
     }
 
@@ -332,7 +352,8 @@ std::size_t olm::Session::encrypt_random_length() const {
 std::size_t olm::Session::encrypt(
     std::uint8_t const * plaintext, std::size_t plaintext_length,
     std::uint8_t const * random, std::size_t random_length,
-    std::uint8_t * message, std::size_t message_length
+    std::uint8_t * message, std::size_t message_length,
+    _olm_curve25519_key_pair const * ratchet_key
 ) {
     if (message_length < encrypt_message_length(plaintext_length)) {
         last_error = OlmErrorCode::OLM_OUTPUT_BUFFER_TOO_SMALL;
@@ -367,7 +388,8 @@ std::size_t olm::Session::encrypt(
     std::size_t result = ratchet.encrypt(
         plaintext, plaintext_length,
         random, random_length,
-        message_body, message_body_length
+        message_body, message_body_length,
+        ratchet_key
     );
 
     if (result == std::size_t(-1)) {
@@ -506,20 +528,44 @@ void olm::Session::describe(char *describe_buffer, size_t buflen) {
     size = snprintf(describe_buffer, remaining, " skipped message keys:");
     CHECK_SIZE_AND_ADVANCE;
 
-    for (size_t i = 0; i < ratchet.skipped_message_keys.size(); ++i) {
+    for (auto const & skipped : ratchet.skipped_message_keys) {
         size = snprintf(
             describe_buffer, remaining,
-            " %d", ratchet.skipped_message_keys[i].message_key.index
+            " %d", skipped.message_key.index
         );
         CHECK_SIZE_AND_ADVANCE;
     }
 #undef CHECK_SIZE_AND_ADVANCE
 }
 
+std::size_t olm::Session::set_max_skipped_message_keys(
+    std::size_t max_keys
+) {
+    max_keys = std::max<std::size_t>(max_keys, 1);
+    max_keys = std::min(max_keys, MAX_RATCHET_LIST_LIMIT);
+    ratchet.skipped_message_keys.set_max_size(max_keys);
+    ratchet.changes |= RATCHET_CHANGED_LIMITS
+        | RATCHET_CHANGED_SKIPPED_MESSAGE_KEYS;
+    return max_keys;
+}
+
+std::size_t olm::Session::set_max_receiver_chains(
+    std::size_t max_chains
+) {
+    max_chains = std::max<std::size_t>(max_chains, 1);
+    max_chains = std::min(max_chains, MAX_RATCHET_LIST_LIMIT);
+    ratchet.receiver_chains.set_max_size(max_chains);
+    ratchet.changes |= RATCHET_CHANGED_LIMITS;
+    ratchet.receiver_chains_changed();
+    return max_chains;
+}
+
 namespace {
 // the master branch writes pickle version 1; the logging_enabled branch writes
-// 0x80000001.
-static const std::uint32_t SESSION_PICKLE_VERSION = 1;
+// 0x80000001. Version 2 adds the maximum sizes of the ratchet's key lists.
+// Version 3 adds the delta generation.
+static const std::uint32_t SESSION_PICKLE_VERSION = 3;
+static const std::uint32_t SESSION_DELTA_VERSION = 1;
 }
 
 std::size_t olm::pickle_length(
@@ -532,6 +578,13 @@ std::size_t olm::pickle_length(
     length += olm::pickle_length(value.alice_base_key);
     length += olm::pickle_length(value.bob_one_time_key);
     length += olm::pickle_length(value.bob_prekey);
+    length += olm::pickle_length(
+        std::uint32_t(value.ratchet.receiver_chains.max_size())
+    );
+    length += olm::pickle_length(
+        std::uint32_t(value.ratchet.skipped_message_keys.max_size())
+    );
+    length += olm::pickle_length(value.delta_generation);
     length += olm::pickle_length(value.ratchet);
     return length;
 }
@@ -547,6 +600,13 @@ std::uint8_t * olm::pickle(
     pos = olm::pickle(pos, value.alice_base_key);
     pos = olm::pickle(pos, value.bob_one_time_key);
     pos = olm::pickle(pos, value.bob_prekey);
+    pos = olm::pickle(
+        pos, std::uint32_t(value.ratchet.receiver_chains.max_size())
+    );
+    pos = olm::pickle(
+        pos, std::uint32_t(value.ratchet.skipped_message_keys.max_size())
+    );
+    pos = olm::pickle(pos, value.delta_generation);
     pos = olm::pickle(pos, value.ratchet);
     return pos;
 }
@@ -561,6 +621,8 @@ std::uint8_t const * olm::unpickle(
 
     bool includes_chain_index;
     switch (pickle_version) {
+        case SESSION_PICKLE_VERSION:
+        case 2:
         case 1:
             includes_chain_index = false;
             break;
@@ -579,7 +641,73 @@ std::uint8_t const * olm::unpickle(
     pos = olm::unpickle(pos, end, value.alice_base_key); UNPICKLE_OK(pos);
     pos = olm::unpickle(pos, end, value.bob_one_time_key); UNPICKLE_OK(pos);
     pos = olm::unpickle(pos, end, value.bob_prekey); UNPICKLE_OK(pos);
+    value.delta_generation = 0;
+    if (pickle_version >= 2 && pickle_version <= SESSION_PICKLE_VERSION) {
+        std::uint32_t max_receiver_chains, max_skipped_message_keys;
+        pos = olm::unpickle(pos, end, max_receiver_chains); UNPICKLE_OK(pos);
+        pos = olm::unpickle(pos, end, max_skipped_message_keys); UNPICKLE_OK(pos);
+        if (max_receiver_chains < 1
+                || max_receiver_chains > MAX_RATCHET_LIST_LIMIT
+                || max_skipped_message_keys < 1
+                || max_skipped_message_keys > MAX_RATCHET_LIST_LIMIT) {
+            value.last_error = OlmErrorCode::OLM_CORRUPTED_PICKLE;
+            return nullptr;
+        }
+        value.ratchet.receiver_chains.set_max_size(max_receiver_chains);
+        value.ratchet.skipped_message_keys.set_max_size(
+            max_skipped_message_keys
+        );
+    }
+    if (pickle_version == SESSION_PICKLE_VERSION) {
+        pos = olm::unpickle(pos, end, value.delta_generation); UNPICKLE_OK(pos);
+    }
     pos = olm::unpickle(pos, end, value.ratchet, includes_chain_index); UNPICKLE_OK(pos);
 
     return pos;
 }
+
+
+std::size_t olm::pickle_delta_length(
+    Session const & value
+) {
+    std::size_t length = 0;
+    length += olm::pickle_length(SESSION_DELTA_VERSION);
+    length += olm::pickle_length(value.delta_generation);
+    length += olm::pickle_length(value.received_message);
+    length += olm::pickle_delta_length(value.ratchet);
+    return length;
+}
+
+
+std::uint8_t * olm::pickle_delta(
+    std::uint8_t * pos,
+    Session const & value
+) {
+    pos = olm::pickle(pos, SESSION_DELTA_VERSION);
+    pos = olm::pickle(pos, value.delta_generation);
+    pos = olm::pickle(pos, value.received_message);
+    pos = olm::pickle_delta(pos, value.ratchet);
+    return pos;
+}
+
+
+std::uint8_t const * olm::unpickle_delta(
+    std::uint8_t const * pos, std::uint8_t const * end,
+    Session & value
+) {
+    std::uint32_t delta_version, delta_generation;
+    pos = olm::unpickle(pos, end, delta_version); UNPICKLE_OK(pos);
+    if (delta_version != SESSION_DELTA_VERSION) {
+        value.last_error = OlmErrorCode::OLM_UNKNOWN_PICKLE_VERSION;
+        return nullptr;
+    }
+    pos = olm::unpickle(pos, end, delta_generation); UNPICKLE_OK(pos);
+    if (delta_generation != value.delta_generation) {
+        value.last_error = OlmErrorCode::OLM_DELTA_OUT_OF_ORDER;
+        return nullptr;
+    }
+    pos = olm::unpickle(pos, end, value.received_message); UNPICKLE_OK(pos);
+    pos = olm::unpickle_delta(pos, end, value.ratchet); UNPICKLE_OK(pos);
+    value.delta_generation++;
+    return pos;
+}
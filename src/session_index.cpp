@@ -0,0 +1,175 @@
+/* Copyright 2026 Comm Technologies, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+#include "olm/session_index.hh"
+#include "olm/message.hh"
+#include "olm/session.hh"
+#include "olm/memory.hh"
+
+#include <cstring>
+
+namespace {
+
+/* values in the index are positions in the entries list */
+static const std::size_t MAX_SESSIONS = 0xFFFFFFFF;
+
+} // namespace
+
+
+olm::SessionIndex::SessionIndex(
+) : last_error(OlmErrorCode::OLM_SUCCESS),
+    entries(MAX_SESSIONS) {
+}
+
+
+void olm::SessionIndex::index_sessions() {
+    index.clear();
+    for (std::size_t i = 0; i < entries.size(); ++i) {
+        index.insert(KeyIndex::hash(entries[i].id), i);
+    }
+}
+
+
+olm::SessionIndex::Entry const * olm::SessionIndex::find_entry(
+    std::uint8_t const * id, Session const * session
+) const {
+    auto matches = [&](Entry const & entry) {
+        return (!session || entry.session == session)
+            && 0 == std::memcmp(entry.id, id, sizeof(entry.id));
+    };
+
+    if (!index.enabled()) {
+        for (Entry const & entry : entries) {
+            if (matches(entry)) {
+                return &entry;
+            }
+        }
+        return nullptr;
+    }
+
+    Entry const * found = nullptr;
+    index.find(KeyIndex::hash(id), [&](std::uint32_t position) {
+        if (matches(entries[position])) {
+            found = &entries[position];
+            return true;
+        }
+        return false;
+    });
+    return found;
+}
+
+
+std::size_t olm::SessionIndex::add(
+    Session & session
+) {
+    std::uint8_t id[SHA256_OUTPUT_LENGTH];
+    session.session_id(id, sizeof(id));
+    if (find_entry(id, &session)) {
+        return 0;
+    }
+    if (entries.size() == entries.max_size()) {
+        last_error = OlmErrorCode::OLM_OUT_OF_MEMORY;
+        return std::size_t(-1);
+    }
+    Entry * entry = entries.insert(entries.end());
+    if (!entry) {
+        last_error = OlmErrorCode::OLM_OUT_OF_MEMORY;
+        return std::size_t(-1);
+    }
+    entry->session = &session;
+    olm::load_array(entry->id, id);
+    if (!index.enabled()) {
+        /* try again now that the index may fit */
+        index_sessions();
+    } else {
+        index.insert(KeyIndex::hash(id), entries.size() - 1);
+    }
+    return 0;
+}
+
+
+bool olm::SessionIndex::remove(
+    Session & session
+) {
+    std::uint8_t id[SHA256_OUTPUT_LENGTH];
+    session.session_id(id, sizeof(id));
+    Entry const * found = find_entry(id, &session);
+    if (!found) {
+        return false;
+    }
+    std::size_t position = found - entries.begin();
+    std::size_t last = entries.size() - 1;
+    index.erase(KeyIndex::hash(id), position);
+    if (position != last) {
+        /* move the last entry into the gap */
+        index.erase(KeyIndex::hash(entries[last].id), last);
+        entries[position] = entries[last];
+        index.insert(KeyIndex::hash(entries[position].id), position);
+    }
+    entries.erase(entries.begin() + last);
+    return true;
+}
+
+
+olm::Session * olm::SessionIndex::find(
+    std::uint8_t const * id
+) const {
+    Entry const * found = find_entry(id, nullptr);
+    return found ? found->session : nullptr;
+}
+
+
+std::size_t olm::SessionIndex::find_inbound(
+    _olm_curve25519_public_key const * their_identity_key,
+    std::uint8_t const * pre_key_message, std::size_t message_length,
+    Session * & session
+) {
+    session = nullptr;
+    olm::PreKeyMessageReader reader;
+    olm::peek_one_time_key_message(reader, pre_key_message, message_length);
+
+    if (reader.version != olm::PROTOCOL_VERSION) {
+        last_error = OlmErrorCode::OLM_BAD_MESSAGE_VERSION;
+        return std::size_t(-1);
+    }
+    if (!olm::Session::check_inbound_message_fields(
+            reader, their_identity_key
+    )) {
+        last_error = OlmErrorCode::OLM_BAD_MESSAGE_FORMAT;
+        return std::size_t(-1);
+    }
+
+    _olm_curve25519_public_key identity_key;
+    _olm_curve25519_public_key base_key;
+    _olm_curve25519_public_key one_time_key;
+    if (reader.identity_key) {
+        olm::load_array(identity_key.public_key, reader.identity_key);
+        if (their_identity_key && !olm::array_equal(
+                identity_key.public_key, their_identity_key->public_key
+        )) {
+            return 0;
+        }
+    } else {
+        identity_key = *their_identity_key;
+    }
+    olm::load_array(base_key.public_key, reader.base_key);
+    olm::load_array(one_time_key.public_key, reader.one_time_key);
+
+    std::uint8_t id[SHA256_OUTPUT_LENGTH];
+    olm::Session::compute_session_id(
+        identity_key, base_key, one_time_key, id
+    );
+    session = find(id);
+    return 0;
+}
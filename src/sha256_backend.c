@@ -0,0 +1,221 @@
+/* Copyright 2026 Comm Technologies, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+#include "olm/sha256_backend.h"
+#include "olm/cpu_features.h"
+
+#include <string.h>
+
+const uint32_t _olm_sha256_k[64] = {
+    0x428a2f98, 0x71374491, 0xb5c0fbcf, 0xe9b5dba5,
+    0x3956c25b, 0x59f111f1, 0x923f82a4, 0xab1c5ed5,
+    0xd807aa98, 0x12835b01, 0x243185be, 0x550c7dc3,
+    0x72be5d74, 0x80deb1fe, 0x9bdc06a7, 0xc19bf174,
+    0xe49b69c1, 0xefbe4786, 0x0fc19dc6, 0x240ca1cc,
+    0x2de92c6f, 0x4a7484aa, 0x5cb0a9dc, 0x76f988da,
+    0x983e5152, 0xa831c66d, 0xb00327c8, 0xbf597fc7,
+    0xc6e00bf3, 0xd5a79147, 0x06ca6351, 0x14292967,
+    0x27b70a85, 0x2e1b2138, 0x4d2c6dfc, 0x53380d13,
+    0x650a7354, 0x766a0abb, 0x81c2c92e, 0x92722c85,
+    0xa2bfe8a1, 0xa81a664b, 0xc24b8b70, 0xc76c51a3,
+    0xd192e819, 0xd6990624, 0xf40e3585, 0x106aa070,
+    0x19a4c116, 0x1e376c08, 0x2748774c, 0x34b0bcb5,
+    0x391c0cb3, 0x4ed8aa4a, 0x5b9cca4f, 0x682e6ff3,
+    0x748f82ee, 0x78a5636f, 0x84c87814, 0x8cc70208,
+    0x90befffa, 0xa4506ceb, 0xbef9a3f7, 0xc67178f2,
+};
+
+static const uint32_t SHA256_INITIAL_STATE[SHA256_STATE_WORDS] = {
+    0x6a09e667, 0xbb67ae85, 0x3c6ef372, 0xa54ff53a,
+    0x510e527f, 0x9b05688c, 0x1f83d9ab, 0x5be0cd19,
+};
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define CH(x, y, z) (((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+#define EP0(x) (ROTR(x, 2) ^ ROTR(x, 13) ^ ROTR(x, 22))
+#define EP1(x) (ROTR(x, 6) ^ ROTR(x, 11) ^ ROTR(x, 25))
+#define SIG0(x) (ROTR(x, 7) ^ ROTR(x, 18) ^ ((x) >> 3))
+#define SIG1(x) (ROTR(x, 17) ^ ROTR(x, 19) ^ ((x) >> 10))
+
+static uint32_t load_be32(const uint8_t * bytes) {
+    return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16)
+        | ((uint32_t)bytes[2] << 8) | (uint32_t)bytes[3];
+}
+
+static void store_be32(uint8_t * bytes, uint32_t value) {
+    bytes[0] = value >> 24;
+    bytes[1] = value >> 16;
+    bytes[2] = value >> 8;
+    bytes[3] = value;
+}
+
+/* The message schedule is kept in a 16 word ring rather than expanded up
+ * front, which keeps the working set in registers on 64-bit targets. */
+void _olm_sha256_portable_compress(
+    uint32_t * state, const uint8_t * blocks, size_t block_count
+) {
+    uint32_t w[16];
+    uint32_t a, b, c, d, e, f, g, h, t1, t2;
+    int i;
+
+    while (block_count--) {
+        for (i = 0; i < 16; ++i) {
+            w[i] = load_be32(blocks + 4 * i);
+        }
+        a = state[0]; b = state[1]; c = state[2]; d = state[3];
+        e = state[4]; f = state[5]; g = state[6]; h = state[7];
+
+        for (i = 0; i < 64; ++i) {
+            if (i >= 16) {
+                w[i & 15] += SIG1(w[(i - 2) & 15]) + w[(i - 7) & 15]
+                    + SIG0(w[(i - 15) & 15]);
+            }
+            t1 = h + EP1(e) + CH(e, f, g) + _olm_sha256_k[i] + w[i & 15];
+            t2 = EP0(a) + MAJ(a, b, c);
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+        blocks += SHA256_BLOCK_LENGTH;
+    }
+    memset(w, 0, sizeof(w));
+}
+
+void _olm_sha256_compress(
+    uint32_t * state, const uint8_t * blocks, size_t block_count
+) {
+    unsigned int features = _olm_cpu_features();
+    (void)features;
+#if defined(OLM_CPU_X86)
+    if (features & OLM_CPU_X86_SHA) {
+        _olm_sha256_x86_sha_compress(state, blocks, block_count);
+        return;
+    }
+    if (features & OLM_CPU_X86_SSSE3) {
+        _olm_sha256_x86_ssse3_compress(state, blocks, block_count);
+        return;
+    }
+#elif defined(OLM_CPU_ARM_CRYPTO_SHA2)
+    if (features & OLM_CPU_ARM_SHA2) {
+        _olm_sha256_arm_compress(state, blocks, block_count);
+        return;
+    }
+#endif
+    _olm_sha256_portable_compress(state, blocks, block_count);
+}
+
+void _olm_sha256_compress_lanes(
+    uint32_t (* states)[SHA256_STATE_WORDS],
+    const uint8_t * const * blocks, size_t lane_count
+) {
+    void (*kernel)(
+        uint32_t (* states)[SHA256_STATE_WORDS], const uint8_t * const * blocks
+    ) = NULL;
+    unsigned int features = _olm_cpu_features();
+    size_t lane;
+    (void)features;
+
+    /* with SHA instructions a block is done faster one at a time than the
+     * SIMD kernels can do four */
+#if defined(OLM_CPU_X86)
+    if ((features & OLM_CPU_X86_SSE2) && !(features & OLM_CPU_X86_SHA)) {
+        kernel = _olm_sha256_x86_compress_x4;
+    }
+#elif defined(OLM_CPU_ARM_CRYPTO_SHA2)
+    if (!(features & OLM_CPU_ARM_SHA2)) {
+        kernel = _olm_sha256_neon_compress_x4;
+    }
+#elif defined(OLM_CPU_ARM_NEON)
+    kernel = _olm_sha256_neon_compress_x4;
+#endif
+
+    if (kernel && lane_count > 1) {
+        const uint8_t * lane_blocks[SHA256_MAX_LANES];
+        uint32_t lane_states[SHA256_MAX_LANES][SHA256_STATE_WORDS];
+        for (lane = 0; lane < SHA256_MAX_LANES; ++lane) {
+            /* unused lanes repeat the first one */
+            size_t source = lane < lane_count ? lane : 0;
+            lane_blocks[lane] = blocks[source];
+            memcpy(lane_states[lane], states[source], sizeof(lane_states[lane]));
+        }
+        kernel(lane_states, lane_blocks);
+        memcpy(states, lane_states, lane_count * sizeof(lane_states[0]));
+        memset(lane_states, 0, sizeof(lane_states));
+        return;
+    }
+
+    for (lane = 0; lane < lane_count; ++lane) {
+        _olm_sha256_compress(states[lane], blocks[lane], 1);
+    }
+}
+
+void _olm_sha256_init(struct _olm_sha256_ctx * ctx) {
+    memcpy(ctx->state, SHA256_INITIAL_STATE, sizeof(ctx->state));
+    ctx->length = 0;
+}
+
+void _olm_sha256_update(
+    struct _olm_sha256_ctx * ctx,
+    const uint8_t * input, size_t input_length
+) {
+    size_t buffered = ctx->length % SHA256_BLOCK_LENGTH;
+    ctx->length += input_length;
+
+    if (buffered) {
+        size_t needed = SHA256_BLOCK_LENGTH - buffered;
+        if (input_length < needed) {
+            memcpy(ctx->buffer + buffered, input, input_length);
+            return;
+        }
+        memcpy(ctx->buffer + buffered, input, needed);
+        _olm_sha256_compress(ctx->state, ctx->buffer, 1);
+        input += needed;
+        input_length -= needed;
+    }
+
+    /* whole blocks are compressed straight from the input */
+    if (input_length >= SHA256_BLOCK_LENGTH) {
+        size_t block_count = input_length / SHA256_BLOCK_LENGTH;
+        _olm_sha256_compress(ctx->state, input, block_count);
+        input += block_count * SHA256_BLOCK_LENGTH;
+        input_length -= block_count * SHA256_BLOCK_LENGTH;
+    }
+
+    memcpy(ctx->buffer, input, input_length);
+}
+
+void _olm_sha256_final(struct _olm_sha256_ctx * ctx, uint8_t * output) {
+    size_t buffered = ctx->length % SHA256_BLOCK_LENGTH;
+    uint64_t bit_length = ctx->length * 8;
+    int i;
+
+    ctx->buffer[buffered++] = 0x80;
+    if (buffered > SHA256_BLOCK_LENGTH - 8) {
+        memset(ctx->buffer + buffered, 0, SHA256_BLOCK_LENGTH - buffered);
+        _olm_sha256_compress(ctx->state, ctx->buffer, 1);
+        buffered = 0;
+    }
+    memset(ctx->buffer + buffered, 0, SHA256_BLOCK_LENGTH - 8 - buffered);
+    store_be32(ctx->buffer + SHA256_BLOCK_LENGTH - 8, bit_length >> 32);
+    store_be32(ctx->buffer + SHA256_BLOCK_LENGTH - 4, bit_length);
+    _olm_sha256_compress(ctx->state, ctx->buffer, 1);
+
+    for (i = 0; i < SHA256_STATE_WORDS; ++i) {
+        store_be32(output + 4 * i, ctx->state[i]);
+    }
+}
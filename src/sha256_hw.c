@@ -0,0 +1,386 @@
+/* Copyright 2026 Comm Technologies, Inc.
+ *
+ * Licensed under the Apache License, Version 2.0 (the "License");
+ * you may not use this file except in compliance with the License.
+ * You may obtain a copy of the License at
+ *
+ *     http://www.apache.org/licenses/LICENSE-2.0
+ *
+ * Unless required by applicable law or agreed to in writing, software
+ * distributed under the License is distributed on an "AS IS" BASIS,
+ * WITHOUT WARRANTIES OR CONDITIONS OF ANY KIND, either express or implied.
+ * See the License for the specific language governing permissions and
+ * limitations under the License.
+ */
+
+/* SHA-256 compression using the SHA extensions on x86 and ARMv8, and an SSSE3
+ * message schedule for x86 machines without them. Also four-lane SSE2 and NEON
+ * kernels that compress independent blocks side by side. Only called after
+ * the CPU has been checked for support, see sha256_backend.c.
+ */
+
+#include "olm/sha256_backend.h"
+#include "olm/cpu_features.h"
+
+#if defined(OLM_CPU_X86)
+
+#include <immintrin.h>
+
+#define OLM_TARGET_SHA __attribute__((target("sha,sse4.1")))
+#define OLM_TARGET_SSSE3 __attribute__((target("ssse3")))
+
+OLM_TARGET_SHA
+void _olm_sha256_x86_sha_compress(
+    uint32_t * state, const uint8_t * blocks, size_t block_count
+) {
+    const __m128i byte_swap = _mm_set_epi64x(
+        0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL
+    );
+    __m128i state0, state1, tmp, message, saved0, saved1;
+    __m128i w[4];
+    int group;
+
+    /* SHA256RNDS2 wants the state as ABEF and CDGH */
+    tmp = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)state), 0xB1);
+    state1 = _mm_shuffle_epi32(
+        _mm_loadu_si128((const __m128i *)(state + 4)), 0x1B
+    );
+    state0 = _mm_alignr_epi8(tmp, state1, 8);
+    state1 = _mm_blend_epi16(state1, tmp, 0xF0);
+
+    while (block_count--) {
+        saved0 = state0;
+        saved1 = state1;
+
+        /* each group does four rounds, while the schedule for the following
+         * groups is computed from the last four words */
+        for (group = 0; group < 16; ++group) {
+            if (group < 4) {
+                w[group] = _mm_shuffle_epi8(
+                    _mm_loadu_si128((const __m128i *)blocks + group),
+                    byte_swap
+                );
+            }
+            message = _mm_add_epi32(
+                w[group & 3],
+                _mm_loadu_si128((const __m128i *)(_olm_sha256_k + 4 * group))
+            );
+            state1 = _mm_sha256rnds2_epu32(state1, state0, message);
+            if (group >= 3 && group < 15) {
+                tmp = _mm_alignr_epi8(w[group & 3], w[(group + 3) & 3], 4);
+                w[(group + 1) & 3] = _mm_sha256msg2_epu32(
+                    _mm_add_epi32(w[(group + 1) & 3], tmp), w[group & 3]
+                );
+            }
+            message = _mm_shuffle_epi32(message, 0x0E);
+            state0 = _mm_sha256rnds2_epu32(state0, state1, message);
+            if (group >= 1 && group < 13) {
+                w[(group + 3) & 3] = _mm_sha256msg1_epu32(
+                    w[(group + 3) & 3], w[group & 3]
+                );
+            }
+        }
+
+        state0 = _mm_add_epi32(state0, saved0);
+        state1 = _mm_add_epi32(state1, saved1);
+        blocks += SHA256_BLOCK_LENGTH;
+    }
+
+    tmp = _mm_shuffle_epi32(state0, 0x1B);
+    state1 = _mm_shuffle_epi32(state1, 0xB1);
+    state0 = _mm_blend_epi16(tmp, state1, 0xF0);
+    state1 = _mm_alignr_epi8(state1, tmp, 8);
+    _mm_storeu_si128((__m128i *)state, state0);
+    _mm_storeu_si128((__m128i *)(state + 4), state1);
+}
+
+
+#define ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+#define CH(x, y, z) (((x) & (y)) ^ (~(x) & (z)))
+#define MAJ(x, y, z) (((x) & (y)) ^ ((x) & (z)) ^ ((y) & (z)))
+#define EP0(x) (ROTR(x, 2) ^ ROTR(x, 13) ^ ROTR(x, 22))
+#define EP1(x) (ROTR(x, 6) ^ ROTR(x, 11) ^ ROTR(x, 25))
+
+#define ROTR_X4(x, n) \
+    _mm_or_si128(_mm_srli_epi32(x, n), _mm_slli_epi32(x, 32 - (n)))
+
+OLM_TARGET_SSSE3
+static __m128i sig0_x4(__m128i x) {
+    return _mm_xor_si128(
+        _mm_xor_si128(ROTR_X4(x, 7), ROTR_X4(x, 18)), _mm_srli_epi32(x, 3)
+    );
+}
+
+OLM_TARGET_SSSE3
+static __m128i sig1_x4(__m128i x) {
+    return _mm_xor_si128(
+        _mm_xor_si128(ROTR_X4(x, 17), ROTR_X4(x, 19)), _mm_srli_epi32(x, 10)
+    );
+}
+
+/* Computes the message schedule four words at a time, and adds the round
+ * constants in the same pass. The rounds themselves stay scalar. */
+OLM_TARGET_SSSE3
+void _olm_sha256_x86_ssse3_compress(
+    uint32_t * state, const uint8_t * blocks, size_t block_count
+) {
+    const __m128i byte_swap = _mm_set_epi64x(
+        0x0c0d0e0f08090a0bULL, 0x0405060700010203ULL
+    );
+    uint32_t wk[64];
+    __m128i w[4];
+    uint32_t a, b, c, d, e, f, g, h, t1, t2;
+    int i;
+
+    while (block_count--) {
+        for (i = 0; i < 4; ++i) {
+            w[i] = _mm_shuffle_epi8(
+                _mm_loadu_si128((const __m128i *)blocks + i), byte_swap
+            );
+        }
+        for (i = 0; i < 16; ++i) {
+            __m128i next;
+            _mm_storeu_si128(
+                (__m128i *)(wk + 4 * i),
+                _mm_add_epi32(
+                    w[i & 3],
+                    _mm_loadu_si128((const __m128i *)(_olm_sha256_k + 4 * i))
+                )
+            );
+            if (i >= 12) {
+                continue;
+            }
+            /* w[t..t+3] from w[t-16..t-1], which are w[i & 3] to
+             * w[(i + 3) & 3]. SIG1 needs w[t] and w[t+1] for the upper
+             * two words, so it is applied in two halves. */
+            next = _mm_add_epi32(
+                _mm_add_epi32(
+                    w[i & 3],
+                    sig0_x4(_mm_alignr_epi8(w[(i + 1) & 3], w[i & 3], 4))
+                ),
+                _mm_alignr_epi8(w[(i + 3) & 3], w[(i + 2) & 3], 4)
+            );
+            next = _mm_add_epi32(
+                next, sig1_x4(_mm_srli_si128(w[(i + 3) & 3], 8))
+            );
+            next = _mm_add_epi32(next, sig1_x4(_mm_slli_si128(next, 8)));
+            w[i & 3] = next;
+        }
+
+        a = state[0]; b = state[1]; c = state[2]; d = state[3];
+        e = state[4]; f = state[5]; g = state[6]; h = state[7];
+        for (i = 0; i < 64; ++i) {
+            t1 = h + EP1(e) + CH(e, f, g) + wk[i];
+            t2 = EP0(a) + MAJ(a, b, c);
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+        state[0] += a; state[1] += b; state[2] += c; state[3] += d;
+        state[4] += e; state[5] += f; state[6] += g; state[7] += h;
+        blocks += SHA256_BLOCK_LENGTH;
+    }
+    for (i = 0; i < 64; ++i) {
+        wk[i] = 0;
+    }
+}
+
+
+#define OLM_TARGET_SSE2 __attribute__((target("sse2")))
+
+#define CH_X4(x, y, z) \
+    _mm_xor_si128(_mm_and_si128(x, y), _mm_andnot_si128(x, z))
+#define MAJ_X4(x, y, z) \
+    _mm_or_si128(_mm_and_si128(x, y), _mm_and_si128(z, _mm_or_si128(x, y)))
+#define EP0_X4(x) \
+    _mm_xor_si128(_mm_xor_si128(ROTR_X4(x, 2), ROTR_X4(x, 13)), ROTR_X4(x, 22))
+#define EP1_X4(x) \
+    _mm_xor_si128(_mm_xor_si128(ROTR_X4(x, 6), ROTR_X4(x, 11)), ROTR_X4(x, 25))
+#define SIG0_X4(x) _mm_xor_si128( \
+    _mm_xor_si128(ROTR_X4(x, 7), ROTR_X4(x, 18)), _mm_srli_epi32(x, 3))
+#define SIG1_X4(x) _mm_xor_si128( \
+    _mm_xor_si128(ROTR_X4(x, 17), ROTR_X4(x, 19)), _mm_srli_epi32(x, 10))
+
+static uint32_t load_be32(const uint8_t * bytes) {
+    return ((uint32_t)bytes[0] << 24) | ((uint32_t)bytes[1] << 16)
+        | ((uint32_t)bytes[2] << 8) | (uint32_t)bytes[3];
+}
+
+/* Four independent compressions, one in each 32-bit lane. */
+OLM_TARGET_SSE2
+void _olm_sha256_x86_compress_x4(
+    uint32_t (* states)[SHA256_STATE_WORDS], const uint8_t * const * blocks
+) {
+    __m128i v[SHA256_STATE_WORDS];
+    __m128i w[16];
+    __m128i a, b, c, d, e, f, g, h, t1, t2;
+    uint32_t lanes[4];
+    int i, lane;
+
+    for (i = 0; i < SHA256_STATE_WORDS; ++i) {
+        v[i] = _mm_set_epi32(
+            states[3][i], states[2][i], states[1][i], states[0][i]
+        );
+    }
+    for (i = 0; i < 16; ++i) {
+        w[i] = _mm_set_epi32(
+            load_be32(blocks[3] + 4 * i), load_be32(blocks[2] + 4 * i),
+            load_be32(blocks[1] + 4 * i), load_be32(blocks[0] + 4 * i)
+        );
+    }
+
+    a = v[0]; b = v[1]; c = v[2]; d = v[3];
+    e = v[4]; f = v[5]; g = v[6]; h = v[7];
+    for (i = 0; i < 64; ++i) {
+        if (i >= 16) {
+            w[i & 15] = _mm_add_epi32(
+                _mm_add_epi32(w[i & 15], SIG1_X4(w[(i - 2) & 15])),
+                _mm_add_epi32(w[(i - 7) & 15], SIG0_X4(w[(i - 15) & 15]))
+            );
+        }
+        t1 = _mm_add_epi32(
+            _mm_add_epi32(h, EP1_X4(e)),
+            _mm_add_epi32(
+                CH_X4(e, f, g),
+                _mm_add_epi32(_mm_set1_epi32(_olm_sha256_k[i]), w[i & 15])
+            )
+        );
+        t2 = _mm_add_epi32(EP0_X4(a), MAJ_X4(a, b, c));
+        h = g; g = f; f = e; e = _mm_add_epi32(d, t1);
+        d = c; c = b; b = a; a = _mm_add_epi32(t1, t2);
+    }
+    v[0] = _mm_add_epi32(v[0], a); v[1] = _mm_add_epi32(v[1], b);
+    v[2] = _mm_add_epi32(v[2], c); v[3] = _mm_add_epi32(v[3], d);
+    v[4] = _mm_add_epi32(v[4], e); v[5] = _mm_add_epi32(v[5], f);
+    v[6] = _mm_add_epi32(v[6], g); v[7] = _mm_add_epi32(v[7], h);
+
+    for (i = 0; i < SHA256_STATE_WORDS; ++i) {
+        _mm_storeu_si128((__m128i *)lanes, v[i]);
+        for (lane = 0; lane < 4; ++lane) {
+            states[lane][i] = lanes[lane];
+        }
+    }
+}
+
+#elif defined(OLM_CPU_ARM_NEON)
+
+#include <arm_neon.h>
+
+#define ROTR_X4(x, n) vsriq_n_u32(vshlq_n_u32(x, 32 - (n)), x, n)
+#define EP0_X4(x) veorq_u32(veorq_u32(ROTR_X4(x, 2), ROTR_X4(x, 13)), ROTR_X4(x, 22))
+#define EP1_X4(x) veorq_u32(veorq_u32(ROTR_X4(x, 6), ROTR_X4(x, 11)), ROTR_X4(x, 25))
+#define SIG0_X4(x) veorq_u32(veorq_u32(ROTR_X4(x, 7), ROTR_X4(x, 18)), vshrq_n_u32(x, 3))
+#define SIG1_X4(x) veorq_u32(veorq_u32(ROTR_X4(x, 17), ROTR_X4(x, 19)), vshrq_n_u32(x, 10))
+/* CH picks f where e is set, MAJ picks c where a and b differ */
+#define CH_X4(x, y, z) vbslq_u32(x, y, z)
+#define MAJ_X4(x, y, z) vbslq_u32(veorq_u32(x, y), z, y)
+
+/* Four independent compressions, one in each 32-bit lane. */
+void _olm_sha256_neon_compress_x4(
+    uint32_t (* states)[SHA256_STATE_WORDS], const uint8_t * const * blocks
+) {
+    uint32x4_t v[SHA256_STATE_WORDS];
+    uint32x4_t w[16];
+    uint32x4_t a, b, c, d, e, f, g, h, t1, t2;
+    uint32_t lanes[4];
+    int i, lane;
+
+    for (i = 0; i < SHA256_STATE_WORDS; ++i) {
+        for (lane = 0; lane < 4; ++lane) {
+            lanes[lane] = states[lane][i];
+        }
+        v[i] = vld1q_u32(lanes);
+    }
+    for (i = 0; i < 16; ++i) {
+        for (lane = 0; lane < 4; ++lane) {
+            const uint8_t * bytes = blocks[lane] + 4 * i;
+            lanes[lane] = ((uint32_t)bytes[0] << 24)
+                | ((uint32_t)bytes[1] << 16)
+                | ((uint32_t)bytes[2] << 8) | (uint32_t)bytes[3];
+        }
+        w[i] = vld1q_u32(lanes);
+    }
+
+    a = v[0]; b = v[1]; c = v[2]; d = v[3];
+    e = v[4]; f = v[5]; g = v[6]; h = v[7];
+    for (i = 0; i < 64; ++i) {
+        if (i >= 16) {
+            w[i & 15] = vaddq_u32(
+                vaddq_u32(w[i & 15], SIG1_X4(w[(i - 2) & 15])),
+                vaddq_u32(w[(i - 7) & 15], SIG0_X4(w[(i - 15) & 15]))
+            );
+        }
+        t1 = vaddq_u32(
+            vaddq_u32(h, EP1_X4(e)),
+            vaddq_u32(
+                CH_X4(e, f, g),
+                vaddq_u32(vdupq_n_u32(_olm_sha256_k[i]), w[i & 15])
+            )
+        );
+        t2 = vaddq_u32(EP0_X4(a), MAJ_X4(a, b, c));
+        h = g; g = f; f = e; e = vaddq_u32(d, t1);
+        d = c; c = b; b = a; a = vaddq_u32(t1, t2);
+    }
+    v[0] = vaddq_u32(v[0], a); v[1] = vaddq_u32(v[1], b);
+    v[2] = vaddq_u32(v[2], c); v[3] = vaddq_u32(v[3], d);
+    v[4] = vaddq_u32(v[4], e); v[5] = vaddq_u32(v[5], f);
+    v[6] = vaddq_u32(v[6], g); v[7] = vaddq_u32(v[7], h);
+
+    for (i = 0; i < SHA256_STATE_WORDS; ++i) {
+        vst1q_u32(lanes, v[i]);
+        for (lane = 0; lane < 4; ++lane) {
+            states[lane][i] = lanes[lane];
+        }
+    }
+}
+
+#if defined(OLM_CPU_ARM_CRYPTO_SHA2)
+
+void _olm_sha256_arm_compress(
+    uint32_t * state, const uint8_t * blocks, size_t block_count
+) {
+    uint32x4_t state0 = vld1q_u32(state);
+    uint32x4_t state1 = vld1q_u32(state + 4);
+    uint32x4_t saved0, saved1, message, tmp;
+    uint32x4_t w[4];
+    int group;
+
+    while (block_count--) {
+        saved0 = state0;
+        saved1 = state1;
+        for (group = 0; group < 4; ++group) {
+            w[group] = vreinterpretq_u32_u8(
+                vrev32q_u8(vld1q_u8(blocks + 16 * group))
+            );
+        }
+
+        for (group = 0; group < 16; ++group) {
+            message = vaddq_u32(
+                w[group & 3], vld1q_u32(_olm_sha256_k + 4 * group)
+            );
+            if (group < 12) {
+                w[group & 3] = vsha256su0q_u32(
+                    w[group & 3], w[(group + 1) & 3]
+                );
+            }
+            tmp = state0;
+            state0 = vsha256hq_u32(state0, state1, message);
+            state1 = vsha256h2q_u32(state1, tmp, message);
+            if (group < 12) {
+                w[group & 3] = vsha256su1q_u32(
+                    w[group & 3], w[(group + 2) & 3], w[(group + 3) & 3]
+                );
+            }
+        }
+
+        state0 = vaddq_u32(state0, saved0);
+        state1 = vaddq_u32(state1, saved1);
+        blocks += SHA256_BLOCK_LENGTH;
+    }
+
+    vst1q_u32(state, state0);
+    vst1q_u32(state + 4, state1);
+}
+
+#endif /* OLM_CPU_ARM_CRYPTO_SHA2 */
+
+#endif
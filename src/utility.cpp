@@ -55,3 +55,44 @@ size_t olm::Utility::ed25519_verify(
     }
     return std::size_t(0);
 }
+
+
+std::size_t olm::Utility::ed25519_verify_batch(
+    _olm_ed25519_public_key const * keys,
+    std::uint8_t const * const * messages,
+    std::size_t const * message_lengths,
+    std::uint8_t const * const * signatures,
+    std::size_t const * signature_lengths,
+    std::size_t count, std::uint8_t const * random,
+    int * results
+) {
+    /* signatures that are too short are left out of the batch, so each run
+     * of signatures between them is checked together */
+    bool all_valid = true;
+    std::size_t start = 0;
+    while (start < count) {
+        if (signature_lengths[start] < ED25519_SIGNATURE_LENGTH) {
+            results[start++] = 0;
+            all_valid = false;
+            continue;
+        }
+        std::size_t end = start + 1;
+        while (end < count && signature_lengths[end] >= ED25519_SIGNATURE_LENGTH) {
+            ++end;
+        }
+        if (!_olm_crypto_ed25519_verify_batch(
+            keys + start, messages + start, message_lengths + start,
+            signatures + start, end - start,
+            random + start * ED25519_BATCH_RANDOM_LENGTH, results + start
+        )) {
+            all_valid = false;
+        }
+        start = end;
+    }
+
+    if (!all_valid) {
+        last_error = OlmErrorCode::OLM_BAD_MESSAGE_MAC;
+        return std::size_t(-1);
+    }
+    return std::size_t(0);
+}
@@ -1,5 +1,6 @@
 #include "olm/base64.hh"
 #include "olm/base64.h"
+#include "olm/cpu_features.h"
 #include <cstring>
 #include <vector>
 #include <array>
@@ -83,3 +84,69 @@ REQUIRE_EQ(std::size_t(-1), output_length);
 CHECK_EQ(output, expected_output);
 }
 
+
+TEST_CASE("Base64 vectorised codecs match the portable ones") {
+std::vector<std::uint8_t> input(300);
+for (std::size_t i = 0; i < input.size(); ++i) {
+    input[i] = i * 37 + (i >> 3);
+}
+
+/* each of the x86 codecs, as AVX2 finishes with SSSE3 */
+for (unsigned int features : {~0u, unsigned(OLM_CPU_X86_SSSE3)}) {
+    for (std::size_t length = 0; length <= input.size(); ++length) {
+        std::size_t encoded_length = olm::encode_base64_length(length);
+        std::vector<std::uint8_t> expected(encoded_length);
+        std::vector<std::uint8_t> actual(encoded_length);
+
+        _olm_cpu_restrict_features(0);
+        olm::encode_base64(input.data(), length, expected.data());
+        _olm_cpu_restrict_features(features);
+        olm::encode_base64(input.data(), length, actual.data());
+        CHECK_EQ(expected, actual);
+
+        /* in place, with the input at the end of the output */
+        std::memcpy(actual.data() + encoded_length - length, input.data(), length);
+        olm::encode_base64(
+            actual.data() + encoded_length - length, length, actual.data()
+        );
+        CHECK_EQ(expected, actual);
+
+        std::vector<std::uint8_t> decoded(length);
+        CHECK_EQ(length, olm::decode_base64(
+            expected.data(), encoded_length, decoded.data()
+        ));
+        CHECK_EQ_SIZE(input.data(), decoded.data(), length);
+
+        CHECK_EQ(length, olm::decode_base64(
+            actual.data(), encoded_length, actual.data()
+        ));
+        CHECK_EQ_SIZE(input.data(), actual.data(), length);
+    }
+}
+_olm_cpu_restrict_features(~0u);
+}
+
+TEST_CASE("Base64 vectorised decoding of invalid characters") {
+std::vector<std::uint8_t> input(200);
+for (std::size_t i = 0; i < input.size(); ++i) {
+    input[i] = i * 11;
+}
+std::vector<std::uint8_t> encoded(olm::encode_base64_length(input.size()));
+olm::encode_base64(input.data(), input.size(), encoded.data());
+
+/* the output is the same whichever decoder handles the bad character */
+for (std::uint8_t bad : {'=', '-', '_', ' ', '\0', '\x80', '\xAB', '\xFF'}) {
+    for (std::size_t position = 0; position < encoded.size(); position += 7) {
+        std::vector<std::uint8_t> corrupted(encoded);
+        corrupted[position] = bad;
+        std::vector<std::uint8_t> expected(input.size());
+        std::vector<std::uint8_t> actual(input.size());
+
+        _olm_cpu_restrict_features(0);
+        olm::decode_base64(corrupted.data(), corrupted.size(), expected.data());
+        _olm_cpu_restrict_features(~0u);
+        olm::decode_base64(corrupted.data(), corrupted.size(), actual.data());
+        CHECK_EQ(expected, actual);
+    }
+}
+}
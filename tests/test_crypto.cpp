@@ -13,9 +13,14 @@
  * limitations under the License.
  */
 #include "olm/crypto.h"
+#include "olm/cpu_features.h"
+#include "olm/curve25519_backend.h"
 
 #include "testing.hh"
 
+#include <cstring>
+#include <vector>
+
 
 /* Curve25529 Test Case 1 */
 
@@ -80,6 +85,85 @@ CHECK_EQ_SIZE(expected_agreement, actual_agreement, 32);
 
 } /* Curve25529 Test Case 1 */
 
+TEST_CASE("Curve25529 Test Case 2") {
+
+/* the 64-bit build agrees with the 32-bit one, including for points that are
+ * not reduced mod p */
+std::uint8_t secret[32];
+std::uint8_t point[32];
+std::uint8_t expected[32];
+std::uint8_t actual[32];
+
+for (unsigned i = 0; i < 32; ++i) {
+    secret[i] = i * 29 + 3;
+    point[i] = i * 17 + 9;
+}
+for (unsigned round = 0; round < 8; ++round) {
+    _olm_curve25519_donna32(expected, secret, point);
+#if defined(OLM_CURVE25519_C64)
+    _olm_curve25519_donna64(actual, secret, point);
+#else
+    _olm_curve25519_donna32(actual, secret, point);
+#endif
+    CHECK_EQ_SIZE(expected, actual, 32);
+    std::memcpy(point, expected, 32);
+    secret[round] ^= 0xff;
+}
+std::memset(point, 0xff, 32);
+_olm_curve25519_donna32(expected, secret, point);
+_olm_curve25519_scalarmult(actual, secret, point);
+CHECK_EQ_SIZE(expected, actual, 32);
+
+} /* Curve25529 Test Case 2 */
+
+
+TEST_CASE("Curve25529 Test Case 3") {
+
+/* key generation uses the Ed25519 fixed-base tables, which must give the same
+ * public key as the ladder with the base point */
+std::uint8_t base_point[32] = {9};
+std::uint8_t random[32];
+std::uint8_t expected[32];
+
+for (unsigned i = 0; i < 32; ++i) {
+    random[i] = i * 41 + 7;
+}
+for (unsigned round = 0; round < 16; ++round) {
+    _olm_curve25519_key_pair key_pair;
+    _olm_crypto_curve25519_generate_key(random, &key_pair);
+    _olm_curve25519_scalarmult(expected, random, base_point);
+    CHECK_EQ_SIZE(expected, key_pair.public_key.public_key, 32);
+    random[round] ^= 0xff;
+    random[31 - round] += round;
+}
+
+} /* Curve25529 Test Case 3 */
+
+
+TEST_CASE("Curve25529 Test Case 4") {
+
+/* generating keys together shares the inversions, and spans more than one
+ * batch here */
+std::uint8_t random[40 * 32];
+_olm_curve25519_key_pair key_pairs[40];
+
+for (unsigned i = 0; i < sizeof(random); ++i) {
+    random[i] = i * 13 + (i >> 5);
+}
+_olm_crypto_curve25519_generate_keys(random, 40, key_pairs);
+for (unsigned i = 0; i < 40; ++i) {
+    _olm_curve25519_key_pair expected;
+    _olm_crypto_curve25519_generate_key(random + 32 * i, &expected);
+    CHECK_EQ_SIZE(
+        expected.private_key.private_key, key_pairs[i].private_key.private_key, 32
+    );
+    CHECK_EQ_SIZE(
+        expected.public_key.public_key, key_pairs[i].public_key.public_key, 32
+    );
+}
+
+} /* Curve25529 Test Case 4 */
+
 
 TEST_CASE("Ed25519 Signature Test Case 1") {
 std::uint8_t private_key[33] = "This key is a string of 32 bytes";
@@ -107,6 +191,87 @@ result = _olm_crypto_ed25519_verify(
 CHECK(!result);
 }
 
+TEST_CASE("Ed25519 Signature Test Case 2") {
+std::uint8_t private_key[33] = "This key is a string of 32 bytes";
+
+std::uint8_t message[] = "Hello, World";
+std::size_t message_length = sizeof(message) - 1;
+
+_olm_ed25519_key_pair key_pair;
+_olm_crypto_ed25519_generate_key(private_key, &key_pair);
+
+std::uint8_t signature[64];
+_olm_crypto_ed25519_sign(
+    &key_pair, message, message_length, signature
+);
+
+_olm_ed25519_prepared_key prepared;
+CHECK(_olm_crypto_ed25519_prepare_key(&key_pair.public_key, &prepared));
+
+/* the prepared key can be used repeatedly */
+for (int i = 0; i < 2; ++i) {
+    CHECK(_olm_crypto_ed25519_verify_prepared(
+        &prepared, message, message_length, signature
+    ));
+}
+
+message[0] = 'n';
+CHECK(!_olm_crypto_ed25519_verify_prepared(
+    &prepared, message, message_length, signature
+));
+
+/* a y coordinate with no matching point */
+_olm_ed25519_public_key bad_key = {{2}};
+CHECK(!_olm_crypto_ed25519_prepare_key(&bad_key, &prepared));
+}
+
+TEST_CASE("Ed25519 Signature Test Case 3") {
+/* more than one chunk of signatures, from different keys */
+const std::size_t count = 21;
+_olm_ed25519_public_key keys[count];
+std::uint8_t messages[count][16];
+std::uint8_t signatures[count][64];
+std::uint8_t const * message_ptrs[count];
+std::size_t message_lengths[count];
+std::uint8_t const * signature_ptrs[count];
+std::uint8_t random[count * ED25519_BATCH_RANDOM_LENGTH];
+int valid[count];
+
+for (std::size_t i = 0; i < count; ++i) {
+    std::uint8_t seed[32];
+    std::memset(seed, int(i), sizeof(seed));
+    _olm_ed25519_key_pair key_pair;
+    _olm_crypto_ed25519_generate_key(seed, &key_pair);
+    keys[i] = key_pair.public_key;
+    std::memset(messages[i], int(i * 3), sizeof(messages[i]));
+    _olm_crypto_ed25519_sign(
+        &key_pair, messages[i], i % sizeof(messages[i]), signatures[i]
+    );
+    message_ptrs[i] = messages[i];
+    message_lengths[i] = i % sizeof(messages[i]);
+    signature_ptrs[i] = signatures[i];
+}
+for (std::size_t i = 0; i < sizeof(random); ++i) random[i] = i * 13;
+
+CHECK(_olm_crypto_ed25519_verify_batch(
+    keys, message_ptrs, message_lengths, signature_ptrs, count, random, valid
+));
+for (std::size_t i = 0; i < count; ++i) {
+    CHECK(valid[i]);
+}
+
+/* a bad signature only fails its own entry */
+signatures[3][40] ^= 1;
+/* and so does one signed by someone else */
+keys[17] = keys[16];
+CHECK(!_olm_crypto_ed25519_verify_batch(
+    keys, message_ptrs, message_lengths, signature_ptrs, count, random, valid
+));
+for (std::size_t i = 0; i < count; ++i) {
+    CHECK_EQ(i != 3 && i != 17, valid[i] != 0);
+}
+}
+
 
 /* AES Test Case 1 */
 
@@ -139,6 +304,122 @@ CHECK_EQ_SIZE(input, actual, length);
 } /* AES Test Case 1 */
 
 
+/* AES Test Case 2: NIST SP 800-38A F.2.5, on every available backend */
+
+TEST_CASE("AES Test Case 2") {
+
+_olm_aes256_key key = {{
+    0x60, 0x3D, 0xEB, 0x10, 0x15, 0xCA, 0x71, 0xBE,
+    0x2B, 0x73, 0xAE, 0xF0, 0x85, 0x7D, 0x77, 0x81,
+    0x1F, 0x35, 0x2C, 0x07, 0x3B, 0x61, 0x08, 0xD7,
+    0x2D, 0x98, 0x10, 0xA3, 0x09, 0x14, 0xDF, 0xF4
+}};
+_olm_aes256_iv iv = {{
+    0x00, 0x01, 0x02, 0x03, 0x04, 0x05, 0x06, 0x07,
+    0x08, 0x09, 0x0A, 0x0B, 0x0C, 0x0D, 0x0E, 0x0F
+}};
+std::uint8_t input[64] = {
+    0x6B, 0xC1, 0xBE, 0xE2, 0x2E, 0x40, 0x9F, 0x96,
+    0xE9, 0x3D, 0x7E, 0x11, 0x73, 0x93, 0x17, 0x2A,
+    0xAE, 0x2D, 0x8A, 0x57, 0x1E, 0x03, 0xAC, 0x9C,
+    0x9E, 0xB7, 0x6F, 0xAC, 0x45, 0xAF, 0x8E, 0x51,
+    0x30, 0xC8, 0x1C, 0x46, 0xA3, 0x5C, 0xE4, 0x11,
+    0xE5, 0xFB, 0xC1, 0x19, 0x1A, 0x0A, 0x52, 0xEF,
+    0xF6, 0x9F, 0x24, 0x45, 0xDF, 0x4F, 0x9B, 0x17,
+    0xAD, 0x2B, 0x41, 0x7B, 0xE6, 0x6C, 0x37, 0x10
+};
+std::uint8_t expected[64] = {
+    0xF5, 0x8C, 0x4C, 0x04, 0xD6, 0xE5, 0xF1, 0xBA,
+    0x77, 0x9E, 0xAB, 0xFB, 0x5F, 0x7B, 0xFB, 0xD6,
+    0x9C, 0xFC, 0x4E, 0x96, 0x7E, 0xDB, 0x80, 0x8D,
+    0x67, 0x9F, 0x77, 0x7B, 0xC6, 0x70, 0x2C, 0x7D,
+    0x39, 0xF2, 0x33, 0x69, 0xA9, 0xD9, 0xBA, 0xCF,
+    0xA5, 0x30, 0xE2, 0x63, 0x04, 0x23, 0x14, 0x61,
+    0xB2, 0xEB, 0x05, 0xE2, 0xC3, 0x9B, 0xE9, 0xFC,
+    0xDA, 0x6C, 0x19, 0x07, 0x8C, 0x6A, 0x9D, 0x1B
+};
+
+for (unsigned int features : {~0u, 0u}) {
+    _olm_cpu_restrict_features(features);
+
+    std::uint8_t actual[80] = {};
+    _olm_crypto_aes_encrypt_cbc(&key, &iv, input, sizeof(input), actual);
+    CHECK_EQ_SIZE(expected, actual, 64);
+
+    std::size_t length = _olm_crypto_aes_decrypt_cbc(
+        &key, &iv, actual, sizeof(actual), actual
+    );
+    CHECK_EQ(std::size_t(64), length);
+    CHECK_EQ_SIZE(input, actual, 64);
+}
+_olm_cpu_restrict_features(~0u);
+
+} /* AES Test Case 2 */
+
+
+/* AES Test Case 3: the backends agree on every padding length */
+
+TEST_CASE("AES Test Case 3") {
+
+_olm_aes256_key key;
+_olm_aes256_iv iv;
+std::uint8_t input[100];
+for (unsigned i = 0; i < sizeof(key.key); ++i) key.key[i] = i * 7;
+for (unsigned i = 0; i < sizeof(iv.iv); ++i) iv.iv[i] = i * 13;
+for (unsigned i = 0; i < sizeof(input); ++i) input[i] = i * 31;
+
+for (std::size_t input_length = 0; input_length <= sizeof(input); ++input_length) {
+    std::uint8_t expected[112] = {};
+    std::uint8_t actual[112] = {};
+    std::size_t length = _olm_crypto_aes_encrypt_cbc_length(input_length);
+
+    _olm_cpu_restrict_features(0);
+    _olm_crypto_aes_encrypt_cbc(&key, &iv, input, input_length, expected);
+    _olm_cpu_restrict_features(~0u);
+    _olm_crypto_aes_encrypt_cbc(&key, &iv, input, input_length, actual);
+    CHECK_EQ_SIZE(expected, actual, length);
+
+    CHECK_EQ(
+        input_length,
+        _olm_crypto_aes_decrypt_cbc(&key, &iv, expected, length, actual)
+    );
+    CHECK_EQ_SIZE(input, actual, input_length);
+}
+
+} /* AES Test Case 3 */
+
+
+/* AES Test Case 4: multi-block decryption, in place */
+
+TEST_CASE("AES Test Case 4") {
+
+_olm_aes256_key key;
+_olm_aes256_iv iv;
+std::uint8_t input[300];
+for (unsigned i = 0; i < sizeof(key.key); ++i) key.key[i] = i * 5;
+for (unsigned i = 0; i < sizeof(iv.iv); ++i) iv.iv[i] = i * 11;
+for (unsigned i = 0; i < sizeof(input); ++i) input[i] = i * 17;
+
+std::uint8_t ciphertext[304] = {};
+_olm_cpu_restrict_features(0);
+_olm_crypto_aes_encrypt_cbc(&key, &iv, input, sizeof(input), ciphertext);
+
+for (unsigned int features : {~0u, 0u}) {
+    _olm_cpu_restrict_features(features);
+
+    std::uint8_t buffer[304];
+    std::memcpy(buffer, ciphertext, sizeof(buffer));
+    std::size_t length = _olm_crypto_aes_decrypt_cbc(
+        &key, &iv, buffer, sizeof(buffer), buffer
+    );
+    CHECK_EQ(sizeof(input), length);
+    CHECK_EQ_SIZE(input, buffer, sizeof(input));
+}
+_olm_cpu_restrict_features(~0u);
+
+} /* AES Test Case 4 */
+
+
 /* SHA 256 Test Case 1 */
 
 TEST_CASE("SHA 256 Test Case 1") {
@@ -163,6 +444,45 @@ CHECK_EQ_SIZE(expected, actual, 32);
 
 } /* SHA 256 Test Case 1 */
 
+/* SHA 256 Test Case 2: every backend, across block boundaries */
+
+TEST_CASE("SHA 256 Test Case 2") {
+
+std::uint8_t input[] =
+    "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq";
+
+std::uint8_t expected[32] = {
+    0x24, 0x8D, 0x6A, 0x61, 0xD2, 0x06, 0x38, 0xB8,
+    0xE5, 0xC0, 0x26, 0x93, 0x0C, 0x3E, 0x60, 0x39,
+    0xA3, 0x3C, 0xE4, 0x59, 0x64, 0xFF, 0x21, 0x67,
+    0xF6, 0xEC, 0xED, 0xD4, 0x19, 0xDB, 0x06, 0xC1
+};
+
+std::uint8_t long_input[1000];
+for (unsigned i = 0; i < sizeof(long_input); ++i) long_input[i] = i * 7;
+
+std::uint8_t reference[sizeof(long_input) + 1][32];
+_olm_cpu_restrict_features(0);
+for (std::size_t length = 0; length <= sizeof(long_input); ++length) {
+    _olm_crypto_sha256(long_input, length, reference[length]);
+}
+
+for (unsigned int features : {~0u, OLM_CPU_X86_SSSE3, 0u}) {
+    _olm_cpu_restrict_features(features);
+
+    std::uint8_t actual[32];
+    _olm_crypto_sha256(input, sizeof(input) - 1, actual);
+    CHECK_EQ_SIZE(expected, actual, 32);
+
+    for (std::size_t length = 0; length <= sizeof(long_input); ++length) {
+        _olm_crypto_sha256(long_input, length, actual);
+        CHECK_EQ_SIZE(reference[length], actual, 32);
+    }
+}
+_olm_cpu_restrict_features(~0u);
+
+} /* SHA 256 Test Case 2 */
+
 /* HMAC Test Case 1 */
 
 TEST_CASE("HMAC Test Case 1") {
@@ -187,6 +507,167 @@ CHECK_EQ_SIZE(expected, actual, 32);
 
 } /* HMAC Test Case 1 */
 
+/* HMAC Test Case 2: known answers from RFC 4231, with each context reused for
+ * all the messages under its key */
+
+TEST_CASE("HMAC Test Case 2") {
+
+auto to_bytes = [](char const * text) {
+    return std::vector<std::uint8_t>(text, text + std::strlen(text));
+};
+
+std::vector<std::uint8_t> key_4;
+for (unsigned i = 1; i <= 25; ++i) key_4.push_back(i);
+std::vector<std::uint8_t> key_64;
+for (unsigned i = 0; i < 64; ++i) key_64.push_back(i);
+
+struct KnownAnswer {
+    std::vector<std::uint8_t> message;
+    std::uint8_t expected[32];
+};
+struct KeyAnswers {
+    std::vector<std::uint8_t> key;
+    std::vector<KnownAnswer> answers;
+};
+
+std::vector<KeyAnswers> tests = {
+/* RFC 4231 test case 1 */
+{std::vector<std::uint8_t>(20, 0x0b), {
+{to_bytes("Hi There"), {
+    0xb0, 0x34, 0x4c, 0x61, 0xd8, 0xdb, 0x38, 0x53,
+    0x5c, 0xa8, 0xaf, 0xce, 0xaf, 0x0b, 0xf1, 0x2b,
+    0x88, 0x1d, 0xc2, 0x00, 0xc9, 0x83, 0x3d, 0xa7,
+    0x26, 0xe9, 0x37, 0x6c, 0x2e, 0x32, 0xcf, 0xf7
+}},
+}},
+/* RFC 4231 test case 2 */
+{to_bytes("Jefe"), {
+{to_bytes("what do ya want for nothing?"), {
+    0x5b, 0xdc, 0xc1, 0x46, 0xbf, 0x60, 0x75, 0x4e,
+    0x6a, 0x04, 0x24, 0x26, 0x08, 0x95, 0x75, 0xc7,
+    0x5a, 0x00, 0x3f, 0x08, 0x9d, 0x27, 0x39, 0x83,
+    0x9d, 0xec, 0x58, 0xb9, 0x64, 0xec, 0x38, 0x43
+}},
+}},
+/* RFC 4231 test case 3 */
+{std::vector<std::uint8_t>(20, 0xaa), {
+{std::vector<std::uint8_t>(50, 0xdd), {
+    0x77, 0x3e, 0xa9, 0x1e, 0x36, 0x80, 0x0e, 0x46,
+    0x85, 0x4d, 0xb8, 0xeb, 0xd0, 0x91, 0x81, 0xa7,
+    0x29, 0x59, 0x09, 0x8b, 0x3e, 0xf8, 0xc1, 0x22,
+    0xd9, 0x63, 0x55, 0x14, 0xce, 0xd5, 0x65, 0xfe
+}},
+}},
+/* RFC 4231 test case 4 */
+{key_4, {
+{std::vector<std::uint8_t>(50, 0xcd), {
+    0x82, 0x55, 0x8a, 0x38, 0x9a, 0x44, 0x3c, 0x0e,
+    0xa4, 0xcc, 0x81, 0x98, 0x99, 0xf2, 0x08, 0x3a,
+    0x85, 0xf0, 0xfa, 0xa3, 0xe5, 0x78, 0xf8, 0x07,
+    0x7a, 0x2e, 0x3f, 0xf4, 0x67, 0x29, 0x66, 0x5b
+}},
+}},
+/* RFC 4231 test cases 6 and 7: a key longer than a block */
+{std::vector<std::uint8_t>(131, 0xaa), {
+{to_bytes("Test Using Larger Than Block-Size Key - Hash Key First"), {
+    0x60, 0xe4, 0x31, 0x59, 0x1e, 0xe0, 0xb6, 0x7f,
+    0x0d, 0x8a, 0x26, 0xaa, 0xcb, 0xf5, 0xb7, 0x7f,
+    0x8e, 0x0b, 0xc6, 0x21, 0x37, 0x28, 0xc5, 0x14,
+    0x05, 0x46, 0x04, 0x0f, 0x0e, 0xe3, 0x7f, 0x54
+}},
+{to_bytes(
+    "This is a test using a larger than block-size key and a larger than "
+    "block-size data. The key needs to be hashed before being used by the "
+    "HMAC algorithm."
+), {
+    0x9b, 0x09, 0xff, 0xa7, 0x1b, 0x94, 0x2f, 0xcb,
+    0x27, 0x63, 0x5f, 0xbc, 0xd5, 0xb0, 0xe9, 0x44,
+    0xbf, 0xdc, 0x63, 0x64, 0x4f, 0x07, 0x13, 0x93,
+    0x8a, 0x7f, 0x51, 0x53, 0x5c, 0x3a, 0x35, 0xe2
+}},
+}},
+/* a key of exactly one block, from the NIST HMAC examples */
+{key_64, {
+{to_bytes("Sample message for keylen=blocklen"), {
+    0x8b, 0xb9, 0xa1, 0xdb, 0x98, 0x06, 0xf2, 0x0d,
+    0xf7, 0xf7, 0x7b, 0x82, 0x13, 0x8c, 0x79, 0x14,
+    0xd1, 0x74, 0xd5, 0x9e, 0x13, 0xdc, 0x4d, 0x01,
+    0x69, 0xc9, 0x05, 0x7b, 0x13, 0x3e, 0x1d, 0x62
+}},
+{std::vector<std::uint8_t>(50, 0xcd), {
+    0x1d, 0xb0, 0x0a, 0xfc, 0x1c, 0xb8, 0xd0, 0x1e,
+    0x01, 0xf3, 0x52, 0x40, 0x21, 0x10, 0xbb, 0x99,
+    0x7b, 0x89, 0xcb, 0x67, 0x6c, 0xc3, 0x23, 0x13,
+    0xac, 0xbc, 0xc3, 0x78, 0x2a, 0x2a, 0x92, 0xfd
+}},
+{std::vector<std::uint8_t>(), {
+    0x34, 0x99, 0xf1, 0x63, 0xf4, 0x86, 0x04, 0xc0,
+    0xb1, 0x5a, 0xc8, 0x9e, 0x4e, 0x7c, 0x66, 0xf3,
+    0x14, 0xfb, 0x3b, 0x20, 0x3b, 0x8a, 0xc2, 0xf5,
+    0x64, 0x82, 0x8e, 0x62, 0xf6, 0xbe, 0x9d, 0x9d
+}},
+}},
+};
+
+for (KeyAnswers & test : tests) {
+    _olm_hmac_sha256_ctx ctx;
+    _olm_crypto_hmac_sha256_init(&ctx, test.key.data(), test.key.size());
+    for (KnownAnswer & answer : test.answers) {
+        std::uint8_t actual[32];
+        _olm_crypto_hmac_sha256_with_ctx(
+            &ctx, answer.message.data(), answer.message.size(), actual
+        );
+        CHECK_EQ_SIZE(answer.expected, actual, 32);
+        _olm_crypto_hmac_sha256(
+            test.key.data(), test.key.size(),
+            answer.message.data(), answer.message.size(), actual
+        );
+        CHECK_EQ_SIZE(answer.expected, actual, 32);
+    }
+}
+
+} /* HMAC Test Case 2 */
+
+TEST_CASE("HMAC Test Case 3") {
+
+std::uint8_t key[32];
+std::uint8_t inputs[4][130];
+for (unsigned i = 0; i < sizeof(key); ++i) key[i] = i * 7;
+for (unsigned i = 0; i < sizeof(inputs); ++i) inputs[i / 130][i % 130] = i * 11;
+
+_olm_hmac_sha256_ctx ctx;
+_olm_crypto_hmac_sha256_init(&ctx, key, sizeof(key));
+
+/* the SIMD lanes, the single block backends, and portable C */
+for (unsigned int mask : {~0u, OLM_CPU_X86_SSE2, 0u}) {
+    _olm_cpu_restrict_features(mask);
+    /* the padding takes one or two blocks around 55 and 64 bytes */
+    for (std::size_t input_length : {0, 1, 55, 56, 63, 64, 65, 130}) {
+        for (std::size_t count = 1; count <= 4; ++count) {
+            std::uint8_t actual[4][32];
+            std::uint8_t const * input_ptrs[4];
+            std::uint8_t * output_ptrs[4];
+            for (std::size_t i = 0; i < count; ++i) {
+                input_ptrs[i] = inputs[i];
+                output_ptrs[i] = actual[i];
+            }
+            _olm_crypto_hmac_sha256_multi(
+                &ctx, input_ptrs, input_length, output_ptrs, count
+            );
+            for (std::size_t i = 0; i < count; ++i) {
+                std::uint8_t expected[32];
+                _olm_crypto_hmac_sha256_with_ctx(
+                    &ctx, inputs[i], input_length, expected
+                );
+                CHECK_EQ_SIZE(expected, actual[i], 32);
+            }
+        }
+    }
+}
+_olm_cpu_restrict_features(~0u);
+
+} /* HMAC Test Case 3 */
+
 /* HDKF Test Case 1 */
 
 TEST_CASE("HDKF Test Case 1") {
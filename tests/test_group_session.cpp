@@ -12,6 +12,7 @@
  * See the License for the specific language governing permissions and
  * limitations under the License.
  */
+#include "olm/base64.h"
 #include "olm/inbound_group_session.h"
 #include "olm/outbound_group_session.h"
 #include "testing.hh"
@@ -74,6 +75,63 @@ TEST_CASE("Pickle outbound group session") {
                   olm_outbound_group_session_last_error_code(session));
 }
 
+TEST_CASE("Binary pickle outbound group session") {
+
+    size_t size = olm_outbound_group_session_size();
+    std::vector<uint8_t> memory(size);
+    OlmOutboundGroupSession *session = olm_outbound_group_session(memory.data());
+    std::vector<uint8_t> random(
+        olm_init_outbound_group_session_random_length(session), 'R'
+    );
+    olm_init_outbound_group_session(session, random.data(), random.size());
+
+    std::vector<uint8_t> key_buffer(olm_pickle_key_size());
+    OlmPickleKey *pickle_key = olm_pickle_key(key_buffer.data(), "secret_key", 10);
+
+    /* the binary pickle is the base64 pickle before it is encoded */
+    size_t pickle_length = olm_pickle_outbound_group_session_length(session);
+    size_t binary_length = olm_pickle_outbound_group_session_binary_length(session);
+    CHECK_EQ(pickle_length, _olm_encode_base64_length(binary_length));
+
+    std::vector<uint8_t> pickle(pickle_length);
+    std::vector<uint8_t> binary_pickle(binary_length);
+    CHECK_EQ(pickle_length, olm_pickle_outbound_group_session(
+        session, "secret_key", 10, pickle.data(), pickle_length
+    ));
+    CHECK_EQ(binary_length, olm_pickle_outbound_group_session_binary(
+        session, pickle_key, binary_pickle.data(), binary_length
+    ));
+    std::vector<uint8_t> encoded(pickle_length);
+    _olm_encode_base64(binary_pickle.data(), binary_length, encoded.data());
+    CHECK_EQ_SIZE(pickle.data(), encoded.data(), pickle_length);
+
+    std::vector<uint8_t> buffer2(size);
+    OlmOutboundGroupSession *session2 = olm_outbound_group_session(buffer2.data());
+    CHECK_EQ(binary_length, olm_unpickle_outbound_group_session_binary(
+        session2, pickle_key, binary_pickle.data(), binary_length
+    ));
+    CHECK_EQ(binary_length, olm_pickle_outbound_group_session_binary(
+        session2, pickle_key, binary_pickle.data(), binary_length
+    ));
+    _olm_encode_base64(binary_pickle.data(), binary_length, encoded.data());
+    CHECK_EQ_SIZE(pickle.data(), encoded.data(), pickle_length);
+
+    CHECK_EQ(std::size_t(-1), olm_pickle_outbound_group_session_binary(
+        session2, pickle_key, binary_pickle.data(), binary_length - 1
+    ));
+    CHECK_EQ(OLM_OUTPUT_BUFFER_TOO_SMALL,
+                  olm_outbound_group_session_last_error_code(session2));
+
+    binary_pickle[0] ^= 1;
+    CHECK_EQ(std::size_t(-1), olm_unpickle_outbound_group_session_binary(
+        session2, pickle_key, binary_pickle.data(), binary_length
+    ));
+    CHECK_EQ(OLM_BAD_ACCOUNT_KEY,
+                  olm_outbound_group_session_last_error_code(session2));
+
+    olm_clear_pickle_key(pickle_key);
+}
+
 TEST_CASE("Pickle inbound group session") {
 
     size_t size = olm_inbound_group_session_size();
@@ -128,6 +186,97 @@ TEST_CASE("Pickle inbound group session") {
                   olm_inbound_group_session_last_error_code(session));
 }
 
+TEST_CASE("Pickle group sessions with a key context") {
+
+    size_t size = olm_outbound_group_session_size();
+    std::vector<uint8_t> memory(size);
+    OlmOutboundGroupSession *session = olm_outbound_group_session(memory.data());
+    std::vector<uint8_t> random(
+        olm_init_outbound_group_session_random_length(session), 'R'
+    );
+    olm_init_outbound_group_session(session, random.data(), random.size());
+
+    size_t session_key_len = olm_outbound_group_session_key_length(session);
+    std::vector<uint8_t> session_key(session_key_len);
+    olm_outbound_group_session_key(session, session_key.data(), session_key_len);
+
+    size_t inbound_size = olm_inbound_group_session_size();
+    std::vector<uint8_t> inbound_memory(inbound_size);
+    OlmInboundGroupSession *inbound_session =
+        olm_inbound_group_session(inbound_memory.data());
+    CHECK_EQ((size_t)0, olm_init_inbound_group_session(
+        inbound_session, session_key.data(), session_key_len
+    ));
+
+    std::vector<uint8_t> key_buffer(olm_pickle_key_size());
+    OlmPickleKey *pickle_key = olm_pickle_key(key_buffer.data(), "secret_key", 10);
+    std::vector<uint8_t> wrong_key_buffer(olm_pickle_key_size());
+    OlmPickleKey *wrong_key = olm_pickle_key(wrong_key_buffer.data(), "wrong_key", 9);
+
+    /* the outbound pickle matches the one made with the raw key, and unpickles
+     * to the same session */
+    size_t pickle_length = olm_pickle_outbound_group_session_length(session);
+    std::vector<uint8_t> pickle1(pickle_length);
+    std::vector<uint8_t> pickle2(pickle_length);
+    CHECK_EQ(pickle_length, olm_pickle_outbound_group_session(
+        session, "secret_key", 10, pickle1.data(), pickle_length
+    ));
+    CHECK_EQ(pickle_length, olm_pickle_outbound_group_session_with_key_context(
+        session, pickle_key, pickle2.data(), pickle_length
+    ));
+    CHECK_EQ_SIZE(pickle1.data(), pickle2.data(), pickle_length);
+
+    std::vector<uint8_t> buffer2(size);
+    OlmOutboundGroupSession *session2 = olm_outbound_group_session(buffer2.data());
+    CHECK_EQ(pickle_length, olm_unpickle_outbound_group_session_with_key_context(
+        session2, pickle_key, pickle2.data(), pickle_length
+    ));
+    CHECK_EQ(pickle_length, olm_pickle_outbound_group_session_with_key_context(
+        session2, pickle_key, pickle2.data(), pickle_length
+    ));
+    CHECK_EQ_SIZE(pickle1.data(), pickle2.data(), pickle_length);
+
+    CHECK_EQ(std::size_t(-1), olm_unpickle_outbound_group_session_with_key_context(
+        session2, wrong_key, pickle1.data(), pickle_length
+    ));
+    CHECK_EQ(OLM_BAD_ACCOUNT_KEY,
+                  olm_outbound_group_session_last_error_code(session2));
+
+    /* and the same for the inbound session */
+    pickle_length = olm_pickle_inbound_group_session_length(inbound_session);
+    pickle1.resize(pickle_length);
+    pickle2.resize(pickle_length);
+    CHECK_EQ(pickle_length, olm_pickle_inbound_group_session(
+        inbound_session, "secret_key", 10, pickle1.data(), pickle_length
+    ));
+    CHECK_EQ(pickle_length, olm_pickle_inbound_group_session_with_key_context(
+        inbound_session, pickle_key, pickle2.data(), pickle_length
+    ));
+    CHECK_EQ_SIZE(pickle1.data(), pickle2.data(), pickle_length);
+
+    std::vector<uint8_t> inbound_memory2(inbound_size);
+    OlmInboundGroupSession *inbound_session2 =
+        olm_inbound_group_session(inbound_memory2.data());
+    CHECK_EQ(pickle_length, olm_unpickle_inbound_group_session_with_key_context(
+        inbound_session2, pickle_key, pickle2.data(), pickle_length
+    ));
+    CHECK_EQ(pickle_length, olm_pickle_inbound_group_session_with_key_context(
+        inbound_session2, pickle_key, pickle2.data(), pickle_length
+    ));
+    CHECK_EQ_SIZE(pickle1.data(), pickle2.data(), pickle_length);
+
+    CHECK_EQ(std::size_t(-1), olm_unpickle_inbound_group_session_with_key_context(
+        inbound_session2, wrong_key, pickle1.data(), pickle_length
+    ));
+    CHECK_EQ(OLM_BAD_ACCOUNT_KEY,
+                  olm_inbound_group_session_last_error_code(inbound_session2));
+
+    olm_clear_inbound_group_session(inbound_session);
+    olm_clear_inbound_group_session(inbound_session2);
+    olm_clear_pickle_key(pickle_key);
+    olm_clear_pickle_key(wrong_key);
+}
+
 TEST_CASE("Group message send/receive") {
 
     uint8_t random_bytes[] =
@@ -216,6 +365,133 @@ TEST_CASE("Group message send/receive") {
     CHECK_EQ(message_index, uint32_t(0));
 }
 
+TEST_CASE("Group message decrypt without destroying the input") {
+
+    uint8_t random_bytes[] =
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF";
+
+    std::vector<uint8_t> memory(olm_outbound_group_session_size());
+    OlmOutboundGroupSession *session = olm_outbound_group_session(memory.data());
+    olm_init_outbound_group_session(session, random_bytes, sizeof(random_bytes));
+
+    std::vector<uint8_t> session_key(olm_outbound_group_session_key_length(session));
+    olm_outbound_group_session_key(session, session_key.data(), session_key.size());
+
+    std::vector<uint8_t> inbound_session_memory(olm_inbound_group_session_size());
+    OlmInboundGroupSession *inbound_session =
+        olm_inbound_group_session(inbound_session_memory.data());
+    CHECK_EQ((size_t)0, olm_init_inbound_group_session(
+        inbound_session, session_key.data(), session_key.size()
+    ));
+
+    uint8_t plaintext[] = "Message";
+    size_t plaintext_length = sizeof(plaintext) - 1;
+    std::vector<uint8_t> msg(olm_group_encrypt_message_length(
+        session, plaintext_length
+    ));
+    olm_group_encrypt(session, plaintext, plaintext_length, msg.data(), msg.size());
+    const std::vector<uint8_t> original(msg);
+
+    /* decode into scratch space, sized by the message */
+    std::vector<uint8_t> scratch(msg.size() * 3 / 4);
+    std::vector<uint8_t> plaintext_buf(scratch.size());
+    uint32_t message_index = 1;
+    size_t res = olm_group_decrypt_with_scratch(
+        inbound_session, msg.data(), msg.size(),
+        scratch.data(), scratch.size(),
+        plaintext_buf.data(), plaintext_buf.size(), &message_index
+    );
+    CHECK_EQ(plaintext_length, res);
+    CHECK_EQ_SIZE(plaintext, plaintext_buf.data(), res);
+    CHECK_EQ(uint32_t(0), message_index);
+    CHECK_EQ(original, msg);
+
+    CHECK_EQ((size_t)-1, olm_group_decrypt_with_scratch(
+        inbound_session, msg.data(), msg.size(),
+        scratch.data(), scratch.size() - 1,
+        plaintext_buf.data(), plaintext_buf.size(), &message_index
+    ));
+    CHECK_EQ(OLM_OUTPUT_BUFFER_TOO_SMALL,
+             olm_inbound_group_session_last_error_code(inbound_session));
+
+    /* an already decoded message */
+    std::vector<uint8_t> raw(_olm_decode_base64_length(msg.size()));
+    _olm_decode_base64(msg.data(), msg.size(), raw.data());
+    const std::vector<uint8_t> raw_original(raw);
+    res = olm_group_decrypt_raw(
+        inbound_session, raw.data(), raw.size(),
+        plaintext_buf.data(), raw.size(), &message_index
+    );
+    CHECK_EQ(plaintext_length, res);
+    CHECK_EQ_SIZE(plaintext, plaintext_buf.data(), res);
+    CHECK_EQ(raw_original, raw);
+
+    raw[raw.size() - 1] ^= 1;
+    CHECK_EQ((size_t)-1, olm_group_decrypt_raw(
+        inbound_session, raw.data(), raw.size(),
+        plaintext_buf.data(), raw.size(), &message_index
+    ));
+    CHECK_EQ(OLM_BAD_SIGNATURE,
+             olm_inbound_group_session_last_error_code(inbound_session));
+}
+
+TEST_CASE("Peek group message") {
+
+    uint8_t random_bytes[] =
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF";
+
+    std::vector<uint8_t> memory(olm_outbound_group_session_size());
+    OlmOutboundGroupSession *session = olm_outbound_group_session(memory.data());
+    olm_init_outbound_group_session(session, random_bytes, sizeof(random_bytes));
+
+    uint8_t plaintext[] = "Message";
+    std::vector<uint8_t> msg;
+    for (int i = 0; i < 200; ++i) {
+        /* the message grows as the index needs more bytes */
+        msg.resize(olm_group_encrypt_message_length(session, 7));
+        CHECK_EQ(msg.size(), olm_group_encrypt(
+            session, plaintext, 7, msg.data(), msg.size()
+        ));
+    }
+    const std::vector<uint8_t> original(msg);
+
+    uint8_t version = 0;
+    uint32_t message_index = 0;
+    CHECK_EQ(OLM_SUCCESS, olm_peek_group_message(
+        msg.data(), msg.size(), &version, &message_index
+    ));
+    CHECK_EQ(3, version);
+    CHECK_EQ(uint32_t(199), message_index);
+    CHECK_EQ(original, msg);
+
+    std::vector<uint8_t> raw(_olm_decode_base64_length(msg.size()));
+    _olm_decode_base64(msg.data(), msg.size(), raw.data());
+    message_index = 0;
+    CHECK_EQ(OLM_SUCCESS, olm_peek_group_message_raw(
+        raw.data(), raw.size(), &version, &message_index
+    ));
+    CHECK_EQ(uint32_t(199), message_index);
+
+    raw[0] = 2;
+    CHECK_EQ(OLM_BAD_MESSAGE_VERSION, olm_peek_group_message_raw(
+        raw.data(), raw.size(), &version, &message_index
+    ));
+    CHECK_EQ(2, version);
+    CHECK_EQ(OLM_INVALID_BASE64, olm_peek_group_message(
+        msg.data(), 5, &version, &message_index
+    ));
+}
+
 TEST_CASE("Inbound group session export/import") {
 
     uint8_t session_key[] =
@@ -363,3 +639,220 @@ TEST_CASE("Invalid signature group message") {
         std::string(olm_inbound_group_session_last_error(inbound_session))
     );
 }
+
+TEST_CASE("Group session checkpoints") {
+
+    uint8_t random_bytes[] =
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF";
+
+    std::vector<uint8_t> memory(olm_outbound_group_session_size());
+    OlmOutboundGroupSession *session = olm_outbound_group_session(memory.data());
+    olm_init_outbound_group_session(session, random_bytes, sizeof(random_bytes));
+
+    size_t session_key_len = olm_outbound_group_session_key_length(session);
+    std::vector<uint8_t> session_key(session_key_len);
+    olm_outbound_group_session_key(session, session_key.data(), session_key_len);
+
+    /* messages spanning several blocks of 256 */
+    const unsigned message_count = 700;
+    uint8_t plaintext[] = "Message";
+    size_t plaintext_length = sizeof(plaintext) - 1;
+    std::vector<std::vector<uint8_t>> messages;
+    for (unsigned i = 0; i < message_count; ++i) {
+        /* the length grows with the encoded message index */
+        size_t msglen = olm_group_encrypt_message_length(session, plaintext_length);
+        messages.emplace_back(msglen);
+        olm_group_encrypt(
+            session, plaintext, plaintext_length, messages.back().data(), msglen
+        );
+    }
+
+    std::vector<uint8_t> inbound_memory(olm_inbound_group_session_size());
+    OlmInboundGroupSession *inbound =
+        olm_inbound_group_session(inbound_memory.data());
+    olm_init_inbound_group_session(inbound, session_key.data(), session_key_len);
+
+    CHECK_EQ(
+        (size_t)OLM_INBOUND_GROUP_SESSION_MAX_CHECKPOINTS,
+        olm_inbound_group_session_set_max_checkpoints(inbound, 1000)
+    );
+    CHECK_EQ((size_t)8, olm_inbound_group_session_set_max_checkpoints(inbound, 8));
+
+    std::vector<uint8_t> plaintext_buf(messages.back().size());
+    uint32_t message_index;
+
+    /* the latest message, then back through the rest */
+    for (unsigned n = 0; n < message_count; ++n) {
+        unsigned i = n == 0 ? message_count - 1 : message_count - 1 - n;
+        if (n == message_count / 2) {
+            /* the checkpoints survive a pickle round trip */
+            size_t pickle_length = olm_pickle_inbound_group_session_length(inbound);
+            std::vector<uint8_t> pickle(pickle_length);
+            CHECK_EQ(pickle_length, olm_pickle_inbound_group_session(
+                inbound, "secret_key", 10, pickle.data(), pickle_length
+            ));
+            olm_clear_inbound_group_session(inbound);
+            CHECK_EQ(pickle_length, olm_unpickle_inbound_group_session(
+                inbound, "secret_key", 10, pickle.data(), pickle_length
+            ));
+            CHECK_EQ(pickle_length, olm_pickle_inbound_group_session_length(inbound));
+        }
+        std::vector<uint8_t> msg(messages[i]);
+        size_t res = olm_group_decrypt(
+            inbound, msg.data(), msg.size(),
+            plaintext_buf.data(), plaintext_buf.size(), &message_index
+        );
+        CHECK_EQ(plaintext_length, res);
+        CHECK_EQ_SIZE(plaintext, plaintext_buf.data(), plaintext_length);
+        CHECK_EQ(i, message_index);
+    }
+
+    /* a session without checkpoints derives the same keys */
+    CHECK_EQ((size_t)0, olm_inbound_group_session_set_max_checkpoints(inbound, 0));
+    for (unsigned i : {0u, 15u, 16u, 255u, 256u, 600u}) {
+        std::vector<uint8_t> msg(messages[i]);
+        size_t res = olm_group_decrypt(
+            inbound, msg.data(), msg.size(),
+            plaintext_buf.data(), plaintext_buf.size(), &message_index
+        );
+        CHECK_EQ(plaintext_length, res);
+        CHECK_EQ(i, message_index);
+    }
+
+    /* it is pickled as version 2, which older versions can load, and only a
+     * session with checkpoints needs version 3 */
+    for (unsigned max_checkpoints : {0u, 8u}) {
+        olm_inbound_group_session_set_max_checkpoints(inbound, max_checkpoints);
+        size_t pickle_length = olm_pickle_inbound_group_session_length(inbound);
+        std::vector<uint8_t> pickle(pickle_length);
+        CHECK_EQ(pickle_length, olm_pickle_inbound_group_session(
+            inbound, "secret_key", 10, pickle.data(), pickle_length
+        ));
+        std::vector<uint8_t> copy(pickle);
+        CHECK_NE((size_t)-1, _olm_enc_input(
+            (const uint8_t *)"secret_key", 10, copy.data(), copy.size(), NULL
+        ));
+        uint8_t version[] = {0, 0, 0, uint8_t(max_checkpoints ? 3 : 2)};
+        CHECK_EQ_SIZE(version, copy.data(), 4);
+        CHECK_EQ(pickle_length, olm_unpickle_inbound_group_session(
+            inbound, "secret_key", 10, pickle.data(), pickle_length
+        ));
+    }
+}
+
+TEST_CASE("Group message batch decrypt") {
+
+    uint8_t random_bytes[] =
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF"
+        "0123456789ABDEF0123456789ABCDEF";
+
+    std::vector<uint8_t> memory(olm_outbound_group_session_size());
+    OlmOutboundGroupSession *session = olm_outbound_group_session(memory.data());
+    olm_init_outbound_group_session(session, random_bytes, sizeof(random_bytes));
+
+    uint8_t plaintext[] = "Message";
+    size_t plaintext_length = sizeof(plaintext) - 1;
+    std::vector<std::vector<uint8_t>> messages;
+    std::vector<uint8_t> session_key;
+    for (unsigned i = 0; i < 300; ++i) {
+        if (i == 10) {
+            /* the inbound session only knows from index 10 */
+            session_key.resize(olm_outbound_group_session_key_length(session));
+            olm_outbound_group_session_key(
+                session, session_key.data(), session_key.size()
+            );
+        }
+        size_t msglen = olm_group_encrypt_message_length(session, plaintext_length);
+        messages.emplace_back(msglen);
+        olm_group_encrypt(
+            session, plaintext, plaintext_length, messages.back().data(), msglen
+        );
+    }
+
+    std::vector<uint8_t> inbound_memory(olm_inbound_group_session_size());
+    OlmInboundGroupSession *inbound =
+        olm_inbound_group_session(inbound_memory.data());
+    olm_init_inbound_group_session(inbound, session_key.data(), session_key.size());
+
+    /* have the latest ratchet part way through */
+    {
+        std::vector<uint8_t> msg(messages[150]);
+        std::vector<uint8_t> plaintext_buf(msg.size());
+        uint32_t message_index;
+        CHECK_EQ(plaintext_length, olm_group_decrypt(
+            inbound, msg.data(), msg.size(),
+            plaintext_buf.data(), plaintext_buf.size(), &message_index
+        ));
+    }
+
+    /* out of order, either side of the latest ratchet, with a repeat, a
+     * message from before the session and one that is not base64 */
+    const unsigned order[] = {
+        299, 3, 40, 151, 150, 12, 10, 200, 12, 11, 298, 9999
+    };
+    const size_t count = sizeof(order) / sizeof(order[0]);
+    std::vector<std::vector<uint8_t>> inputs;
+    std::vector<std::vector<uint8_t>> outputs;
+    for (unsigned index : order) {
+        if (index < messages.size()) {
+            inputs.push_back(messages[index]);
+        } else {
+            inputs.push_back(std::vector<uint8_t>(5, 'A'));
+        }
+        outputs.emplace_back(inputs.back().size());
+    }
+    std::vector<uint8_t *> message_ptrs, plaintext_ptrs;
+    std::vector<size_t> message_lengths, max_plaintext_lengths;
+    for (size_t i = 0; i < count; ++i) {
+        message_ptrs.push_back(inputs[i].data());
+        message_lengths.push_back(inputs[i].size());
+        plaintext_ptrs.push_back(outputs[i].data());
+        max_plaintext_lengths.push_back(outputs[i].size());
+    }
+    std::vector<size_t> plaintext_lengths(count);
+    std::vector<uint32_t> message_indexes(count);
+    std::vector<OlmErrorCode> errors(count);
+
+    size_t res = olm_group_decrypt_batch(
+        inbound, count,
+        message_ptrs.data(), message_lengths.data(),
+        plaintext_ptrs.data(), max_plaintext_lengths.data(),
+        plaintext_lengths.data(), message_indexes.data(), errors.data()
+    );
+    CHECK_EQ(count - 2, res);
+
+    for (size_t i = 0; i < count; ++i) {
+        if (order[i] == 3) {
+            CHECK_EQ((size_t)-1, plaintext_lengths[i]);
+            CHECK_EQ(OLM_UNKNOWN_MESSAGE_INDEX, errors[i]);
+            CHECK_EQ(3U, message_indexes[i]);
+        } else if (order[i] == 9999) {
+            CHECK_EQ((size_t)-1, plaintext_lengths[i]);
+            CHECK_EQ(OLM_INVALID_BASE64, errors[i]);
+        } else {
+            CHECK_EQ(plaintext_length, plaintext_lengths[i]);
+            CHECK_EQ(OLM_SUCCESS, errors[i]);
+            CHECK_EQ(order[i], message_indexes[i]);
+            CHECK_EQ_SIZE(plaintext, outputs[i].data(), plaintext_length);
+        }
+    }
+
+    /* the latest ratchet moved on to the highest index */
+    std::vector<uint8_t> msg(messages[299]);
+    std::vector<uint8_t> plaintext_buf(msg.size());
+    uint32_t message_index;
+    CHECK_EQ(plaintext_length, olm_group_decrypt(
+        inbound, msg.data(), msg.size(),
+        plaintext_buf.data(), plaintext_buf.size(), &message_index
+    ));
+    CHECK_EQ(299U, message_index);
+}
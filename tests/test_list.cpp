@@ -87,3 +87,52 @@ for (auto item : test_list) {
 CHECK_EQ(3, i);
 
 }
+
+
+/** DynamicList test **/
+TEST_CASE("DynamicList insert and erase") {
+
+olm::DynamicList<int> test_list(6);
+CHECK_EQ(std::size_t(0), test_list.size());
+CHECK(test_list.begin() == test_list.end());
+
+for (int i = 0; i < 8; ++i) {
+    *test_list.insert(test_list.begin()) = i;
+}
+/* the oldest items are pushed off the end */
+CHECK_EQ(std::size_t(6), test_list.size());
+int i = 8;
+for (auto item : test_list) {
+    CHECK_EQ(--i, item);
+}
+CHECK_EQ(2, i);
+
+/* inserting at the end of a full list replaces the last item */
+*test_list.insert(test_list.end()) = 100;
+CHECK_EQ(std::size_t(6), test_list.size());
+CHECK_EQ(100, test_list[5]);
+
+test_list.erase(test_list.begin() + 1);
+CHECK_EQ(std::size_t(5), test_list.size());
+CHECK_EQ(7, test_list[0]);
+CHECK_EQ(5, test_list[1]);
+
+/* several items at once */
+int * items = test_list.insert(test_list.begin() + 1, 3);
+items[0] = 10; items[1] = 11; items[2] = 12;
+CHECK_EQ(std::size_t(6), test_list.size());
+CHECK_EQ(7, test_list[0]);
+CHECK_EQ(10, test_list[1]);
+CHECK_EQ(12, test_list[3]);
+CHECK_EQ(5, test_list[4]);
+CHECK_EQ(4, test_list[5]);
+
+test_list.set_max_size(2);
+CHECK_EQ(std::size_t(2), test_list.size());
+CHECK_EQ(std::size_t(2), test_list.max_size());
+CHECK_EQ(10, test_list[1]);
+
+test_list.clear();
+CHECK(test_list.empty());
+
+} /** DynamicList test **/
@@ -1,4 +1,5 @@
 #include "olm/olm.h"
+#include "olm/base64.h"
 
 #include "testing.hh"
 #include "utils.hh"
@@ -6,6 +7,7 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstring>
+#include <string>
 #include <vector>
 
 struct MockRandom {
@@ -88,6 +90,9 @@ CHECK_EQ(std::size_t(-1),
     ::olm_unpickle_account(account, "secret_key", 10,
         junk_pickle.data(), junk_pickle_length));
 CHECK_EQ(OLM_PICKLE_EXTRA_DATA, olm_account_last_error_code(account));
+
+::olm_clear_account(account);
+::olm_clear_account(account2);
 }
 
 
@@ -113,6 +118,7 @@ CHECK_EQ(OLM_PICKLE_EXTRA_DATA, olm_account_last_error_code(account));
         std::string("BAD_LEGACY_ACCOUNT_PICKLE"),
         std::string(::olm_account_last_error(account))
     );
+    ::olm_clear_account(account);
 }
 
 
@@ -187,6 +193,10 @@ CHECK_EQ(std::size_t(-1),
     ::olm_unpickle_session(session, "secret_key", 10,
         junk_pickle.data(), junk_pickle_length));
 CHECK_EQ(OLM_PICKLE_EXTRA_DATA, olm_session_last_error_code(session));
+
+::olm_clear_session(session);
+::olm_clear_session(session2);
+::olm_clear_account(account);
 }
 
 /** Loopback test */
@@ -346,6 +356,10 @@ CHECK_NE(std::size_t(-1), ::olm_session_id(
 CHECK_EQ(a_session_id.size(), b_session_id.size());
 CHECK_EQ_SIZE(a_session_id.data(), b_session_id.data(), b_session_id.size());
 
+::olm_clear_session(a_session);
+::olm_clear_session(b_session);
+::olm_clear_account(a_account);
+::olm_clear_account(b_account);
 }
 
 /** More messages test */
@@ -468,6 +482,11 @@ for (unsigned i = 0; i < 8; ++i) {
     ));
     }
 }
+
+::olm_clear_session(a_session);
+::olm_clear_session(b_session);
+::olm_clear_account(a_account);
+::olm_clear_account(b_account);
 }
 
 TEST_CASE("Fallback key test") {
@@ -697,6 +716,15 @@ CHECK_EQ(
     std::string("BAD_MESSAGE_KEY_ID"),
     std::string(::olm_session_last_error(b_session3))
 );
+
+::olm_clear_session(a_session1);
+::olm_clear_session(b_session1);
+::olm_clear_session(a_session2);
+::olm_clear_session(b_session2);
+::olm_clear_session(a_session3);
+::olm_clear_session(b_session3);
+::olm_clear_account(a_account);
+::olm_clear_account(b_account);
 }
 
 TEST_CASE("Old account (v3) unpickle test") {
@@ -728,4 +756,1256 @@ TEST_CASE("Old account (v3) unpickle test") {
     CHECK_EQ_SIZE(expected_fallback, fallback.data(), len);
     len = ::olm_account_unpublished_fallback_key(account, fallback.data(), fallback.size());
     CHECK_EQ_SIZE(expected_unpublished_fallback, fallback.data(), len);
+
+    ::olm_clear_account(account);
+}
+
+static void reverse_parallel_for(
+    void * context, std::size_t task_count,
+    void (*task)(void * task_context, std::size_t index), void * task_context
+) {
+    *static_cast<std::size_t *>(context) = task_count;
+    for (std::size_t i = task_count; i-- > 0;) {
+        task(task_context, i);
+    }
+}
+
+TEST_CASE("Parallel one time key generation test") {
+    MockRandom mock_random('O');
+
+    std::vector<std::uint8_t> account_buffer1(::olm_account_size());
+    ::OlmAccount *account1 = ::olm_account(account_buffer1.data());
+    std::vector<std::uint8_t> account_buffer2(::olm_account_size());
+    ::OlmAccount *account2 = ::olm_account(account_buffer2.data());
+    std::vector<std::uint8_t> random(::olm_create_account_random_length(account1));
+    mock_random(random.data(), random.size());
+    std::vector<std::uint8_t> random2(random);
+    ::olm_create_account(account1, random.data(), random.size());
+    ::olm_create_account(account2, random2.data(), random2.size());
+
+    /* more keys than the account keeps, so that some are skipped */
+    std::size_t number_of_keys = 150;
+    random.resize(::olm_account_generate_one_time_keys_random_length(
+        account1, number_of_keys
+    ));
+    mock_random(random.data(), random.size());
+    random2 = random;
+    CHECK_EQ(number_of_keys, ::olm_account_generate_one_time_keys(
+        account1, number_of_keys, random.data(), random.size()
+    ));
+    std::size_t task_count = 0;
+    CHECK_EQ(number_of_keys, ::olm_account_generate_one_time_keys_parallel(
+        account2, number_of_keys, random2.data(), random2.size(),
+        reverse_parallel_for, &task_count
+    ));
+    CHECK(task_count > 1);
+
+    std::size_t pickle_length = ::olm_pickle_account_length(account1);
+    CHECK_EQ(pickle_length, ::olm_pickle_account_length(account2));
+    std::vector<std::uint8_t> pickle1(pickle_length);
+    std::vector<std::uint8_t> pickle2(pickle_length);
+    ::olm_pickle_account(account1, "", 0, pickle1.data(), pickle_length);
+    ::olm_pickle_account(account2, "", 0, pickle2.data(), pickle_length);
+    CHECK_EQ_SIZE(pickle1.data(), pickle2.data(), pickle_length);
+
+    /* the ids of the skipped keys are still used up */
+    std::vector<std::uint8_t> keys(::olm_account_one_time_keys_length(account2));
+    std::size_t keys_length = ::olm_account_one_time_keys(
+        account2, keys.data(), keys.size()
+    );
+    std::string json(keys.begin(), keys.begin() + keys_length);
+    CHECK(json.find("\"AAAAlg\"") != std::string::npos);
+    CHECK(json.find("\"AAAAMg\"") == std::string::npos);
+
+    ::olm_clear_account(account1);
+    ::olm_clear_account(account2);
+}
+
+TEST_CASE("One time key limit test") {
+    MockRandom mock_random('L');
+
+    std::vector<std::uint8_t> account_buffer(::olm_account_size());
+    ::OlmAccount *account = ::olm_account(account_buffer.data());
+    std::vector<std::uint8_t> random(::olm_create_account_random_length(account));
+    mock_random(random.data(), random.size());
+    ::olm_create_account(account, random.data(), random.size());
+
+    CHECK_EQ(std::size_t(100), ::olm_account_max_number_of_one_time_keys(account));
+    CHECK_EQ(std::size_t(1), ::olm_account_set_max_number_of_one_time_keys(account, 0));
+    CHECK_EQ(std::size_t(250), ::olm_account_set_max_number_of_one_time_keys(account, 250));
+    CHECK_EQ(std::size_t(250), ::olm_account_max_number_of_one_time_keys(account));
+
+    random.resize(::olm_account_generate_one_time_keys_random_length(account, 120));
+    for (int i = 0; i < 3; ++i) {
+        mock_random(random.data(), random.size());
+        CHECK_EQ(std::size_t(120), ::olm_account_generate_one_time_keys(
+            account, 120, random.data(), random.size()
+        ));
+    }
+
+    /* the limit and all of the keys survive pickling */
+    std::size_t pickle_length = ::olm_pickle_account_length(account);
+    std::vector<std::uint8_t> pickle(pickle_length);
+    ::olm_pickle_account(account, "", 0, pickle.data(), pickle_length);
+    std::vector<std::uint8_t> account_buffer2(::olm_account_size());
+    ::OlmAccount *account2 = ::olm_account(account_buffer2.data());
+    CHECK_NE(std::size_t(-1), ::olm_unpickle_account(
+        account2, "", 0, pickle.data(), pickle_length
+    ));
+    CHECK_EQ(std::size_t(250), ::olm_account_max_number_of_one_time_keys(account2));
+
+    std::vector<std::uint8_t> keys1(::olm_account_one_time_keys_length(account));
+    std::vector<std::uint8_t> keys2(::olm_account_one_time_keys_length(account2));
+    CHECK_EQ(keys1.size(), keys2.size());
+    std::size_t keys_length = ::olm_account_one_time_keys(
+        account, keys1.data(), keys1.size()
+    );
+    ::olm_account_one_time_keys(account2, keys2.data(), keys2.size());
+    CHECK_EQ_SIZE(keys1.data(), keys2.data(), keys_length);
+
+    std::string json(keys1.begin(), keys1.begin() + keys_length);
+    std::size_t count = 0;
+    for (std::size_t pos = json.find("\":\""); pos != std::string::npos;
+            pos = json.find("\":\"", pos + 1)) {
+        ++count;
+    }
+    CHECK_EQ(std::size_t(250), count);
+
+    /* lowering the limit drops the oldest keys */
+    CHECK_EQ(std::size_t(10), ::olm_account_set_max_number_of_one_time_keys(account2, 10));
+    keys2.resize(::olm_account_one_time_keys_length(account2));
+    keys_length = ::olm_account_one_time_keys(account2, keys2.data(), keys2.size());
+    json.assign(keys2.begin(), keys2.begin() + keys_length);
+    CHECK(json.find("\"AAABaA\"") != std::string::npos);
+    CHECK(json.find("\"AAABXg\"") == std::string::npos);
+
+    ::olm_clear_account(account);
+    ::olm_clear_account(account2);
+}
+
+TEST_CASE("One time key index test") {
+    MockRandom mock_random_a('A', 0x00);
+    std::uint32_t state = 0x12345678;
+    auto fill_random = [&](std::vector<std::uint8_t> & bytes) {
+        for (auto & byte : bytes) {
+            state ^= state << 13; state ^= state >> 17; state ^= state << 5;
+            byte = state;
+        }
+    };
+
+    std::vector<std::uint8_t> a_account_buffer(::olm_account_size());
+    ::OlmAccount *a_account = ::olm_account(a_account_buffer.data());
+    std::vector<std::uint8_t> random(::olm_create_account_random_length(a_account));
+    mock_random_a(random.data(), random.size());
+    ::olm_create_account(a_account, random.data(), random.size());
+
+    std::vector<std::uint8_t> b_account_buffer(::olm_account_size());
+    ::OlmAccount *b_account = ::olm_account(b_account_buffer.data());
+    random.resize(::olm_create_account_random_length(b_account));
+    fill_random(random);
+    ::olm_create_account(b_account, random.data(), random.size());
+    ::olm_account_set_max_number_of_one_time_keys(b_account, 1000);
+    random.resize(::olm_account_generate_one_time_keys_random_length(b_account, 700));
+    fill_random(random);
+    ::olm_account_generate_one_time_keys(b_account, 700, random.data(), random.size());
+
+    std::vector<std::uint8_t> b_id_keys(::olm_account_identity_keys_length(b_account));
+    std::vector<std::uint8_t> b_pre_key(::olm_account_prekey_length(b_account));
+    std::vector<std::uint8_t> b_pre_key_signature(::olm_account_signature_length(b_account));
+    std::vector<std::uint8_t> b_ot_keys(::olm_account_one_time_keys_length(b_account));
+    ::olm_account_identity_keys(b_account, b_id_keys.data(), b_id_keys.size());
+    ::olm_account_prekey(b_account, b_pre_key.data(), b_pre_key.size());
+    ::olm_account_prekey_signature(b_account, b_pre_key_signature.data());
+    ::olm_account_one_time_keys(b_account, b_ot_keys.data(), b_ot_keys.size());
+
+    /* the public part of the n-th key in the JSON */
+    auto one_time_key = [&](std::size_t n) {
+        std::string json(b_ot_keys.begin(), b_ot_keys.end());
+        std::size_t pos = json.find("\":\"");
+        while (n--) {
+            pos = json.find("\":\"", pos + 1);
+        }
+        return b_ot_keys.data() + pos + 3;
+    };
+
+    /* a pre-key message from A to the given one time key of B */
+    auto pre_key_message = [&](std::uint8_t * b_ot_key) {
+        std::vector<std::uint8_t> session_buffer(::olm_session_size());
+        ::OlmSession *session = ::olm_session(session_buffer.data());
+        std::vector<std::uint8_t> rand(::olm_create_outbound_session_random_length(session));
+        mock_random_a(rand.data(), rand.size());
+        ::olm_create_outbound_session(
+            session, a_account,
+            b_id_keys.data() + 15, 43,
+            b_id_keys.data() + 71, 43,
+            b_pre_key.data() + 25, 43,
+            b_pre_key_signature.data(), 86,
+            b_ot_key, 43,
+            rand.data(), rand.size()
+        );
+        std::vector<std::uint8_t> message(::olm_encrypt_message_length(session, 5));
+        rand.resize(::olm_encrypt_random_length(session));
+        mock_random_a(rand.data(), rand.size());
+        ::olm_encrypt(
+            session, "hello", 5, rand.data(), rand.size(),
+            message.data(), message.size()
+        );
+        ::olm_clear_session(session);
+        return message;
+    };
+
+    std::vector<std::uint8_t> b_session_buffer(::olm_session_size());
+    ::OlmSession *b_session = ::olm_session(b_session_buffer.data());
+    for (std::size_t n : {0, 350, 699}) {
+        std::vector<std::uint8_t> message = pre_key_message(one_time_key(n));
+        std::vector<std::uint8_t> tmp(message);
+        CHECK_NE(std::size_t(-1), ::olm_create_inbound_session(
+            b_session, b_account, tmp.data(), tmp.size()
+        ));
+        CHECK_NE(std::size_t(-1), ::olm_remove_one_time_keys(b_account, b_session));
+        ::olm_clear_session(b_session);
+
+        /* the key has gone */
+        tmp = message;
+        CHECK_EQ(std::size_t(-1), ::olm_create_inbound_session(
+            b_session, b_account, tmp.data(), tmp.size()
+        ));
+        CHECK_EQ(
+            std::string("BAD_MESSAGE_KEY_ID"),
+            std::string(::olm_session_last_error(b_session))
+        );
+        ::olm_clear_session(b_session);
+    }
+
+    /* the index is rebuilt when the account is unpickled */
+    std::size_t pickle_length = ::olm_pickle_account_length(b_account);
+    std::vector<std::uint8_t> pickle(pickle_length);
+    ::olm_pickle_account(b_account, "", 0, pickle.data(), pickle_length);
+    std::vector<std::uint8_t> b_account_buffer2(::olm_account_size());
+    ::OlmAccount *b_account2 = ::olm_account(b_account_buffer2.data());
+    ::olm_unpickle_account(b_account2, "", 0, pickle.data(), pickle_length);
+
+    std::vector<std::uint8_t> message = pre_key_message(one_time_key(500));
+    CHECK_NE(std::size_t(-1), ::olm_create_inbound_session(
+        b_session, b_account2, message.data(), message.size()
+    ));
+    CHECK_NE(std::size_t(-1), ::olm_remove_one_time_keys(b_account2, b_session));
+    ::olm_clear_session(b_session);
+
+    ::olm_clear_account(a_account);
+    ::olm_clear_account(b_account);
+    ::olm_clear_account(b_account2);
+}
+
+TEST_CASE("Pickle key context test") {
+MockRandom mock_random('K');
+
+std::vector<std::uint8_t> account_buffer(::olm_account_size());
+::OlmAccount *account = ::olm_account(account_buffer.data());
+std::vector<std::uint8_t> random(::olm_create_account_random_length(account));
+mock_random(random.data(), random.size());
+::olm_create_account(account, random.data(), random.size());
+
+std::vector<std::uint8_t> key_buffer(::olm_pickle_key_size());
+::OlmPickleKey *pickle_key = ::olm_pickle_key(key_buffer.data(), "secret_key", 10);
+
+/* the pickles are the same as with the raw key */
+std::size_t pickle_length = ::olm_pickle_account_length(account);
+std::vector<std::uint8_t> pickle1(pickle_length);
+std::vector<std::uint8_t> pickle2(pickle_length);
+CHECK_EQ(pickle_length, ::olm_pickle_account(
+    account, "secret_key", 10, pickle1.data(), pickle_length
+));
+CHECK_EQ(pickle_length, ::olm_pickle_account_with_key_context(
+    account, pickle_key, pickle2.data(), pickle_length
+));
+CHECK_EQ_SIZE(pickle1.data(), pickle2.data(), pickle_length);
+
+std::vector<std::uint8_t> account_buffer2(::olm_account_size());
+::OlmAccount *account2 = ::olm_account(account_buffer2.data());
+CHECK_EQ(pickle_length, ::olm_unpickle_account_with_key_context(
+    account2, pickle_key, pickle2.data(), pickle_length
+));
+CHECK_EQ(pickle_length, ::olm_pickle_account(
+    account2, "secret_key", 10, pickle2.data(), pickle_length
+));
+CHECK_EQ_SIZE(pickle1.data(), pickle2.data(), pickle_length);
+
+std::vector<std::uint8_t> wrong_key_buffer(::olm_pickle_key_size());
+::OlmPickleKey *wrong_key = ::olm_pickle_key(wrong_key_buffer.data(), "wrong_key", 9);
+CHECK_EQ(std::size_t(-1), ::olm_unpickle_account_with_key_context(
+    account2, wrong_key, pickle1.data(), pickle_length
+));
+CHECK_EQ(OLM_BAD_ACCOUNT_KEY, ::olm_account_last_error_code(account2));
+
+/* and the same for a session, here to the account itself */
+std::vector<std::uint8_t> o_random(::olm_account_generate_one_time_keys_random_length(
+        account, 1
+));
+mock_random(o_random.data(), o_random.size());
+::olm_account_generate_one_time_keys(account, 1, o_random.data(), o_random.size());
+std::vector<std::uint8_t> p_random(::olm_account_generate_prekey_random_length(
+        account
+));
+mock_random(p_random.data(), p_random.size());
+::olm_account_generate_prekey(account, p_random.data(), p_random.size());
+
+std::vector<std::uint8_t> id_keys(::olm_account_identity_keys_length(account));
+std::vector<std::uint8_t> pre_key(::olm_account_prekey_length(account));
+std::vector<std::uint8_t> pre_key_signature(::olm_account_signature_length(account));
+std::vector<std::uint8_t> ot_keys(::olm_account_one_time_keys_length(account));
+::olm_account_identity_keys(account, id_keys.data(), id_keys.size());
+::olm_account_prekey(account, pre_key.data(), pre_key.size());
+::olm_account_prekey_signature(account, pre_key_signature.data());
+::olm_account_one_time_keys(account, ot_keys.data(), ot_keys.size());
+
+std::vector<std::uint8_t> session_buffer(::olm_session_size());
+::OlmSession *session = ::olm_session(session_buffer.data());
+std::vector<std::uint8_t> session_random(::olm_create_outbound_session_random_length(session));
+mock_random(session_random.data(), session_random.size());
+CHECK_NE(std::size_t(-1), ::olm_create_outbound_session(
+    session, account,
+    id_keys.data() + 15, 43,
+    id_keys.data() + 71, 43,
+    pre_key.data() + 25, 43,
+    pre_key_signature.data(), 86,
+    ot_keys.data() + 25, 43,
+    session_random.data(), session_random.size()
+));
+
+pickle_length = ::olm_pickle_session_length(session);
+pickle1.resize(pickle_length);
+pickle2.resize(pickle_length);
+CHECK_EQ(pickle_length, ::olm_pickle_session(
+    session, "secret_key", 10, pickle1.data(), pickle_length
+));
+CHECK_EQ(pickle_length, ::olm_pickle_session_with_key_context(
+    session, pickle_key, pickle2.data(), pickle_length
+));
+CHECK_EQ_SIZE(pickle1.data(), pickle2.data(), pickle_length);
+
+std::vector<std::uint8_t> session_buffer2(::olm_session_size());
+::OlmSession *session2 = ::olm_session(session_buffer2.data());
+CHECK_EQ(pickle_length, ::olm_unpickle_session_with_key_context(
+    session2, pickle_key, pickle2.data(), pickle_length
+));
+CHECK_EQ(pickle_length, ::olm_pickle_session_with_key_context(
+    session2, pickle_key, pickle2.data(), pickle_length
+));
+CHECK_EQ_SIZE(pickle1.data(), pickle2.data(), pickle_length);
+
+CHECK_EQ(std::size_t(-1), ::olm_unpickle_session_with_key_context(
+    session2, wrong_key, pickle1.data(), pickle_length
+));
+CHECK_EQ(OLM_BAD_ACCOUNT_KEY, ::olm_session_last_error_code(session2));
+
+::olm_clear_pickle_key(pickle_key);
+::olm_clear_pickle_key(wrong_key);
+::olm_clear_session(session);
+::olm_clear_session(session2);
+::olm_clear_account(account);
+::olm_clear_account(account2);
+}
+
+TEST_CASE("Session delta test") {
+MockRandom mock_random_a('A', 0x00);
+MockRandom mock_random_b('B', 0x80);
+
+std::vector<std::uint8_t> a_account_buffer(::olm_account_size());
+::OlmAccount *a_account = ::olm_account(a_account_buffer.data());
+std::vector<std::uint8_t> a_random(::olm_create_account_random_length(a_account));
+mock_random_a(a_random.data(), a_random.size());
+::olm_create_account(a_account, a_random.data(), a_random.size());
+
+std::vector<std::uint8_t> b_account_buffer(::olm_account_size());
+::OlmAccount *b_account = ::olm_account(b_account_buffer.data());
+std::vector<std::uint8_t> b_random(::olm_create_account_random_length(b_account));
+mock_random_b(b_random.data(), b_random.size());
+::olm_create_account(b_account, b_random.data(), b_random.size());
+std::vector<std::uint8_t> o_random(::olm_account_generate_one_time_keys_random_length(
+        b_account, 1
+));
+mock_random_b(o_random.data(), o_random.size());
+::olm_account_generate_one_time_keys(b_account, 1, o_random.data(), o_random.size());
+
+std::vector<std::uint8_t> p_random(::olm_account_generate_prekey_random_length(
+        b_account
+));
+mock_random_b(p_random.data(), p_random.size());
+::olm_account_generate_prekey(b_account, p_random.data(), p_random.size());
+
+std::vector<std::uint8_t> b_id_keys(::olm_account_identity_keys_length(b_account));
+std::vector<std::uint8_t> b_pre_key(::olm_account_prekey_length(b_account));
+std::vector<std::uint8_t> b_pre_key_signature(::olm_account_signature_length(b_account));
+std::vector<std::uint8_t> b_ot_keys(::olm_account_one_time_keys_length(b_account));
+::olm_account_identity_keys(b_account, b_id_keys.data(), b_id_keys.size());
+::olm_account_prekey(b_account, b_pre_key.data(), b_pre_key.size());
+::olm_account_prekey_signature(b_account, b_pre_key_signature.data());
+::olm_account_one_time_keys(b_account, b_ot_keys.data(), b_ot_keys.size());
+
+std::vector<std::uint8_t> a_session_buffer(::olm_session_size());
+::OlmSession *a_session = ::olm_session(a_session_buffer.data());
+std::vector<std::uint8_t> a_rand(::olm_create_outbound_session_random_length(a_session));
+mock_random_a(a_rand.data(), a_rand.size());
+CHECK_NE(std::size_t(-1), ::olm_create_outbound_session(
+    a_session, a_account,
+    b_id_keys.data() + 15, 43,
+    b_id_keys.data() + 71, 43,
+    b_pre_key.data() + 25, 43,
+    b_pre_key_signature.data(), 86,
+    b_ot_keys.data() + 25, 43,
+    a_rand.data(), a_rand.size()
+));
+
+std::uint8_t plaintext[] = "Hello, World";
+std::vector<std::uint8_t> b_session_buffer(::olm_session_size());
+::OlmSession *b_session = ::olm_session(b_session_buffer.data());
+
+auto encrypt = [&](::OlmSession *session, MockRandom & mock_random) {
+    std::vector<std::uint8_t> message(::olm_encrypt_message_length(session, 12));
+    std::vector<std::uint8_t> random(::olm_encrypt_random_length(session));
+    mock_random(random.data(), random.size());
+    CHECK_NE(std::size_t(-1), ::olm_encrypt(
+        session, plaintext, 12, random.data(), random.size(),
+        message.data(), message.size()
+    ));
+    return message;
+};
+auto decrypt = [&](::OlmSession *session, std::size_t type, std::vector<std::uint8_t> message) {
+    std::vector<std::uint8_t> tmp(message);
+    std::vector<std::uint8_t> output(::olm_decrypt_max_plaintext_length(
+        session, type, tmp.data(), tmp.size()
+    ));
+    CHECK_EQ(std::size_t(12), ::olm_decrypt(
+        session, type, message.data(), message.size(), output.data(), output.size()
+    ));
+};
+
+std::vector<std::uint8_t> message_1 = encrypt(a_session, mock_random_a);
+std::vector<std::uint8_t> tmp_message_1(message_1);
+CHECK_NE(std::size_t(-1), ::olm_create_inbound_session(
+    b_session, b_account, tmp_message_1.data(), tmp_message_1.size()
+));
+decrypt(b_session, 0, message_1);
+
+std::vector<std::uint8_t> key_buffer(::olm_pickle_key_size());
+::OlmPickleKey *pickle_key = ::olm_pickle_key(key_buffer.data(), "secret_key", 10);
+
+/* store a base pickle of bob's session, then a delta for each change */
+std::vector<std::uint8_t> base(::olm_pickle_session_binary_length(b_session));
+CHECK_EQ(base.size(), ::olm_pickle_session_binary(
+    b_session, pickle_key, base.data(), base.size()
+));
+
+std::vector<std::vector<std::uint8_t>> deltas;
+auto take_delta = [&]() {
+    std::vector<std::uint8_t> delta(::olm_session_delta_length(b_session));
+    CHECK_EQ(delta.size(), ::olm_session_delta(
+        b_session, pickle_key, delta.data(), delta.size()
+    ));
+    CHECK_EQ(std::size_t(0), ::olm_session_delta_length(b_session));
+    deltas.push_back(delta);
+};
+
+take_delta();
+for (unsigned i = 0; i < 3; ++i) {
+    decrypt(a_session, 1, encrypt(b_session, mock_random_b));
+    take_delta();
+    decrypt(b_session, 1, encrypt(a_session, mock_random_a));
+    take_delta();
+}
+
+/* receiving out of order stores and then uses a skipped message key */
+std::vector<std::uint8_t> message_2 = encrypt(a_session, mock_random_a);
+std::vector<std::uint8_t> message_3 = encrypt(a_session, mock_random_a);
+decrypt(b_session, 1, message_3);
+take_delta();
+decrypt(b_session, 1, message_2);
+take_delta();
+::olm_session_set_max_skipped_message_keys(b_session, 10);
+take_delta();
+
+/* A message on an older receiver chain changes just that chain, and then
+ * limiting the receiver chains drops it. The delta must not refer to the
+ * chain by its old position. */
+std::vector<std::uint8_t> message_4 = encrypt(a_session, mock_random_a);
+decrypt(a_session, 1, encrypt(b_session, mock_random_b));
+decrypt(b_session, 1, encrypt(a_session, mock_random_a));
+take_delta();
+decrypt(b_session, 1, message_4);
+::olm_session_set_max_receiver_chains(b_session, 1);
+take_delta();
+
+/* a delta that doesn't change anything is empty */
+CHECK_EQ(std::size_t(0), ::olm_session_delta(
+    b_session, pickle_key, nullptr, 0
+));
+
+/* bob's session is rebuilt from the base pickle and the deltas */
+std::vector<std::uint8_t> c_session_buffer(::olm_session_size());
+::OlmSession *c_session = ::olm_session(c_session_buffer.data());
+CHECK_EQ(base.size(), ::olm_unpickle_session_binary(
+    c_session, pickle_key, base.data(), base.size()
+));
+for (std::size_t i = 0; i < deltas.size(); ++i) {
+    std::vector<std::uint8_t> delta(deltas[i]);
+    CHECK_EQ(delta.size(), ::olm_session_apply_delta(
+        c_session, pickle_key, delta.data(), delta.size()
+    ));
+}
+
+std::vector<std::uint8_t> b_pickle(::olm_pickle_session_binary_length(b_session));
+std::vector<std::uint8_t> c_pickle(::olm_pickle_session_binary_length(c_session));
+CHECK_EQ(b_pickle.size(), c_pickle.size());
+CHECK_EQ(b_pickle.size(), ::olm_pickle_session_binary(
+    b_session, pickle_key, b_pickle.data(), b_pickle.size()
+));
+CHECK_EQ(c_pickle.size(), ::olm_pickle_session_binary(
+    c_session, pickle_key, c_pickle.data(), c_pickle.size()
+));
+CHECK_EQ_SIZE(b_pickle.data(), c_pickle.data(), b_pickle.size());
+
+/* the rebuilt session carries on where bob's left off */
+decrypt(c_session, 1, encrypt(a_session, mock_random_a));
+
+/* deltas must be applied in order */
+std::vector<std::uint8_t> replayed(deltas.back());
+CHECK_EQ(std::size_t(-1), ::olm_session_apply_delta(
+    c_session, pickle_key, replayed.data(), replayed.size()
+));
+CHECK_EQ(OLM_DELTA_OUT_OF_ORDER, ::olm_session_last_error_code(c_session));
+
+::olm_clear_pickle_key(pickle_key);
+::olm_clear_session(a_session);
+::olm_clear_session(b_session);
+::olm_clear_session(c_session);
+::olm_clear_account(a_account);
+::olm_clear_account(b_account);
+}
+
+TEST_CASE("Peek message headers test") {
+MockRandom mock_random_a('A', 0x00);
+MockRandom mock_random_b('B', 0x80);
+
+std::vector<std::uint8_t> a_account_buffer(::olm_account_size());
+::OlmAccount *a_account = ::olm_account(a_account_buffer.data());
+std::vector<std::uint8_t> a_random(::olm_create_account_random_length(a_account));
+mock_random_a(a_random.data(), a_random.size());
+::olm_create_account(a_account, a_random.data(), a_random.size());
+
+std::vector<std::uint8_t> b_account_buffer(::olm_account_size());
+::OlmAccount *b_account = ::olm_account(b_account_buffer.data());
+std::vector<std::uint8_t> b_random(::olm_create_account_random_length(b_account));
+mock_random_b(b_random.data(), b_random.size());
+::olm_create_account(b_account, b_random.data(), b_random.size());
+std::vector<std::uint8_t> o_random(::olm_account_generate_one_time_keys_random_length(
+        b_account, 1
+));
+mock_random_b(o_random.data(), o_random.size());
+::olm_account_generate_one_time_keys(b_account, 1, o_random.data(), o_random.size());
+
+std::vector<std::uint8_t> p_random(::olm_account_generate_prekey_random_length(
+        b_account
+));
+mock_random_b(p_random.data(), p_random.size());
+::olm_account_generate_prekey(b_account, p_random.data(), p_random.size());
+
+std::vector<std::uint8_t> a_id_keys(::olm_account_identity_keys_length(a_account));
+std::vector<std::uint8_t> b_id_keys(::olm_account_identity_keys_length(b_account));
+std::vector<std::uint8_t> b_pre_key(::olm_account_prekey_length(b_account));
+std::vector<std::uint8_t> b_pre_key_signature(::olm_account_signature_length(b_account));
+std::vector<std::uint8_t> b_ot_keys(::olm_account_one_time_keys_length(b_account));
+::olm_account_identity_keys(a_account, a_id_keys.data(), a_id_keys.size());
+::olm_account_identity_keys(b_account, b_id_keys.data(), b_id_keys.size());
+::olm_account_prekey(b_account, b_pre_key.data(), b_pre_key.size());
+::olm_account_prekey_signature(b_account, b_pre_key_signature.data());
+::olm_account_one_time_keys(b_account, b_ot_keys.data(), b_ot_keys.size());
+
+std::vector<std::uint8_t> a_session_buffer(::olm_session_size());
+::OlmSession *a_session = ::olm_session(a_session_buffer.data());
+std::vector<std::uint8_t> a_rand(::olm_create_outbound_session_random_length(a_session));
+mock_random_a(a_rand.data(), a_rand.size());
+CHECK_NE(std::size_t(-1), ::olm_create_outbound_session(
+    a_session, a_account,
+    b_id_keys.data() + 15, 43,
+    b_id_keys.data() + 71, 43,
+    b_pre_key.data() + 25, 43,
+    b_pre_key_signature.data(), 86,
+    b_ot_keys.data() + 25, 43,
+    a_rand.data(), a_rand.size()
+));
+
+/* long enough that only the start of it is decoded */
+std::vector<std::uint8_t> plaintext(1000, 'x');
+std::vector<std::uint8_t> message(::olm_encrypt_message_length(a_session, plaintext.size()));
+std::vector<std::uint8_t> message_random(::olm_encrypt_random_length(a_session));
+mock_random_a(message_random.data(), message_random.size());
+CHECK_NE(std::size_t(-1), ::olm_encrypt(
+    a_session, plaintext.data(), plaintext.size(),
+    message_random.data(), message_random.size(),
+    message.data(), message.size()
+));
+std::vector<std::uint8_t> const original(message);
+
+::OlmMessageHeaders headers;
+CHECK_EQ(OLM_SUCCESS, ::olm_peek_message(
+    OLM_MESSAGE_TYPE_PRE_KEY, message.data(), message.size(), &headers
+));
+CHECK_EQ(original, message);
+CHECK_EQ(3, headers.version);
+CHECK_EQ(std::uint32_t(0), headers.counter);
+
+std::uint8_t key[OLM_MESSAGE_HEADER_KEY_LENGTH];
+::_olm_decode_base64(a_id_keys.data() + 15, 43, key);
+CHECK_EQ_SIZE(key, headers.identity_key, sizeof(key));
+::_olm_decode_base64(b_ot_keys.data() + 25, 43, key);
+CHECK_EQ_SIZE(key, headers.one_time_key, sizeof(key));
+::_olm_decode_base64(b_pre_key.data() + 25, 43, key);
+CHECK_EQ_SIZE(key, headers.prekey, sizeof(key));
+
+/* the same headers from the decoded message */
+std::vector<std::uint8_t> raw(::_olm_decode_base64_length(message.size()));
+::_olm_decode_base64(message.data(), message.size(), raw.data());
+::OlmMessageHeaders raw_headers;
+CHECK_EQ(OLM_SUCCESS, ::olm_peek_message_raw(
+    OLM_MESSAGE_TYPE_PRE_KEY, raw.data(), raw.size(), &raw_headers
+));
+CHECK_EQ_SIZE(
+    reinterpret_cast<std::uint8_t *>(&headers),
+    reinterpret_cast<std::uint8_t *>(&raw_headers), sizeof(headers)
+);
+
+/* a pre-key message holds a normal message */
+CHECK_EQ(OLM_BAD_MESSAGE_FORMAT, ::olm_peek_message_raw(
+    OLM_MESSAGE_TYPE_MESSAGE, raw.data(), raw.size(), &raw_headers
+));
+CHECK_EQ(OLM_BAD_MESSAGE_FORMAT, ::olm_peek_message_raw(
+    2, raw.data(), raw.size(), &raw_headers
+));
+CHECK_EQ(OLM_INVALID_BASE64, ::olm_peek_message(
+    OLM_MESSAGE_TYPE_PRE_KEY, message.data(), 5, &headers
+));
+
+/* the reply is a normal message */
+std::vector<std::uint8_t> b_session_buffer(::olm_session_size());
+::OlmSession *b_session = ::olm_session(b_session_buffer.data());
+std::memcpy(message.data(), original.data(), original.size());
+CHECK_NE(std::size_t(-1), ::olm_create_inbound_session(
+    b_session, b_account, message.data(), message.size()
+));
+std::memcpy(message.data(), original.data(), original.size());
+std::vector<std::uint8_t> decrypted(plaintext.size() + 16);
+CHECK_EQ(plaintext.size(), ::olm_decrypt(
+    b_session, OLM_MESSAGE_TYPE_PRE_KEY, message.data(), message.size(),
+    decrypted.data(), decrypted.size()
+));
+
+std::vector<std::uint8_t> reply(::olm_encrypt_message_length(b_session, 5));
+std::vector<std::uint8_t> reply_random(::olm_encrypt_random_length(b_session));
+mock_random_b(reply_random.data(), reply_random.size());
+CHECK_EQ(std::size_t(1), ::olm_encrypt_message_type(b_session));
+CHECK_NE(std::size_t(-1), ::olm_encrypt(
+    b_session, plaintext.data(), 5,
+    reply_random.data(), reply_random.size(),
+    reply.data(), reply.size()
+));
+CHECK_EQ(OLM_SUCCESS, ::olm_peek_message(
+    OLM_MESSAGE_TYPE_MESSAGE, reply.data(), reply.size(), &headers
+));
+CHECK_EQ(3, headers.version);
+CHECK_EQ(std::uint32_t(0), headers.counter);
+std::uint8_t zero[OLM_MESSAGE_HEADER_KEY_LENGTH] = {};
+CHECK_EQ_SIZE(zero, headers.identity_key, sizeof(zero));
+
+::olm_clear_session(a_session);
+::olm_clear_session(b_session);
+::olm_clear_account(a_account);
+::olm_clear_account(b_account);
+}
+
+TEST_CASE("Session index test") {
+MockRandom mock_random_a('A', 0x00);
+MockRandom mock_random_b('B', 0x80);
+
+std::vector<std::uint8_t> a_account_buffer(::olm_account_size());
+::OlmAccount *a_account = ::olm_account(a_account_buffer.data());
+std::vector<std::uint8_t> a_random(::olm_create_account_random_length(a_account));
+mock_random_a(a_random.data(), a_random.size());
+::olm_create_account(a_account, a_random.data(), a_random.size());
+
+std::vector<std::uint8_t> b_account_buffer(::olm_account_size());
+::OlmAccount *b_account = ::olm_account(b_account_buffer.data());
+std::vector<std::uint8_t> b_random(::olm_create_account_random_length(b_account));
+mock_random_b(b_random.data(), b_random.size());
+::olm_create_account(b_account, b_random.data(), b_random.size());
+std::vector<std::uint8_t> o_random(::olm_account_generate_one_time_keys_random_length(
+        b_account, 3
+));
+mock_random_b(o_random.data(), o_random.size());
+::olm_account_generate_one_time_keys(b_account, 3, o_random.data(), o_random.size());
+
+std::vector<std::uint8_t> p_random(::olm_account_generate_prekey_random_length(
+        b_account
+));
+mock_random_b(p_random.data(), p_random.size());
+::olm_account_generate_prekey(b_account, p_random.data(), p_random.size());
+
+std::vector<std::uint8_t> a_id_keys(::olm_account_identity_keys_length(a_account));
+std::vector<std::uint8_t> b_id_keys(::olm_account_identity_keys_length(b_account));
+std::vector<std::uint8_t> b_pre_key(::olm_account_prekey_length(b_account));
+std::vector<std::uint8_t> b_pre_key_signature(::olm_account_signature_length(b_account));
+std::vector<std::uint8_t> b_ot_keys(::olm_account_one_time_keys_length(b_account));
+::olm_account_identity_keys(a_account, a_id_keys.data(), a_id_keys.size());
+::olm_account_identity_keys(b_account, b_id_keys.data(), b_id_keys.size());
+::olm_account_prekey(b_account, b_pre_key.data(), b_pre_key.size());
+::olm_account_prekey_signature(b_account, b_pre_key_signature.data());
+::olm_account_one_time_keys(b_account, b_ot_keys.data(), b_ot_keys.size());
+
+std::vector<std::uint8_t> index_buffer(::olm_session_index_size());
+::OlmSessionIndex *index = ::olm_session_index(index_buffer.data());
+
+/* sessions that have never been set up all have the same id, and fill the
+ * index up past its first size */
+std::vector<std::vector<std::uint8_t>> blank_buffers(40);
+for (auto & buffer : blank_buffers) {
+    buffer.resize(::olm_session_size());
+    ::olm_session(buffer.data());
+    CHECK_EQ(std::size_t(0), ::olm_session_index_add(
+        index, reinterpret_cast<::OlmSession *>(buffer.data())
+    ));
+}
+
+/* one session for each of Bob's one time keys */
+std::vector<std::vector<std::uint8_t>> a_session_buffers(3);
+std::vector<std::vector<std::uint8_t>> b_session_buffers(3);
+std::vector<std::vector<std::uint8_t>> messages(3);
+for (unsigned i = 0; i < 3; ++i) {
+    a_session_buffers[i].resize(::olm_session_size());
+    ::OlmSession *a_session = ::olm_session(a_session_buffers[i].data());
+    std::vector<std::uint8_t> a_rand(::olm_create_outbound_session_random_length(a_session));
+    mock_random_a(a_rand.data(), a_rand.size());
+    CHECK_NE(std::size_t(-1), ::olm_create_outbound_session(
+        a_session, a_account,
+        b_id_keys.data() + 15, 43,
+        b_id_keys.data() + 71, 43,
+        b_pre_key.data() + 25, 43,
+        b_pre_key_signature.data(), 86,
+        b_ot_keys.data() + 25 + 55 * i, 43,
+        a_rand.data(), a_rand.size()
+    ));
+
+    std::uint8_t plaintext[] = "Hello, World";
+    messages[i].resize(::olm_encrypt_message_length(a_session, 12));
+    std::vector<std::uint8_t> message_random(::olm_encrypt_random_length(a_session));
+    mock_random_a(message_random.data(), message_random.size());
+    CHECK_NE(std::size_t(-1), ::olm_encrypt(
+        a_session, plaintext, 12,
+        message_random.data(), message_random.size(),
+        messages[i].data(), messages[i].size()
+    ));
+
+    b_session_buffers[i].resize(::olm_session_size());
+    ::OlmSession *b_session = ::olm_session(b_session_buffers[i].data());
+    std::vector<std::uint8_t> tmp(messages[i]);
+    CHECK_NE(std::size_t(-1), ::olm_create_inbound_session(
+        b_session, b_account, tmp.data(), tmp.size()
+    ));
+    CHECK_EQ(std::size_t(0), ::olm_session_index_add(index, b_session));
+    /* adding it again does nothing */
+    CHECK_EQ(std::size_t(0), ::olm_session_index_add(index, b_session));
+}
+CHECK_EQ(std::size_t(43), ::olm_session_index_count(index));
+
+/* each message finds its own session, and is left intact */
+for (unsigned i = 0; i < 3; ++i) {
+    ::OlmSession *b_session = reinterpret_cast<::OlmSession *>(
+        b_session_buffers[i].data()
+    );
+    std::vector<std::uint8_t> const original(messages[i]);
+    ::OlmSession *found = nullptr;
+    CHECK_EQ(std::size_t(1), ::olm_session_index_find_inbound(
+        index, nullptr, 0, messages[i].data(), messages[i].size(), &found
+    ));
+    CHECK_EQ(b_session, found);
+    CHECK_EQ(original, messages[i]);
+
+    found = nullptr;
+    CHECK_EQ(std::size_t(1), ::olm_session_index_find_inbound(
+        index, a_id_keys.data() + 15, 43,
+        messages[i].data(), messages[i].size(), &found
+    ));
+    CHECK_EQ(b_session, found);
+
+    /* the message isn't from Bob */
+    CHECK_EQ(std::size_t(0), ::olm_session_index_find_inbound(
+        index, b_id_keys.data() + 15, 43,
+        messages[i].data(), messages[i].size(), &found
+    ));
+    CHECK_EQ(static_cast<::OlmSession *>(nullptr), found);
+}
+
+/* removing the blank sessions moves the others about in the index */
+for (unsigned i = 0; i < 40; i += 2) {
+    CHECK_EQ(std::size_t(1), ::olm_session_index_remove(
+        index, reinterpret_cast<::OlmSession *>(blank_buffers[i].data())
+    ));
+}
+::OlmSession *b_session_1 = reinterpret_cast<::OlmSession *>(
+    b_session_buffers[1].data()
+);
+CHECK_EQ(std::size_t(1), ::olm_session_index_remove(index, b_session_1));
+CHECK_EQ(std::size_t(0), ::olm_session_index_remove(index, b_session_1));
+CHECK_EQ(std::size_t(22), ::olm_session_index_count(index));
+
+for (unsigned i = 0; i < 3; ++i) {
+    ::OlmSession *found = nullptr;
+    CHECK_EQ(std::size_t(i == 1 ? 0 : 1), ::olm_session_index_find_inbound(
+        index, nullptr, 0, messages[i].data(), messages[i].size(), &found
+    ));
+    CHECK_EQ(
+        i == 1 ? nullptr : reinterpret_cast<::OlmSession *>(
+            b_session_buffers[i].data()
+        ),
+        found
+    );
+}
+
+::OlmSession *found = nullptr;
+CHECK_EQ(std::size_t(-1), ::olm_session_index_find_inbound(
+    index, nullptr, 0, messages[0].data(), 5, &found
+));
+CHECK_EQ(OLM_INVALID_BASE64, ::olm_session_index_last_error_code(index));
+CHECK_EQ(std::size_t(-1), ::olm_session_index_find_inbound(
+    index, nullptr, 0, messages[0].data(), 8, &found
+));
+CHECK_EQ(OLM_BAD_MESSAGE_FORMAT, ::olm_session_index_last_error_code(index));
+
+/* the keys alone aren't enough, as for olm_matches_inbound_session */
+CHECK_EQ(std::size_t(-1), ::olm_session_index_find_inbound(
+    index, nullptr, 0, messages[0].data(), 183, &found
+));
+CHECK_EQ(OLM_BAD_MESSAGE_FORMAT, ::olm_session_index_last_error_code(index));
+
+/* the version is in the top bits of the first character */
+std::vector<std::uint8_t> other_version(messages[0]);
+other_version[0] = 'Q';
+CHECK_EQ(std::size_t(-1), ::olm_session_index_find_inbound(
+    index, nullptr, 0, other_version.data(), other_version.size(), &found
+));
+CHECK_EQ(OLM_BAD_MESSAGE_VERSION, ::olm_session_index_last_error_code(index));
+CHECK_EQ(static_cast<::OlmSession *>(nullptr), found);
+
+::olm_clear_session_index(index);
+CHECK_EQ(std::size_t(0), ::olm_session_index_count(index));
+for (auto & buffer : b_session_buffers) {
+    ::olm_clear_session(reinterpret_cast<::OlmSession *>(buffer.data()));
+}
+for (auto & buffer : a_session_buffers) {
+    ::olm_clear_session(reinterpret_cast<::OlmSession *>(buffer.data()));
+}
+::olm_clear_account(a_account);
+::olm_clear_account(b_account);
+}
+
+/* Sends enough messages on the session in context before running the tasks
+ * that the counter in its next message takes another byte. */
+static void growing_parallel_for(
+    void * context, std::size_t task_count,
+    void (*task)(void * task_context, std::size_t index), void * task_context
+) {
+    ::OlmSession * session = static_cast<::OlmSession *>(context);
+    std::uint8_t plaintext[] = "Hello, World";
+    for (std::size_t i = 0; i < 128; ++i) {
+        std::vector<std::uint8_t> message(::olm_encrypt_message_length(session, 12));
+        ::olm_encrypt(session, plaintext, 12, nullptr, 0, message.data(), message.size());
+    }
+    for (std::size_t i = 0; i < task_count; ++i) {
+        task(task_context, i);
+    }
+}
+
+TEST_CASE("Fan-out encryption test") {
+MockRandom mock_random_a('A', 0x00);
+MockRandom mock_random_b('B', 0x80);
+std::size_t const session_count = 20;
+
+std::vector<std::uint8_t> a_account_buffer(::olm_account_size());
+::OlmAccount *a_account = ::olm_account(a_account_buffer.data());
+std::vector<std::uint8_t> a_random(::olm_create_account_random_length(a_account));
+mock_random_a(a_random.data(), a_random.size());
+::olm_create_account(a_account, a_random.data(), a_random.size());
+
+std::vector<std::uint8_t> b_account_buffer(::olm_account_size());
+::OlmAccount *b_account = ::olm_account(b_account_buffer.data());
+std::vector<std::uint8_t> b_random(::olm_create_account_random_length(b_account));
+mock_random_b(b_random.data(), b_random.size());
+::olm_create_account(b_account, b_random.data(), b_random.size());
+std::vector<std::uint8_t> o_random(::olm_account_generate_one_time_keys_random_length(
+        b_account, session_count
+));
+mock_random_b(o_random.data(), o_random.size());
+::olm_account_generate_one_time_keys(
+    b_account, session_count, o_random.data(), o_random.size()
+);
+
+std::vector<std::uint8_t> p_random(::olm_account_generate_prekey_random_length(
+        b_account
+));
+mock_random_b(p_random.data(), p_random.size());
+::olm_account_generate_prekey(b_account, p_random.data(), p_random.size());
+
+std::vector<std::uint8_t> b_id_keys(::olm_account_identity_keys_length(b_account));
+std::vector<std::uint8_t> b_pre_key(::olm_account_prekey_length(b_account));
+std::vector<std::uint8_t> b_pre_key_signature(::olm_account_signature_length(b_account));
+std::vector<std::uint8_t> b_ot_keys(::olm_account_one_time_keys_length(b_account));
+::olm_account_identity_keys(b_account, b_id_keys.data(), b_id_keys.size());
+::olm_account_prekey(b_account, b_pre_key.data(), b_pre_key.size());
+::olm_account_prekey_signature(b_account, b_pre_key_signature.data());
+::olm_account_one_time_keys(b_account, b_ot_keys.data(), b_ot_keys.size());
+
+/* Bob has an inbound session with each of Alice's sessions, and hasn't sent
+ * anything yet, so each of his sessions needs random bytes to reply. A copy
+ * of each of Bob's sessions encrypts the same replies with olm_encrypt(). */
+std::vector<std::vector<std::uint8_t>> a_session_buffers(session_count);
+std::vector<std::vector<std::uint8_t>> b_session_buffers(session_count);
+std::vector<std::vector<std::uint8_t>> b_copy_buffers(session_count);
+std::vector<::OlmSession *> a_sessions(session_count);
+std::vector<::OlmSession *> b_sessions(session_count);
+std::vector<::OlmSession *> b_copies(session_count);
+std::uint8_t plaintext[] = "Hello, World";
+for (std::size_t i = 0; i < session_count; ++i) {
+    a_session_buffers[i].resize(::olm_session_size());
+    a_sessions[i] = ::olm_session(a_session_buffers[i].data());
+    std::vector<std::uint8_t> a_rand(::olm_create_outbound_session_random_length(a_sessions[i]));
+    mock_random_a(a_rand.data(), a_rand.size());
+    CHECK_NE(std::size_t(-1), ::olm_create_outbound_session(
+        a_sessions[i], a_account,
+        b_id_keys.data() + 15, 43,
+        b_id_keys.data() + 71, 43,
+        b_pre_key.data() + 25, 43,
+        b_pre_key_signature.data(), 86,
+        b_ot_keys.data() + 25 + 55 * i, 43,
+        a_rand.data(), a_rand.size()
+    ));
+
+    std::vector<std::uint8_t> message(::olm_encrypt_message_length(a_sessions[i], 12));
+    std::vector<std::uint8_t> message_random(::olm_encrypt_random_length(a_sessions[i]));
+    mock_random_a(message_random.data(), message_random.size());
+    CHECK_NE(std::size_t(-1), ::olm_encrypt(
+        a_sessions[i], plaintext, 12,
+        message_random.data(), message_random.size(),
+        message.data(), message.size()
+    ));
+
+    b_session_buffers[i].resize(::olm_session_size());
+    b_sessions[i] = ::olm_session(b_session_buffers[i].data());
+    std::vector<std::uint8_t> tmp(message);
+    CHECK_NE(std::size_t(-1), ::olm_create_inbound_session(
+        b_sessions[i], b_account, tmp.data(), tmp.size()
+    ));
+    std::uint8_t decrypted[64];
+    CHECK_EQ(std::size_t(12), ::olm_decrypt(
+        b_sessions[i], OLM_MESSAGE_TYPE_PRE_KEY, message.data(), message.size(),
+        decrypted, sizeof(decrypted)
+    ));
+
+    std::vector<std::uint8_t> pickle(::olm_pickle_session_length(b_sessions[i]));
+    ::olm_pickle_session(b_sessions[i], "", 0, pickle.data(), pickle.size());
+    b_copy_buffers[i].resize(::olm_session_size());
+    b_copies[i] = ::olm_session(b_copy_buffers[i].data());
+    CHECK_NE(std::size_t(-1), ::olm_unpickle_session(
+        b_copies[i], "", 0, pickle.data(), pickle.size()
+    ));
+}
+
+std::size_t random_length = ::olm_encrypt_fan_out_random_length(
+    b_sessions.data(), session_count
+);
+CHECK_EQ(session_count * ::olm_encrypt_random_length(b_sessions[0]), random_length);
+std::vector<std::uint8_t> random(random_length);
+mock_random_b(random.data(), random.size());
+std::vector<std::uint8_t> const original_random(random);
+
+std::size_t messages_length = ::olm_encrypt_fan_out_length(
+    b_sessions.data(), session_count, 12
+);
+std::vector<std::uint8_t> messages(messages_length);
+std::vector<std::size_t> offsets(session_count);
+std::vector<std::size_t> lengths(session_count);
+
+/* nothing is encrypted if the buffers are too small */
+CHECK_EQ(std::size_t(-1), ::olm_encrypt_fan_out(
+    b_sessions.data(), session_count, plaintext, 12,
+    random.data(), random.size() - 1,
+    messages.data(), messages.size(),
+    offsets.data(), lengths.data(), nullptr, nullptr
+));
+CHECK_EQ(OLM_NOT_ENOUGH_RANDOM, ::olm_session_last_error_code(b_sessions[0]));
+random = original_random;
+CHECK_EQ(std::size_t(-1), ::olm_encrypt_fan_out(
+    b_sessions.data(), session_count, plaintext, 12,
+    random.data(), random.size(),
+    messages.data(), messages.size() - 1,
+    offsets.data(), lengths.data(), nullptr, nullptr
+));
+CHECK_EQ(OLM_OUTPUT_BUFFER_TOO_SMALL, ::olm_session_last_error_code(b_sessions[19]));
+CHECK_EQ(random_length, ::olm_encrypt_fan_out_random_length(
+    b_sessions.data(), session_count
+));
+
+random = original_random;
+std::size_t task_count = 0;
+CHECK_EQ(messages_length, ::olm_encrypt_fan_out(
+    b_sessions.data(), session_count, plaintext, 12,
+    random.data(), random.size(),
+    messages.data(), messages.size(),
+    offsets.data(), lengths.data(),
+    reverse_parallel_for, &task_count
+));
+CHECK_EQ(std::size_t(2), task_count);
+
+std::size_t random_offset = 0;
+for (std::size_t i = 0; i < session_count; ++i) {
+    CHECK_EQ(i ? offsets[i - 1] + lengths[i - 1] : 0, offsets[i]);
+
+    std::vector<std::uint8_t> message_random(
+        original_random.begin() + random_offset,
+        original_random.begin() + random_offset
+            + ::olm_encrypt_random_length(b_copies[i])
+    );
+    random_offset += message_random.size();
+    std::vector<std::uint8_t> expected(::olm_encrypt_message_length(b_copies[i], 12));
+    CHECK_EQ(lengths[i], ::olm_encrypt(
+        b_copies[i], plaintext, 12,
+        message_random.data(), message_random.size(),
+        expected.data(), expected.size()
+    ));
+    CHECK_EQ_SIZE(expected.data(), messages.data() + offsets[i], lengths[i]);
+
+    CHECK_EQ(std::size_t(1), ::olm_encrypt_message_type(b_sessions[i]));
+    std::uint8_t decrypted[64];
+    CHECK_EQ(std::size_t(12), ::olm_decrypt(
+        a_sessions[i], OLM_MESSAGE_TYPE_MESSAGE,
+        messages.data() + offsets[i], lengths[i],
+        decrypted, sizeof(decrypted)
+    ));
+    CHECK_EQ_SIZE(plaintext, decrypted, 12);
+}
+CHECK_EQ(random_length, random_offset);
+
+/* a message that no longer fits its slot fails without touching the next */
+CHECK_EQ(std::size_t(0), ::olm_encrypt_fan_out_random_length(
+    b_sessions.data(), session_count
+));
+messages_length = ::olm_encrypt_fan_out_length(
+    b_sessions.data(), session_count, 12
+);
+messages.assign(messages_length, 0);
+CHECK_EQ(std::size_t(-1), ::olm_encrypt_fan_out(
+    b_sessions.data(), session_count, plaintext, 12,
+    nullptr, 0, messages.data(), messages.size(),
+    offsets.data(), lengths.data(),
+    growing_parallel_for, b_sessions[0]
+));
+CHECK_EQ(OLM_OUTPUT_BUFFER_TOO_SMALL, ::olm_session_last_error_code(b_sessions[0]));
+CHECK_EQ(std::size_t(-1), lengths[0]);
+for (std::size_t i = 1; i < session_count; ++i) {
+    std::uint8_t decrypted[64];
+    CHECK_EQ(std::size_t(12), ::olm_decrypt(
+        a_sessions[i], OLM_MESSAGE_TYPE_MESSAGE,
+        messages.data() + offsets[i], lengths[i],
+        decrypted, sizeof(decrypted)
+    ));
+}
+
+for (std::size_t i = 0; i < session_count; ++i) {
+    ::olm_clear_session(a_sessions[i]);
+    ::olm_clear_session(b_sessions[i]);
+    ::olm_clear_session(b_copies[i]);
+}
+::olm_clear_account(a_account);
+::olm_clear_account(b_account);
+}
+
+TEST_CASE("Ratchet key pool test") {
+MockRandom mock_random_a('A', 0x00);
+MockRandom mock_random_b('B', 0x80);
+
+std::vector<std::uint8_t> a_account_buffer(::olm_account_size());
+::OlmAccount *a_account = ::olm_account(a_account_buffer.data());
+std::vector<std::uint8_t> a_random(::olm_create_account_random_length(a_account));
+mock_random_a(a_random.data(), a_random.size());
+::olm_create_account(a_account, a_random.data(), a_random.size());
+
+std::vector<std::uint8_t> b_account_buffer(::olm_account_size());
+::OlmAccount *b_account = ::olm_account(b_account_buffer.data());
+std::vector<std::uint8_t> b_random(::olm_create_account_random_length(b_account));
+mock_random_b(b_random.data(), b_random.size());
+::olm_create_account(b_account, b_random.data(), b_random.size());
+std::vector<std::uint8_t> o_random(::olm_account_generate_one_time_keys_random_length(
+        b_account, 1
+));
+mock_random_b(o_random.data(), o_random.size());
+::olm_account_generate_one_time_keys(b_account, 1, o_random.data(), o_random.size());
+
+std::vector<std::uint8_t> p_random(::olm_account_generate_prekey_random_length(
+        b_account
+));
+mock_random_b(p_random.data(), p_random.size());
+::olm_account_generate_prekey(b_account, p_random.data(), p_random.size());
+
+std::vector<std::uint8_t> b_id_keys(::olm_account_identity_keys_length(b_account));
+std::vector<std::uint8_t> b_pre_key(::olm_account_prekey_length(b_account));
+std::vector<std::uint8_t> b_pre_key_signature(::olm_account_signature_length(b_account));
+std::vector<std::uint8_t> b_ot_keys(::olm_account_one_time_keys_length(b_account));
+::olm_account_identity_keys(b_account, b_id_keys.data(), b_id_keys.size());
+::olm_account_prekey(b_account, b_pre_key.data(), b_pre_key.size());
+::olm_account_prekey_signature(b_account, b_pre_key_signature.data());
+::olm_account_one_time_keys(b_account, b_ot_keys.data(), b_ot_keys.size());
+
+std::vector<std::uint8_t> a_session_buffer(::olm_session_size());
+::OlmSession *a_session = ::olm_session(a_session_buffer.data());
+std::vector<std::uint8_t> a_rand(::olm_create_outbound_session_random_length(a_session));
+mock_random_a(a_rand.data(), a_rand.size());
+CHECK_NE(std::size_t(-1), ::olm_create_outbound_session(
+    a_session, a_account,
+    b_id_keys.data() + 15, 43,
+    b_id_keys.data() + 71, 43,
+    b_pre_key.data() + 25, 43,
+    b_pre_key_signature.data(), 86,
+    b_ot_keys.data() + 25, 43,
+    a_rand.data(), a_rand.size()
+));
+
+std::uint8_t plaintext[] = "Hello, World";
+std::vector<std::uint8_t> message(::olm_encrypt_message_length(a_session, 12));
+std::vector<std::uint8_t> message_random(::olm_encrypt_random_length(a_session));
+mock_random_a(message_random.data(), message_random.size());
+CHECK_NE(std::size_t(-1), ::olm_encrypt(
+    a_session, plaintext, 12,
+    message_random.data(), message_random.size(),
+    message.data(), message.size()
+));
+
+std::vector<std::uint8_t> b_session_buffer(::olm_session_size());
+::OlmSession *b_session = ::olm_session(b_session_buffer.data());
+std::vector<std::uint8_t> tmp(message);
+CHECK_NE(std::size_t(-1), ::olm_create_inbound_session(
+    b_session, b_account, tmp.data(), tmp.size()
+));
+std::uint8_t decrypted[64];
+CHECK_EQ(std::size_t(12), ::olm_decrypt(
+    b_session, OLM_MESSAGE_TYPE_PRE_KEY, message.data(), message.size(),
+    decrypted, sizeof(decrypted)
+));
+
+std::vector<std::uint8_t> pool_buffer(::olm_ratchet_key_pool_size());
+::OlmRatchetKeyPool *pool = ::olm_ratchet_key_pool(pool_buffer.data());
+CHECK_EQ(std::size_t(0), ::olm_ratchet_key_pool_count(pool));
+std::size_t refill_length = ::olm_ratchet_key_pool_refill_random_length(pool);
+CHECK_EQ(std::size_t(0), refill_length % 32);
+
+/* only whole keys are made */
+std::vector<std::uint8_t> pool_random(3 * 32 + 5);
+mock_random_b(pool_random.data(), pool_random.size());
+std::vector<std::uint8_t> const first_key_random(
+    pool_random.begin(), pool_random.begin() + 32
+);
+CHECK_EQ(std::size_t(3), ::olm_ratchet_key_pool_refill(
+    pool, pool_random.data(), pool_random.size()
+));
+CHECK_EQ(std::size_t(3), ::olm_ratchet_key_pool_count(pool));
+CHECK_EQ(refill_length - 3 * 32, ::olm_ratchet_key_pool_refill_random_length(pool));
+
+/* Bob's reply uses the first key in the pool, and is the same as the reply
+ * olm_encrypt() makes from the random bytes the key came from */
+std::vector<std::uint8_t> pickle(::olm_pickle_session_length(b_session));
+::olm_pickle_session(b_session, "", 0, pickle.data(), pickle.size());
+std::vector<std::uint8_t> b_copy_buffer(::olm_session_size());
+::OlmSession *b_copy = ::olm_session(b_copy_buffer.data());
+CHECK_NE(std::size_t(-1), ::olm_unpickle_session(
+    b_copy, "", 0, pickle.data(), pickle.size()
+));
+std::vector<std::uint8_t> expected(::olm_encrypt_message_length(b_copy, 12));
+std::vector<std::uint8_t> expected_random(first_key_random);
+CHECK_EQ(expected.size(), ::olm_encrypt(
+    b_copy, plaintext, 12,
+    expected_random.data(), expected_random.size(),
+    expected.data(), expected.size()
+));
+
+std::vector<std::uint8_t> reply(::olm_encrypt_message_length(b_session, 12));
+CHECK_EQ(reply.size(), ::olm_encrypt_with_key_pool(
+    b_session, pool, plaintext, 12, nullptr, 0, reply.data(), reply.size()
+));
+CHECK_EQ(expected, reply);
+CHECK_EQ(std::size_t(2), ::olm_ratchet_key_pool_count(pool));
+
+/* the sender chain is there now, so the next reply doesn't need a key */
+std::vector<std::uint8_t> reply2(::olm_encrypt_message_length(b_session, 12));
+CHECK_EQ(reply2.size(), ::olm_encrypt_with_key_pool(
+    b_session, pool, plaintext, 12, nullptr, 0, reply2.data(), reply2.size()
+));
+CHECK_EQ(std::size_t(2), ::olm_ratchet_key_pool_count(pool));
+
+CHECK_EQ(std::size_t(12), ::olm_decrypt(
+    a_session, OLM_MESSAGE_TYPE_MESSAGE, reply.data(), reply.size(),
+    decrypted, sizeof(decrypted)
+));
+CHECK_EQ_SIZE(plaintext, decrypted, 12);
+CHECK_EQ(std::size_t(12), ::olm_decrypt(
+    a_session, OLM_MESSAGE_TYPE_MESSAGE, reply2.data(), reply2.size(),
+    decrypted, sizeof(decrypted)
+));
+
+/* with an empty pool the random bytes are used instead */
+std::vector<std::uint8_t> empty_pool_buffer(::olm_ratchet_key_pool_size());
+::OlmRatchetKeyPool *empty_pool = ::olm_ratchet_key_pool(empty_pool_buffer.data());
+message.resize(::olm_encrypt_message_length(a_session, 12));
+CHECK_EQ(std::size_t(-1), ::olm_encrypt_with_key_pool(
+    a_session, empty_pool, plaintext, 12, nullptr, 0,
+    message.data(), message.size()
+));
+CHECK_EQ(OLM_NOT_ENOUGH_RANDOM, ::olm_session_last_error_code(a_session));
+message_random.resize(::olm_encrypt_random_length(a_session));
+mock_random_a(message_random.data(), message_random.size());
+CHECK_EQ(message.size(), ::olm_encrypt_with_key_pool(
+    a_session, empty_pool, plaintext, 12,
+    message_random.data(), message_random.size(),
+    message.data(), message.size()
+));
+CHECK_EQ(std::size_t(12), ::olm_decrypt(
+    b_session, OLM_MESSAGE_TYPE_MESSAGE, message.data(), message.size(),
+    decrypted, sizeof(decrypted)
+));
+
+/* Taking turns goes round the pool several times, with Alice and Bob sharing
+ * it since they are on the same thread. */
+for (unsigned i = 0; i < 40; ++i) {
+    ::OlmSession *sender = i % 2 ? a_session : b_session;
+    ::OlmSession *receiver = i % 2 ? b_session : a_session;
+    pool_random.resize(::olm_ratchet_key_pool_refill_random_length(pool));
+    mock_random_b(pool_random.data(), pool_random.size());
+    ::olm_ratchet_key_pool_refill(pool, pool_random.data(), pool_random.size());
+    CHECK_NE(std::size_t(0), ::olm_ratchet_key_pool_count(pool));
+
+    message.resize(::olm_encrypt_message_length(sender, 12));
+    CHECK_EQ(message.size(), ::olm_encrypt_with_key_pool(
+        sender, pool, plaintext, 12, nullptr, 0, message.data(), message.size()
+    ));
+    CHECK_EQ(std::size_t(12), ::olm_decrypt(
+        receiver, OLM_MESSAGE_TYPE_MESSAGE, message.data(), message.size(),
+        decrypted, sizeof(decrypted)
+    ));
+    CHECK_EQ_SIZE(plaintext, decrypted, 12);
+}
+
+::olm_clear_ratchet_key_pool(pool);
+CHECK_EQ(std::size_t(0), ::olm_ratchet_key_pool_count(pool));
+::olm_clear_ratchet_key_pool(empty_pool);
+::olm_clear_session(a_session);
+::olm_clear_session(b_session);
+::olm_clear_session(b_copy);
+::olm_clear_account(a_account);
+::olm_clear_account(b_account);
 }
@@ -87,3 +87,201 @@ free(message);
 
 }
 
+
+TEST_CASE("Batch signing test") {
+
+MockRandom mock_random_a('A', 0x00);
+
+void * account_buffer = check_malloc(::olm_account_size());
+::OlmAccount * account = ::olm_account(account_buffer);
+
+std::size_t random_size = ::olm_create_account_random_length(account);
+void * random = check_malloc(random_size);
+mock_random_a(random, random_size);
+::olm_create_account(account, random, random_size);
+::free(random);
+
+const std::size_t count = 20;
+std::size_t signature_size = ::olm_account_signature_length(account);
+std::uint8_t messages[count][8];
+std::uint8_t signatures[count][86];
+void const * keys[count];
+std::size_t key_lengths[count];
+void const * message_ptrs[count];
+std::size_t message_lengths[count];
+void * signature_ptrs[count];
+std::size_t signature_lengths[count];
+int results[count];
+
+std::size_t id_keys_size = ::olm_account_identity_keys_length(account);
+std::uint8_t * id_keys = (std::uint8_t *) check_malloc(id_keys_size);
+CHECK_NE(std::size_t(-1), ::olm_account_identity_keys(
+    account, id_keys, id_keys_size
+));
+
+CHECK_EQ(sizeof(signatures[0]), signature_size);
+for (std::size_t i = 0; i < count; ++i) {
+    std::memset(messages[i], 'a' + i, sizeof(messages[i]));
+    CHECK_NE(std::size_t(-1), ::olm_account_sign(
+        account, messages[i], sizeof(messages[i]), signatures[i], signature_size
+    ));
+    keys[i] = id_keys + 71;
+    key_lengths[i] = 43;
+    message_ptrs[i] = messages[i];
+    message_lengths[i] = sizeof(messages[i]);
+    signature_ptrs[i] = signatures[i];
+    signature_lengths[i] = signature_size;
+}
+
+olm_clear_account(account);
+free(account_buffer);
+
+void * utility_buffer = check_malloc(::olm_utility_size());
+::OlmUtility * utility = ::olm_utility(utility_buffer);
+
+std::size_t batch_random_size = ::olm_ed25519_verify_batch_random_length(
+    utility, count
+);
+std::uint8_t * batch_random = check_malloc(batch_random_size);
+mock_random_a(batch_random, batch_random_size);
+
+CHECK_EQ(std::size_t(-1), ::olm_ed25519_verify_batch(
+    utility, count, keys, key_lengths, message_ptrs, message_lengths,
+    signature_ptrs, signature_lengths, batch_random, batch_random_size - 1,
+    results
+));
+CHECK_EQ(OLM_NOT_ENOUGH_RANDOM, ::olm_utility_last_error_code(utility));
+
+/* the signature buffers are destroyed, so check copies */
+std::uint8_t signature_copies[count][86];
+std::memcpy(signature_copies, signatures, sizeof(signatures));
+for (std::size_t i = 0; i < count; ++i) {
+    signature_ptrs[i] = signature_copies[i];
+}
+CHECK_EQ(std::size_t(0), ::olm_ed25519_verify_batch(
+    utility, count, keys, key_lengths, message_ptrs, message_lengths,
+    signature_ptrs, signature_lengths, batch_random, batch_random_size,
+    results
+));
+for (std::size_t i = 0; i < count; ++i) {
+    CHECK_EQ(1, results[i]);
+    signature_ptrs[i] = signatures[i];
+}
+
+/* a message that does not match its signature */
+messages[5][0] = 'z';
+CHECK_EQ(std::size_t(-1), ::olm_ed25519_verify_batch(
+    utility, count, keys, key_lengths, message_ptrs, message_lengths,
+    signature_ptrs, signature_lengths, batch_random, batch_random_size,
+    results
+));
+CHECK_EQ(OLM_BAD_MESSAGE_MAC, ::olm_utility_last_error_code(utility));
+for (std::size_t i = 0; i < count; ++i) {
+    CHECK_EQ(i == 5 ? 0 : 1, results[i]);
+}
+
+olm_clear_utility(utility);
+free(utility_buffer);
+
+free(batch_random);
+free(id_keys);
+
+}
+
+
+TEST_CASE("Batch signing with small order components") {
+
+/* Signatures made with a key a B and the point T = (0, -1) of order 2:
+ * two with R = r B + T, then two with R = r B and the key a B + T, where h
+ * is even for the first, so that only it passes olm_ed25519_verify. */
+const std::size_t count = 4;
+const char * keys[count] = {
+    "U9MapM4Xtxhh3ZbnIlC7NRWPccNl1BJ/Y9siboZtVfY",
+    "U9MapM4Xtxhh3ZbnIlC7NRWPccNl1BJ/Y9siboZtVfY",
+    "mizlWzHoSOeeImkY3a9EyupwjjyaK+2AnCTdkXmSqgk",
+    "mizlWzHoSOeeImkY3a9EyupwjjyaK+2AnCTdkXmSqgk",
+};
+const char * messages[count] = {
+    "torsion in R 1",
+    "torsion in R 2",
+    "torsion in A 1",
+    "torsion in A 2",
+};
+const char * signatures[count] = {
+    "/YNzia4daK39vmtMf6pK20jZOXjmnHlsAoEsROaCdj3lGigWhfcamApE1YlsAA8RvTGgohsfuOcfd4YSgMhxDQ",
+    "Kn7ruHjoTMbIsOX6Xe+bTpLiHCPH3UeZkfu3lJGkTCxIY1GlR8tMMIAy0bvTznpSVMaa2p2v8ckDOj4cuHv6AA",
+    "6A+L2NA10MkGe7zPhJ3ERLpHSX+o7MTNO38bjXzOnQAPFCFdYkpfQzsW73YTKtkZNJQlGxYpci4cKG+t7cQyDw",
+    "0WGsTL7hwhIM6MpTveWZi+QaB6Cdfesvakw8lJZi3rxk8AV+XEeNcw4M8jwnMNERDd7ZD7dN/gA2UGXHHTHSBQ",
+};
+
+void const * key_ptrs[count];
+std::size_t key_lengths[count];
+void const * message_ptrs[count];
+std::size_t message_lengths[count];
+std::uint8_t signature_buffers[count][86];
+void * signature_ptrs[count];
+std::size_t signature_lengths[count];
+int expected[count];
+int results[count];
+
+void * utility_buffer = check_malloc(::olm_utility_size());
+::OlmUtility * utility = ::olm_utility(utility_buffer);
+
+for (std::size_t i = 0; i < count; ++i) {
+    key_ptrs[i] = keys[i];
+    key_lengths[i] = std::strlen(keys[i]);
+    message_ptrs[i] = messages[i];
+    message_lengths[i] = std::strlen(messages[i]);
+    std::memcpy(signature_buffers[i], signatures[i], 86);
+    signature_ptrs[i] = signature_buffers[i];
+    signature_lengths[i] = 86;
+    expected[i] = std::size_t(-1) != ::olm_ed25519_verify(
+        utility, keys[i], key_lengths[i], messages[i], message_lengths[i],
+        signature_buffers[i], 86
+    );
+}
+CHECK_EQ(0, expected[0]);
+CHECK_EQ(0, expected[1]);
+CHECK_EQ(1, expected[2]);
+CHECK_EQ(0, expected[3]);
+
+MockRandom mock_random_b('B', 0x00);
+std::size_t batch_random_size = ::olm_ed25519_verify_batch_random_length(
+    utility, count
+);
+std::uint8_t * batch_random = check_malloc(batch_random_size);
+mock_random_b(batch_random, batch_random_size);
+
+/* the order 2 components of the first two cancel for odd z */
+for (std::size_t n = 1; n <= count; ++n) {
+    for (std::size_t i = 0; i < count; ++i) {
+        std::memcpy(signature_buffers[i], signatures[i], 86);
+        results[i] = -1;
+    }
+    CHECK_EQ(std::size_t(-1), ::olm_ed25519_verify_batch(
+        utility, n, key_ptrs, key_lengths, message_ptrs, message_lengths,
+        signature_ptrs, signature_lengths, batch_random, batch_random_size,
+        results
+    ));
+    CHECK_EQ(OLM_BAD_MESSAGE_MAC, ::olm_utility_last_error_code(utility));
+    for (std::size_t i = 0; i < n; ++i) {
+        CHECK_EQ(expected[i], results[i]);
+    }
+}
+
+/* the only valid one on its own */
+std::memcpy(signature_buffers[2], signatures[2], 86);
+CHECK_EQ(std::size_t(0), ::olm_ed25519_verify_batch(
+    utility, 1, key_ptrs + 2, key_lengths + 2, message_ptrs + 2,
+    message_lengths + 2, signature_ptrs + 2, signature_lengths + 2,
+    batch_random, batch_random_size, results + 2
+));
+CHECK_EQ(1, results[2]);
+
+olm_clear_utility(utility);
+free(utility_buffer);
+
+free(batch_random);
+
+}
+
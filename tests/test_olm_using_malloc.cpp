@@ -99,6 +99,8 @@ CHECK_NE(std::size_t(-1), ::olm_create_outbound_session(
     a_rand, a_rand_size
 ));
 free(b_id_keys);
+free(b_pre_key);
+free(b_pre_key_signature);
 free(b_ot_keys);
 free(a_rand);
 
@@ -16,6 +16,7 @@
 #include "olm/cipher.h"
 #include "testing.hh"
 
+#include <cstring>
 #include <vector>
 
 std::uint8_t root_info[] = "Olm";
@@ -220,3 +221,103 @@ random[31]++;
 
 }
 
+
+
+TEST_CASE("Skipped message key store") {
+
+olm::SkippedMessageKeys keys(8);
+olm::SkippedMessageKey key = {};
+std::memset(key.ratchet_key.public_key, 'A', CURVE25519_KEY_LENGTH);
+_olm_curve25519_public_key other_ratchet_key;
+std::memset(other_ratchet_key.public_key, 'B', CURVE25519_KEY_LENGTH);
+
+for (std::uint32_t i = 0; i < 12; ++i) {
+    key.message_key.index = i;
+    keys.insert(key);
+}
+/* the oldest keys are dropped */
+CHECK_EQ(std::size_t(8), keys.size());
+CHECK(nullptr == keys.find(key.ratchet_key, 3));
+CHECK(nullptr != keys.find(key.ratchet_key, 4));
+CHECK(nullptr == keys.find(other_ratchet_key, 4));
+
+keys.erase(keys.find(key.ratchet_key, 6));
+keys.erase(keys.find(key.ratchet_key, 9));
+CHECK_EQ(std::size_t(6), keys.size());
+CHECK(nullptr == keys.find(key.ratchet_key, 6));
+
+for (std::uint32_t i = 12; i < 15; ++i) {
+    key.message_key.index = i;
+    keys.insert(key);
+}
+CHECK_EQ(std::size_t(8), keys.size());
+
+std::vector<std::uint32_t> indices;
+for (auto const & skipped : keys) {
+    indices.push_back(skipped.message_key.index);
+}
+std::vector<std::uint32_t> expected = {14, 13, 12, 11, 10, 8, 7, 5};
+CHECK(expected == indices);
+CHECK_EQ(std::uint32_t(10), keys.find(key.ratchet_key, 10)->message_key.index);
+
+keys.set_max_size(3);
+CHECK_EQ(std::size_t(3), keys.size());
+CHECK(nullptr == keys.find(key.ratchet_key, 11));
+CHECK(nullptr != keys.find(key.ratchet_key, 12));
+
+} /* Skipped message key store */
+
+
+TEST_CASE("Olm Skipped Message Key Limit") {
+
+olm::Ratchet alice(kdf_info, cipher);
+olm::Ratchet bob(kdf_info, cipher);
+
+alice.initialise_as_alice(shared_secret, sizeof(shared_secret) - 1, alice_key);
+bob.initialise_as_bob(shared_secret, sizeof(shared_secret) - 1, alice_key.public_key);
+bob.skipped_message_keys.set_max_size(2);
+
+std::uint8_t plaintext[] = "Message";
+std::uint8_t random[] = "This is a random 32 byte string.";
+std::vector<std::vector<std::uint8_t>> messages;
+
+for (unsigned i = 0; i < 5; ++i) {
+    std::vector<std::uint8_t> message(alice.encrypt_output_length(7));
+    alice.encrypt(
+        plaintext, 7, random, i ? 0 : 32, message.data(), message.size()
+    );
+    messages.push_back(message);
+}
+
+/* a bad MAC leaves bob's ratchet unchanged */
+std::vector<std::uint8_t> forged(messages[4]);
+forged.back() ^= 1;
+std::vector<std::uint8_t> output(
+    bob.decrypt_max_plaintext_length(forged.data(), forged.size())
+);
+CHECK_EQ(std::size_t(-1), bob.decrypt(
+    forged.data(), forged.size(), output.data(), output.size()
+));
+CHECK_EQ(std::uint32_t(0), bob.receiver_chains[0].chain_key.index);
+CHECK(bob.skipped_message_keys.empty());
+
+CHECK_EQ(std::size_t(7), bob.decrypt(
+    messages[4].data(), messages[4].size(), output.data(), output.size()
+));
+CHECK_EQ_SIZE(plaintext, output.data(), 7);
+CHECK_EQ(std::size_t(2), bob.skipped_message_keys.size());
+
+/* only the newest of the skipped keys are kept */
+CHECK_EQ(std::size_t(7), bob.decrypt(
+    messages[2].data(), messages[2].size(), output.data(), output.size()
+));
+CHECK_EQ(std::size_t(7), bob.decrypt(
+    messages[3].data(), messages[3].size(), output.data(), output.size()
+));
+CHECK_EQ(std::size_t(-1), bob.decrypt(
+    messages[1].data(), messages[1].size(), output.data(), output.size()
+));
+CHECK_EQ(OlmErrorCode::OLM_ALREADY_DECRYPTED_OR_KEYS_SKIPPED, bob.last_error);
+CHECK(bob.skipped_message_keys.empty());
+
+} /* Olm Skipped Message Key Limit */
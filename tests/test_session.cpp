@@ -133,3 +133,44 @@ TEST_CASE("V2 session pickle") {
 
     check_session(session);
 }
+
+TEST_CASE("Session id") {
+
+    const uint8_t *PICKLE_KEY=(uint8_t *)"secret_key";
+    uint8_t pickled[] =
+        "jfeWFTiR6UrMw1bfBAiq8boj5VyCU8mv8T7zsn3FvtLJKET1OUg3B/RdSza+TtgfNBo7sEkQh"
+        "sBjr4IkWiL6eCxxqOksuJfsbtpDjs6wBEfi3UCNa9gyKQyrL9gQ80TqTjQoakkAIkJQxPBGBX"
+        "kgxrPoItfykTNd+sWK0BBqyIhLCt55yzoEjoOUfhAEteA/oZE/Vfs783NmnQwee3uwUzyfMUm"
+        "kewQkSGjdXtfULdWcne6fh8FXpe7s9ZILzDPrWYiozuRt2g2ANPxf6si9YsoI3BGs56hrn/KE"
+        "I27SyFPh2DOq5UY+M7B/dPHvufvrBryDGJ0J0G6VH4MFD3sDr92Skm/UY5OV/Yclx+T/DW4ZD"
+        "wjEMK+DV7DytCKBTXEb2kYArnb4a50";
+
+    _olm_enc_input(
+        PICKLE_KEY, strlen((char *)PICKLE_KEY),
+        pickled, strlen((char *)pickled), NULL
+    );
+
+    olm::Session session;
+    olm::unpickle(pickled, pickled+sizeof(pickled), session);
+
+    /* the ID is the SHA-256 of the identity, base and one time keys only */
+    std::uint8_t expected_id[32];
+    std::memcpy(
+        expected_id,
+        decode_hex("564b09e7df99e1822443d878bb68f3a42b9a2ef4c9caec40a32b69b1879781d6"),
+        32
+    );
+
+    CHECK_EQ(std::size_t(32), session.session_id_length());
+    std::uint8_t session_id[32];
+    CHECK_EQ(std::size_t(32), session.session_id(session_id, sizeof(session_id)));
+    CHECK_EQ_SIZE(expected_id, session_id, 32);
+
+    /* the prekey must not change the ID */
+    std::memset(session.bob_prekey.public_key, 0x42, 32);
+    CHECK_EQ(std::size_t(32), session.session_id(session_id, sizeof(session_id)));
+    CHECK_EQ_SIZE(expected_id, session_id, 32);
+
+    CHECK_EQ(std::size_t(-1), session.session_id(session_id, 31));
+    CHECK_EQ(OLM_OUTPUT_BUFFER_TOO_SMALL, session.last_error);
+}